@@ -6,6 +6,8 @@ QT_FOR_PRIVATE = network
 QMAKE_DOCS = $$PWD/doc/qtcoap.qdocconf
 
 PUBLIC_HEADERS += \
+    qcoapasync.h \
+    qcoapbatch.h \
     qcoapclient.h \
     qcoapglobal.h \
     qcoapmessage.h \
@@ -13,42 +15,75 @@ PUBLIC_HEADERS += \
     qcoapoption.h \
     qcoapreply.h \
     qcoaprequest.h \
+    qcoaprequesthandle.h \
     qcoapresource.h \
     qcoapresourcediscoveryreply.h \
+    qcoapresult.h \
+    qcoaproundtripstatistics.h \
     qcoapsecurityconfiguration.h
 
 PRIVATE_HEADERS += \
+    qcoapasync_p.h \
+    qcoapbatch_p.h \
+    qcoapblocksizecontroller_p.h \
+    qcoapcallbackexchange_p.h \
     qcoapclient_p.h \
     qcoapconnection_p.h \
+    qcoapendpoint_p.h \
     qcoapinternalmessage_p.h \
     qcoapinternalreply_p.h \
     qcoapinternalrequest_p.h \
+    qcoaplockfreequeue_p.h \
     qcoapmessage_p.h \
+    qcoapmessageidallocator_p.h \
     qcoapnamespace_p.h \
     qcoapoption_p.h \
+    qcoappduview_p.h \
     qcoapprotocol_p.h \
+    qcoapqtcpconnection_p.h \
     qcoapqudpconnection_p.h \
     qcoapreply_p.h \
+    qcoapreplydispatcher_p.h \
     qcoaprequest_p.h \
+    qcoaprequestscheduler_p.h \
     qcoapresource_p.h \
-    qcoapresourcediscoveryreply_p.h
+    qcoapresourcediscoveryreply_p.h \
+    qcoaprttestimator_p.h \
+    qcoaptimerwheel_p.h \
+    qcoaptokengenerator_p.h \
+    qcoapuploadsource_p.h
 
 SOURCES += \
+    qcoapasync.cpp \
+    qcoapbatch.cpp \
+    qcoapblocksizecontroller.cpp \
     qcoapclient.cpp \
     qcoapconnection.cpp \
+    qcoapendpoint.cpp \
     qcoapinternalmessage.cpp \
     qcoapinternalreply.cpp \
     qcoapinternalrequest.cpp \
     qcoapmessage.cpp \
+    qcoapmessageidallocator.cpp \
     qcoapnamespace.cpp \
     qcoapoption.cpp \
+    qcoappduview.cpp \
     qcoapprotocol.cpp \
+    qcoapqtcpconnection.cpp \
     qcoapqudpconnection.cpp \
     qcoapreply.cpp \
+    qcoapreplydispatcher.cpp \
     qcoaprequest.cpp \
+    qcoaprequesthandle.cpp \
+    qcoaprequestscheduler.cpp \
     qcoapresource.cpp \
     qcoapresourcediscoveryreply.cpp \
-    qcoapsecurityconfiguration.cpp
+    qcoapresult.cpp \
+    qcoaprttestimator.cpp \
+    qcoapsecurityconfiguration.cpp \
+    qcoaptimerwheel.cpp \
+    qcoaptokengenerator.cpp \
+    qcoapuploadsource.cpp
 
 HEADERS += $$PUBLIC_HEADERS $$PRIVATE_HEADERS
 
@@ -0,0 +1,396 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapasync_p.h"
+#include "qcoapreply.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCoapAsyncResult
+    \inmodule QtCoap
+
+    \brief The QCoapAsyncResult class holds the pending result of a request
+    sent with one of the asynchronous methods of QCoapClient.
+
+    \reentrant
+
+    With a C++20 compiler, a QCoapAsyncResult can be awaited in a
+    coroutine, which is resumed with the QCoapResult of the request:
+
+    \code
+        QCoapResult result = co_await client->getAsync(QUrl("coap://coap.me/test"));
+    \endcode
+
+    The coroutine is resumed from the delivery of the result, in the thread
+    of the client, without going through the event loop again. Destroying
+    the suspended coroutine, or the QCoapAsyncResult of a request which did
+    not complete, cancels the request.
+
+    Without coroutines, a continuation can be set with setContinuation()
+    to be called once the result is ready, which is then taken with
+    takeResult().
+
+    A QCoapAsyncResult can be moved, but not copied.
+
+    \sa QCoapClient::getAsync(), QCoapNotificationStream
+*/
+
+/*!
+    \internal
+
+    Returns the callback passing its result to the pending \a state. The
+    callback does not keep the state alive, since the state holds the
+    handle of the request.
+*/
+QCoapResultCallback QCoapAsyncResultPrivate::callback(
+        const QSharedPointer<QCoapAsyncResultPrivate> &state)
+{
+    const QWeakPointer<QCoapAsyncResultPrivate> weakState = state;
+    return [weakState](QCoapResult result) {
+        if (const auto strongState = weakState.toStrongRef())
+            strongState->setResult(std::move(result));
+    };
+}
+
+/*!
+    \internal
+
+    Stores the \a newResult and calls the continuation, if any.
+*/
+void QCoapAsyncResultPrivate::setResult(QCoapResult &&newResult)
+{
+    result = std::move(newResult);
+    isReady = true;
+
+    std::function<void()> call;
+    call.swap(continuation);
+    if (call)
+        call();
+}
+
+/*!
+    Constructs a null result.
+*/
+QCoapAsyncResult::QCoapAsyncResult()
+{
+}
+
+/*!
+    \internal
+
+    Constructs a result waiting for the pending \a state.
+*/
+QCoapAsyncResult::QCoapAsyncResult(const QSharedPointer<QCoapAsyncResultPrivate> &state) :
+    d(state)
+{
+}
+
+/*!
+    Move-constructs a result from \a other, which becomes null.
+*/
+QCoapAsyncResult::QCoapAsyncResult(QCoapAsyncResult &&other) :
+    d(std::move(other.d))
+{
+    other.d.reset();
+}
+
+/*!
+    Destroys the result, and cancels the request if its result was not
+    received yet.
+*/
+QCoapAsyncResult::~QCoapAsyncResult()
+{
+    cancel();
+}
+
+/*!
+    Move-assigns \a other to this result, and cancels the request this
+    result was waiting for, if any.
+*/
+QCoapAsyncResult &QCoapAsyncResult::operator=(QCoapAsyncResult &&other)
+{
+    if (this != &other) {
+        cancel();
+        d = std::move(other.d);
+        other.d.reset();
+    }
+    return *this;
+}
+
+/*!
+    Returns \c true if the result does not refer to a request.
+*/
+bool QCoapAsyncResult::isNull() const
+{
+    return d.isNull();
+}
+
+/*!
+    Returns \c true if the result of the request was received, or if the
+    request could not be sent.
+*/
+bool QCoapAsyncResult::isReady() const
+{
+    return d && d->isReady;
+}
+
+/*!
+    Returns the result of the request, and leaves a default QCoapResult in
+    its place. If the result is not ready, the error of the returned result
+    is QtCoap::Error::Unknown.
+*/
+QCoapResult QCoapAsyncResult::takeResult()
+{
+    if (!isReady()) {
+        QCoapResult result;
+        result.error = QtCoap::Error::Unknown;
+        return result;
+    }
+
+    return std::move(d->result);
+}
+
+/*!
+    Sets the \a continuation called once the result is ready, in the thread
+    of the client. If the result is already ready, the continuation is
+    called immediately.
+*/
+void QCoapAsyncResult::setContinuation(const std::function<void()> &continuation)
+{
+    if (!d)
+        return;
+
+    if (d->isReady) {
+        continuation();
+        return;
+    }
+
+    d->continuation = continuation;
+}
+
+/*!
+    Cancels the request if its result was not received yet. The
+    continuation is not called after the request is cancelled.
+
+    \sa QCoapRequestHandle::cancel()
+*/
+void QCoapAsyncResult::cancel()
+{
+    if (!d || d->isReady)
+        return;
+
+    d->handle.cancel();
+    d->continuation = nullptr;
+}
+
+/*!
+    \class QCoapNotificationStream
+    \inmodule QtCoap
+
+    \brief The QCoapNotificationStream class delivers the notifications of
+    an observed resource to a coroutine.
+
+    \reentrant
+
+    With a C++20 compiler, awaiting a QCoapNotificationStream returns its
+    next notification, or \c std::nullopt once the observation is over:
+
+    \code
+        QCoapNotificationStream stream = client->observeAsync(url);
+        while (std::optional<QCoapMessage> notification = co_await stream)
+            process(notification->payload());
+    \endcode
+
+    Notifications received while the coroutine is busy are queued. The
+    coroutine is resumed from the delivery of the notification, in the
+    thread of the client. Destroying the stream aborts the observation, as
+    QCoapReply::abortRequest() does.
+
+    A QCoapNotificationStream can be moved, but not copied.
+
+    \sa QCoapClient::observeAsync(), QCoapAsyncResult
+*/
+
+/*!
+    \internal
+
+    Calls the continuation, if any.
+*/
+void QCoapNotificationStreamPrivate::resume()
+{
+    std::function<void()> call;
+    call.swap(continuation);
+    if (call)
+        call();
+}
+
+/*!
+    Constructs a null stream.
+*/
+QCoapNotificationStream::QCoapNotificationStream()
+{
+}
+
+/*!
+    \internal
+
+    Constructs a stream of the notifications received by \a reply, which is
+    owned by the stream. A null \a reply makes a finished stream.
+*/
+QCoapNotificationStream::QCoapNotificationStream(QCoapReply *reply) :
+    d(QSharedPointer<QCoapNotificationStreamPrivate>::create())
+{
+    d->reply = reply;
+    if (!reply) {
+        d->isFinished = true;
+        return;
+    }
+
+    // The connections keep the state alive as long as the reply
+    const QSharedPointer<QCoapNotificationStreamPrivate> state = d;
+    QObject::connect(reply, &QCoapReply::notified, reply,
+                     [state](QCoapReply *, const QCoapMessage &message) {
+        state->notifications.enqueue(message);
+        state->resume();
+    });
+    QObject::connect(reply, &QCoapReply::finished, reply, [state]() {
+        state->isFinished = true;
+        state->resume();
+    });
+}
+
+/*!
+    Move-constructs a stream from \a other, which becomes null.
+*/
+QCoapNotificationStream::QCoapNotificationStream(QCoapNotificationStream &&other) :
+    d(std::move(other.d))
+{
+    other.d.reset();
+}
+
+/*!
+    Destroys the stream, and aborts the observation if it is not over.
+*/
+QCoapNotificationStream::~QCoapNotificationStream()
+{
+    cancel();
+}
+
+/*!
+    Move-assigns \a other to this stream, and aborts the observation of this
+    stream, if any.
+*/
+QCoapNotificationStream &QCoapNotificationStream::operator=(QCoapNotificationStream &&other)
+{
+    if (this != &other) {
+        cancel();
+        d = std::move(other.d);
+        other.d.reset();
+    }
+    return *this;
+}
+
+/*!
+    Returns \c true if the stream does not refer to an observation.
+*/
+bool QCoapNotificationStream::isNull() const
+{
+    return d.isNull();
+}
+
+/*!
+    Returns \c true if the observation is over. Notifications may still be
+    pending.
+*/
+bool QCoapNotificationStream::isFinished() const
+{
+    return !d || d->isFinished;
+}
+
+/*!
+    Returns \c true if a notification can be taken with takeNotification().
+*/
+bool QCoapNotificationStream::hasPendingNotification() const
+{
+    return d && !d->notifications.isEmpty();
+}
+
+/*!
+    Returns the oldest pending notification, or an empty message if there
+    is none.
+*/
+QCoapMessage QCoapNotificationStream::takeNotification()
+{
+    if (!hasPendingNotification())
+        return QCoapMessage();
+
+    return d->notifications.dequeue();
+}
+
+/*!
+    Sets the \a continuation called once, when the next notification is
+    received or the observation is over, in the thread of the client.
+*/
+void QCoapNotificationStream::setContinuation(const std::function<void()> &continuation)
+{
+    if (d)
+        d->continuation = continuation;
+}
+
+/*!
+    Aborts the observation, as QCoapReply::abortRequest() does, and
+    destroys its reply. The continuation is not called afterwards.
+*/
+void QCoapNotificationStream::cancel()
+{
+    if (!d)
+        return;
+
+    d->continuation = nullptr;
+    d->isFinished = true;
+    if (!d->reply.isNull()) {
+        QCoapReply *reply = d->reply;
+        d->reply.clear();
+        QObject::disconnect(reply, nullptr, reply, nullptr);
+        reply->abortRequest();
+        reply->deleteLater();
+    }
+}
+
+/*!
+    Returns the reply of the observation, or \c nullptr if the stream is
+    null or cancelled.
+*/
+QCoapReply *QCoapNotificationStream::reply() const
+{
+    return d ? d->reply.data() : nullptr;
+}
+
+QT_END_NAMESPACE
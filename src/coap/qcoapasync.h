@@ -0,0 +1,159 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPASYNC_H
+#define QCOAPASYNC_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapmessage.h>
+#include <QtCoap/qcoapresult.h>
+#include <QtCore/qsharedpointer.h>
+
+#include <functional>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#  if __has_include(<coroutine>)
+#    include <coroutine>
+#    include <optional>
+#    define QT_COAP_COROUTINES
+#  endif
+#endif
+
+QT_BEGIN_NAMESPACE
+
+class QCoapReply;
+
+class QCoapAsyncResultPrivate;
+class Q_COAP_EXPORT QCoapAsyncResult
+{
+public:
+    QCoapAsyncResult();
+    QCoapAsyncResult(QCoapAsyncResult &&other);
+    ~QCoapAsyncResult();
+
+    QCoapAsyncResult &operator=(QCoapAsyncResult &&other);
+
+    bool isNull() const;
+    bool isReady() const;
+    QCoapResult takeResult();
+    void setContinuation(const std::function<void()> &continuation);
+    void cancel();
+
+private:
+    Q_DISABLE_COPY(QCoapAsyncResult)
+    explicit QCoapAsyncResult(const QSharedPointer<QCoapAsyncResultPrivate> &state);
+
+    QSharedPointer<QCoapAsyncResultPrivate> d;
+
+    friend class QCoapClientPrivate;
+};
+
+class QCoapNotificationStreamPrivate;
+class Q_COAP_EXPORT QCoapNotificationStream
+{
+public:
+    QCoapNotificationStream();
+    QCoapNotificationStream(QCoapNotificationStream &&other);
+    ~QCoapNotificationStream();
+
+    QCoapNotificationStream &operator=(QCoapNotificationStream &&other);
+
+    bool isNull() const;
+    bool isFinished() const;
+    bool hasPendingNotification() const;
+    QCoapMessage takeNotification();
+    void setContinuation(const std::function<void()> &continuation);
+    void cancel();
+
+    QCoapReply *reply() const;
+
+private:
+    Q_DISABLE_COPY(QCoapNotificationStream)
+    explicit QCoapNotificationStream(QCoapReply *reply);
+
+    QSharedPointer<QCoapNotificationStreamPrivate> d;
+
+    friend class QCoapClient;
+};
+
+#ifdef QT_COAP_COROUTINES
+
+// Awaiting a QCoapAsyncResult suspends the coroutine until the result of the
+// request is received. The coroutine is resumed by the delivery of the
+// result, in the thread of the client. Destroying the suspended coroutine
+// cancels the request.
+struct QCoapResultAwaiter
+{
+    QCoapAsyncResult pending;
+
+    bool await_ready() const { return pending.isNull() || pending.isReady(); }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        pending.setContinuation([handle]() { handle.resume(); });
+    }
+    QCoapResult await_resume() { return pending.takeResult(); }
+};
+
+inline QCoapResultAwaiter operator co_await(QCoapAsyncResult &&pending)
+{
+    return QCoapResultAwaiter{ std::move(pending) };
+}
+
+// Awaiting a QCoapNotificationStream returns its next notification, or
+// std::nullopt once the observation is over.
+struct QCoapNotificationAwaiter
+{
+    QCoapNotificationStream &stream;
+
+    bool await_ready() const
+    {
+        return stream.isNull() || stream.hasPendingNotification() || stream.isFinished();
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        stream.setContinuation([handle]() { handle.resume(); });
+    }
+    std::optional<QCoapMessage> await_resume()
+    {
+        if (!stream.hasPendingNotification())
+            return std::nullopt;
+        return stream.takeNotification();
+    }
+};
+
+inline QCoapNotificationAwaiter operator co_await(QCoapNotificationStream &stream)
+{
+    return QCoapNotificationAwaiter{ stream };
+}
+
+#endif // QT_COAP_COROUTINES
+
+QT_END_NAMESPACE
+
+#endif // QCOAPASYNC_H
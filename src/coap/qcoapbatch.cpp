@@ -0,0 +1,300 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapbatch_p.h"
+#include "qcoapcallbackexchange_p.h"
+#include "qcoapprotocol_p.h"
+
+#include <QtCore/qhash.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCoapBatch
+    \inmodule QtCoap
+
+    \brief The QCoapBatch class refers to a batch of requests sent with
+    QCoapClient::sendBatch().
+
+    \reentrant
+
+    The requests of a batch are validated once, and submitted to the
+    protocol all together instead of one at a time. No QCoapReply is
+    created for them: the result of each request is kept in the batch, in
+    the order of the requests, until it is taken with takeResult().
+
+    A QCoapBatch can be copied cheaply, and dropping it does not affect the
+    requests. Its methods must be called from the thread of the client.
+
+    \sa QCoapResult, QCoapRequestHandle
+*/
+
+/*!
+    \internal
+
+    \class QCoapBatchPrivate
+    \brief The QCoapBatchPrivate class holds the state of a batch of
+    requests.
+
+    It is shared by the handles of the batch, and by the callbacks of its
+    running requests, which are only called in the thread of the client.
+*/
+
+/*!
+    \internal
+
+    Marks the request at \a index as finished, without sending it, with the
+    QtCoap::Error::Unknown error.
+*/
+void QCoapBatchPrivate::setInvalid(int index)
+{
+    Item &item = items[index];
+    item.result.error = QtCoap::Error::Unknown;
+    item.isFinished = true;
+    ++finishedCount;
+}
+
+/*!
+    \internal
+
+    Submits the requests not sent yet, up to the maximum number of running
+    requests, if any. The requests sent to the same protocol are submitted
+    together.
+*/
+void QCoapBatchPrivate::submitPending()
+{
+    QHash<QCoapProtocol *, QVector<QCoapCallbackSubmission>> submissions;
+    const QSharedPointer<QCoapBatchPrivate> self = sharedFromThis();
+
+    while (nextIndex < items.size()
+           && (maximumConcurrency <= 0 || runningCount < maximumConcurrency)) {
+        const int index = nextIndex++;
+        Item &item = items[index];
+        if (item.isFinished)
+            continue;
+
+        QCoapCallbackSubmission submission;
+        submission.exchange = QSharedPointer<QCoapCallbackExchange>::create(
+                    item.request, [self, index](QCoapResult result) {
+            self->onItemFinished(index, std::move(result));
+        });
+        submission.connection = item.connection;
+        item.exchange = submission.exchange;
+        ++runningCount;
+
+        submissions[item.protocol].append(submission);
+    }
+
+    for (auto it = submissions.begin(); it != submissions.end(); ++it)
+        it.key()->d_func()->submitBatch(std::move(it.value()));
+}
+
+/*!
+    \internal
+
+    Stores the \a result of the request at \a index, and submits the next
+    request waiting for a running one to finish.
+*/
+void QCoapBatchPrivate::onItemFinished(int index, QCoapResult &&result)
+{
+    Item &item = items[index];
+    item.result = std::move(result);
+    item.isFinished = true;
+    --runningCount;
+    ++finishedCount;
+
+    if (isCancelled)
+        return;
+
+    submitPending();
+
+    if (finishedCount == items.size()) {
+        std::function<void()> call;
+        call.swap(finishedCallback);
+        if (call)
+            call();
+    }
+}
+
+/*!
+    Constructs a null batch.
+*/
+QCoapBatch::QCoapBatch()
+{
+}
+
+/*!
+    \internal
+
+    Constructs a handle referring to \a batch.
+*/
+QCoapBatch::QCoapBatch(const QSharedPointer<QCoapBatchPrivate> &batch) :
+    d(batch)
+{
+}
+
+/*!
+    Constructs a copy of the \a other batch handle.
+*/
+QCoapBatch::QCoapBatch(const QCoapBatch &other) :
+    d(other.d)
+{
+}
+
+/*!
+    Destroys the batch handle. The requests are not affected.
+*/
+QCoapBatch::~QCoapBatch()
+{
+}
+
+/*!
+    Copies the \a other batch handle into this one.
+*/
+QCoapBatch &QCoapBatch::operator=(const QCoapBatch &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Returns \c true if the handle does not refer to a batch.
+*/
+bool QCoapBatch::isNull() const
+{
+    return d.isNull();
+}
+
+/*!
+    Returns the number of requests of the batch.
+*/
+int QCoapBatch::size() const
+{
+    return d ? d->items.size() : 0;
+}
+
+/*!
+    Returns the number of requests of the batch which are finished,
+    including the requests which could not be sent.
+*/
+int QCoapBatch::finishedCount() const
+{
+    return d ? d->finishedCount : 0;
+}
+
+/*!
+    Returns \c true if all the requests of the batch are finished.
+*/
+bool QCoapBatch::isFinished() const
+{
+    return d && d->finishedCount == d->items.size();
+}
+
+/*!
+    Returns \c true if the batch was cancelled.
+
+    \sa cancel()
+*/
+bool QCoapBatch::isCancelled() const
+{
+    return d && d->isCancelled;
+}
+
+/*!
+    \overload
+
+    Returns \c true if the request at \a index is finished, in which case
+    its result can be taken with takeResult().
+*/
+bool QCoapBatch::isFinished(int index) const
+{
+    return d && index >= 0 && index < d->items.size() && d->items.at(index).isFinished;
+}
+
+/*!
+    Returns the result of the request at \a index, and clears it from the
+    batch. A request which could not be sent has the
+    QtCoap::Error::Unknown error.
+
+    The result is empty if the request is not finished yet.
+
+    \sa isFinished()
+*/
+QCoapResult QCoapBatch::takeResult(int index)
+{
+    if (!isFinished(index))
+        return QCoapResult();
+
+    QCoapResult result = std::move(d->items[index].result);
+    d->items[index].result = QCoapResult();
+    return result;
+}
+
+/*!
+    Sets the \a callback called once all the requests of the batch are
+    finished, in the thread of the client. If the batch is already
+    finished, the callback is called immediately.
+
+    The callback is not called after the batch is cancelled.
+*/
+void QCoapBatch::setFinishedCallback(const std::function<void()> &callback)
+{
+    if (!d || d->isCancelled)
+        return;
+
+    if (isFinished()) {
+        if (callback)
+            callback();
+        return;
+    }
+
+    d->finishedCallback = callback;
+}
+
+/*!
+    Cancels the requests of the batch which are not finished. The requests
+    not sent yet are not sent, and the results of the running requests are
+    ignored. The results of the finished requests are kept.
+*/
+void QCoapBatch::cancel()
+{
+    if (!d || d->isCancelled)
+        return;
+
+    d->isCancelled = true;
+    d->finishedCallback = nullptr;
+    d->nextIndex = d->items.size();
+
+    for (const QCoapBatchPrivate::Item &item : qAsConst(d->items)) {
+        if (const auto exchange = item.exchange.toStrongRef())
+            exchange->cancel();
+    }
+}
+
+QT_END_NAMESPACE
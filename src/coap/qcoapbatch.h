@@ -0,0 +1,73 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPBATCH_H
+#define QCOAPBATCH_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapresult.h>
+#include <QtCore/qsharedpointer.h>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+
+class QCoapBatchPrivate;
+class Q_COAP_EXPORT QCoapBatch
+{
+public:
+    QCoapBatch();
+    QCoapBatch(const QCoapBatch &other);
+    ~QCoapBatch();
+
+    QCoapBatch &operator=(const QCoapBatch &other);
+
+    bool isNull() const;
+    int size() const;
+    int finishedCount() const;
+    bool isFinished() const;
+    bool isCancelled() const;
+
+    bool isFinished(int index) const;
+    QCoapResult takeResult(int index);
+
+    void setFinishedCallback(const std::function<void()> &callback);
+    void cancel();
+
+private:
+    explicit QCoapBatch(const QSharedPointer<QCoapBatchPrivate> &batch);
+
+    QSharedPointer<QCoapBatchPrivate> d;
+
+    friend class QCoapClientPrivate;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPBATCH_H
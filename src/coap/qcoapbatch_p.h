@@ -0,0 +1,86 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPBATCH_P_H
+#define QCOAPBATCH_P_H
+
+#include <QtCoap/qcoapbatch.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCore/qvector.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QCoapCallbackExchange;
+class QCoapConnection;
+class QCoapProtocol;
+class Q_AUTOTEST_EXPORT QCoapBatchPrivate : public QEnableSharedFromThis<QCoapBatchPrivate>
+{
+public:
+    struct Item
+    {
+        // Validated request, and where it is sent
+        QCoapRequest request;
+        QCoapProtocol *protocol = nullptr;
+        QCoapConnection *connection = nullptr;
+
+        // Set once the request is submitted, the exchange is owned by the
+        // protocol, whose callback keeps the batch alive
+        QWeakPointer<QCoapCallbackExchange> exchange;
+
+        QCoapResult result;
+        bool isFinished = false;
+    };
+
+    void setInvalid(int index);
+    void submitPending();
+    void onItemFinished(int index, QCoapResult &&result);
+
+    QVector<Item> items;
+    int maximumConcurrency = 0;
+    int nextIndex = 0;
+    int runningCount = 0;
+    int finishedCount = 0;
+    bool isCancelled = false;
+    std::function<void()> finishedCallback;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPBATCH_P_H
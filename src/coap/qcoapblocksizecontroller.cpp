@@ -0,0 +1,371 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapblocksizecontroller_p.h"
+
+QT_BEGIN_NAMESPACE
+
+// Block sizes allowed by RFC 7959, in bytes
+static const uint minimumBlockSize = 16;
+static const uint maximumBlockSize = 1024;
+
+// Room left in a datagram for the CoAP header, the token and the options
+// of a block message
+static const int messageOverhead = 64;
+static const int udpHeaderSize = 8;
+
+// Number of clean transfers before the block size is doubled, and bound of
+// this number after repeated step downs
+static const int initialStepUpThreshold = 8;
+static const int maximumStepUpThreshold = 128;
+
+// Number of consecutive timeouts of a block before the block size is halved
+static const int lossThreshold = 2;
+
+// Endpoints without new transfers for this long are forgotten
+static const qint64 endpointIdleTimeout = 10 * 60 * 1000;
+
+/*!
+    \internal
+
+    \class QCoapBlockSizeController
+    \brief The QCoapBlockSizeController class adapts the size of the blocks
+    exchanged with each endpoint during blockwise transfers.
+
+    Each endpoint starts with the initial block size, bounded by the largest
+    block fitting in the path MTU configured for it. The block size is then
+    doubled after a number of transfers completed without retransmission,
+    and halved when a block times out repeatedly, which usually means that
+    the datagrams are fragmented and the fragments lost. Each step down
+    doubles the number of clean transfers needed for the next step up, so
+    that the block size does not keep oscillating around a fragmentation
+    threshold.
+
+    For more details, refer to
+    \l{https://tools.ietf.org/html/rfc7959#section-2.2}{RFC 7959 - Section 2.2}
+    and \l{https://tools.ietf.org/html/rfc7252#section-4.6}{RFC 7252 - Section 4.6}.
+*/
+
+/*!
+    \internal
+
+    Returns the block size used for endpoints without transfers, before it
+    is bounded by the path MTU.
+*/
+uint QCoapBlockSizeController::initialBlockSize() const
+{
+    return defaultBlockSize;
+}
+
+/*!
+    \internal
+
+    Sets the block size used for endpoints without transfers to
+    \a blockSize. The block size is 1024 if \a blockSize is 0.
+*/
+void QCoapBlockSizeController::setInitialBlockSize(uint blockSize)
+{
+    defaultBlockSize = blockSize > 0 ? qBound(minimumBlockSize, blockSize, maximumBlockSize)
+                                     : maximumBlockSize;
+}
+
+/*!
+    \internal
+
+    Returns the path MTU configured for \a host, using the most specific
+    subnet containing \a host, or 0 if it is unknown.
+*/
+int QCoapBlockSizeController::pathMtu(const QHostAddress &host) const
+{
+    int mtu = defaultPathMtu;
+    int bestPrefixLength = -1;
+    for (const PathMtu &path : pathMtus) {
+        if (path.prefixLength > bestPrefixLength
+                && host.isInSubnet(path.subnet, path.prefixLength)) {
+            mtu = path.mtu;
+            bestPrefixLength = path.prefixLength;
+        }
+    }
+    return mtu;
+}
+
+/*!
+    \internal
+
+    Sets the path MTU of the endpoints outside of the subnets with a
+    specific path MTU to \a mtu, in bytes. A value of 0 means that the path
+    MTU is unknown, so that the block size is only bounded to 1024.
+*/
+void QCoapBlockSizeController::setPathMtu(int mtu)
+{
+    defaultPathMtu = qMax(mtu, 0);
+}
+
+/*!
+    \internal
+
+    Sets the path MTU of the endpoints of the subnet \a subnet with a prefix
+    of \a prefixLength bits, typically the subnet of a network interface, to
+    \a mtu, in bytes. A value of 0 removes the path MTU of the subnet.
+*/
+void QCoapBlockSizeController::setPathMtu(const QHostAddress &subnet, int prefixLength, int mtu)
+{
+    for (auto it = pathMtus.begin(); it != pathMtus.end(); ++it) {
+        if (it->prefixLength == prefixLength && it->subnet.isEqual(subnet)) {
+            if (mtu > 0)
+                it->mtu = mtu;
+            else
+                pathMtus.erase(it);
+            return;
+        }
+    }
+
+    if (mtu > 0) {
+        PathMtu path;
+        path.subnet = subnet;
+        path.prefixLength = prefixLength;
+        path.mtu = mtu;
+        pathMtus.append(path);
+    }
+}
+
+/*!
+    \internal
+
+    Returns the block size to use for the next blocks exchanged with
+    \a host.
+*/
+uint QCoapBlockSizeController::blockSize(const QHostAddress &host) const
+{
+    const uint maximum = maximumBlockSize(host);
+    const auto it = endpoints.constFind(host);
+    if (it == endpoints.constEnd())
+        return qMin(defaultBlockSize, maximum);
+
+    return qMin(it->blockSize, maximum);
+}
+
+/*!
+    \internal
+
+    Returns the largest block size whose messages fit in the path MTU of
+    \a host.
+*/
+uint QCoapBlockSizeController::maximumBlockSize(const QHostAddress &host) const
+{
+    return blockSizeForMtu(pathMtu(host), host.protocol());
+}
+
+/*!
+    \internal
+
+    Records a block of \a blockSize bytes exchanged with \a host at the time
+    \a now, in milliseconds, after \a retransmissions retransmissions. The
+    block size of \a host is doubled once enough blocks of the current size
+    are exchanged without retransmission.
+*/
+void QCoapBlockSizeController::addTransfer(const QHostAddress &host, uint blockSize,
+                                           uint retransmissions, qint64 now)
+{
+    EndpointState &state = endpointState(host, now);
+
+    // The block got through, so its losses were not caused by its size
+    state.lossCount = 0;
+
+    if (retransmissions > 0) {
+        state.cleanTransferCount = 0;
+        return;
+    }
+
+    // Blocks sent before the last change do not count
+    if (blockSize < state.blockSize)
+        return;
+
+    if (++state.cleanTransferCount >= state.stepUpThreshold) {
+        state.cleanTransferCount = 0;
+        if (state.blockSize < maximumBlockSize(host))
+            state.blockSize *= 2;
+    }
+}
+
+/*!
+    \internal
+
+    Records the timeout of a block of \a blockSize bytes exchanged with
+    \a host at the time \a now, in milliseconds. Returns \c true if blocks
+    smaller than \a blockSize should be used from now on, in which case
+    blockSize() returns the new block size.
+*/
+bool QCoapBlockSizeController::addLoss(const QHostAddress &host, uint blockSize, qint64 now)
+{
+    EndpointState &state = endpointState(host, now);
+    state.cleanTransferCount = 0;
+
+    // The block size was already reduced by the losses of other blocks
+    if (blockSize > state.blockSize)
+        return true;
+
+    if (blockSize < state.blockSize || blockSize <= minimumBlockSize)
+        return false;
+
+    if (++state.lossCount < lossThreshold)
+        return false;
+
+    state.lossCount = 0;
+    state.blockSize = qMax(minimumBlockSize, blockSize / 2);
+    state.stepUpThreshold = qMin(state.stepUpThreshold * 2, maximumStepUpThreshold);
+    ++state.stepDownCount;
+    return true;
+}
+
+/*!
+    \internal
+
+    Bounds the block size of \a host to the \a blockSize chosen by the
+    server at the time \a now, in milliseconds.
+*/
+void QCoapBlockSizeController::limitBlockSize(const QHostAddress &host, uint blockSize,
+                                              qint64 now)
+{
+    EndpointState &state = endpointState(host, now);
+    if (blockSize < state.blockSize) {
+        state.blockSize = qMax(minimumBlockSize, blockSize);
+        state.cleanTransferCount = 0;
+    }
+}
+
+/*!
+    \internal
+
+    Returns the state of the block size of \a host.
+*/
+QCoapBlockSizeController::Statistics
+QCoapBlockSizeController::statistics(const QHostAddress &host) const
+{
+    Statistics statistics;
+    statistics.blockSize = blockSize(host);
+    statistics.maximumBlockSize = maximumBlockSize(host);
+    statistics.stepUpThreshold = initialStepUpThreshold;
+
+    const auto it = endpoints.constFind(host);
+    if (it != endpoints.constEnd()) {
+        statistics.cleanTransferCount = it->cleanTransferCount;
+        statistics.stepUpThreshold = it->stepUpThreshold;
+        statistics.stepDownCount = it->stepDownCount;
+        statistics.lastUpdate = it->lastUpdate;
+    }
+
+    return statistics;
+}
+
+/*!
+    \internal
+
+    Returns the number of endpoints with an adapted block size.
+*/
+int QCoapBlockSizeController::endpointCount() const
+{
+    return endpoints.size();
+}
+
+/*!
+    \internal
+
+    Forgets the block sizes of all endpoints. The path MTUs are kept.
+*/
+void QCoapBlockSizeController::clear()
+{
+    endpoints.clear();
+    nextPurge = 0;
+}
+
+/*!
+    \internal
+
+    Returns the largest block size whose messages fit in a datagram of
+    \a mtu bytes sent over the network layer \a protocol, or 1024 if
+    \a mtu is 0.
+*/
+uint QCoapBlockSizeController::blockSizeForMtu(int mtu,
+                                               QAbstractSocket::NetworkLayerProtocol protocol)
+{
+    if (mtu <= 0)
+        return maximumBlockSize;
+
+    const int ipHeaderSize = protocol == QAbstractSocket::IPv6Protocol ? 40 : 20;
+    const int available = mtu - ipHeaderSize - udpHeaderSize - messageOverhead;
+
+    uint blockSize = maximumBlockSize;
+    while (blockSize > minimumBlockSize && static_cast<int>(blockSize) > available)
+        blockSize /= 2;
+    return blockSize;
+}
+
+/*!
+    \internal
+
+    Returns the state of \a host at the time \a now, in milliseconds,
+    creating it if needed.
+*/
+QCoapBlockSizeController::EndpointState &
+QCoapBlockSizeController::endpointState(const QHostAddress &host, qint64 now)
+{
+    if (now >= nextPurge) {
+        purge(now);
+        nextPurge = now + endpointIdleTimeout;
+    }
+
+    auto it = endpoints.find(host);
+    if (it == endpoints.end()) {
+        it = endpoints.insert(host, EndpointState());
+        it->blockSize = qMin(defaultBlockSize, maximumBlockSize(host));
+        it->stepUpThreshold = initialStepUpThreshold;
+    }
+
+    it->lastUpdate = now;
+    return *it;
+}
+
+/*!
+    \internal
+
+    Drops the state of the endpoints without new transfers since
+    \c endpointIdleTimeout at the time \a now.
+*/
+void QCoapBlockSizeController::purge(qint64 now)
+{
+    for (auto it = endpoints.begin(); it != endpoints.end();) {
+        if (now - it->lastUpdate >= endpointIdleTimeout)
+            it = endpoints.erase(it);
+        else
+            ++it;
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPBLOCKSIZECONTROLLER_P_H
+#define QCOAPBLOCKSIZECONTROLLER_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qvector.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapBlockSizeController
+{
+public:
+    struct Statistics {
+        uint blockSize = 0;
+        uint maximumBlockSize = 0;
+        int cleanTransferCount = 0;
+        int stepUpThreshold = 0;
+        int stepDownCount = 0;
+        qint64 lastUpdate = -1;
+    };
+
+    QCoapBlockSizeController() = default;
+
+    uint initialBlockSize() const;
+    void setInitialBlockSize(uint blockSize);
+
+    int pathMtu(const QHostAddress &host) const;
+    void setPathMtu(int mtu);
+    void setPathMtu(const QHostAddress &subnet, int prefixLength, int mtu);
+
+    uint blockSize(const QHostAddress &host) const;
+    uint maximumBlockSize(const QHostAddress &host) const;
+    void addTransfer(const QHostAddress &host, uint blockSize, uint retransmissions,
+                     qint64 now);
+    bool addLoss(const QHostAddress &host, uint blockSize, qint64 now);
+    void limitBlockSize(const QHostAddress &host, uint blockSize, qint64 now);
+    Statistics statistics(const QHostAddress &host) const;
+    int endpointCount() const;
+    void clear();
+
+    static uint blockSizeForMtu(int mtu, QAbstractSocket::NetworkLayerProtocol protocol);
+
+private:
+    struct PathMtu {
+        QHostAddress subnet;
+        int prefixLength = 0;
+        int mtu = 0;
+    };
+
+    struct EndpointState {
+        uint blockSize = 0;
+        int cleanTransferCount = 0;
+        int lossCount = 0;
+        int stepUpThreshold = 0;
+        int stepDownCount = 0;
+        qint64 lastUpdate = 0;
+    };
+
+    EndpointState &endpointState(const QHostAddress &host, qint64 now);
+    void purge(qint64 now);
+
+    QHash<QHostAddress, EndpointState> endpoints;
+    QVector<PathMtu> pathMtus;
+    int defaultPathMtu = 0;
+    uint defaultBlockSize = 1024;
+    qint64 nextPurge = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPBLOCKSIZECONTROLLER_P_H
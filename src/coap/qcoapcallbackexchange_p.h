@@ -0,0 +1,79 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPCALLBACKEXCHANGE_P_H
+#define QCOAPCALLBACKEXCHANGE_P_H
+
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapresult.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qsharedpointer.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QCoapProtocol;
+class Q_AUTOTEST_EXPORT QCoapCallbackExchange
+    : public QEnableSharedFromThis<QCoapCallbackExchange>
+{
+public:
+    QCoapCallbackExchange(const QCoapRequest &request, const QCoapResultCallback &callback);
+
+    bool isCancelled() const { return cancelled.loadAcquire() != 0; }
+    bool isFinished() const { return finished.loadAcquire() != 0; }
+    void complete(QCoapResult &&result);
+    void cancel();
+
+    // Set before the exchange is submitted to the protocol, then read-only
+    const QCoapRequest request;
+
+    // Only used in the thread of the client
+    QCoapResultCallback callback;
+
+    // Set when the exchange is submitted to the protocol, then read-only
+    QPointer<QCoapProtocol> protocol;
+
+    QAtomicInt cancelled;
+    QAtomicInt finished;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPCALLBACKEXCHANGE_P_H
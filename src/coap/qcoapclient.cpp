@@ -30,13 +30,20 @@
 
 #include "qcoapclient_p.h"
 #include "qcoapprotocol_p.h"
+#include "qcoapendpoint_p.h"
 #include "qcoapreply.h"
 #include "qcoapresourcediscoveryreply.h"
 #include "qcoapnamespace.h"
 #include "qcoapsecurityconfiguration.h"
+#include "qcoapqtcpconnection_p.h"
 #include "qcoapqudpconnection_p.h"
 #include "qcoaprequest_p.h"
 #include "qcoapreply_p.h"
+#include "qcoapreplydispatcher_p.h"
+#include "qcoapcallbackexchange_p.h"
+#include "qcoapasync_p.h"
+#include "qcoapbatch_p.h"
+#include "qcoapuploadsource_p.h"
 #include <QtCore/qiodevice.h>
 #include <QtCore/qurl.h>
 #include <QtCore/qloggingcategory.h>
@@ -51,18 +58,30 @@ QCoapClientPrivate::QCoapClientPrivate(QCoapProtocol *protocol, QCoapConnection
     , connection(connection)
     , workerThread(new QThread)
 {
+    QCoapClientShard shard;
+    shard.protocol = protocol;
+    shard.connection = connection;
+    shard.tcpConnection = new QCoapQTcpConnection;
+    shard.workerThread = workerThread;
+
     protocol->moveToThread(workerThread);
     connection->moveToThread(workerThread);
+    shard.tcpConnection->moveToThread(workerThread);
     workerThread->start();
+
+    shards.append(shard);
 }
 
 QCoapClientPrivate::~QCoapClientPrivate()
 {
-    workerThread->quit();
-    workerThread->wait();
-    delete workerThread;
-    delete protocol;
-    delete connection;
+    stopWorkerThreads();
+
+    for (const QCoapClientShard &shard : qAsConst(shards)) {
+        delete shard.workerThread;
+        delete shard.protocol;
+        delete shard.connection;
+        delete shard.tcpConnection;
+    }
 }
 
 /*!
@@ -109,6 +128,16 @@ QCoapClientPrivate::~QCoapClientPrivate()
 
     When a reply arrives, the QCoapClient emits a finished() signal.
 
+    Requests whose URL has the \c coap+tcp scheme are sent over TCP, as
+    defined in \l{https://tools.ietf.org/html/rfc8323}{RFC 8323}, instead of
+    UDP. Such requests are never retransmitted, and large payloads are
+    exchanged in BERT blocks when the server supports them. CoAP over TLS is
+    not supported.
+
+    The methods taking a QCoapResultCallback can be called from any thread,
+    for instance by several producer threads sharing a client. The other
+    methods must be called from the thread of the client.
+
     \note For a discovery request, the returned object is a QCoapResourceDiscoveryReply.
     It can be used the same way as a QCoapReply but contains also a list of
     resources.
@@ -182,47 +211,197 @@ QCoapClient::QCoapClient(QtCoap::SecurityMode securityMode, QObject *parent) :
     qRegisterMetaType<QCoapMessageId>("QCoapMessageId");
     qRegisterMetaType<QAbstractSocket::SocketOption>();
 
-    connect(d->connection, &QCoapConnection::readyRead, d->protocol,
-            [this](const QByteArray &data, const QHostAddress &sender) {
-                    Q_D(QCoapClient);
-                    d->protocol->d_func()->onFrameReceived(data, sender);
-            });
-    connect(d->connection, &QCoapConnection::error, d->protocol,
-            [this](QAbstractSocket::SocketError socketError) {
-                    Q_D(QCoapClient);
-                    d->protocol->d_func()->onConnectionError(socketError);
-            });
+    d->connectShard(d->shards.first());
+}
 
-    connect(d->protocol, &QCoapProtocol::finished,
-            this, &QCoapClient::finished);
-    connect(d->protocol, &QCoapProtocol::responseToMulticastReceived,
-            this, &QCoapClient::responseToMulticastReceived);
-    connect(d->protocol, &QCoapProtocol::error,
-            this, &QCoapClient::error);
+/*!
+    Constructs a QCoapClient object for the given \a securityMode, running
+    the protocol in \a workerThreadCount threads, and sets \a parent as the
+    parent object.
+
+    By default, the protocol and the socket of a client run in a single worker
+    thread. With several worker threads, each thread has its own protocol
+    and socket, bound to its own port, and each server is served by a single
+    thread, chosen from its address and port. Requests to different servers
+    are then decoded, matched and retransmitted in parallel. The settings of
+    the client apply to all the threads.
+
+    This only helps clients exchanging with many servers at a high rate: the
+    requests to a given server are always handled by the same thread.
+*/
+QCoapClient::QCoapClient(QtCoap::SecurityMode securityMode, int workerThreadCount,
+                         QObject *parent) :
+    QCoapClient(securityMode, parent)
+{
+    Q_D(QCoapClient);
+    d->addShards(workerThreadCount - 1);
 }
 
 /*!
     \internal
 
     Sets the client's connection to \a customConnection.
+
+    A custom connection is a single transport, which cannot serve the
+    servers of several shards. The client is thus reduced to its first
+    shard, whatever the number of worker threads it was created with.
 */
 void QCoapClientPrivate::setConnection(QCoapConnection *customConnection)
 {
-    Q_Q(QCoapClient);
+    for (int i = 1; i < shards.size(); ++i) {
+        const QCoapClientShard &shard = shards.at(i);
+        shard.workerThread->quit();
+        shard.workerThread->wait();
+        delete shard.workerThread;
+        delete shard.protocol;
+        delete shard.connection;
+        delete shard.tcpConnection;
+    }
+    shards.resize(1);
 
     delete connection;
     connection = customConnection;
+    shards.first().connection = customConnection;
+
+    connectTransport(connection, protocol);
+}
+
+/*!
+    \internal
+
+    Adds \a count shards, each one with its own protocol and UDP connection
+    running in its own worker thread.
+*/
+void QCoapClientPrivate::addShards(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        QCoapClientShard shard;
+        shard.protocol = new QCoapProtocol;
+        shard.connection = new QCoapQUdpConnection(connection->securityMode());
+        shard.tcpConnection = new QCoapQTcpConnection;
+        shard.workerThread = new QThread;
+
+        shard.protocol->moveToThread(shard.workerThread);
+        shard.connection->moveToThread(shard.workerThread);
+        shard.tcpConnection->moveToThread(shard.workerThread);
+        shard.workerThread->start();
+
+        connectShard(shard);
+        shards.append(shard);
+    }
+}
+
+/*!
+    \internal
+
+    Returns the shard handling the exchanges with the server of \a url.
+
+    The shards are created with the client and never change afterwards, so
+    this method can be called from any thread.
+*/
+const QCoapClientShard &QCoapClientPrivate::shardFor(const QUrl &url) const
+{
+    if (shards.size() == 1)
+        return shards.first();
+
+    const uint hash = qHash(QCoapEndpoint::fromUrl(url));
+    return shards.at(static_cast<int>(hash % static_cast<uint>(shards.size())));
+}
+
+/*!
+    \internal
+
+    Forwards the signals of the protocol of \a shard to the client, and the
+    frames received by its connection to its protocol.
+*/
+void QCoapClientPrivate::connectShard(const QCoapClientShard &shard)
+{
+    Q_Q(QCoapClient);
+
+    // No request was sent to the protocol yet, so it is not running
+    if (!replyDispatcher)
+        replyDispatcher = new QCoapReplyDispatcher(q);
+    shard.protocol->d_func()->replyDispatcher = replyDispatcher;
+
+    connectTransport(shard.connection, shard.protocol);
+    connectTransport(shard.tcpConnection, shard.protocol);
+
+    q->connect(shard.protocol, &QCoapProtocol::finished,
+               q, &QCoapClient::finished);
+    q->connect(shard.protocol, &QCoapProtocol::responseToMulticastReceived,
+               q, &QCoapClient::responseToMulticastReceived);
+    q->connect(shard.protocol, &QCoapProtocol::error,
+               q, &QCoapClient::error);
+}
+
+/*!
+    \internal
+
+    Stops the worker threads of all the shards, and waits for them to
+    finish.
+*/
+void QCoapClientPrivate::stopWorkerThreads()
+{
+    for (const QCoapClientShard &shard : qAsConst(shards))
+        shard.workerThread->quit();
+
+    for (const QCoapClientShard &shard : qAsConst(shards))
+        shard.workerThread->wait();
+}
+
+/*!
+    \internal
 
-    q->connect(connection, &QCoapConnection::readyRead, protocol,
-            [this](const QByteArray &data, const QHostAddress &sender) {
-                    protocol->d_func()->onFrameReceived(data, sender);
+    Forwards the frames received and the errors of \a transport to
+    \a shardProtocol, in its thread.
+*/
+void QCoapClientPrivate::connectTransport(QCoapConnection *transport,
+                                          QCoapProtocol *shardProtocol)
+{
+    Q_Q(QCoapClient);
+
+    q->connect(transport, &QCoapConnection::readyRead, shardProtocol,
+            [shardProtocol](const QByteArray &data, const QHostAddress &sender) {
+                    shardProtocol->d_func()->onFrameReceived(data, sender);
+            });
+    q->connect(transport, &QCoapConnection::error, shardProtocol,
+            [shardProtocol](QAbstractSocket::SocketError socketError) {
+                    shardProtocol->d_func()->onConnectionError(socketError);
             });
-    q->connect(connection, &QCoapConnection::error, protocol,
-            [this](QAbstractSocket::SocketError socketError) {
-                    protocol->d_func()->onConnectionError(socketError);
+    q->connect(transport, &QCoapConnection::connectionLost, shardProtocol,
+            [shardProtocol, transport](const QCoapEndpoint &endpoint,
+                                       QAbstractSocket::SocketError socketError) {
+                    shardProtocol->d_func()->onConnectionLost(transport, endpoint, socketError);
             });
 }
 
+/*!
+    \internal
+
+    Invokes the \a member method of the protocol of each shard with the
+    arguments \a val0, \a val1 and \a val2, in the worker threads.
+*/
+void QCoapClientPrivate::invokeOnProtocols(const char *member, QGenericArgument val0,
+                                           QGenericArgument val1, QGenericArgument val2)
+{
+    for (const QCoapClientShard &shard : qAsConst(shards))
+        QMetaObject::invokeMethod(shard.protocol, member, Qt::QueuedConnection,
+                                  val0, val1, val2);
+}
+
+/*!
+    \internal
+
+    Invokes the \a member method of the UDP connection of each shard with
+    the arguments \a val0 and \a val1, in the worker threads.
+*/
+void QCoapClientPrivate::invokeOnConnections(const char *member, QGenericArgument val0,
+                                             QGenericArgument val1)
+{
+    for (const QCoapClientShard &shard : qAsConst(shards))
+        QMetaObject::invokeMethod(shard.connection, member, Qt::QueuedConnection, val0, val1);
+}
+
 /*!
     Destroys the QCoapClient object and frees up any
     resources. Note that QCoapReply objects that are returned from
@@ -231,6 +410,11 @@ void QCoapClientPrivate::setConnection(QCoapConnection *customConnection)
 */
 QCoapClient::~QCoapClient()
 {
+    Q_D(QCoapClient);
+
+    // The protocols must not deliver anything once the reply dispatcher,
+    // a child of the client, is destroyed
+    d->stopWorkerThreads();
     qDeleteAll(findChildren<QCoapReply *>(QString(), Qt::FindDirectChildrenOnly));
 }
 
@@ -261,6 +445,58 @@ QCoapReply *QCoapClient::get(const QUrl &url)
     return get(request);
 }
 
+/*!
+    Fetches the resource targeted by \a request, whose size is
+    \a resourceSize bytes, as several independent GET requests of
+    \a blocksPerRange blocks of \a blockSize bytes each. Returns the
+    replies in the order of the ranges, so that their payloads put end to
+    end make up the resource.
+
+    The ranges are requested in parallel; the number of requests sent to
+    the server at the same time is bounded by
+    setMaximumOutstandingRequests(), the remaining ones being queued. The
+    size of the resource is usually known from the Size2 option of a
+    previous response.
+
+    Returns an empty vector if \a resourceSize, \a blockSize or
+    \a blocksPerRange is invalid.
+
+    \sa get(), QCoapRequest::setBlockRange()
+*/
+QVector<QCoapReply *> QCoapClient::getBlockRanges(const QCoapRequest &request,
+                                                  qint64 resourceSize, quint16 blockSize,
+                                                  uint blocksPerRange)
+{
+    QVector<QCoapReply *> replies;
+    if (resourceSize <= 0 || blocksPerRange == 0 || blockSize == 0) {
+        qCWarning(lcCoapClient, "Cannot fetch block ranges, invalid resource or range size.");
+        return replies;
+    }
+
+    const qint64 blockCount = (resourceSize + blockSize - 1) / blockSize;
+    if (blockCount > (1 << 20)) {
+        qCWarning(lcCoapClient, "Cannot fetch block ranges, too many blocks.");
+        return replies;
+    }
+
+    QCoapRequest rangeRequest(request);
+    rangeRequest.setBlockRange(0, 0, blockSize);
+    if (!rangeRequest.hasBlockRange())
+        return replies;
+
+    const uint lastBlock = static_cast<uint>(blockCount - 1);
+    for (uint first = 0; first <= lastBlock; first += blocksPerRange) {
+        const uint last = static_cast<uint>(qMin(qint64(lastBlock),
+                                                 qint64(first) + blocksPerRange - 1));
+        rangeRequest.setBlockRange(first, last, blockSize);
+        replies.append(get(rangeRequest));
+        if (last == lastBlock)
+            break;
+    }
+
+    return replies;
+}
+
 /*!
     Sends the \a request using the PUT method and returns a new QCoapReply
     object. Uses \a data as the payload for this request.
@@ -284,13 +520,27 @@ QCoapReply *QCoapClient::put(const QCoapRequest &request, const QByteArray &data
     object. Uses \a device content as the payload for this request.
     A null device is treated as empty content.
 
-    \note The device has to be open and readable before calling this function.
+    Unless its content is small and of known size, the device is not read
+    at once: the payload is sent blockwise, and each block is read from the
+    device when it is about to be sent. The upload starts as soon as the
+    first block can be read, and its progress is reported by the
+    QCoapReply::uploadProgress() signal.
+
+    \note The device has to be open and readable before calling this function,
+    and must remain valid until the reply is finished.
 
     \sa get(), post(), deleteResource(), observe(), discover()
 */
 QCoapReply *QCoapClient::put(const QCoapRequest &request, QIODevice *device)
 {
-    return put(request, device ? device->readAll() : QByteArray());
+    Q_D(QCoapClient);
+
+    if (!QCoapClientPrivate::isUploadStreamed(device))
+        return put(request, device ? device->readAll() : QByteArray());
+
+    QCoapRequest copyRequest = QCoapRequestPrivate::createRequest(request, QtCoap::Method::Put,
+                                                                  d->connection->isSecure());
+    return d->sendRequest(copyRequest, device);
 }
 
 /*!
@@ -329,16 +579,30 @@ QCoapReply *QCoapClient::post(const QCoapRequest &request, const QByteArray &dat
     object. Uses \a device content as the payload for this request.
     A null device is treated as empty content.
 
-    \note The device has to be open and readable before calling this function.
+    Unless its content is small and of known size, the device is not read
+    at once: the payload is sent blockwise, and each block is read from the
+    device when it is about to be sent. The upload starts as soon as the
+    first block can be read, and its progress is reported by the
+    QCoapReply::uploadProgress() signal.
+
+    \note The device has to be open and readable before calling this function,
+    and must remain valid until the reply is finished.
 
     \sa get(), put(), deleteResource(), observe(), discover()
 */
 QCoapReply *QCoapClient::post(const QCoapRequest &request, QIODevice *device)
 {
+    Q_D(QCoapClient);
+
     if (!device)
         return nullptr;
 
-    return post(request, device->readAll());
+    if (!QCoapClientPrivate::isUploadStreamed(device))
+        return post(request, device->readAll());
+
+    QCoapRequest copyRequest = QCoapRequestPrivate::createRequest(request, QtCoap::Method::Post,
+                                                                  d->connection->isSecure());
+    return d->sendRequest(copyRequest, device);
 }
 
 /*!
@@ -381,6 +645,261 @@ QCoapReply *QCoapClient::deleteResource(const QUrl &url)
     return deleteResource(QCoapRequest(url));
 }
 
+/*!
+    \overload
+
+    Sends the \a request using the GET method, and passes its result to
+    \a callback in the thread of the client. Returns a handle to the
+    request, which is null if the request cannot be sent.
+
+    No QCoapReply is created: the request is only known to the protocol
+    until it completes, and its result is moved to the callback. This is
+    lighter than a reply when sending many small requests. The finished()
+    and error() signals of the client are not emitted for such requests.
+    Large responses are still fetched block by block, and passed to the
+    callback at once.
+
+    Observe and multicast requests cannot be sent with a callback, and
+    neither can a payload read from a QIODevice.
+
+    This method can be called from any thread while the client exists, and
+    does not block. The \a callback is still called in the thread of the
+    client, which must run an event loop.
+
+    \threadsafe
+
+    \sa QCoapResult, QCoapRequestHandle
+*/
+QCoapRequestHandle QCoapClient::get(const QCoapRequest &request,
+                                    const QCoapResultCallback &callback)
+{
+    Q_D(QCoapClient);
+
+    return d->sendWithCallback(QCoapRequestPrivate::createRequest(
+                                   request, QtCoap::Method::Get, d->connection->isSecure()),
+                               callback);
+}
+
+/*!
+    \overload
+
+    Sends the \a request using the PUT method, with \a data as its payload,
+    and passes its result to \a callback in the thread of the client.
+    Returns a handle to the request, which is null if the request cannot be
+    sent.
+
+    \threadsafe
+
+    \sa get(const QCoapRequest &, const QCoapResultCallback &)
+*/
+QCoapRequestHandle QCoapClient::put(const QCoapRequest &request, const QByteArray &data,
+                                    const QCoapResultCallback &callback)
+{
+    Q_D(QCoapClient);
+
+    QCoapRequest copyRequest = QCoapRequestPrivate::createRequest(request, QtCoap::Method::Put,
+                                                                  d->connection->isSecure());
+    copyRequest.setPayload(data);
+    return d->sendWithCallback(copyRequest, callback);
+}
+
+/*!
+    \overload
+
+    Sends the \a request using the POST method, with \a data as its payload,
+    and passes its result to \a callback in the thread of the client.
+    Returns a handle to the request, which is null if the request cannot be
+    sent.
+
+    \threadsafe
+
+    \sa get(const QCoapRequest &, const QCoapResultCallback &)
+*/
+QCoapRequestHandle QCoapClient::post(const QCoapRequest &request, const QByteArray &data,
+                                     const QCoapResultCallback &callback)
+{
+    Q_D(QCoapClient);
+
+    QCoapRequest copyRequest = QCoapRequestPrivate::createRequest(request, QtCoap::Method::Post,
+                                                                  d->connection->isSecure());
+    copyRequest.setPayload(data);
+    return d->sendWithCallback(copyRequest, callback);
+}
+
+/*!
+    \overload
+
+    Sends the \a request using the DELETE method, and passes its result to
+    \a callback in the thread of the client. Returns a handle to the
+    request, which is null if the request cannot be sent.
+
+    \threadsafe
+
+    \sa get(const QCoapRequest &, const QCoapResultCallback &)
+*/
+QCoapRequestHandle QCoapClient::deleteResource(const QCoapRequest &request,
+                                               const QCoapResultCallback &callback)
+{
+    Q_D(QCoapClient);
+
+    return d->sendWithCallback(QCoapRequestPrivate::createRequest(
+                                   request, QtCoap::Method::Delete, d->connection->isSecure()),
+                               callback);
+}
+
+/*!
+    Sends the \a request using the GET method, and returns its pending
+    result, which can be awaited in a C++20 coroutine:
+
+    \code
+        QCoapResult result = co_await client->getAsync(request);
+    \endcode
+
+    The request is sent like with a callback, without creating a
+    QCoapReply. The coroutine is resumed with the result in the thread of
+    the client. Destroying the suspended coroutine cancels the request. If
+    the request cannot be sent, the result is ready at once, with the
+    QtCoap::Error::Unknown error.
+
+    \sa QCoapAsyncResult, get(const QCoapRequest &, const QCoapResultCallback &)
+*/
+QCoapAsyncResult QCoapClient::getAsync(const QCoapRequest &request)
+{
+    Q_D(QCoapClient);
+
+    return d->sendAsync(QCoapRequestPrivate::createRequest(request, QtCoap::Method::Get,
+                                                           d->connection->isSecure()));
+}
+
+/*!
+    \overload
+
+    Sends a GET request to \a url, and returns its pending result.
+*/
+QCoapAsyncResult QCoapClient::getAsync(const QUrl &url)
+{
+    return getAsync(QCoapRequest(url));
+}
+
+/*!
+    Sends the \a request using the PUT method, with \a data as its payload,
+    and returns its pending result.
+
+    \sa getAsync()
+*/
+QCoapAsyncResult QCoapClient::putAsync(const QCoapRequest &request, const QByteArray &data)
+{
+    Q_D(QCoapClient);
+
+    QCoapRequest copyRequest = QCoapRequestPrivate::createRequest(request, QtCoap::Method::Put,
+                                                                  d->connection->isSecure());
+    copyRequest.setPayload(data);
+    return d->sendAsync(copyRequest);
+}
+
+/*!
+    Sends the \a request using the POST method, with \a data as its payload,
+    and returns its pending result.
+
+    \sa getAsync()
+*/
+QCoapAsyncResult QCoapClient::postAsync(const QCoapRequest &request, const QByteArray &data)
+{
+    Q_D(QCoapClient);
+
+    QCoapRequest copyRequest = QCoapRequestPrivate::createRequest(request, QtCoap::Method::Post,
+                                                                  d->connection->isSecure());
+    copyRequest.setPayload(data);
+    return d->sendAsync(copyRequest);
+}
+
+/*!
+    Sends the \a request using the DELETE method, and returns its pending
+    result.
+
+    \sa getAsync()
+*/
+QCoapAsyncResult QCoapClient::deleteResourceAsync(const QCoapRequest &request)
+{
+    Q_D(QCoapClient);
+
+    return d->sendAsync(QCoapRequestPrivate::createRequest(request, QtCoap::Method::Delete,
+                                                           d->connection->isSecure()));
+}
+
+/*!
+    Sends a request to observe the target \a request, and returns the stream
+    of its notifications, which can be awaited in a C++20 coroutine:
+
+    \code
+        QCoapNotificationStream stream = client->observeAsync(request);
+        while (std::optional<QCoapMessage> notification = co_await stream)
+            process(notification->payload());
+    \endcode
+
+    The stream owns the QCoapReply of the observation. Destroying the stream
+    aborts the observation. If the request cannot be sent, the stream is
+    finished at once.
+
+    \sa QCoapNotificationStream, observe()
+*/
+QCoapNotificationStream QCoapClient::observeAsync(const QCoapRequest &request)
+{
+    return QCoapNotificationStream(observe(request));
+}
+
+/*!
+    \overload
+
+    Sends a request to observe the target \a url, and returns the stream of
+    its notifications.
+*/
+QCoapNotificationStream QCoapClient::observeAsync(const QUrl &url)
+{
+    return observeAsync(QCoapRequest(url));
+}
+
+/*!
+    Sends the \a requests using the given \a method, and returns the batch
+    holding their results. The payload of each request is sent for the
+    methods having one.
+
+    The requests are sent like with a callback, without creating a
+    QCoapReply, and are validated once. They are submitted to the protocol
+    together, instead of one at a time, which saves most of the cost of
+    sending thousands of requests, for instance to poll a fleet of devices.
+
+    If \a maximumConcurrency is positive, at most that many requests of the
+    batch are running at the same time, the next ones being sent as the
+    running ones finish. Otherwise, all the requests are sent at once, and
+    only the limit set with setMaximumOutstandingRequests() applies to each
+    endpoint.
+
+    Observe and multicast requests, and the requests which cannot be sent,
+    finish at once with the QtCoap::Error::Unknown error.
+
+    \sa getBatch(), QCoapBatch
+*/
+QCoapBatch QCoapClient::sendBatch(QtCoap::Method method, const QVector<QCoapRequest> &requests,
+                                  int maximumConcurrency)
+{
+    Q_D(QCoapClient);
+
+    return d->sendBatch(method, requests, maximumConcurrency);
+}
+
+/*!
+    Sends the \a requests using the GET method, and returns the batch
+    holding their results. At most \a maximumConcurrency requests are
+    running at the same time, if it is positive.
+
+    \sa sendBatch()
+*/
+QCoapBatch QCoapClient::getBatch(const QVector<QCoapRequest> &requests, int maximumConcurrency)
+{
+    return sendBatch(QtCoap::Method::Get, requests, maximumConcurrency);
+}
+
 /*!
     \overload
 
@@ -494,7 +1013,10 @@ QCoapReply *QCoapClient::observe(const QUrl &url)
 void QCoapClient::cancelObserve(QCoapReply *notifiedReply)
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->protocol, "cancelObserve",
+    if (!notifiedReply)
+        return;
+
+    QMetaObject::invokeMethod(d->shardFor(notifiedReply->url()).protocol, "cancelObserve",
                               Q_ARG(QPointer<QCoapReply>, QPointer<QCoapReply>(notifiedReply)));
 }
 
@@ -509,7 +1031,8 @@ void QCoapClient::cancelObserve(const QUrl &url)
 {
     Q_D(QCoapClient);
     const auto adjustedUrl = QCoapRequestPrivate::adjustedUrl(url, d->connection->isSecure());
-    QMetaObject::invokeMethod(d->protocol, "cancelObserve", Q_ARG(QUrl, adjustedUrl));
+    QMetaObject::invokeMethod(d->shardFor(adjustedUrl).protocol, "cancelObserve",
+                              Q_ARG(QUrl, adjustedUrl));
 }
 
 /*!
@@ -523,22 +1046,43 @@ void QCoapClient::cancelObserve(const QUrl &url)
 void QCoapClient::disconnect()
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->connection, "disconnect", Qt::QueuedConnection);
+    for (const QCoapClientShard &shard : qAsConst(d->shards)) {
+        QMetaObject::invokeMethod(shard.connection, "disconnect", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(shard.tcpConnection, "disconnect", Qt::QueuedConnection);
+    }
 }
 
 /*!
     \internal
 
     Sends the CoAP \a request to its own URL and returns a new QCoapReply
-    object.
+    object. If \a device is not \c nullptr, the payload is read from it
+    block by block.
 */
-QCoapReply *QCoapClientPrivate::sendRequest(const QCoapRequest &request)
+QCoapReply *QCoapClientPrivate::sendRequest(const QCoapRequest &request, QIODevice *device)
 {
     Q_Q(QCoapClient);
 
     // Prepare the reply
     QCoapReply *reply = QCoapReplyPrivate::createCoapReply(request, q);
 
+    if (device) {
+        auto source = new QCoapUploadSource(device, reply);
+        QCoapReplyPrivate::get(reply)->uploadSource = source;
+
+        QCoapProtocol *protocol = shardFor(reply->url()).protocol;
+        QObject::connect(source, &QCoapUploadSource::blockRead, protocol,
+                         [protocol](const QCoapToken &token, uint blockNumber,
+                                    const QByteArray &data, bool hasMoreBlocks) {
+                             protocol->d_func()->sendUploadBlock(token, blockNumber, data,
+                                                                 hasMoreBlocks);
+                         });
+        QObject::connect(source, &QCoapUploadSource::readFailed, protocol,
+                         [protocol](const QCoapToken &token) {
+                             protocol->d_func()->onUploadFailed(token);
+                         });
+    }
+
     if (!send(reply)) {
         delete reply;
         return nullptr;
@@ -547,6 +1091,18 @@ QCoapReply *QCoapClientPrivate::sendRequest(const QCoapRequest &request)
     return reply;
 }
 
+/*!
+    \internal
+
+    Returns \c true if the payload read from \a device is uploaded block by
+    block, instead of being read at once. This is the case for sequential
+    devices, and for other devices holding more than the largest block.
+*/
+bool QCoapClientPrivate::isUploadStreamed(QIODevice *device)
+{
+    return device && (device->isSequential() || device->bytesAvailable() > 1024);
+}
+
 /*!
     \internal
 
@@ -575,33 +1131,169 @@ QCoapResourceDiscoveryReply *QCoapClientPrivate::sendDiscovery(const QCoapReques
 */
 bool QCoapClientPrivate::send(QCoapReply *reply)
 {
-    const auto scheme = connection->isSecure() ? QLatin1String("coaps") : QLatin1String("coap");
-    if (reply->request().url().scheme() != scheme) {
-        qCWarning(lcCoapClient, "Failed to send request, URL has an incorrect scheme.");
+    const QCoapClientShard &shard = shardFor(reply->url());
+    QCoapConnection *targetConnection = transportFor(shard, reply->request());
+    if (!targetConnection)
         return false;
+
+    shard.protocol->d_func()->submitRequest(reply, targetConnection);
+
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns the connection of \a shard on which the \a request is sent, or
+    \c nullptr if the request cannot be sent.
+*/
+QCoapConnection *QCoapClientPrivate::transportFor(const QCoapClientShard &shard,
+                                                  const QCoapRequest &request) const
+{
+    // Requests with the coap+tcp scheme are sent over TCP, whatever the
+    // transport of the client
+    QCoapConnection *targetConnection = shard.connection;
+    const bool isMulticast = QHostAddress(request.url().host()).isMulticast();
+    if (request.url().scheme() == QLatin1String("coap+tcp")) {
+        if (connection->isSecure()) {
+            qCWarning(lcCoapClient, "Failed to send request, CoAP over TLS is not supported.");
+            return nullptr;
+        }
+        if (isMulticast) {
+            qCWarning(lcCoapClient, "Failed to send request, "
+                                    "multicast requests cannot be sent over TCP.");
+            return nullptr;
+        }
+        targetConnection = shard.tcpConnection;
+    } else {
+        const auto scheme = connection->isSecure() ? QLatin1String("coaps")
+                                                   : QLatin1String("coap");
+        if (request.url().scheme() != scheme) {
+            qCWarning(lcCoapClient, "Failed to send request, URL has an incorrect scheme.");
+            return nullptr;
+        }
     }
 
-    if (!QCoapRequestPrivate::isUrlValid(reply->request().url())) {
+    if (!QCoapRequestPrivate::isUrlValid(request.url())) {
         qCWarning(lcCoapClient, "Failed to send request for an invalid URL.");
-        return false;
+        return nullptr;
     }
 
     // According to https://tools.ietf.org/html/rfc7252#section-8.1,
     // multicast requests MUST be Non-confirmable.
-    if (QHostAddress(reply->url().host()).isMulticast()
-            && reply->request().type() == QCoapMessage::Type::Confirmable) {
+    if (isMulticast && request.type() == QCoapMessage::Type::Confirmable) {
         qCWarning(lcCoapClient, "Failed to send request, "
                                 "multicast requests must be non-confirmable.");
-        return false;
+        return nullptr;
     }
 
-    QMetaObject::invokeMethod(protocol, "sendRequest", Qt::QueuedConnection,
-                              Q_ARG(QPointer<QCoapReply>, QPointer<QCoapReply>(reply)),
-                              Q_ARG(QCoapConnection *, connection));
+    return targetConnection;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the \a request can be sent without a reply, which is
+    not the case of observe and multicast requests.
+*/
+static bool canSendWithCallback(const QCoapRequest &request)
+{
+    if (request.isObserve() || QHostAddress(request.url().host()).isMulticast()) {
+        qCWarning(lcCoapClient, "Failed to send request, observe and multicast requests "
+                                "cannot be sent with a callback.");
+        return false;
+    }
 
     return true;
 }
 
+/*!
+    \internal
+
+    Sends the \a request, whose result is passed to \a callback, without
+    creating a reply. Returns a null handle if the request cannot be sent.
+
+    This method is thread-safe. It only reads the shards and the
+    connections, which are created with the client, and the protocol takes
+    the request through its lock-free submission queue.
+*/
+QCoapRequestHandle QCoapClientPrivate::sendWithCallback(const QCoapRequest &request,
+                                                        const QCoapResultCallback &callback)
+{
+    if (!callback) {
+        qCWarning(lcCoapClient, "Failed to send request, the callback is empty.");
+        return QCoapRequestHandle();
+    }
+    if (!canSendWithCallback(request))
+        return QCoapRequestHandle();
+
+    const QCoapClientShard &shard = shardFor(request.url());
+    QCoapConnection *targetConnection = transportFor(shard, request);
+    if (!targetConnection)
+        return QCoapRequestHandle();
+
+    auto exchange = QSharedPointer<QCoapCallbackExchange>::create(request, callback);
+    shard.protocol->d_func()->submitRequest(exchange, targetConnection);
+    return QCoapRequestHandle(exchange);
+}
+
+/*!
+    \internal
+
+    Sends the \a request, whose result is awaited with the returned
+    QCoapAsyncResult. The result is ready at once, with an error, if the
+    request cannot be sent.
+*/
+QCoapAsyncResult QCoapClientPrivate::sendAsync(const QCoapRequest &request)
+{
+    auto state = QSharedPointer<QCoapAsyncResultPrivate>::create();
+    state->handle = sendWithCallback(request, QCoapAsyncResultPrivate::callback(state));
+    if (state->handle.isNull()) {
+        state->result.error = QtCoap::Error::Unknown;
+        state->isReady = true;
+    }
+
+    return QCoapAsyncResult(state);
+}
+
+/*!
+    \internal
+
+    Sends the \a requests with the given \a method, validating each of them
+    once, and submitting them together to the protocol of their shard. At
+    most \a maximumConcurrency requests are running at the same time, if it
+    is positive.
+*/
+QCoapBatch QCoapClientPrivate::sendBatch(QtCoap::Method method,
+                                         const QVector<QCoapRequest> &requests,
+                                         int maximumConcurrency)
+{
+    auto batch = QSharedPointer<QCoapBatchPrivate>::create();
+    batch->maximumConcurrency = maximumConcurrency;
+    batch->items.resize(requests.size());
+
+    const bool isSecure = connection->isSecure();
+    for (int i = 0; i < requests.size(); ++i) {
+        QCoapBatchPrivate::Item &item = batch->items[i];
+        item.request = QCoapRequestPrivate::createRequest(requests.at(i), method, isSecure);
+        if (!canSendWithCallback(item.request)) {
+            batch->setInvalid(i);
+            continue;
+        }
+
+        const QCoapClientShard &shard = shardFor(item.request.url());
+        item.connection = transportFor(shard, item.request);
+        if (!item.connection) {
+            batch->setInvalid(i);
+            continue;
+        }
+        item.protocol = shard.protocol;
+    }
+
+    batch->submitPending();
+    return QCoapBatch(batch);
+}
+
 /*!
     Sets the security configuration parameters from \a configuration.
     Configuration will be ignored if the QtCoap::NoSecurity mode is used.
@@ -616,8 +1308,8 @@ void QCoapClient::setSecurityConfiguration(const QCoapSecurityConfiguration &con
 {
     Q_D(QCoapClient);
 
-    QMetaObject::invokeMethod(d->connection, "setSecurityConfiguration", Qt::QueuedConnection,
-                              Q_ARG(QCoapSecurityConfiguration, configuration));
+    d->invokeOnConnections("setSecurityConfiguration",
+                           Q_ARG(QCoapSecurityConfiguration, configuration));
 }
 
 /*!
@@ -629,8 +1321,7 @@ void QCoapClient::setBlockSize(quint16 blockSize)
 {
     Q_D(QCoapClient);
 
-    QMetaObject::invokeMethod(d->protocol, "setBlockSize", Qt::QueuedConnection,
-                              Q_ARG(quint16, blockSize));
+    d->invokeOnProtocols("setBlockSize", Q_ARG(quint16, blockSize));
 }
 
 /*!
@@ -640,9 +1331,8 @@ void QCoapClient::setSocketOption(QAbstractSocket::SocketOption option, const QV
 {
     Q_D(QCoapClient);
 
-    QMetaObject::invokeMethod(d->connection, "setSocketOption", Qt::QueuedConnection,
-                              Q_ARG(QAbstractSocket::SocketOption, option),
-                              Q_ARG(QVariant, value));
+    d->invokeOnConnections("setSocketOption", Q_ARG(QAbstractSocket::SocketOption, option),
+                           Q_ARG(QVariant, value));
 }
 
 /*!
@@ -655,8 +1345,7 @@ void QCoapClient::setSocketOption(QAbstractSocket::SocketOption option, const QV
 void QCoapClient::setMaximumServerResponseDelay(uint responseDelay)
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->protocol, "setMaximumServerResponseDelay", Qt::QueuedConnection,
-                              Q_ARG(uint, responseDelay));
+    d->invokeOnProtocols("setMaximumServerResponseDelay", Q_ARG(uint, responseDelay));
 }
 
 /*!
@@ -672,8 +1361,7 @@ void QCoapClient::setMaximumServerResponseDelay(uint responseDelay)
 void QCoapClient::setAckTimeout(uint ackTimeout)
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->protocol, "setAckTimeout", Qt::QueuedConnection,
-                              Q_ARG(uint, ackTimeout));
+    d->invokeOnProtocols("setAckTimeout", Q_ARG(uint, ackTimeout));
 }
 
 /*!
@@ -686,8 +1374,7 @@ void QCoapClient::setAckTimeout(uint ackTimeout)
 void QCoapClient::setAckRandomFactor(double ackRandomFactor)
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->protocol, "setAckRandomFactor", Qt::QueuedConnection,
-                              Q_ARG(double, ackRandomFactor));
+    d->invokeOnProtocols("setAckRandomFactor", Q_ARG(double, ackRandomFactor));
 }
 
 /*!
@@ -698,8 +1385,7 @@ void QCoapClient::setAckRandomFactor(double ackRandomFactor)
 void QCoapClient::setMaximumRetransmitCount(uint maximumRetransmitCount)
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->protocol, "setMaximumRetransmitCount", Qt::QueuedConnection,
-                              Q_ARG(uint, maximumRetransmitCount));
+    d->invokeOnProtocols("setMaximumRetransmitCount", Q_ARG(uint, maximumRetransmitCount));
 }
 
 /*!
@@ -710,8 +1396,252 @@ void QCoapClient::setMaximumRetransmitCount(uint maximumRetransmitCount)
 void QCoapClient::setMinimumTokenSize(int tokenSize)
 {
     Q_D(QCoapClient);
-    QMetaObject::invokeMethod(d->protocol, "setMinimumTokenSize", Qt::QueuedConnection,
-                              Q_ARG(int, tokenSize));
+    d->invokeOnProtocols("setMinimumTokenSize", Q_ARG(int, tokenSize));
+}
+
+/*!
+    Sets whether the timeout of confirmable messages adapts to the round-trip
+    time measured for each server to \a enabled. The default is \c false.
+
+    When enabled, the client estimates the retransmission timeout of each
+    server from the time it takes to receive acknowledgments, following the
+    CoAP Simple Congestion Control/Advanced (CoCoA) algorithm. This timeout is
+    used instead of \c ACK_TIMEOUT, which only remains the initial estimate
+    for servers without measurements. Retransmissions back off faster for
+    servers with short round-trip times, and slower for the others.
+
+    Adaptive timeouts do not apply to multicast requests.
+
+    \sa setAckTimeout(), setAckRandomFactor()
+*/
+void QCoapClient::setAdaptiveTimeoutEnabled(bool enabled)
+{
+    Q_D(QCoapClient);
+    d->invokeOnProtocols("setAdaptiveTimeoutEnabled", Q_ARG(bool, enabled));
+}
+
+/*!
+    Sets whether the size of the blocks of blockwise transfers is adapted to
+    each server to \a enabled. The default is \c false.
+
+    When enabled, transfers start with the block size set by setBlockSize(),
+    or with blocks of 1024 bytes if none is set, bounded by the path MTU
+    set with setPathMtu(). The block size of a server grows while blocks are
+    exchanged without retransmission, and is halved when blocks time out
+    repeatedly, as datagrams too large for the path are fragmented and more
+    likely to be lost.
+
+    \sa setBlockSize(), setPathMtu()
+*/
+void QCoapClient::setAdaptiveBlockSizeEnabled(bool enabled)
+{
+    Q_D(QCoapClient);
+    d->invokeOnProtocols("setAdaptiveBlockSizeEnabled", Q_ARG(bool, enabled));
+}
+
+/*!
+    Sets the path MTU to the servers to \a mtu bytes. The default is 0,
+    meaning that the path MTU is unknown.
+
+    With adaptive block sizes, the blocks are never larger than the largest
+    block whose messages fit in the path MTU of the server, once the IP, UDP
+    and CoAP headers are accounted for.
+
+    \sa setAdaptiveBlockSizeEnabled()
+*/
+void QCoapClient::setPathMtu(int mtu)
+{
+    Q_D(QCoapClient);
+    d->invokeOnProtocols("setPathMtu", Q_ARG(int, mtu));
+}
+
+/*!
+    \overload
+
+    Sets the path MTU to the servers of \a subnet, given as an address and a
+    prefix length, to \a mtu bytes. This is typically used with the subnet
+    and MTU of a network interface. When a server belongs to several
+    subnets, the most specific one is used. A value of 0 removes the path MTU
+    of \a subnet.
+
+    \sa QNetworkInterface, QHostAddress::parseSubnet()
+*/
+void QCoapClient::setPathMtu(const QPair<QHostAddress, int> &subnet, int mtu)
+{
+    Q_D(QCoapClient);
+    d->invokeOnProtocols("setPathMtu", Q_ARG(QHostAddress, subnet.first),
+                         Q_ARG(int, subnet.second),
+                         Q_ARG(int, mtu));
+}
+
+/*!
+    Sets the maximum number of outstanding interactions with each server,
+    the \c NSTART value defined in \l {RFC 7252 - Section 4.7}, to \a count.
+    The default is 0, which does not limit the number of outstanding
+    interactions.
+
+    An interaction is outstanding until its response is received, it fails,
+    or, for an observation, until its first notification is received.
+    Requests made while the limit is reached are queued, and sent as soon as
+    an outstanding interaction with the same server ends. Queued requests are
+    sent by decreasing priority, and in the order they were made for the
+    same priority.
+
+    The limit does not apply to multicast requests.
+
+    \sa QCoapRequest::setPriority()
+*/
+void QCoapClient::setMaximumOutstandingRequests(int count)
+{
+    Q_D(QCoapClient);
+    d->invokeOnProtocols("setMaximumOutstandingRequests", Q_ARG(int, count));
+}
+
+/*!
+    Sets whether the notifications of observed resources are coalesced to
+    \a enabled. This is disabled by default.
+
+    When enabled, a notification still waiting to be handled in the thread
+    of the client is dropped when a newer notification of the same
+    observation arrives, and the QCoapReply::notified() signal is only
+    emitted for the newest one. A client thread too busy to keep up with
+    the notifications thus skips the outdated values, instead of handling
+    all of them late.
+
+    Whether coalescing is enabled or not, notifications received out of
+    order are dropped, as described in \l {RFC 7641 - Section 3.4}.
+
+    \sa observe()
+*/
+void QCoapClient::setNotificationCoalescingEnabled(bool enabled)
+{
+    Q_D(QCoapClient);
+    d->replyDispatcher->setNotificationCoalescingEnabled(enabled);
+}
+
+/*!
+    \struct QCoapRoundTripStatistics
+    \inmodule QtCoap
+
+    \brief The QCoapRoundTripStatistics struct holds the round-trip time
+    estimations of a server.
+
+    \reentrant
+
+    The strong estimations are measured from the exchanges completed without
+    retransmission, and the weak ones from the exchanges completed after
+    retransmissions. The times are in milliseconds.
+
+    \sa QCoapClient::roundTripStatistics()
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::retransmissionTimeout
+
+    The retransmission timeout used for the next Confirmable message sent to
+    the server, in milliseconds, when adaptive timeouts are enabled.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::strongRoundTripTime
+
+    The smoothed round-trip time of the exchanges completed without
+    retransmission.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::strongRoundTripTimeVariation
+
+    The variation of the round-trip time of the exchanges completed without
+    retransmission.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::strongSampleCount
+
+    The number of exchanges completed without retransmission.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::weakRoundTripTime
+
+    The smoothed round-trip time of the exchanges completed after
+    retransmissions.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::weakRoundTripTimeVariation
+
+    The variation of the round-trip time of the exchanges completed after
+    retransmissions.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::weakSampleCount
+
+    The number of exchanges completed after retransmissions.
+*/
+
+/*!
+    \variable QCoapRoundTripStatistics::lastUpdateAge
+
+    The time elapsed since the last measurement, in milliseconds, or -1 if
+    the server was never measured.
+*/
+
+/*!
+    Returns the round-trip time estimations of the server \a host, and the
+    retransmission timeout derived from them.
+
+    The round-trip times are measured from the responses to Confirmable
+    messages, even when adaptive timeouts are disabled. If the client
+    exchanges with several ports of \a host, the most recent estimations are
+    returned.
+
+    This function can be called from any thread. It blocks until the worker
+    threads of the client have collected the estimations.
+
+    \sa setAdaptiveTimeoutEnabled(), setAckTimeout()
+*/
+QCoapRoundTripStatistics QCoapClient::roundTripStatistics(const QHostAddress &host) const
+{
+    Q_D(const QCoapClient);
+
+    QCoapRoundTripStatistics statistics;
+    for (int i = 0; i < d->shards.size(); ++i) {
+        QCoapProtocol *protocol = d->shards.at(i).protocol;
+        QCoapRoundTripStatistics shardStatistics;
+        const auto collect = [protocol, &host, &shardStatistics]() {
+            const QCoapRttEstimator::Statistics estimations =
+                    protocol->roundTripStatistics(host);
+            shardStatistics.retransmissionTimeout = estimations.retransmissionTimeout;
+            shardStatistics.strongRoundTripTime = estimations.strongRoundTripTime;
+            shardStatistics.strongRoundTripTimeVariation =
+                    estimations.strongRoundTripTimeVariation;
+            shardStatistics.strongSampleCount = estimations.strongSampleCount;
+            shardStatistics.weakRoundTripTime = estimations.weakRoundTripTime;
+            shardStatistics.weakRoundTripTimeVariation = estimations.weakRoundTripTimeVariation;
+            shardStatistics.weakSampleCount = estimations.weakSampleCount;
+            if (estimations.lastUpdate >= 0) {
+                shardStatistics.lastUpdateAge =
+                        protocol->d_func()->clock.elapsed() - estimations.lastUpdate;
+            }
+        };
+
+        // The estimations are only accessed from the thread of the protocol
+        if (protocol->thread() == QThread::currentThread())
+            collect();
+        else
+            QMetaObject::invokeMethod(protocol, collect, Qt::BlockingQueuedConnection);
+
+        if (i == 0 || (shardStatistics.lastUpdateAge >= 0
+                       && (statistics.lastUpdateAge < 0
+                           || shardStatistics.lastUpdateAge < statistics.lastUpdateAge))) {
+            statistics = shardStatistics;
+        }
+    }
+
+    return statistics;
 }
 
 QT_END_NAMESPACE
@@ -33,8 +33,15 @@
 
 #include <QtCore/qglobal.h>
 #include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapasync.h>
+#include <QtCoap/qcoapbatch.h>
 #include <QtCoap/qcoapnamespace.h>
+#include <QtCoap/qcoaprequesthandle.h>
+#include <QtCoap/qcoapresult.h>
+#include <QtCoap/qcoaproundtripstatistics.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qpair.h>
+#include <QtCore/qvector.h>
 #include <QtNetwork/qabstractsocket.h>
 
 QT_BEGIN_NAMESPACE
@@ -55,10 +62,14 @@ class Q_COAP_EXPORT QCoapClient : public QObject
 public:
     explicit QCoapClient(QtCoap::SecurityMode securityMode = QtCoap::SecurityMode::NoSecurity,
                          QObject *parent = nullptr);
+    QCoapClient(QtCoap::SecurityMode securityMode, int workerThreadCount,
+                QObject *parent = nullptr);
     ~QCoapClient();
 
     QCoapReply *get(const QCoapRequest &request);
     QCoapReply *get(const QUrl &url);
+    QVector<QCoapReply *> getBlockRanges(const QCoapRequest &request, qint64 resourceSize,
+                                         quint16 blockSize, uint blocksPerRange);
     QCoapReply *put(const QCoapRequest &request, const QByteArray &data = QByteArray());
     QCoapReply *put(const QCoapRequest &request, QIODevice *device);
     QCoapReply *put(const QUrl &url, const QByteArray &data = QByteArray());
@@ -67,6 +78,23 @@ public:
     QCoapReply *post(const QUrl &url, const QByteArray &data = QByteArray());
     QCoapReply *deleteResource(const QCoapRequest &request);
     QCoapReply *deleteResource(const QUrl &url);
+    QCoapRequestHandle get(const QCoapRequest &request, const QCoapResultCallback &callback);
+    QCoapRequestHandle put(const QCoapRequest &request, const QByteArray &data,
+                           const QCoapResultCallback &callback);
+    QCoapRequestHandle post(const QCoapRequest &request, const QByteArray &data,
+                            const QCoapResultCallback &callback);
+    QCoapRequestHandle deleteResource(const QCoapRequest &request,
+                                      const QCoapResultCallback &callback);
+    QCoapAsyncResult getAsync(const QCoapRequest &request);
+    QCoapAsyncResult getAsync(const QUrl &url);
+    QCoapAsyncResult putAsync(const QCoapRequest &request, const QByteArray &data);
+    QCoapAsyncResult postAsync(const QCoapRequest &request, const QByteArray &data);
+    QCoapAsyncResult deleteResourceAsync(const QCoapRequest &request);
+    QCoapNotificationStream observeAsync(const QCoapRequest &request);
+    QCoapNotificationStream observeAsync(const QUrl &url);
+    QCoapBatch sendBatch(QtCoap::Method method, const QVector<QCoapRequest> &requests,
+                         int maximumConcurrency = 0);
+    QCoapBatch getBatch(const QVector<QCoapRequest> &requests, int maximumConcurrency = 0);
     QCoapReply *observe(const QCoapRequest &request);
     QCoapReply *observe(const QUrl &request);
     void cancelObserve(QCoapReply *notifiedReply);
@@ -89,6 +117,14 @@ public:
     void setAckRandomFactor(double ackRandomFactor);
     void setMaximumRetransmitCount(uint maximumRetransmitCount);
     void setMinimumTokenSize(int tokenSize);
+    void setAdaptiveTimeoutEnabled(bool enabled);
+    void setAdaptiveBlockSizeEnabled(bool enabled);
+    void setPathMtu(int mtu);
+    void setPathMtu(const QPair<QHostAddress, int> &subnet, int mtu);
+    void setMaximumOutstandingRequests(int count);
+    void setNotificationCoalescingEnabled(bool enabled);
+
+    QCoapRoundTripStatistics roundTripStatistics(const QHostAddress &host) const;
 
 Q_SIGNALS:
     void finished(QCoapReply *reply);
@@ -34,6 +34,7 @@
 #include <QtCoap/qcoapclient.h>
 #include <QtCore/qthread.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qvector.h>
 #include <private/qobject_p.h>
 
 //
@@ -49,21 +50,57 @@
 
 QT_BEGIN_NAMESPACE
 
+class QCoapReplyDispatcher;
+
+struct QCoapClientShard
+{
+    QCoapProtocol *protocol = nullptr;
+    QCoapConnection *connection = nullptr;
+    // Used for the requests with the coap+tcp scheme. It is created with
+    // the shard, and only opens a socket once a request is sent.
+    QCoapConnection *tcpConnection = nullptr;
+    QThread *workerThread = nullptr;
+};
+
 class Q_AUTOTEST_EXPORT QCoapClientPrivate : public QObjectPrivate
 {
 public:
     QCoapClientPrivate(QCoapProtocol *protocol, QCoapConnection *connection);
     ~QCoapClientPrivate();
 
+    // Objects of the first shard, the only one unless several worker
+    // threads are requested
     QCoapProtocol *protocol = nullptr;
     QCoapConnection *connection = nullptr;
     QThread *workerThread = nullptr;
+    QVector<QCoapClientShard> shards;
+    QCoapReplyDispatcher *replyDispatcher = nullptr;
 
-    QCoapReply *sendRequest(const QCoapRequest &request);
+    QCoapReply *sendRequest(const QCoapRequest &request, QIODevice *device = nullptr);
     QCoapResourceDiscoveryReply *sendDiscovery(const QCoapRequest &request);
     bool send(QCoapReply *reply);
+    QCoapConnection *transportFor(const QCoapClientShard &shard,
+                                  const QCoapRequest &request) const;
+    QCoapRequestHandle sendWithCallback(const QCoapRequest &request,
+                                        const QCoapResultCallback &callback);
+    QCoapAsyncResult sendAsync(const QCoapRequest &request);
+    QCoapBatch sendBatch(QtCoap::Method method, const QVector<QCoapRequest> &requests,
+                         int maximumConcurrency);
+    static bool isUploadStreamed(QIODevice *device);
 
     void setConnection(QCoapConnection *customConnection);
+    void addShards(int count);
+    const QCoapClientShard &shardFor(const QUrl &url) const;
+    void connectShard(const QCoapClientShard &shard);
+    void stopWorkerThreads();
+    void connectTransport(QCoapConnection *transport, QCoapProtocol *shardProtocol);
+    void invokeOnProtocols(const char *member,
+                           QGenericArgument val0 = QGenericArgument(nullptr),
+                           QGenericArgument val1 = QGenericArgument(),
+                           QGenericArgument val2 = QGenericArgument());
+    void invokeOnConnections(const char *member,
+                             QGenericArgument val0 = QGenericArgument(nullptr),
+                             QGenericArgument val1 = QGenericArgument());
 
     Q_DECLARE_PUBLIC(QCoapClient)
 };
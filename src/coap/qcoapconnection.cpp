@@ -72,6 +72,18 @@ Q_LOGGING_CATEGORY(lcCoapConnection, "qt.coap.connection")
     parameter describes the type of error that occurred.
 */
 
+/*!
+    \internal
+
+    \fn void QCoapConnection::connectionLost(const QCoapEndpoint &endpoint,
+                                             QAbstractSocket::SocketError error)
+
+    This signal is emitted by connection-oriented transports when the
+    connection to \a endpoint could not be established, or was closed, so
+    that the exchanges in progress with this endpoint will get no response.
+    The \a error parameter describes why the connection was lost.
+*/
+
 /*!
     \internal
 
@@ -103,10 +115,10 @@ Q_LOGGING_CATEGORY(lcCoapConnection, "qt.coap.connection")
 /*!
     \internal
 
-    \fn void QCoapConnection::bind(const QString &host, quint16 port)
+    \fn void QCoapConnection::bind(const QCoapEndpoint &endpoint)
 
-    Prepares the underlying transport for data transmission to to the given \a host
-    address on \a port. Emits the bound() signal when the transport is ready.
+    Prepares the underlying transport for data transmission to to the given
+    \a endpoint. Emits the bound() signal when the transport is ready.
 
     This is a pure virtual method.
 
@@ -127,9 +139,13 @@ Q_LOGGING_CATEGORY(lcCoapConnection, "qt.coap.connection")
 /*!
     \internal
 
-    \fn void QCoapConnection::writeData(const QByteArray &data, const QString &host, quint16 port)
+    \fn void QCoapConnection::writeData(const QByteArray &data, const QCoapEndpoint &endpoint)
 
-    Sends the given \a data frame to the host address \a host at port \a port.
+    Sends the given \a data frame to the \a endpoint.
+
+    The frame is always encoded for an unreliable transport, as defined in
+    \l{https://tools.ietf.org/html/rfc7252#section-3}{RFC 7252 - Section 3}.
+    Reliable transports convert it to their own framing.
 
     This is a pure virtual method.
 */
@@ -179,22 +195,22 @@ QCoapConnection::~QCoapConnection()
     \internal
 
     Prepares the underlying transport for data transmission and sends the given
-    \a request frame to the given \a host at the given \a port when the transport
+    \a request frame to the given \a endpoint when the transport
     is ready.
 
     The preparation of the transport is done by calling the pure virtual bind() method,
     which needs to be implemented by derived classes.
 */
 void
-QCoapConnectionPrivate::sendRequest(const QByteArray &request, const QString &host, quint16 port)
+QCoapConnectionPrivate::sendRequest(const QByteArray &request, const QCoapEndpoint &endpoint)
 {
     Q_Q(QCoapConnection);
 
-    CoapFrame frame(request, host, port);
+    CoapFrame frame(request, endpoint);
     framesToSend.enqueue(frame);
 
     if (state == QCoapConnection::ConnectionState::Unconnected)
-        q->bind(host, port);
+        q->bind(endpoint);
     else
         q->startToSendRequest();
 }
@@ -232,6 +248,36 @@ QCoapConnection::ConnectionState QCoapConnection::state() const
     return d->state;
 }
 
+/*!
+    \internal
+
+    Returns \c true if the transport delivers the frames reliably and in
+    order, in which case the protocol does not retransmit Confirmable
+    messages, nor acknowledges the received ones.
+*/
+bool QCoapConnection::isReliable() const
+{
+    Q_D(const QCoapConnection);
+    return d->reliable;
+}
+
+/*!
+    \internal
+
+    Returns the size of the BERT blocks that can be sent to \a endpoint,
+    or 0 if BERT blocks are not supported. BERT blocks are
+    multiples of 1024 bytes, and are only available over reliable transports.
+    The default implementation returns 0.
+
+    For more details, refer to
+    \l{https://tools.ietf.org/html/rfc8323#section-6}{RFC 8323 - Section 6}.
+*/
+uint QCoapConnection::bertBlockSize(const QCoapEndpoint &endpoint) const
+{
+    Q_UNUSED(endpoint);
+    return 0;
+}
+
 /*!
     \internal
 
@@ -245,7 +291,7 @@ void QCoapConnection::startToSendRequest()
     Q_ASSERT(!d->framesToSend.isEmpty());
     while (!d->framesToSend.isEmpty()) {
         const CoapFrame frame = d->framesToSend.dequeue();
-        writeData(frame.currentPdu, frame.host, frame.port);
+        writeData(frame.currentPdu, frame.endpoint);
     }
 }
 
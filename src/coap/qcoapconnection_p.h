@@ -32,6 +32,7 @@
 
 #include <QtCoap/qcoapnamespace.h>
 #include <QtCoap/qcoapsecurityconfiguration.h>
+#include <private/qcoapendpoint_p.h>
 
 #include <QtCore/qqueue.h>
 #include <QtCore/qobject.h>
@@ -68,6 +69,7 @@ public:
     bool isSecure() const;
     QtCoap::SecurityMode securityMode() const;
     ConnectionState state() const;
+    bool isReliable() const;
     QCoapSecurityConfiguration securityConfiguration() const;
 
     Q_INVOKABLE void setSecurityConfiguration(const QCoapSecurityConfiguration &configuration);
@@ -75,6 +77,7 @@ public:
 
 Q_SIGNALS:
     void error(QAbstractSocket::SocketError error);
+    void connectionLost(const QCoapEndpoint &endpoint, QAbstractSocket::SocketError error);
     void readyRead(const QByteArray &data, const QHostAddress &sender);
     void bound();
     void securityConfigurationChanged();
@@ -85,9 +88,10 @@ private:
 protected:
     QCoapConnection(QObjectPrivate &dd, QObject *parent = nullptr);
 
-    virtual void bind(const QString &host, quint16 port) = 0;
-    virtual void writeData(const QByteArray &data, const QString &host, quint16 port) = 0;
+    virtual void bind(const QCoapEndpoint &endpoint) = 0;
+    virtual void writeData(const QByteArray &data, const QCoapEndpoint &endpoint) = 0;
     virtual void close() = 0;
+    virtual uint bertBlockSize(const QCoapEndpoint &endpoint) const;
 
 private:
     friend class QCoapProtocolPrivate;
@@ -97,11 +101,10 @@ private:
 
 struct CoapFrame {
     QByteArray currentPdu;
-    QString host;
-    quint16 port = 0;
+    QCoapEndpoint endpoint;
 
-    CoapFrame(const QByteArray &pdu, const QString &hostName, quint16 portNumber)
-    : currentPdu(pdu), host(hostName), port(portNumber) {}
+    CoapFrame(const QByteArray &pdu, const QCoapEndpoint &target)
+    : currentPdu(pdu), endpoint(target) {}
 };
 
 class Q_AUTOTEST_EXPORT QCoapConnectionPrivate : public QObjectPrivate
@@ -111,11 +114,12 @@ public:
 
     ~QCoapConnectionPrivate() override = default;
 
-    void sendRequest(const QByteArray &request, const QString &host, quint16 port);
+    void sendRequest(const QByteArray &request, const QCoapEndpoint &endpoint);
 
     QCoapSecurityConfiguration securityConfiguration;
     QtCoap::SecurityMode securityMode;
     QCoapConnection::ConnectionState state;
+    bool reliable = false;
     QQueue<CoapFrame> framesToSend;
 
     Q_DECLARE_PUBLIC(QCoapConnection)
@@ -0,0 +1,188 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapendpoint_p.h"
+#include "qcoapnamespace.h"
+
+#include <QtCore/qhashfunctions.h>
+#include <QtCore/qurl.h>
+#include <QtNetwork/qnetworkinterface.h>
+
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+
+    \class QCoapEndpoint
+    \inmodule QtCoap
+
+    \brief The QCoapEndpoint class identifies the address and port of a
+    CoAP server.
+
+    The host of a request is parsed once, when the exchange is registered,
+    and the resulting endpoint is shared by every frame sent for the
+    exchange and used to match the sender of the replies. Copies share the
+    same data, so that the frame queues carry no string to parse again.
+
+    An endpoint keeps the address, its raw forms, the index of its scope and
+    the port. The textual form of the host is only kept when it is not an IP
+    address, for reporting errors.
+*/
+
+/*!
+    \internal
+
+    Constructs an endpoint for the \a address and \a port.
+*/
+QCoapEndpoint::QCoapEndpoint(const QHostAddress &address, quint16 port)
+    : d(new QCoapEndpointData)
+{
+    d->address = address;
+    d->port = port;
+    d->bytes = address.toIPv6Address();
+    d->ipv4Address = address.toIPv4Address(&d->isIPv4);
+
+    const QString scopeId = address.scopeId();
+    if (!scopeId.isEmpty()) {
+        bool ok = false;
+        d->scopeIndex = scopeId.toUInt(&ok);
+        if (!ok)
+            d->scopeIndex = static_cast<quint32>(QNetworkInterface::interfaceIndexFromName(scopeId));
+    }
+}
+
+/*!
+    \internal
+
+    Returns the endpoint for the textual \a host address and \a port. The
+    endpoint is null if \a host is not an IP address, but keeps \a host for
+    reporting errors.
+*/
+QCoapEndpoint QCoapEndpoint::fromHost(const QString &host, quint16 port)
+{
+    QCoapEndpoint endpoint(QHostAddress(host), port);
+    if (endpoint.d->address.isNull())
+        endpoint.d->invalidHost = host;
+    return endpoint;
+}
+
+/*!
+    \internal
+
+    Returns the endpoint for the host and port of \a url. If \a url has no
+    port, the default CoAP port of its scheme is used.
+
+    \sa fromHost()
+*/
+QCoapEndpoint QCoapEndpoint::fromUrl(const QUrl &url)
+{
+    const int defaultPort = url.scheme() == QLatin1String("coaps")
+            ? QtCoap::DefaultSecurePort : QtCoap::DefaultPort;
+    return fromHost(url.host(), static_cast<quint16>(url.port(defaultPort)));
+}
+
+/*!
+    \internal
+
+    Returns the textual form of the host of the endpoint.
+*/
+QString QCoapEndpoint::host() const
+{
+    if (!d)
+        return QString();
+
+    return d->address.isNull() ? d->invalidHost : d->address.toString();
+}
+
+/*!
+    \internal
+
+    Returns the address of the endpoint, a null address for a null endpoint.
+*/
+const QHostAddress &QCoapEndpoint::address() const
+{
+    static const QHostAddress nullAddress;
+    return d ? d->address : nullAddress;
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a sender is the address of this endpoint. IPv4
+    addresses match their IPv4-mapped IPv6 form, as in
+    QHostAddress::isEqual(), without comparing the scopes.
+*/
+bool QCoapEndpoint::matches(const QHostAddress &sender) const
+{
+    if (isNull() || sender.isNull())
+        return false;
+
+    if (d->isIPv4 && sender.protocol() == QAbstractSocket::IPv4Protocol)
+        return sender.toIPv4Address() == d->ipv4Address;
+
+    const Q_IPV6ADDR senderBytes = sender.toIPv6Address();
+    return memcmp(senderBytes.c, d->bytes.c, sizeof(senderBytes.c)) == 0;
+}
+
+/*!
+    \internal
+
+    Returns \c true if this endpoint and \a other have the same address and
+    port.
+*/
+bool QCoapEndpoint::operator==(const QCoapEndpoint &other) const
+{
+    if (d == other.d)
+        return true;
+    if (!d || !other.d)
+        return false;
+
+    return d->port == other.d->port
+            && memcmp(d->bytes.c, other.d->bytes.c, sizeof(d->bytes.c)) == 0
+            && d->scopeIndex == other.d->scopeIndex;
+}
+
+/*!
+    \internal
+
+    Returns the hash value for the \a endpoint, using \a seed to seed the
+    calculation.
+*/
+uint qHash(const QCoapEndpoint &endpoint, uint seed) noexcept
+{
+    if (endpoint.isNull())
+        return seed;
+
+    const Q_IPV6ADDR bytes = endpoint.toIPv6Address();
+    return qHashBits(bytes.c, sizeof(bytes.c), qHash(endpoint.port(), seed));
+}
+
+QT_END_NAMESPACE
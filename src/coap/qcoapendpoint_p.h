@@ -0,0 +1,99 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPENDPOINT_P_H
+#define QCOAPENDPOINT_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qshareddata.h>
+#include <QtCore/qstring.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QUrl;
+
+struct QCoapEndpointData : public QSharedData
+{
+    QHostAddress address;
+    // Only set when the host is not an IP address, for reporting errors
+    QString invalidHost;
+    Q_IPV6ADDR bytes;
+    quint32 ipv4Address = 0;
+    quint32 scopeIndex = 0;
+    quint16 port = 0;
+    bool isIPv4 = false;
+};
+
+class Q_AUTOTEST_EXPORT QCoapEndpoint
+{
+public:
+    QCoapEndpoint() = default;
+    QCoapEndpoint(const QHostAddress &address, quint16 port);
+
+    static QCoapEndpoint fromHost(const QString &host, quint16 port);
+    static QCoapEndpoint fromUrl(const QUrl &url);
+
+    bool isNull() const { return !d || d->address.isNull(); }
+    const QHostAddress &address() const;
+    QString host() const;
+    quint16 port() const { return d ? d->port : 0; }
+    bool isMulticast() const { return d && d->address.isMulticast(); }
+    bool isIPv4() const { return d && d->isIPv4; }
+
+    // Raw forms of the address, for the transports filling socket addresses
+    Q_IPV6ADDR toIPv6Address() const { return d ? d->bytes : Q_IPV6ADDR(); }
+    quint32 toIPv4Address() const { return d ? d->ipv4Address : 0; }
+    quint32 scopeIndex() const { return d ? d->scopeIndex : 0; }
+
+    bool matches(const QHostAddress &sender) const;
+
+    bool operator==(const QCoapEndpoint &other) const;
+    bool operator!=(const QCoapEndpoint &other) const { return !(*this == other); }
+
+private:
+    QExplicitlySharedDataPointer<QCoapEndpointData> d;
+};
+
+Q_AUTOTEST_EXPORT uint qHash(const QCoapEndpoint &endpoint, uint seed = 0) noexcept;
+
+QT_END_NAMESPACE
+
+#endif // QCOAPENDPOINT_P_H
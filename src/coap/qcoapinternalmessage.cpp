@@ -107,7 +107,9 @@ QCoapInternalMessage::QCoapInternalMessage(QCoapInternalMessagePrivate &dd, QObj
     \note For block-wise transfer, the size of the block is expressed by a power
     of two. See
     \l{https://tools.ietf.org/html/rfc7959#section-2.2}{'Structure of a Block Option'}
-    in RFC 7959 for more information.
+    in RFC 7959 for more information. The SZX value 7 stands for a BERT block,
+    made of one or more blocks of 1024 bytes, see
+    \l{https://tools.ietf.org/html/rfc8323#section-6}{RFC 8323 - Section 6}.
 */
 void QCoapInternalMessage::setFromDescriptiveBlockOption(const QCoapOption &option)
 {
@@ -115,7 +117,8 @@ void QCoapInternalMessage::setFromDescriptiveBlockOption(const QCoapOption &opti
 
     const auto value = option.opaqueValue();
     const quint8 *optionData = reinterpret_cast<const quint8 *>(value.data());
-    const quint8 lastByte = optionData[option.length() - 1];
+    // An empty value stands for block 0 with the smallest size
+    const quint8 lastByte = option.length() > 0 ? optionData[option.length() - 1] : 0;
     quint32 blockNumber = 0;
 
     for (int i = 0; i < option.length() - 1; ++i)
@@ -124,10 +127,10 @@ void QCoapInternalMessage::setFromDescriptiveBlockOption(const QCoapOption &opti
     blockNumber = (blockNumber << 4) | (lastByte >> 4);
     d->currentBlockNumber = blockNumber;
     d->hasNextBlock = ((lastByte & 0x8) == 0x8);
-    d->blockSize = static_cast<uint>(1u << ((lastByte & 0x7) + 4));
 
-    if (d->blockSize > 1024)
-        qCWarning(lcCoapExchange, "Received a block size larger than 1024, something may be wrong.");
+    // The block number of BERT blocks counts blocks of 1024 bytes
+    d->isBertBlock = (lastByte & 0x7) == 7;
+    d->blockSize = d->isBertBlock ? 1024 : static_cast<uint>(1u << ((lastByte & 0x7) + 4));
 }
 
 /*!
@@ -231,6 +234,34 @@ uint QCoapInternalMessage::blockSize() const
     return d->blockSize;
 }
 
+/*!
+    \internal
+
+    Returns \c true if the block is a BERT block, whose payload holds one or
+    more blocks of 1024 bytes.
+*/
+bool QCoapInternalMessage::isBertBlock() const
+{
+    Q_D(const QCoapInternalMessage);
+    return d->isBertBlock;
+}
+
+/*!
+    \internal
+
+    Returns the offset of the block following this one, in bytes. A BERT
+    block is followed by the block starting right after its payload.
+*/
+qint64 QCoapInternalMessage::nextBlockOffset() const
+{
+    Q_D(const QCoapInternalMessage);
+
+    const qint64 offset = qint64(d->currentBlockNumber) * d->blockSize;
+    if (d->isBertBlock)
+        return offset + d->message.payload().size();
+    return offset + d->blockSize;
+}
+
 /*!
     \internal
 
@@ -67,6 +67,8 @@ public:
     uint currentBlockNumber() const;
     bool hasMoreBlocksToReceive() const;
     uint blockSize() const;
+    bool isBertBlock() const;
+    qint64 nextBlockOffset() const;
 
     virtual bool isValid() const;
     static bool isUrlValid(const QUrl &url);
@@ -90,6 +92,7 @@ public:
     uint currentBlockNumber = 0;
     bool hasNextBlock = false;
     uint blockSize = 0;
+    bool isBertBlock = false;
 };
 
 QT_END_NAMESPACE
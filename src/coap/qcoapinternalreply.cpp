@@ -58,10 +58,32 @@ QCoapInternalReply::QCoapInternalReply(QObject *parent) :
 
 /*!
     \internal
-    Creates a QCoapInternalReply from the CoAP \a reply frame.
+    Creates a QCoapInternalReply from the CoAP \a frame, or returns \c nullptr
+    if the frame is not a well-formed CoAP message.
 
     For more details, refer to section
     \l{https://tools.ietf.org/html/rfc7252#section-3}{'Message format' of RFC 7252}.
+
+    \sa createFromView()
+*/
+QCoapInternalReply *QCoapInternalReply::createFromFrame(const QByteArray &frame, QObject *parent)
+{
+    const QCoapPduView pdu(frame);
+    if (!pdu.isValid())
+        return nullptr;
+
+    return createFromView(pdu, parent);
+}
+
+/*!
+    \internal
+    Creates a QCoapInternalReply from the parsed frame \a pdu, which must be
+    valid.
+
+    The reply keeps a reference to the frame of \a pdu, which must own its
+    data, and its token, option values and payload point into it instead of
+    being copied. They are only copied by detachedMessage() and
+    detachedPayload(), when handed over to the user.
 */
 //!  0                   1                   2                   3
 //!  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -74,61 +96,33 @@ QCoapInternalReply::QCoapInternalReply(QObject *parent) :
 //! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 //! |1 1 1 1 1 1 1 1|    Payload (if any) ...
 //! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-QCoapInternalReply *QCoapInternalReply::createFromFrame(const QByteArray &reply, QObject *parent)
+QCoapInternalReply *QCoapInternalReply::createFromView(const QCoapPduView &pdu, QObject *parent)
 {
+    Q_ASSERT(pdu.isValid());
+
     QCoapInternalReply *internalReply = new QCoapInternalReply(parent);
     QCoapInternalReplyPrivate *d = internalReply->d_func();
 
-    const quint8 *pduData = reinterpret_cast<const quint8 *>(reply.data());
-
-    // Parse Header and Token
-    d->message.setVersion((pduData[0] >> 6) & 0x03);
-    d->message.setType(QCoapMessage::Type((pduData[0] >> 4) & 0x03));
-    quint8 tokenLength = (pduData[0]) & 0x0F;
-    d->responseCode = static_cast<QtCoap::ResponseCode>(pduData[1]);
-    d->message.setMessageId(static_cast<quint16>((static_cast<quint16>(pduData[2]) << 8)
-                                                 | static_cast<quint16>(pduData[3])));
-    d->message.setToken(reply.mid(4, tokenLength));
-
-    // Parse Options
-    int i = 4 + tokenLength;
-    quint16 lastOptionNumber = 0;
-    while (i != reply.length() && pduData[i] != 0xFF) {
-        quint16 optionDelta = ((pduData[i] >> 4) & 0x0F);
-        quint16 optionLength = (pduData[i] & 0x0F);
-
-        // Delta value > 12 : special values
-        if (optionDelta == 13) {
-            ++i;
-            optionDelta = pduData[i] + 13;
-        } else if (optionDelta == 14) {
-            ++i;
-            optionDelta = pduData[i] + 269;
-        }
-
-        // Delta length > 12 : special values
-        if (optionLength == 13) {
-            ++i;
-            optionLength = pduData[i] + 13;
-        } else if (optionLength == 14) {
-            ++i;
-            optionLength = pduData[i] + 269;
-        }
-
-        quint16 optionNumber = lastOptionNumber + optionDelta;
-        internalReply->addOption(QCoapOption::OptionName(optionNumber),
-                                 reply.mid(i + 1, optionLength));
-        lastOptionNumber = optionNumber;
-        i += 1 + optionLength;
-    }
+    // The slices of the view stay valid as long as the frame is referenced
+    d->frame = pdu.frame();
+
+    // Header and Token
+    d->message.setVersion(pdu.version());
+    d->message.setType(pdu.type());
+    d->responseCode = pdu.responseCode();
+    d->message.setMessageId(pdu.messageId());
+    d->message.setToken(pdu.token());
 
-    // Parse Payload
-    if (pduData[i] == 0xFF) {
-        // -1 because of 0xFF at the beginning
-        QByteArray currentPayload = reply.mid(i + 1);
-        d->message.setPayload(d->message.payload().append(currentPayload));
+    // Options, already sorted by number in the frame
+    for (int i = 0; i < pdu.optionCount(); ++i) {
+        internalReply->addOption(QCoapOption(QCoapOption::OptionName(pdu.optionNumber(i)),
+                                             pdu.optionValue(i)));
     }
 
+    // Payload
+    if (pdu.hasPayload())
+        d->message.setPayload(pdu.payload());
+
     return internalReply;
 }
 
@@ -164,6 +158,57 @@ void QCoapInternalReply::setSenderAddress(const QHostAddress &address)
     d->senderAddress = address;
 }
 
+/*!
+    \internal
+    Returns a copy of the message of the reply owning its data, which remains
+    valid once the reply and its frame are released.
+
+    \sa detachedPayload()
+*/
+QCoapMessage QCoapInternalReply::detachedMessage() const
+{
+    Q_D(const QCoapInternalReply);
+
+    QCoapMessage message = d->message;
+    message.setToken(d->detached(message.token()));
+
+    QVector<QCoapOption> options;
+    options.reserve(d->message.options().size());
+    for (const QCoapOption &option : d->message.options())
+        options.append(QCoapOption(option.name(), d->detached(option.opaqueValue())));
+    message.setOptions(options);
+
+    message.setPayload(d->detached(message.payload()));
+    return message;
+}
+
+/*!
+    \internal
+    Returns a copy of the payload of the reply owning its data.
+
+    \sa detachedMessage()
+*/
+QByteArray QCoapInternalReply::detachedPayload() const
+{
+    Q_D(const QCoapInternalReply);
+    return d->detached(d->message.payload());
+}
+
+/*!
+    \internal
+    Returns a deep copy of \a value if it points into the frame of the reply,
+    or else \a value itself.
+*/
+QByteArray QCoapInternalReplyPrivate::detached(const QByteArray &value) const
+{
+    const char *begin = frame.constData();
+    if (value.isEmpty() || value.constData() < begin
+            || value.constData() >= begin + frame.size()) {
+        return value;
+    }
+    return QByteArray(value.constData(), value.size());
+}
+
 /*!
     \internal
     Returns the number of the next block, if there is another block to come,
@@ -181,7 +226,8 @@ int QCoapInternalReply::nextBlockToSend() const
 
     const auto value = option.opaqueValue();
     const quint8 *optionData = reinterpret_cast<const quint8 *>(value.data());
-    const quint8 lastByte = optionData[option.length() - 1];
+    // An empty value stands for block 0 without the M flag
+    const quint8 lastByte = option.length() > 0 ? optionData[option.length() - 1] : 0;
 
     // M field
     bool hasNextBlock = ((lastByte & 0x8) == 0x8);
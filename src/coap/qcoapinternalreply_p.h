@@ -34,6 +34,7 @@
 #include <QtCoap/qcoapglobal.h>
 #include <QtCoap/qcoapnamespace.h>
 #include <private/qcoapinternalmessage_p.h>
+#include <private/qcoappduview_p.h>
 #include <QtNetwork/qhostaddress.h>
 
 //
@@ -57,6 +58,7 @@ public:
     explicit QCoapInternalReply(QObject *parent = nullptr);
 
     static QCoapInternalReply *createFromFrame(const QByteArray &frame, QObject *parent = nullptr);
+    static QCoapInternalReply *createFromView(const QCoapPduView &pdu, QObject *parent = nullptr);
     void appendData(const QByteArray &data);
     bool hasMoreBlocksToSend() const;
     int nextBlockToSend() const;
@@ -68,6 +70,9 @@ public:
     QtCoap::ResponseCode responseCode() const;
     QHostAddress senderAddress() const;
 
+    QCoapMessage detachedMessage() const;
+    QByteArray detachedPayload() const;
+
 private:
     Q_DECLARE_PRIVATE(QCoapInternalReply)
 };
@@ -77,8 +82,11 @@ class Q_AUTOTEST_EXPORT QCoapInternalReplyPrivate : public QCoapInternalMessageP
 public:
     QCoapInternalReplyPrivate() = default;
 
+    QByteArray detached(const QByteArray &value) const;
+
     QtCoap::ResponseCode responseCode = QtCoap::ResponseCode::InvalidCode;
     QHostAddress senderAddress;
+    QByteArray frame;
 };
 
 QT_END_NAMESPACE
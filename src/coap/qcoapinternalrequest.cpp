@@ -30,6 +30,7 @@
 
 #include "qcoaprequest.h"
 #include "qcoapinternalrequest_p.h"
+#include "qcoapmessage_p.h"
 
 #include <QtCore/qmath.h>
 #include <QtCore/qrandom.h>
@@ -62,16 +63,9 @@ QCoapInternalRequest::QCoapInternalRequest(QObject *parent) :
     QCoapInternalMessage(*new QCoapInternalRequestPrivate, parent)
 {
     Q_D(QCoapInternalRequest);
-    d->timeoutTimer = new QTimer(this);
-    connect(d->timeoutTimer, &QTimer::timeout, this, [this]() { emit timeout(this); });
-
-    d->maxTransmitWaitTimer = new QTimer(this);
-    connect(d->maxTransmitWaitTimer, &QTimer::timeout, this,
-            [this]() { emit maxTransmissionSpanReached(this); });
-
-    d->multicastExpireTimer = new QTimer(this);
-    connect(d->multicastExpireTimer, &QTimer::timeout, this,
-            [this]() { emit multicastRequestExpired(this); });
+    d->timeoutDeadline.request = this;
+    d->maxTransmitWaitDeadline.request = this;
+    d->multicastExpireDeadline.request = this;
 }
 
 /*!
@@ -139,20 +133,89 @@ void QCoapInternalRequest::initForReset(quint16 messageId)
 
 /*!
     \internal
-    Explicitly casts \a value to a char and appends it to the \a buffer.
+    Returns the number of extended bytes needed to encode the option delta
+    or length \a value.
 */
-template<typename T>
-static void appendByte(QByteArray *buffer, T value) {
-    buffer->append(static_cast<char>(value));
+static int extendedSize(quint32 value)
+{
+    if (value > 268)
+        return 2;
+    if (value > 12)
+        return 1;
+    return 0;
 }
 
 /*!
     \internal
-    Returns the CoAP frame corresponding to the QCoapInternalRequest into
-    a QByteArray object.
+    Returns the 4-bit nibble encoding the option delta or length \a value.
+*/
+static quint8 optionNibble(quint32 value)
+{
+    if (value > 268)
+        return 14;
+    if (value > 12)
+        return 13;
+    return static_cast<quint8>(value);
+}
+
+/*!
+    \internal
+    Writes the extended bytes of the option delta or length \a value, if any,
+    at \a pdu and returns the position following them.
+*/
+static quint8 *writeOptionExtended(quint32 value, quint8 *pdu)
+{
+    if (value > 268) {
+        const quint32 extendedValue = value - 269;
+        Q_ASSERT(extendedValue <= 0xFFFF);
+        *pdu++ = static_cast<quint8>(extendedValue >> 8);
+        *pdu++ = static_cast<quint8>(extendedValue);
+    } else if (value > 12) {
+        *pdu++ = static_cast<quint8>(value - 13);
+    }
+    return pdu;
+}
+
+/*!
+    \internal
+    Returns the exact size of the CoAP frame corresponding to the
+    QCoapInternalRequest.
+
+    \sa encode(), toQByteArray()
+*/
+int QCoapInternalRequest::encodedSize() const
+{
+    Q_D(const QCoapInternalRequest);
+
+    // Header, token and payload marker
+    int size = 4 + d->message.token().length();
+    if (!d->message.payload().isEmpty())
+        size += 1 + d->message.payload().length();
+
+    quint16 lastOptionNumber = 0;
+    for (const QCoapOption &option : d->message.options()) {
+        const quint16 optionNumber = static_cast<quint16>(option.name());
+        const int length = option.length();
+        size += 1 + extendedSize(optionNumber - lastOptionNumber) + extendedSize(length) + length;
+        lastOptionNumber = optionNumber;
+    }
+
+    return size;
+}
+
+/*!
+    \internal
+    Encodes the CoAP frame corresponding to the QCoapInternalRequest into
+    \a buffer, resizing it to the exact size of the frame.
+
+    The frame is written in one go, so the memory of \a buffer is reused
+    without any reallocation when it is not shared and large enough, for
+    instance when encoding successive frames into the same buffer.
 
     For more details, refer to section
     \l{https://tools.ietf.org/html/rfc7252#section-3}{'Message format' of RFC 7252}.
+
+    \sa encodedSize(), toQByteArray()
 */
 //! 0                   1                   2                   3
 //! 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -165,85 +228,114 @@ static void appendByte(QByteArray *buffer, T value) {
 //! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
 //! |1 1 1 1 1 1 1 1|    Payload (if any) ...
 //! +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-QByteArray QCoapInternalRequest::toQByteArray() const
+void QCoapInternalRequest::encode(QByteArray *buffer) const
 {
     Q_D(const QCoapInternalRequest);
-    QByteArray pdu;
+    Q_ASSERT(buffer);
+
+    const int size = encodedSize();
+    buffer->resize(size);
+    quint8 *pdu = reinterpret_cast<quint8 *>(buffer->data());
+    quint8 *const pduEnd = pdu + size;
+    Q_UNUSED(pduEnd);
+
+    const QCoapToken token = d->message.token();
+    const quint16 messageId = d->message.messageId();
 
     // Insert header
-    appendByte(&pdu, (d->message.version()                   << 6)  // CoAP version
-                   | (static_cast<quint8>(d->message.type()) << 4)  // Message type
-                   |  d->message.token().length());                 // Token Length
-    appendByte(&pdu,  static_cast<quint8>(d->method) & 0xFF);       // Method code
-    appendByte(&pdu, (d->message.messageId() >> 8)   & 0xFF);       // Message ID
-    appendByte(&pdu,  d->message.messageId()         & 0xFF);
+    *pdu++ = static_cast<quint8>((d->message.version()                   << 6)  // CoAP version
+                               | (static_cast<quint8>(d->message.type()) << 4)  // Message type
+                               |  token.length());                              // Token Length
+    *pdu++ = static_cast<quint8>(d->method);                                    // Method code
+    *pdu++ = static_cast<quint8>(messageId >> 8);                               // Message ID
+    *pdu++ = static_cast<quint8>(messageId);
 
     // Insert Token
-    pdu.append(d->message.token());
-
-    // Insert Options
-    if (!d->message.options().isEmpty()) {
-        QVector<QCoapOption> options = d->message.options();
-
-        // Options should be sorted in order of their option numbers
-        Q_ASSERT(std::is_sorted(d->message.options().cbegin(), d->message.options().cend(),
-                                [](const QCoapOption &a, const QCoapOption &b) -> bool {
-                                    return a.name() < b.name();
-                 }));
-
-        quint8 lastOptionNumber = 0;
-        for (const QCoapOption &option : qAsConst(options)) {
-
-            quint16 optionDelta = static_cast<quint16>(option.name()) - lastOptionNumber;
-            bool isOptionDeltaExtended = false;
-            quint8 optionDeltaExtended = 0;
-
-            // Delta value > 12 : special values
-            if (optionDelta > 268) {
-                optionDeltaExtended = static_cast<quint8>(optionDelta - 269);
-                optionDelta = 14;
-                isOptionDeltaExtended = true;
-            } else if (optionDelta > 12) {
-                optionDeltaExtended = static_cast<quint8>(optionDelta - 13);
-                optionDelta = 13;
-                isOptionDeltaExtended = true;
-            }
-
-            quint16 optionLength = static_cast<quint16>(option.length());
-            bool isOptionLengthExtended = false;
-            quint8 optionLengthExtended = 0;
-
-            // Length > 12 : special values
-            if (optionLength > 268) {
-                optionLengthExtended = static_cast<quint8>(optionLength - 269);
-                optionLength = 14;
-                isOptionLengthExtended = true;
-            } else if (optionLength > 12) {
-                optionLengthExtended = static_cast<quint8>(optionLength - 13);
-                optionLength = 13;
-                isOptionLengthExtended = true;
-            }
-
-            appendByte(&pdu, (optionDelta << 4) | (optionLength & 0x0F));
-
-            if (isOptionDeltaExtended)
-                appendByte(&pdu, optionDeltaExtended);
-            if (isOptionLengthExtended)
-                appendByte(&pdu, optionLengthExtended);
-
-            pdu.append(option.opaqueValue());
-
-            lastOptionNumber = option.name();
-        }
+    memcpy(pdu, token.constData(), static_cast<size_t>(token.length()));
+    pdu += token.length();
+
+    // Insert Options, which should be sorted in order of their option numbers
+    Q_ASSERT(std::is_sorted(d->message.options().cbegin(), d->message.options().cend(),
+                            [](const QCoapOption &a, const QCoapOption &b) -> bool {
+                                return a.name() < b.name();
+             }));
+
+    quint16 lastOptionNumber = 0;
+    for (const QCoapOption &option : d->message.options()) {
+        const quint16 optionNumber = static_cast<quint16>(option.name());
+        const QByteArray value = option.opaqueValue();
+
+        const quint32 delta = optionNumber - lastOptionNumber;
+        const quint32 length = static_cast<quint32>(value.length());
+
+        *pdu++ = static_cast<quint8>((optionNibble(delta) << 4) | optionNibble(length));
+        pdu = writeOptionExtended(delta, pdu);
+        pdu = writeOptionExtended(length, pdu);
+
+        memcpy(pdu, value.constData(), static_cast<size_t>(value.length()));
+        pdu += value.length();
+
+        lastOptionNumber = optionNumber;
     }
 
     // Insert Payload
-    if (!d->message.payload().isEmpty()) {
-        appendByte(&pdu, 0xFF);
-        pdu.append(d->message.payload());
+    const QByteArray payload = d->message.payload();
+    if (!payload.isEmpty()) {
+        *pdu++ = 0xFF;
+        memcpy(pdu, payload.constData(), static_cast<size_t>(payload.length()));
+        pdu += payload.length();
     }
 
-    return pdu;
+    Q_ASSERT(pdu == pduEnd);
+}
+
+/*!
+    \internal
+    Returns the CoAP frame corresponding to the QCoapInternalRequest into
+    a QByteArray object, sharing the frame cached by encodedFrame().
+
+    \sa encode()
+*/
+QByteArray QCoapInternalRequest::toQByteArray() const
+{
+    return encodedFrame();
+}
+
+/*!
+    \internal
+    Returns the CoAP frame corresponding to the QCoapInternalRequest.
+
+    The frame is cached, and only encoded again once the message or the
+    method of the request changed, so that retransmissions send the same
+    bytes without encoding them. A change of the message ID alone is patched
+    in the cached frame by setMessageId().
+
+    Any change to the message is detected, including those made through
+    message(): the cache keeps a copy of the message it was encoded from,
+    so modifying the message detaches it from that copy.
+
+    \sa encode()
+*/
+const QByteArray &QCoapInternalRequest::encodedFrame() const
+{
+    Q_D(const QCoapInternalRequest);
+
+    if (!d->isFrameValid()) {
+        encode(&d->frame);
+        d->frameMessage = d->message;
+        d->frameEncoded = true;
+    }
+    return d->frame;
+}
+
+/*!
+    \internal
+    Returns \c true if the cached frame matches the current message.
+*/
+bool QCoapInternalRequestPrivate::isFrameValid() const
+{
+    return frameEncoded
+            && QCoapMessagePrivate::get(frameMessage) == QCoapMessagePrivate::get(message);
 }
 
 /*!
@@ -251,6 +343,10 @@ QByteArray QCoapInternalRequest::toQByteArray() const
     Initializes block parameters and creates the options needed to request the
     block \a blockNumber with a size of \a blockSize.
 
+    A \a blockSize larger than 1024 asks for BERT blocks, whose size is
+    chosen by the server. The \a blockNumber then counts blocks of 1024
+    bytes.
+
     \sa blockOption(), setToSendBlock()
 */
 void QCoapInternalRequest::setToRequestBlock(uint blockNumber, uint blockSize)
@@ -271,6 +367,9 @@ void QCoapInternalRequest::setToRequestBlock(uint blockNumber, uint blockSize)
     Initialize blocks parameters and creates the options needed to send the block with
     the number \a blockNumber and with a size of \a blockSize.
 
+    A \a blockSize larger than 1024, and multiple of 1024, sends a BERT block
+    of that size. The \a blockNumber then counts blocks of 1024 bytes.
+
     \sa blockOption(), setToRequestBlock()
 */
 void QCoapInternalRequest::setToSendBlock(uint blockNumber, uint blockSize)
@@ -280,13 +379,36 @@ void QCoapInternalRequest::setToSendBlock(uint blockNumber, uint blockSize)
     if (!checkBlockNumber(blockNumber))
         return;
 
-    d->message.setPayload(d->fullPayload.mid(static_cast<int>(blockNumber * blockSize),
+    const qint64 offset = qint64(blockNumber) * qMin(blockSize, 1024u);
+    d->message.setPayload(d->fullPayload.mid(static_cast<int>(offset),
                                              static_cast<int>(blockSize)));
     d->message.removeOption(QCoapOption::Block1);
 
     addOption(blockOption(QCoapOption::Block1, blockNumber, blockSize));
 }
 
+/*!
+    \internal
+    \overload
+
+    Initializes block parameters and creates the options needed to send the
+    block \a blockNumber of \a blockSize bytes, whose content \a data was
+    read from a device. \a hasMoreBlocks tells whether more blocks follow.
+*/
+void QCoapInternalRequest::setToSendBlock(uint blockNumber, uint blockSize,
+                                          const QByteArray &data, bool hasMoreBlocks)
+{
+    Q_D(QCoapInternalRequest);
+
+    if (!checkBlockNumber(blockNumber))
+        return;
+
+    d->message.setPayload(data);
+    d->message.removeOption(QCoapOption::Block1);
+
+    addOption(blockOption(QCoapOption::Block1, blockNumber, blockSize, hasMoreBlocks));
+}
+
 /*!
     \internal
     Returns \c true if the block number is valid, \c false otherwise.
@@ -315,8 +437,25 @@ QCoapOption QCoapInternalRequest::blockOption(QCoapOption::OptionName name, uint
 {
     Q_D(const QCoapInternalRequest);
 
-    Q_ASSERT((blockSize & (blockSize - 1)) == 0); // is a power of two
-    Q_ASSERT(!(blockSize >> 11)); // blockSize <= 1024
+    const qint64 blockEnd = qint64(blockNumber) * qMin(blockSize, 1024u) + blockSize;
+    const bool hasMoreBlocks = name == QCoapOption::Block1
+            && blockEnd < d->fullPayload.length();
+    return blockOption(name, blockNumber, blockSize, hasMoreBlocks);
+}
+
+/*!
+    \internal
+    \overload
+
+    Builds and returns a Block option, whose M field is set if
+    \a hasMoreBlocks is \c true. A \a blockSize larger than 1024 builds the
+    option of a BERT block, with an SZX of 7.
+*/
+QCoapOption QCoapInternalRequest::blockOption(QCoapOption::OptionName name, uint blockNumber,
+                                              uint blockSize, bool hasMoreBlocks) const
+{
+    Q_ASSERT(blockSize > 1024 ? blockSize % 1024 == 0 // is a BERT block
+                              : (blockSize & (blockSize - 1)) == 0); // is a power of two
 
     // NUM field: the relative number of the block within a sequence of blocks
     // 4, 12 or 20 bits (as little as possible)
@@ -324,17 +463,19 @@ QCoapOption QCoapInternalRequest::blockOption(QCoapOption::OptionName name, uint
     quint32 optionData = (blockNumber << 4);
 
     // SZX field: the size of the block
-    // 3 bits, set to "log2(blockSize) - 4"
-    optionData |= (blockSize >> 7)
-                  ? ((blockSize >> 10) ? 6 : (3 + (blockSize >> 8)))
-                  : (blockSize >> 5);
+    // 3 bits, set to "log2(blockSize) - 4", or to 7 for BERT blocks
+    if (blockSize > 1024) {
+        optionData |= 7;
+    } else {
+        optionData |= (blockSize >> 7)
+                      ? ((blockSize >> 10) ? 6 : (3 + (blockSize >> 8)))
+                      : (blockSize >> 5);
+    }
 
     // M field: whether more blocks are following
     // 1 bit
-    if (name == QCoapOption::Block1
-            && static_cast<int>((blockNumber + 1) * blockSize) < d->fullPayload.length()) {
+    if (hasMoreBlocks)
         optionData |= 8;
-    }
 
     QByteArray optionValue;
     Q_ASSERT(!(optionData >> 24));
@@ -354,7 +495,15 @@ QCoapOption QCoapInternalRequest::blockOption(QCoapOption::OptionName name, uint
 void QCoapInternalRequest::setMessageId(quint16 id)
 {
     Q_D(QCoapInternalRequest);
+    const bool patchFrame = d->isFrameValid();
     d->message.setMessageId(id);
+
+    // The message ID has a fixed place in the frame, no need to encode it again
+    if (patchFrame) {
+        d->frame[2] = static_cast<char>(id >> 8);
+        d->frame[3] = static_cast<char>(id & 0xFF);
+        d->frameMessage = d->message;
+    }
 }
 
 /*!
@@ -393,6 +542,7 @@ bool QCoapInternalRequest::addUriOptions(QUrl uri, const QUrl &proxyUri)
     Q_D(QCoapInternalRequest);
     // Set to an invalid state
     d->targetUri = QUrl();
+    d->endpoint = QCoapEndpoint();
 
     // When using a proxy uri, we SHOULD NOT include Uri-Host/Port/Path/Query
     // options.
@@ -401,7 +551,7 @@ bool QCoapInternalRequest::addUriOptions(QUrl uri, const QUrl &proxyUri)
             return false;
 
         addOption(QCoapOption(QCoapOption::ProxyUri, proxyUri.toString()));
-        d->targetUri = proxyUri;
+        setTargetUri(proxyUri);
         return true;
     }
 
@@ -448,7 +598,7 @@ bool QCoapInternalRequest::addUriOptions(QUrl uri, const QUrl &proxyUri)
             addOption(QCoapOption(QCoapOption::UriQuery, queryElement.toString()));
     }
 
-    d->targetUri = uri;
+    setTargetUri(uri);
     return true;
 }
 
@@ -465,52 +615,55 @@ QCoapToken QCoapInternalRequest::token() const
     \internal
     Used to mark the transmission as "in progress", when starting or retrying
     to transmit a message. This method manages the retransmission counter,
-    the transmission timeout and the exchange timeout.
+    and schedules the transmission timeout and the exchange timeout on
+    \a timerWheel, relative to the time \a now.
 */
-void QCoapInternalRequest::restartTransmission()
+void QCoapInternalRequest::restartTransmission(QCoapTimerWheel *timerWheel, qint64 now)
 {
     Q_D(QCoapInternalRequest);
 
     if (!d->transmissionInProgress) {
         d->transmissionInProgress = true;
-        d->maxTransmitWaitTimer->start();
+        d->transmissionStartTime = now;
+        timerWheel->schedule(&d->maxTransmitWaitDeadline, now + d->maxTransmitWait);
     } else {
         d->retransmissionCounter++;
-        d->timeout *= 2;
+        d->timeout = static_cast<uint>(d->timeout * d->backoffFactor);
     }
 
     if (d->timeout > 0)
-        d->timeoutTimer->start(static_cast<int>(d->timeout));
+        timerWheel->schedule(&d->timeoutDeadline, now + d->timeout);
 }
 
 /*!
     \internal
 
-    Starts the timer for keeping the multicast request \e alive.
+    Schedules on \a timerWheel the expiration of the multicast request,
+    which is kept \e alive until then, relative to the time \a now.
 */
-void QCoapInternalRequest::startMulticastTransmission()
+void QCoapInternalRequest::startMulticastTransmission(QCoapTimerWheel *timerWheel, qint64 now)
 {
     Q_ASSERT(isMulticast());
 
     Q_D(QCoapInternalRequest);
-    d->multicastExpireTimer->start();
+    timerWheel->schedule(&d->multicastExpireDeadline, now + d->multicastTimeout);
 }
 
 /*!
     \internal
     Marks the transmission as not running, after a successful reception or an
-    error. It resets the retransmission count if needed and stops all timeout timers.
+    error. It resets the retransmission count if needed and cancels all timeouts.
 */
 void QCoapInternalRequest::stopTransmission()
 {
     Q_D(QCoapInternalRequest);
     if (isMulticast()) {
-        d->multicastExpireTimer->stop();
+        d->multicastExpireDeadline.cancel();
     } else {
         d->transmissionInProgress = false;
         d->retransmissionCounter = 0;
-        d->maxTransmitWaitTimer->stop();
-        d->timeoutTimer->stop();
+        d->maxTransmitWaitDeadline.cancel();
+        d->timeoutDeadline.cancel();
     }
 }
 
@@ -526,6 +679,19 @@ QUrl QCoapInternalRequest::targetUri() const
     return d->targetUri;
 }
 
+/*!
+    \internal
+    Returns the endpoint the request is sent to, resolved from the target
+    uri once, when it is set.
+
+    \sa targetUri()
+*/
+QCoapEndpoint QCoapInternalRequest::endpoint() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->endpoint;
+}
+
 /*!
     \internal
     Returns the connection used to send this request.
@@ -580,8 +746,8 @@ bool QCoapInternalRequest::isObserveCancelled() const
 */
 bool QCoapInternalRequest::isMulticast() const
 {
-    const QHostAddress hostAddress(targetUri().host());
-    return hostAddress.isMulticast();
+    Q_D(const QCoapInternalRequest);
+    return d->endpoint.isMulticast();
 }
 
 /*!
@@ -594,6 +760,28 @@ uint QCoapInternalRequest::retransmissionCounter() const
     return d->retransmissionCounter;
 }
 
+/*!
+    \internal
+    Returns \c true if the request has been sent and is waiting for an
+    acknowledgment or a response.
+*/
+bool QCoapInternalRequest::isTransmissionInProgress() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->transmissionInProgress;
+}
+
+/*!
+    \internal
+    Returns the time of the first transmission of the request, in the time
+    base of the timer wheel, not counting retransmissions.
+*/
+qint64 QCoapInternalRequest::transmissionStartTime() const
+{
+    Q_D(const QCoapInternalRequest);
+    return d->transmissionStartTime;
+}
+
 /*!
     \internal
     Sets the method of the request to the given \a method.
@@ -603,7 +791,10 @@ uint QCoapInternalRequest::retransmissionCounter() const
 void QCoapInternalRequest::setMethod(QtCoap::Method method)
 {
     Q_D(QCoapInternalRequest);
-    d->method = method;
+    if (d->method != method) {
+        d->method = method;
+        d->frameEncoded = false;
+    }
 }
 
 /*!
@@ -632,14 +823,17 @@ void QCoapInternalRequest::setObserveCancelled()
 
 /*!
     \internal
-    Sets the target uri to the given \a targetUri.
+    Sets the target uri to the given \a targetUri, and the endpoint of the
+    request to \a endpoint. If \a endpoint is null, it is resolved from the
+    host and port of \a targetUri.
 
-    \sa targetUri()
+    \sa targetUri(), endpoint()
 */
-void QCoapInternalRequest::setTargetUri(QUrl targetUri)
+void QCoapInternalRequest::setTargetUri(QUrl targetUri, const QCoapEndpoint &endpoint)
 {
     Q_D(QCoapInternalRequest);
     d->targetUri = targetUri;
+    d->endpoint = endpoint.isNull() ? QCoapEndpoint::fromUrl(targetUri) : endpoint;
 }
 
 /*!
@@ -647,7 +841,10 @@ void QCoapInternalRequest::setTargetUri(QUrl targetUri)
     Sets the timeout to the given \a timeout value in milliseconds. Timeout is
     used for reliable transmission of Confirmable messages.
 
-    When such request times out, its timeout value will double.
+    When such request times out, its timeout value is multiplied by the
+    backoff factor, which is 2 by default.
+
+    \sa setBackoffFactor()
 */
 void QCoapInternalRequest::setTimeout(uint timeout)
 {
@@ -655,6 +852,19 @@ void QCoapInternalRequest::setTimeout(uint timeout)
     d->timeout = timeout;
 }
 
+/*!
+    \internal
+    Sets the \a factor by which the timeout is multiplied on each
+    retransmission.
+
+    \sa setTimeout()
+*/
+void QCoapInternalRequest::setBackoffFactor(double factor)
+{
+    Q_D(QCoapInternalRequest);
+    d->backoffFactor = factor;
+}
+
 /*!
     \internal
     Sets the maximum transmission span for the request. If the request is
@@ -663,7 +873,7 @@ void QCoapInternalRequest::setTimeout(uint timeout)
 void QCoapInternalRequest::setMaxTransmissionWait(uint duration)
 {
     Q_D(QCoapInternalRequest);
-    d->maxTransmitWaitTimer->setInterval(static_cast<int>(duration));
+    d->maxTransmitWait = duration;
 }
 
 /*!
@@ -681,7 +891,7 @@ void QCoapInternalRequest::setMaxTransmissionWait(uint duration)
 void QCoapInternalRequest::setMulticastTimeout(uint responseDelay)
 {
     Q_D(QCoapInternalRequest);
-    d->multicastExpireTimer->setInterval(static_cast<int>(responseDelay));
+    d->multicastTimeout = responseDelay;
 }
 
 /*!
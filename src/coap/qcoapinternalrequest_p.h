@@ -36,9 +36,10 @@
 #include <QtCoap/qcoapglobal.h>
 #include <QtCoap/qcoapnamespace.h>
 #include <private/qcoapconnection_p.h>
+#include <private/qcoapendpoint_p.h>
+#include <private/qcoaptimerwheel_p.h>
 
 #include <QtCore/qglobal.h>
-#include <QtCore/qtimer.h>
 #include <QtCore/qurl.h>
 
 //
@@ -69,10 +70,15 @@ public:
     void initForReset(quint16 messageId);
 
     QByteArray toQByteArray() const;
+    const QByteArray &encodedFrame() const;
+    void encode(QByteArray *buffer) const;
+    int encodedSize() const;
     void setMessageId(quint16);
     void setToken(const QCoapToken&);
     void setToRequestBlock(uint blockNumber, uint blockSize);
     void setToSendBlock(uint blockNumber, uint blockSize);
+    void setToSendBlock(uint blockNumber, uint blockSize, const QByteArray &data,
+                        bool hasMoreBlocks);
     bool checkBlockNumber(uint blockNumber);
 
     using QCoapInternalMessage::addOption;
@@ -81,56 +87,85 @@ public:
 
     QCoapToken token() const;
     QUrl targetUri() const;
+    QCoapEndpoint endpoint() const;
     QtCoap::Method method() const;
     bool isObserve() const;
     bool isObserveCancelled() const;
     bool isMulticast() const;
     QCoapConnection *connection() const;
     uint retransmissionCounter() const;
+    bool isTransmissionInProgress() const;
+    qint64 transmissionStartTime() const;
     void setMethod(QtCoap::Method method);
     void setConnection(QCoapConnection *connection);
     void setObserveCancelled();
 
-    void setTargetUri(QUrl targetUri);
+    void setTargetUri(QUrl targetUri, const QCoapEndpoint &endpoint = QCoapEndpoint());
     void setTimeout(uint timeout);
+    void setBackoffFactor(double factor);
     void setMaxTransmissionWait(uint timeout);
     void setMulticastTimeout(uint responseDelay);
-    void restartTransmission();
-    void startMulticastTransmission();
+    void restartTransmission(QCoapTimerWheel *timerWheel, qint64 now);
+    void startMulticastTransmission(QCoapTimerWheel *timerWheel, qint64 now);
     void stopTransmission();
 
-Q_SIGNALS:
-    void timeout(QCoapInternalRequest*);
-    void maxTransmissionSpanReached(QCoapInternalRequest*);
-    void multicastRequestExpired(QCoapInternalRequest*);
-
 protected:
     QCoapOption uriHostOption(const QUrl &uri) const;
     QCoapOption blockOption(QCoapOption::OptionName name, uint blockNumber, uint blockSize) const;
+    QCoapOption blockOption(QCoapOption::OptionName name, uint blockNumber, uint blockSize,
+                            bool hasMoreBlocks) const;
 
 private:
     Q_DECLARE_PRIVATE(QCoapInternalRequest)
 };
 
+class QCoapRequestDeadline : public QCoapTimerWheel::Entry
+{
+public:
+    enum Type {
+        Retransmission,
+        MaximumTransmitWait,
+        MulticastExpiry
+    };
+
+    explicit QCoapRequestDeadline(Type type) : type(type) {}
+
+    QCoapInternalRequest *request = nullptr;
+    const Type type;
+};
+
 class Q_AUTOTEST_EXPORT QCoapInternalRequestPrivate : public QCoapInternalMessagePrivate
 {
 public:
     QCoapInternalRequestPrivate() = default;
 
     QUrl targetUri;
+    QCoapEndpoint endpoint;
     QtCoap::Method method = QtCoap::Method::Invalid;
     QCoapConnection *connection = nullptr;
     QByteArray fullPayload;
 
     uint timeout = 0;
+    double backoffFactor = 2;
+    qint64 transmissionStartTime = 0;
     uint retransmissionCounter = 0;
-    QTimer *timeoutTimer = nullptr;
-    QTimer *maxTransmitWaitTimer = nullptr;
-    QTimer *multicastExpireTimer = nullptr;
+    uint maxTransmitWait = 0;
+    uint multicastTimeout = 0;
+    QCoapRequestDeadline timeoutDeadline { QCoapRequestDeadline::Retransmission };
+    QCoapRequestDeadline maxTransmitWaitDeadline { QCoapRequestDeadline::MaximumTransmitWait };
+    QCoapRequestDeadline multicastExpireDeadline { QCoapRequestDeadline::MulticastExpiry };
+
+    // Last encoded frame, valid as long as the message still shares its data
+    // with the copy it was encoded from, and the method did not change.
+    mutable QByteArray frame;
+    mutable QCoapMessage frameMessage;
+    mutable bool frameEncoded = false;
 
     bool observeCancelled = false;
     bool transmissionInProgress = false;
 
+    bool isFrameValid() const;
+
     Q_DECLARE_PUBLIC(QCoapInternalRequest)
 };
 
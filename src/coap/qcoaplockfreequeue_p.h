@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPLOCKFREEQUEUE_P_H
+#define QCOAPLOCKFREEQUEUE_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qatomic.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+/*
+    A queue of nodes linked through their \c next member, which any thread
+    can append to without locking, and which a single consumer empties at
+    once with takeAll(). The producer appending to an empty queue is told
+    so, and is in charge of waking the consumer up, so that one wake-up
+    drains all the nodes appended until the consumer runs.
+
+    The nodes are stacked as they are appended, and put back in order by
+    the consumer. Since nodes are never taken one at a time, appending is
+    not subject to the ABA problem.
+*/
+template <typename T>
+class QCoapLockFreeQueue
+{
+public:
+    QCoapLockFreeQueue() = default;
+    ~QCoapLockFreeQueue() { clear(); }
+
+    // Appends the node and returns true if the queue was empty
+    bool enqueue(T *node)
+    {
+        T *head = stack.loadAcquire();
+        do {
+            node->next = head;
+        } while (!stack.testAndSetRelease(head, node, head));
+
+        return head == nullptr;
+    }
+
+    // Returns the first of all the queued nodes, which are then owned by the
+    // caller, or nullptr if the queue is empty
+    T *takeAll()
+    {
+        T *node = stack.fetchAndStoreAcquire(nullptr);
+        T *first = nullptr;
+        while (node) {
+            T *next = node->next;
+            node->next = first;
+            first = node;
+            node = next;
+        }
+        return first;
+    }
+
+    // Deletes the queued nodes
+    void clear()
+    {
+        T *node = stack.fetchAndStoreAcquire(nullptr);
+        while (node) {
+            T *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(QCoapLockFreeQueue)
+
+    QAtomicPointer<T> stack;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPLOCKFREEQUEUE_P_H
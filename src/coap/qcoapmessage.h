@@ -92,6 +92,8 @@ protected:
     // Q_DECLARE_PRIVATE equivalent for shared data pointers
     inline QCoapMessagePrivate *d_func();
     const QCoapMessagePrivate *d_func() const { return d_ptr.constData(); }
+
+    friend class QCoapMessagePrivate;
 };
 
 Q_DECLARE_SHARED(QCoapMessage)
@@ -56,6 +56,8 @@ public:
     ~QCoapMessagePrivate();
 
     QVector<QCoapOption>::const_iterator findOption(QCoapOption::OptionName name) const;
+    static const QCoapMessagePrivate *get(const QCoapMessage &message)
+    { return message.d_func(); }
 
     quint8 version = 1;
     QCoapMessage::Type type = QCoapMessage::Type::NonConfirmable;
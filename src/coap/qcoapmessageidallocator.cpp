@@ -0,0 +1,160 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapmessageidallocator_p.h"
+#include "qcoapnamespace_p.h"
+
+QT_BEGIN_NAMESPACE
+
+// Message id 0 is reserved for uninitialized messages
+static const int maximumUsedIds = 0xFFFF;
+
+/*!
+    \internal
+
+    \class QCoapMessageIdAllocator
+    \brief The QCoapMessageIdAllocator class hands out message ids which are
+    not reused within the \c EXCHANGE_LIFETIME.
+
+    Message ids are allocated sequentially for each endpoint, starting from a
+    random value. The ids handed out during the last \c EXCHANGE_LIFETIME are
+    remembered in allocation order, so that expiring them and checking that the
+    next id is free both take constant time, as described in
+    \l{https://tools.ietf.org/html/rfc7252#section-4.4}{RFC 7252 - Section 4.4}.
+
+    When all the 65535 usable ids of an endpoint are still within their
+    lifetime, the allocation is refused instead of reusing an id.
+*/
+
+/*!
+    \internal
+
+    Returns a message id for the endpoint \a host which has not been allocated
+    for this endpoint during the previous \a lifetime milliseconds, and
+    remembers it until \a now + \a lifetime.
+
+    Returns 0, which is not a valid message id, if no id is available.
+*/
+quint16 QCoapMessageIdAllocator::allocate(const QHostAddress &host, qint64 now, qint64 lifetime)
+{
+    if (now >= nextPurge) {
+        purge(now);
+        nextPurge = now + lifetime;
+    }
+
+    auto it = endpoints.find(host);
+    if (it == endpoints.end()) {
+        it = endpoints.insert(host, EndpointState());
+        quint16 start = 0;
+        while (start == 0)
+            QtCoap::fillSecureRandom(&start, sizeof(start));
+        it->nextId = start;
+    }
+
+    EndpointState &state = *it;
+    expire(&state, now);
+
+    // The ids still in use are the last allocated ones, so the next id in the
+    // sequence is free as long as the window is not full.
+    if (state.usedIds.size() >= maximumUsedIds)
+        return 0;
+
+    const quint16 id = state.nextId;
+    state.nextId = (id == 0xFFFF) ? 1 : id + 1;
+    state.usedIds.enqueue({ now + lifetime, id });
+
+    return id;
+}
+
+/*!
+    \internal
+
+    Returns the number of message ids of the endpoint \a host which cannot be
+    reused yet at the time \a now.
+*/
+int QCoapMessageIdAllocator::usedCount(const QHostAddress &host, qint64 now)
+{
+    auto it = endpoints.find(host);
+    if (it == endpoints.end())
+        return 0;
+
+    expire(&(*it), now);
+    return it->usedIds.size();
+}
+
+/*!
+    \internal
+
+    Returns the number of endpoints for which message ids are remembered.
+*/
+int QCoapMessageIdAllocator::endpointCount() const
+{
+    return endpoints.size();
+}
+
+/*!
+    \internal
+
+    Forgets all the allocated message ids.
+*/
+void QCoapMessageIdAllocator::clear()
+{
+    endpoints.clear();
+    nextPurge = 0;
+}
+
+/*!
+    \internal
+
+    Releases the ids of \a state whose lifetime is over at the time \a now.
+*/
+void QCoapMessageIdAllocator::expire(EndpointState *state, qint64 now)
+{
+    while (!state->usedIds.isEmpty() && state->usedIds.head().expiry <= now)
+        state->usedIds.dequeue();
+}
+
+/*!
+    \internal
+
+    Drops the state of the endpoints which have no id in use at the time
+    \a now.
+*/
+void QCoapMessageIdAllocator::purge(qint64 now)
+{
+    for (auto it = endpoints.begin(); it != endpoints.end();) {
+        expire(&(*it), now);
+        if (it->usedIds.isEmpty())
+            it = endpoints.erase(it);
+        else
+            ++it;
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,81 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPMESSAGEIDALLOCATOR_P_H
+#define QCOAPMESSAGEIDALLOCATOR_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qqueue.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapMessageIdAllocator
+{
+public:
+    QCoapMessageIdAllocator() = default;
+
+    quint16 allocate(const QHostAddress &host, qint64 now, qint64 lifetime);
+    int usedCount(const QHostAddress &host, qint64 now);
+    int endpointCount() const;
+    void clear();
+
+private:
+    struct UsedId {
+        qint64 expiry;
+        quint16 id;
+    };
+
+    struct EndpointState {
+        quint16 nextId = 0;
+        QQueue<UsedId> usedIds;
+    };
+
+    static void expire(EndpointState *state, qint64 now);
+    void purge(qint64 now);
+
+    QHash<QHostAddress, EndpointState> endpoints;
+    qint64 nextPurge = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPMESSAGEIDALLOCATOR_P_H
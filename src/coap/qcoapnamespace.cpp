@@ -29,6 +29,8 @@
 
 #include "qcoapnamespace_p.h"
 
+#include <QtCore/qthreadstorage.h>
+
 QT_BEGIN_NAMESPACE
 
 /*!
@@ -301,8 +303,10 @@ QtCoap::Error QtCoap::errorForResponseCode(QtCoap::ResponseCode code)
 /*!
     \internal
 
-    Returns the internal random generator used for generating token values and
-    message IDs.
+    Returns the internal random generator used for randomizing the
+    retransmission timeouts.
+
+    \sa fillSecureRandom()
 */
 QRandomGenerator &QtCoap::randomGenerator()
 {
@@ -310,4 +314,65 @@ QRandomGenerator &QtCoap::randomGenerator()
     return randomGenerator;
 }
 
+namespace {
+
+/*
+    Buffers the output of the system CSPRNG, so that small draws like tokens
+    do not each need a call to the operating system.
+*/
+class SecureRandomPool
+{
+public:
+    void fill(quint8 *data, int size)
+    {
+        while (size > 0) {
+            if (position == int(sizeof(buffer)))
+                refill();
+
+            const int count = qMin(size, int(sizeof(buffer)) - position);
+            quint8 *bytes = reinterpret_cast<quint8 *>(buffer) + position;
+            memcpy(data, bytes, count);
+            // Do not keep around bytes which have been handed out
+            memset(bytes, 0, count);
+
+            position += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+private:
+    void refill()
+    {
+        QRandomGenerator::system()->fillRange(buffer);
+        position = 0;
+    }
+
+    quint32 buffer[256];
+    int position = sizeof(buffer);
+};
+
+}
+
+Q_GLOBAL_STATIC(QThreadStorage<SecureRandomPool *>, secureRandomPools)
+
+/*!
+    \internal
+
+    Fills \a buffer with \a size cryptographically secure random bytes.
+
+    The bytes are taken from a pool local to the calling thread, which is
+    refilled in large chunks from the system generator. Unlike
+    randomGenerator(), this function is thread-safe and threads do not
+    contend with each other.
+*/
+void QtCoap::fillSecureRandom(void *buffer, int size)
+{
+    QThreadStorage<SecureRandomPool *> *pools = secureRandomPools();
+    if (!pools->hasLocalData())
+        pools->setLocalData(new SecureRandomPool);
+
+    pools->localData()->fill(static_cast<quint8 *>(buffer), size);
+}
+
 QT_END_NAMESPACE
@@ -50,6 +50,7 @@ namespace QtCoap
     bool Q_AUTOTEST_EXPORT isError(QtCoap::ResponseCode code);
     Error Q_AUTOTEST_EXPORT errorForResponseCode(QtCoap::ResponseCode code);
     QRandomGenerator Q_AUTOTEST_EXPORT &randomGenerator();
+    void Q_AUTOTEST_EXPORT fillSecureRandom(void *buffer, int size);
 }
 
 QT_END_NAMESPACE
@@ -0,0 +1,339 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoappduview_p.h"
+
+QT_BEGIN_NAMESPACE
+
+static const int headerSize = 4;
+static const int maximumTokenLength = 8;
+static const quint8 payloadMarker = 0xFF;
+
+/*!
+    \internal
+
+    \class QCoapPduView
+    \brief The QCoapPduView class gives read-only access to the fields of
+    a received CoAP frame without copying them.
+
+    The frame is validated and indexed in a single pass when it is parsed:
+    the header, the token length, every option header and its extended delta
+    and length bytes are checked against the size of the frame. Once parsed,
+    the view only stores the offsets of the fields, inline for the common
+    case of up to 16 options, and shares the frame with the QByteArray that
+    was passed to it.
+
+    The token, option values and payload returned by the view are created
+    with QByteArray::fromRawData() and point into the frame. They are only
+    valid while the frame is referenced, which is what the replies built by
+    QCoapInternalReply::createFromView() do.
+
+    For more details, refer to
+    \l{https://tools.ietf.org/html/rfc7252#section-3}{RFC 7252 - Section 3}.
+
+    \value Ok                   The frame is a well-formed CoAP message.
+    \value Truncated            A field extends beyond the end of the frame.
+    \value UnsupportedVersion   The version of the message is not 1.
+    \value InvalidTokenLength   The token length is between 9 and 15.
+    \value InvalidOption        An option uses the reserved value 15 for its
+                                delta or length, or its number exceeds 65535.
+    \value EmptyPayload         The payload marker is not followed by a payload.
+*/
+
+/*!
+    \internal
+
+    Constructs a view of the given \a frame and parses it.
+
+    \sa parse()
+*/
+QCoapPduView::QCoapPduView(const QByteArray &frame)
+{
+    parse(frame);
+}
+
+/*
+    Replaces the 4-bit option delta or length \a value by its extended value
+    when it is 13 or 14, reading the extra bytes at \a position in the \a size
+    bytes of \a data. Returns \c false if they do not fit in the frame.
+*/
+static bool readExtendedValue(const quint8 *data, int size, int *position, quint32 *value)
+{
+    if (*value == 13) {
+        if (size - *position < 1)
+            return false;
+        *value = data[*position] + 13u;
+        *position += 1;
+    } else if (*value == 14) {
+        if (size - *position < 2)
+            return false;
+        *value = ((quint32(data[*position]) << 8) | data[*position + 1]) + 269u;
+        *position += 2;
+    }
+    return true;
+}
+
+/*!
+    \internal
+
+    Parses \a frame and returns \c true if it is a well-formed CoAP message.
+    On failure, status() tells which part of the frame is invalid, and the
+    fields of the view must not be used.
+*/
+bool QCoapPduView::parse(const QByteArray &frame)
+{
+    buffer = frame;
+    options.clear();
+    payloadOffset = 0;
+
+    const quint8 *data = reinterpret_cast<const quint8 *>(buffer.constData());
+    const int size = buffer.size();
+
+    parseStatus = Status::Truncated;
+    if (size < headerSize)
+        return false;
+
+    if ((data[0] >> 6) != 1) {
+        parseStatus = Status::UnsupportedVersion;
+        return false;
+    }
+
+    const int tokenSize = data[0] & 0x0F;
+    if (tokenSize > maximumTokenLength) {
+        parseStatus = Status::InvalidTokenLength;
+        return false;
+    }
+    if (size - headerSize < tokenSize)
+        return false;
+
+    int position = headerSize + tokenSize;
+    quint32 lastOptionNumber = 0;
+    while (position < size) {
+        const quint8 optionHeader = data[position++];
+        if (optionHeader == payloadMarker) {
+            if (position == size) {
+                parseStatus = Status::EmptyPayload;
+                return false;
+            }
+            payloadOffset = position;
+            break;
+        }
+
+        quint32 delta = optionHeader >> 4;
+        quint32 length = optionHeader & 0x0F;
+        if (delta == 15 || length == 15) {
+            parseStatus = Status::InvalidOption;
+            return false;
+        }
+
+        if (!readExtendedValue(data, size, &position, &delta)
+                || !readExtendedValue(data, size, &position, &length)) {
+            return false;
+        }
+
+        lastOptionNumber += delta;
+        if (lastOptionNumber > 0xFFFF) {
+            parseStatus = Status::InvalidOption;
+            return false;
+        }
+        if (length > quint32(size - position))
+            return false;
+
+        OptionEntry entry;
+        entry.number = static_cast<quint16>(lastOptionNumber);
+        entry.offset = position;
+        entry.length = static_cast<int>(length);
+        options.append(entry);
+
+        position += entry.length;
+    }
+
+    parseStatus = Status::Ok;
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns the version of the message.
+*/
+quint8 QCoapPduView::version() const
+{
+    Q_ASSERT(isValid());
+    return static_cast<quint8>(buffer.at(0)) >> 6;
+}
+
+/*!
+    \internal
+
+    Returns the type of the message.
+*/
+QCoapMessage::Type QCoapPduView::type() const
+{
+    Q_ASSERT(isValid());
+    return QCoapMessage::Type((static_cast<quint8>(buffer.at(0)) >> 4) & 0x03);
+}
+
+/*!
+    \internal
+
+    Returns the raw code of the message.
+*/
+quint8 QCoapPduView::code() const
+{
+    Q_ASSERT(isValid());
+    return static_cast<quint8>(buffer.at(1));
+}
+
+/*!
+    \internal
+
+    Returns the code of the message as a response code.
+*/
+QtCoap::ResponseCode QCoapPduView::responseCode() const
+{
+    return static_cast<QtCoap::ResponseCode>(code());
+}
+
+/*!
+    \internal
+
+    Returns the message ID.
+*/
+quint16 QCoapPduView::messageId() const
+{
+    Q_ASSERT(isValid());
+    const quint8 *data = reinterpret_cast<const quint8 *>(buffer.constData());
+    return static_cast<quint16>((quint16(data[2]) << 8) | data[3]);
+}
+
+/*!
+    \internal
+
+    Returns the length of the token.
+*/
+int QCoapPduView::tokenLength() const
+{
+    Q_ASSERT(isValid());
+    return buffer.at(0) & 0x0F;
+}
+
+/*!
+    \internal
+
+    Returns the token, pointing into the frame.
+*/
+QCoapToken QCoapPduView::token() const
+{
+    return slice(headerSize, tokenLength());
+}
+
+/*!
+    \internal
+
+    Returns the number of the option at \a index.
+*/
+quint16 QCoapPduView::optionNumber(int index) const
+{
+    return options.at(index).number;
+}
+
+/*!
+    \internal
+
+    Returns the length of the value of the option at \a index.
+*/
+int QCoapPduView::optionLength(int index) const
+{
+    return options.at(index).length;
+}
+
+/*!
+    \internal
+
+    Returns the value of the option at \a index, pointing into the frame.
+*/
+QByteArray QCoapPduView::optionValue(int index) const
+{
+    const OptionEntry &entry = options.at(index);
+    return slice(entry.offset, entry.length);
+}
+
+/*!
+    \internal
+
+    Returns the index of the first option with the given \a number, starting
+    the search at index \a from, or -1 if there is none.
+*/
+int QCoapPduView::indexOfOption(quint16 number, int from) const
+{
+    // Options are sorted, stop as soon as a larger number is found
+    for (int i = qMax(from, 0); i < options.size(); ++i) {
+        if (options.at(i).number == number)
+            return i;
+        if (options.at(i).number > number)
+            break;
+    }
+    return -1;
+}
+
+/*!
+    \internal
+
+    Returns the length of the payload.
+*/
+int QCoapPduView::payloadLength() const
+{
+    return hasPayload() ? buffer.size() - payloadOffset : 0;
+}
+
+/*!
+    \internal
+
+    Returns the payload, pointing into the frame.
+*/
+QByteArray QCoapPduView::payload() const
+{
+    return slice(payloadOffset, payloadLength());
+}
+
+/*!
+    \internal
+
+    Returns a byte array sharing \a length bytes of the frame, starting at
+    \a offset. No byte array is allocated for empty fields.
+*/
+QByteArray QCoapPduView::slice(int offset, int length) const
+{
+    if (length <= 0)
+        return QByteArray();
+    return QByteArray::fromRawData(buffer.constData() + offset, length);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,110 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPPDUVIEW_P_H
+#define QCOAPPDUVIEW_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapnamespace.h>
+#include <QtCoap/qcoapmessage.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qvarlengtharray.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapPduView
+{
+public:
+    enum class Status {
+        Ok,
+        Truncated,
+        UnsupportedVersion,
+        InvalidTokenLength,
+        InvalidOption,
+        EmptyPayload
+    };
+
+    QCoapPduView() = default;
+    explicit QCoapPduView(const QByteArray &frame);
+
+    bool parse(const QByteArray &frame);
+
+    bool isValid() const { return parseStatus == Status::Ok; }
+    Status status() const { return parseStatus; }
+    QByteArray frame() const { return buffer; }
+
+    quint8 version() const;
+    QCoapMessage::Type type() const;
+    quint8 code() const;
+    QtCoap::ResponseCode responseCode() const;
+    quint16 messageId() const;
+
+    int tokenLength() const;
+    QCoapToken token() const;
+
+    int optionCount() const { return options.size(); }
+    quint16 optionNumber(int index) const;
+    int optionLength(int index) const;
+    QByteArray optionValue(int index) const;
+    int indexOfOption(quint16 number, int from = 0) const;
+
+    bool hasPayload() const { return payloadOffset > 0; }
+    int payloadLength() const;
+    QByteArray payload() const;
+
+private:
+    struct OptionEntry
+    {
+        quint16 number;
+        int offset;
+        int length;
+    };
+
+    QByteArray slice(int offset, int length) const;
+
+    QByteArray buffer;
+    QVarLengthArray<OptionEntry, 16> options;
+    int payloadOffset = 0;
+    Status parseStatus = Status::Truncated;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPPDUVIEW_P_H
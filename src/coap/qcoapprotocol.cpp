@@ -32,9 +32,14 @@
 #include "qcoapinternalrequest_p.h"
 #include "qcoapinternalreply_p.h"
 #include "qcoaprequest_p.h"
+#include "qcoapreply_p.h"
+#include "qcoapcallbackexchange_p.h"
+#include "qcoapuploadsource_p.h"
 #include "qcoapconnection_p.h"
 #include "qcoapnamespace_p.h"
 
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qcoreevent.h>
 #include <QtCore/qrandom.h>
 #include <QtCore/qthread.h>
 #include <QtCore/qloggingcategory.h>
@@ -113,6 +118,9 @@ QCoapProtocol::QCoapProtocol(QObject *parent) :
 {
     qRegisterMetaType<QCoapInternalRequest *>();
     qRegisterMetaType<QHostAddress>();
+
+    Q_D(QCoapProtocol);
+    d->clock.start();
 }
 
 QCoapProtocol::~QCoapProtocol()
@@ -121,6 +129,11 @@ QCoapProtocol::~QCoapProtocol()
 
     // Clear table to avoid double deletion from QObject parenting and QSharedPointer.
     d->exchangeMap.clear();
+    d->messageIdIndex.clear();
+    d->requestIndex.clear();
+    d->userReplyIndex.clear();
+    d->callbackExchangeIndex.clear();
+    d->urlIndex.clear();
 }
 
 /*!
@@ -129,6 +142,12 @@ QCoapProtocol::~QCoapProtocol()
     Creates and sets up a new QCoapInternalRequest related to the request
     associated to the \a reply. The request will then be sent to the server
     using the given \a connection.
+
+    If the maximum number of outstanding requests to the server is reached,
+    the request is queued, and sent once a previous request to this server
+    is completed.
+
+    \sa setMaximumOutstandingRequests()
 */
 void QCoapProtocol::sendRequest(QPointer<QCoapReply> reply, QCoapConnection *connection)
 {
@@ -143,76 +162,451 @@ void QCoapProtocol::sendRequest(QPointer<QCoapReply> reply, QCoapConnection *con
         Q_D(QCoapProtocol);
         d->onRequestAborted(token);
     });
-
-    auto internalRequest = QSharedPointer<QCoapInternalRequest>::create(reply->request(), this);
-    internalRequest->setMaxTransmissionWait(maximumTransmitWait());
     connect(reply.data(), &QCoapReply::finished, this, &QCoapProtocol::finished);
 
+    const QHostAddress targetHost(reply->request().url().host());
+    bool holdsSchedulerSlot = false;
+    if (d->scheduler.maximumOutstanding() > 0 && !targetHost.isMulticast()) {
+        if (!d->scheduler.tryAcquire(targetHost)) {
+            QCoapRequestScheduler::PendingRequest pending;
+            pending.reply = reply;
+            pending.connection = connection;
+            pending.queuedTime = d->clock.elapsed();
+            d->scheduler.enqueue(targetHost, reply->request().priority(), pending);
+            return;
+        }
+        holdsSchedulerSlot = true;
+    }
+
+    d->startExchange(reply, {}, connection, holdsSchedulerSlot);
+}
+
+/*!
+    \internal
+
+    Sends the request of the callback \a exchange using the given
+    \a connection, like QCoapProtocol::sendRequest() does for a reply.
+*/
+void QCoapProtocolPrivate::sendCallbackRequest(
+        const QSharedPointer<QCoapCallbackExchange> &exchange, QCoapConnection *connection)
+{
+    const QCoapRequest &request = exchange->request;
+    if (request.method() == QtCoap::Method::Invalid
+            || !QCoapRequestPrivate::isUrlValid(request.url()))
+        return;
+
+    scheduleCallbackRequest(exchange, connection);
+}
+
+/*!
+    \internal
+
+    Sends the request of the callback \a exchange, whose request is already
+    validated, using the given \a connection, or queues it in the scheduler
+    if its endpoint has too many outstanding requests.
+*/
+void QCoapProtocolPrivate::scheduleCallbackRequest(
+        const QSharedPointer<QCoapCallbackExchange> &exchange, QCoapConnection *connection)
+{
+    if (exchange->isCancelled())
+        return;
+
+    const QCoapRequest &request = exchange->request;
+    const QHostAddress targetHost(request.url().host());
+    bool holdsSchedulerSlot = false;
+    if (scheduler.maximumOutstanding() > 0 && !targetHost.isMulticast()) {
+        if (!scheduler.tryAcquire(targetHost)) {
+            QCoapRequestScheduler::PendingRequest pending;
+            pending.callbackExchange = exchange;
+            pending.connection = connection;
+            pending.queuedTime = clock.elapsed();
+            scheduler.enqueue(targetHost, request.priority(), pending);
+            return;
+        }
+        holdsSchedulerSlot = true;
+    }
+
+    startExchange({}, exchange, connection, holdsSchedulerSlot);
+}
+
+/*!
+    \internal
+
+    Registers and sends the request of the \a reply, or of the
+    \a callbackExchange, using the given \a connection. If
+    \a holdsSchedulerSlot is \c true, the request holds a slot of its
+    endpoint in the scheduler, which is freed when the exchange completes.
+*/
+void QCoapProtocolPrivate::startExchange(
+        const QPointer<QCoapReply> &reply,
+        const QSharedPointer<QCoapCallbackExchange> &callbackExchange,
+        QCoapConnection *connection, bool holdsSchedulerSlot)
+{
+    Q_Q(QCoapProtocol);
+
+    const QCoapRequest userRequest = callbackExchange ? callbackExchange->request
+                                                      : reply->request();
+    auto internalRequest = QSharedPointer<QCoapInternalRequest>::create(userRequest, q);
+    internalRequest->setMaxTransmissionWait(q->maximumTransmitWait());
+
     if (internalRequest->isMulticast()) {
-        connect(internalRequest.data(), &QCoapInternalRequest::multicastRequestExpired, this,
-                [this](QCoapInternalRequest *request) {
-                    Q_D(QCoapProtocol);
-                    d->onMulticastRequestExpired(request);
-                });
         // The timeout interval is chosen based on
         // https://tools.ietf.org/html/rfc7390#section-2.5
-        internalRequest->setMulticastTimeout(nonConfirmLifetime()
-                                             + maximumLatency()
-                                             + maximumServerResponseDelay());
+        internalRequest->setMulticastTimeout(q->nonConfirmLifetime()
+                                             + q->maximumLatency()
+                                             + q->maximumServerResponseDelay());
     }
 
     // Set a unique Message Id and Token
     QCoapMessage *requestMessage = internalRequest->message();
-    internalRequest->setMessageId(d->generateUniqueMessageId());
+    const QHostAddress targetHost = internalRequest->endpoint().address();
+    const quint16 messageId = generateUniqueMessageId(targetHost);
+    if (messageId == 0) {
+        qCWarning(lcCoapProtocol) << "No message id available for" << targetHost
+                                  << "within EXCHANGE_LIFETIME, request refused.";
+        if (holdsSchedulerSlot)
+            releaseSchedulerSlot(targetHost);
+        auto completion = new QCoapReplyCompletion;
+        completion->reply = reply;
+        completion->callbackExchange = callbackExchange;
+        completion->steps = QCoapReplyCompletion::Finished;
+        completion->finishError = QtCoap::Error::Unknown;
+        deliver(completion);
+        if (!callbackExchange)
+            emit q->error(reply, QtCoap::Error::Unknown);
+        return;
+    }
+
+    internalRequest->setMessageId(messageId);
     if (internalRequest->token().isEmpty())
-        internalRequest->setToken(d->generateUniqueToken());
+        internalRequest->setToken(generateUniqueToken());
     internalRequest->setConnection(connection);
 
-    d->registerExchange(requestMessage->token(), reply, internalRequest);
-    QMetaObject::invokeMethod(reply, "_q_setRunning", Qt::QueuedConnection,
-                              Q_ARG(QCoapToken, requestMessage->token()),
-                              Q_ARG(QCoapMessageId, requestMessage->messageId()));
+    registerExchange(requestMessage->token(), reply, internalRequest);
+    if (holdsSchedulerSlot)
+        exchangeMap[requestMessage->token()].schedulerHost = targetHost;
+    if (callbackExchange) {
+        exchangeMap[requestMessage->token()].callbackExchange = callbackExchange;
+        callbackExchangeIndex.insert(callbackExchange.data(), requestMessage->token());
+    } else {
+        auto running = new QCoapReplyCompletion;
+        running->reply = reply;
+        running->steps = QCoapReplyCompletion::Running;
+        running->token = requestMessage->token();
+        running->messageId = requestMessage->messageId();
+        deliver(running);
+    }
 
     // Set block size for blockwise request/replies, if specified
-    if (d->blockSize > 0) {
-        internalRequest->setToRequestBlock(0, d->blockSize);
-        if (requestMessage->payload().length() > d->blockSize)
-            internalRequest->setToSendBlock(0, d->blockSize);
+    uint exchangeBlockSize = internalRequest->isMulticast() ? blockSize
+                                                            : blockSizeFor(targetHost);
+
+    // Reliable transports may carry BERT blocks, also used for payloads too
+    // large for a single message
+    const uint bertSize = connection->bertBlockSize(internalRequest->endpoint());
+    if (bertSize > 0 && (exchangeBlockSize > 0
+                         || requestMessage->payload().length() > static_cast<int>(bertSize))) {
+        exchangeBlockSize = bertSize;
     }
 
-    if (requestMessage->type() == QCoapMessage::Type::Confirmable) {
-        const auto minTimeout = minimumTimeout();
-        const auto maxTimeout = maximumTimeout();
-        Q_ASSERT(minTimeout <= maxTimeout);
+    if (exchangeBlockSize > 0) {
+        internalRequest->setToRequestBlock(0, exchangeBlockSize);
+        if (requestMessage->payload().length() > static_cast<int>(exchangeBlockSize))
+            internalRequest->setToSendBlock(0, exchangeBlockSize);
+    }
+    exchangeMap[requestMessage->token()].requestBlockSize =
+            exchangeBlockSize > 0 ? exchangeBlockSize : 1024;
+
+    // Only fetch the requested range of blocks, starting with the first one
+    if (userRequest.hasBlockRange()) {
+        const quint16 rangeBlockSize = userRequest.rangeBlockSize();
+        internalRequest->setToRequestBlock(userRequest.firstBlock(), rangeBlockSize);
+
+        CoapExchangeData &exchange = exchangeMap[requestMessage->token()];
+        exchange.rangeStart = qint64(userRequest.firstBlock()) * rangeBlockSize;
+        exchange.rangeEnd = (qint64(userRequest.lastBlock()) + 1) * rangeBlockSize;
+        exchange.streamedSize = exchange.rangeStart;
+    }
 
-        internalRequest->setTimeout(minTimeout == maxTimeout
-                                    ? minTimeout
-                                    : QtCoap::randomGenerator().bounded(minTimeout, maxTimeout));
-    } else {
-        internalRequest->setTimeout(maximumTimeout());
+    // A payload read from a device is sent once its first block is readable
+    QCoapUploadSource *uploadSource = reply ? QCoapReplyPrivate::get(reply)->uploadSource.data()
+                                            : nullptr;
+    if (uploadSource) {
+        // The blocks read from a device are never BERT blocks
+        CoapExchangeData &exchange = exchangeMap[requestMessage->token()];
+        exchange.uploadSource = uploadSource;
+        exchange.requestBlockSize = qMin(exchange.requestBlockSize, 1024u);
+        requestUploadBlock(requestMessage->token(), 0);
+        return;
     }
 
-    connect(internalRequest.data(), &QCoapInternalRequest::timeout,
-            [this](QCoapInternalRequest *request) {
-                    Q_D(QCoapProtocol);
-                    d->onRequestTimeout(request);
-            });
-    connect(internalRequest.data(), &QCoapInternalRequest::maxTransmissionSpanReached,
-            [this](QCoapInternalRequest *request) {
-                    Q_D(QCoapProtocol);
-                    d->onRequestMaxTransmissionSpanReached(request);
-            });
-    d->sendRequest(internalRequest.data());
+    setInitialTimeout(internalRequest.data());
+    sendRequest(internalRequest.data());
 }
 
 /*!
     \internal
 
-    Encodes and sends the given \a request to the server. If \a host is not empty,
-    sends the request to \a host, instead of using the host address from the request.
-    The \a host parameter is relevant for multicast blockwise transfers.
+    Asks the upload source of the exchange identified by \a token to read
+    the block \a blockNumber. Returns \c false if the payload of the
+    exchange is not read from a device.
+
+    \sa sendUploadBlock()
 */
-void QCoapProtocolPrivate::sendRequest(QCoapInternalRequest *request, const QString& host) const
+bool QCoapProtocolPrivate::requestUploadBlock(const QCoapToken &token, uint blockNumber)
+{
+    const auto it = exchangeMap.constFind(token);
+    if (it == exchangeMap.constEnd() || it->uploadSource.isNull())
+        return false;
+
+    QMetaObject::invokeMethod(it->uploadSource, "readBlock", Qt::QueuedConnection,
+                              Q_ARG(QCoapToken, token),
+                              Q_ARG(uint, blockNumber),
+                              Q_ARG(uint, it->requestBlockSize));
+    return true;
+}
+
+/*!
+    \internal
+
+    Sends the block \a blockNumber read from the device for the exchange
+    identified by \a token. The block \a data is followed by further blocks
+    if \a hasMoreBlocks is \c true.
+*/
+void QCoapProtocolPrivate::sendUploadBlock(const QCoapToken &token, uint blockNumber,
+                                           const QByteArray &data, bool hasMoreBlocks)
+{
+    QCoapInternalRequest *request = requestForToken(token);
+    if (!request)
+        return;
+
+    request->setToSendBlock(blockNumber, exchangeMap.value(token).requestBlockSize, data,
+                            hasMoreBlocks);
+
+    // The first block uses the message ID allocated with the exchange
+    if (blockNumber > 0
+            && !setUniqueMessageId(request, request->endpoint().address())) {
+        onRequestError(request, QtCoap::Error::Unknown);
+        return;
+    }
+
+    setInitialTimeout(request);
+    sendRequest(request);
+}
+
+/*!
+    \internal
+
+    Aborts the exchange identified by \a token, because its payload could
+    not be read from the device.
+*/
+void QCoapProtocolPrivate::onUploadFailed(const QCoapToken &token)
+{
+    QCoapInternalRequest *request = requestForToken(token);
+    if (request)
+        onRequestError(request, QtCoap::Error::Unknown);
+}
+
+/*!
+    \internal
+
+    Frees the scheduler slot held by the exchange of \a token, if any.
+*/
+void QCoapProtocolPrivate::releaseSchedulerSlot(const QCoapToken &token)
+{
+    const auto it = exchangeMap.find(token);
+    if (it == exchangeMap.end() || it->schedulerHost.isNull())
+        return;
+
+    const QHostAddress host = it->schedulerHost;
+    it->schedulerHost.clear();
+    releaseSchedulerSlot(host);
+}
+
+/*!
+    \internal
+
+    Frees the scheduler slot held by an exchange with \a host, and arranges
+    for the next request queued for this endpoint to be started.
+*/
+void QCoapProtocolPrivate::releaseSchedulerSlot(const QHostAddress &host)
+{
+    Q_Q(QCoapProtocol);
+
+    scheduler.release(host);
+    if (!scheduler.hasQueuedRequests(host))
+        return;
+
+    // Queued requests are started from the event loop, since a slot is
+    // usually freed in the middle of the processing of an exchange.
+    endpointsToDrain.append(host);
+    if (!drainPending) {
+        drainPending = true;
+        QMetaObject::invokeMethod(q, [this]() { startQueuedRequests(); }, Qt::QueuedConnection);
+    }
+}
+
+/*!
+    \internal
+
+    Starts the queued requests of the endpoints which got free slots.
+*/
+void QCoapProtocolPrivate::startQueuedRequests()
+{
+    drainPending = false;
+
+    QVector<QHostAddress> endpoints;
+    endpoints.swap(endpointsToDrain);
+
+    const qint64 now = clock.elapsed();
+    for (const QHostAddress &host : qAsConst(endpoints)) {
+        QCoapRequestScheduler::PendingRequest pending;
+        while (scheduler.takeNext(host, now, &pending)) {
+            // The reply may have been aborted while waiting
+            const bool abandoned = pending.callbackExchange
+                    ? pending.callbackExchange->isCancelled()
+                    : pending.reply.isNull() || pending.reply->isFinished();
+            if (abandoned) {
+                scheduler.release(host);
+                continue;
+            }
+
+            startExchange(pending.reply, pending.callbackExchange, pending.connection, true);
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Sets the timeout of the first transmission of \a request, and the
+    backoff factor applied on retransmissions.
+
+    When adaptive timeouts are enabled, the timeout of unicast Confirmable
+    requests is based on the retransmission timeout estimated for the
+    target endpoint, instead of \l {QCoapProtocol::}{ackTimeout()}.
+
+    \sa QCoapProtocol::setAdaptiveTimeoutEnabled()
+*/
+void QCoapProtocolPrivate::setInitialTimeout(QCoapInternalRequest *request)
+{
+    Q_Q(const QCoapProtocol);
+
+    // Nothing is retransmitted over a reliable transport, the request only
+    // fails once MAX_TRANSMIT_WAIT elapsed without response
+    if (request->connection() && request->connection()->isReliable()) {
+        request->setTimeout(0);
+        return;
+    }
+
+    if (request->message()->type() != QCoapMessage::Type::Confirmable) {
+        request->setTimeout(q->maximumTimeout());
+        return;
+    }
+
+    uint minTimeout = q->minimumTimeout();
+    uint maxTimeout = q->maximumTimeout();
+    double backoffFactor = 2;
+
+    if (adaptiveTimeout && !request->isMulticast()) {
+        const QHostAddress &host = request->endpoint().address();
+        minTimeout = rttEstimator.retransmissionTimeout(host, clock.elapsed());
+        maxTimeout = static_cast<uint>(minTimeout * ackRandomFactor);
+        backoffFactor = QCoapRttEstimator::backoffFactor(minTimeout);
+    }
+    Q_ASSERT(minTimeout <= maxTimeout);
+
+    request->setTimeout(minTimeout == maxTimeout
+                        ? minTimeout
+                        : QtCoap::randomGenerator().bounded(minTimeout, maxTimeout));
+    request->setBackoffFactor(backoffFactor);
+}
+
+/*!
+    \internal
+
+    Returns the size of the blocks to exchange with \a host, or 0 if
+    blockwise transfers are only used when the server asks for them.
+
+    When adaptive block sizes are enabled, the block size of each endpoint
+    is chosen by the QCoapBlockSizeController, starting from blockSize().
+*/
+uint QCoapProtocolPrivate::blockSizeFor(const QHostAddress &host) const
+{
+    if (!adaptiveBlockSize)
+        return blockSize;
+
+    return blockSizeController.blockSize(host);
+}
+
+/*!
+    \internal
+
+    Returns the size of the blocks sent, or else requested, by \a request,
+    or 0 if it is not part of a blockwise transfer.
+*/
+uint QCoapProtocolPrivate::requestedBlockSize(const QCoapInternalRequest *request)
+{
+    for (const auto name : { QCoapOption::Block1, QCoapOption::Block2 }) {
+        const QCoapOption option = request->message()->option(name);
+        if (option.isValid()) {
+            const QByteArray value = option.opaqueValue();
+            const quint8 lastByte = value.isEmpty() ? 0 : static_cast<quint8>(value.back());
+            return 1u << ((lastByte & 0x7) + 4);
+        }
+    }
+    return 0;
+}
+
+/*!
+    \internal
+
+    Asks again for the block requested by \a request with the smaller block
+    size chosen for its endpoint, after its block timed out. The new request
+    asks for the same offset, with a new message ID. Returns \c false if
+    \a request does not ask for a block, or sends blocks, which keep their
+    size until the end of the transfer.
+*/
+bool QCoapProtocolPrivate::reduceRequestedBlockSize(QCoapInternalRequest *request)
+{
+    // The blocks of notifications are reassembled by block number
+    const QCoapOption block2 = request->message()->option(QCoapOption::Block2);
+    if (!block2.isValid() || request->message()->hasOption(QCoapOption::Block1)
+            || request->isObserve()) {
+        return false;
+    }
+
+    const QHostAddress host = request->endpoint().address();
+    const uint oldSize = requestedBlockSize(request);
+    const uint newSize = blockSizeController.blockSize(host);
+    if (newSize >= oldSize)
+        return false;
+
+    const quint32 value = block2.uintValue();
+    request->setToRequestBlock((value >> 4) * (oldSize / newSize), newSize);
+    if (!setUniqueMessageId(request, host)) {
+        onRequestError(request, QtCoap::Error::Unknown);
+        return true;
+    }
+
+    // A new message, not a retransmission: its timeout is not backed off
+    request->stopTransmission();
+    setInitialTimeout(request);
+    sendRequest(request);
+    return true;
+}
+
+/*!
+    \internal
+
+    Encodes and sends the given \a request to the server. If \a endpoint is not
+    null, sends the request to \a endpoint, instead of using the endpoint of the
+    request. The \a endpoint parameter is relevant for multicast blockwise transfers.
+
+    The timeouts of the request are scheduled before sending it.
+*/
+void QCoapProtocolPrivate::sendRequest(QCoapInternalRequest *request,
+                                       const QCoapEndpoint &endpoint)
 {
     Q_Q(const QCoapProtocol);
     Q_ASSERT(QThread::currentThread() == q->thread());
@@ -223,15 +617,34 @@ void QCoapProtocolPrivate::sendRequest(QCoapInternalRequest *request, const QStr
     }
 
     if (request->isMulticast())
-        request->startMulticastTransmission();
+        request->startMulticastTransmission(&timerWheel, clock.elapsed());
     else
-        request->restartTransmission();
+        request->restartTransmission(&timerWheel, clock.elapsed());
+    updateDeadlineTimer();
+
+    transmit(request, endpoint);
+}
+
+/*!
+    \internal
+
+    Encodes and sends the given \a request, without scheduling any timeout.
+    If \a endpoint is not null, sends the request to \a endpoint, instead of
+    using the endpoint of the request.
+*/
+void QCoapProtocolPrivate::transmit(const QCoapInternalRequest *request,
+                                    const QCoapEndpoint &endpoint) const
+{
+    if (!request || !request->connection()) {
+        qCWarning(lcCoapProtocol, "Request null or not bound to any connection: aborted.");
+        return;
+    }
 
-    QByteArray requestFrame = request->toQByteArray();
-    QUrl uri = request->targetUri();
-    const auto& hostAddress = host.isEmpty() ? uri.host() : host;
-    request->connection()->d_func()->sendRequest(requestFrame, hostAddress,
-                                                 static_cast<quint16>(uri.port()));
+    // Retransmissions reuse the frame cached by the request
+    const QByteArray &requestFrame = request->encodedFrame();
+    request->connection()->d_func()->sendRequest(requestFrame, endpoint.isNull()
+                                                               ? request->endpoint()
+                                                               : endpoint);
 }
 
 /*!
@@ -248,8 +661,23 @@ void QCoapProtocolPrivate::onRequestTimeout(QCoapInternalRequest *request)
     if (!isRequestRegistered(request))
         return;
 
+    // A request sent with a callback is only cancelled through its handle
+    if (isExchangeAbandoned(request->token())) {
+        onRequestAborted(request->token());
+        return;
+    }
+
     if (request->message()->type() == QCoapMessage::Type::Confirmable
             && request->retransmissionCounter() < maximumRetransmitCount) {
+        // Large blocks that keep timing out are likely fragmented
+        const uint size = requestedBlockSize(request);
+        if (adaptiveBlockSize && size > 0 && !request->isMulticast()) {
+            const QHostAddress host = request->endpoint().address();
+            if (blockSizeController.addLoss(host, size, clock.elapsed())
+                    && reduceRequestedBlockSize(request)) {
+                return;
+            }
+        }
         sendRequest(request);
     } else {
         onRequestError(request, QtCoap::Error::TimeOut);
@@ -283,10 +711,9 @@ void QCoapProtocolPrivate::onMulticastRequestExpired(QCoapInternalRequest *reque
     Q_ASSERT(request->isMulticast());
 
     request->stopTransmission();
-    QPointer<QCoapReply> userReply = userReplyForToken(request->token());
-    if (userReply) {
-        QMetaObject::invokeMethod(userReply, "_q_setFinished", Qt::QueuedConnection,
-                                  Q_ARG(QtCoap::Error, QtCoap::Error::Ok));
+    if (QCoapReplyCompletion *completion = completionForToken(request->token())) {
+        completion->steps = QCoapReplyCompletion::Finished;
+        deliver(completion);
     } else {
         qCWarning(lcCoapProtocol).nospace() << "Reply for token '" << request->token()
                                             << "' is not registered, reply is null.";
@@ -294,6 +721,194 @@ void QCoapProtocolPrivate::onMulticastRequestExpired(QCoapInternalRequest *reque
     forgetExchange(request);
 }
 
+/*!
+    \internal
+
+    Handles the timeouts whose deadline is reached, one at a time, so that a
+    handler can cancel the other timeouts of its request.
+*/
+void QCoapProtocolPrivate::processExpiredDeadlines()
+{
+    timerWheel.advance(clock.elapsed());
+
+    while (QCoapTimerWheel::Entry *entry = timerWheel.takeExpired()) {
+        const auto deadline = static_cast<QCoapRequestDeadline *>(entry);
+        switch (deadline->type) {
+        case QCoapRequestDeadline::Retransmission:
+            onRequestTimeout(deadline->request);
+            break;
+        case QCoapRequestDeadline::MaximumTransmitWait:
+            onRequestMaxTransmissionSpanReached(deadline->request);
+            break;
+        case QCoapRequestDeadline::MulticastExpiry:
+            onMulticastRequestExpired(deadline->request);
+            break;
+        }
+    }
+
+    updateDeadlineTimer();
+}
+
+/*!
+    \internal
+
+    Starts the timer of the protocol if the timer wheel needs to be advanced
+    before the timer fires. A timer firing too early, because its timeouts
+    were cancelled, only costs a wake-up and is cheaper than restarting it
+    on each cancellation.
+*/
+void QCoapProtocolPrivate::updateDeadlineTimer()
+{
+    Q_Q(QCoapProtocol);
+
+    const qint64 expiry = timerWheel.nextExpiry();
+    if (expiry < 0 || (deadlineTimer.isActive() && deadlineTimerExpiry <= expiry))
+        return;
+
+    deadlineTimerExpiry = expiry;
+    const qint64 interval = qMax<qint64>(expiry - clock.elapsed(), 0);
+    deadlineTimer.start(static_cast<int>(interval), Qt::PreciseTimer, q);
+}
+
+/*!
+    \internal
+
+    Returns the type of the event requesting the protocol to send the
+    submitted requests.
+*/
+static QEvent::Type submissionEventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+/*!
+    \internal
+
+    Queues the request of the \a reply to be sent with the \a connection,
+    in the thread of the protocol. This method is thread-safe and does not
+    lock.
+
+    Only the request submitted to an empty queue posts an event to the
+    protocol, which then sends all the requests submitted until it runs.
+
+    \sa sendSubmittedRequests()
+*/
+void QCoapProtocolPrivate::submitRequest(QCoapReply *reply, QCoapConnection *connection)
+{
+    Q_Q(QCoapProtocol);
+
+    auto submission = new QCoapRequestSubmission;
+    submission->reply = reply;
+    submission->connection = connection;
+
+    if (submissions.enqueue(submission))
+        QCoreApplication::postEvent(q, new QEvent(submissionEventType()));
+}
+
+/*!
+    \internal
+
+    \overload
+
+    Queues the request of the callback \a exchange to be sent with the
+    \a connection, in the thread of the protocol.
+*/
+void QCoapProtocolPrivate::submitRequest(const QSharedPointer<QCoapCallbackExchange> &exchange,
+                                         QCoapConnection *connection)
+{
+    Q_Q(QCoapProtocol);
+
+    exchange->protocol = q;
+
+    auto submission = new QCoapRequestSubmission;
+    submission->callbackExchange = exchange;
+    submission->connection = connection;
+
+    if (submissions.enqueue(submission))
+        QCoreApplication::postEvent(q, new QEvent(submissionEventType()));
+}
+
+/*!
+    \internal
+
+    Queues the callback requests of a \a batch, validated by the client, to
+    be sent in the thread of the protocol. The whole batch takes a single
+    node of the submission queue.
+*/
+void QCoapProtocolPrivate::submitBatch(QVector<QCoapCallbackSubmission> &&batch)
+{
+    Q_Q(QCoapProtocol);
+
+    for (const QCoapCallbackSubmission &item : qAsConst(batch))
+        item.exchange->protocol = q;
+
+    auto submission = new QCoapRequestSubmission;
+    submission->batch = std::move(batch);
+
+    if (submissions.enqueue(submission))
+        QCoreApplication::postEvent(q, new QEvent(submissionEventType()));
+}
+
+/*!
+    \internal
+
+    Sends the requests submitted so far, in the order they were submitted.
+*/
+void QCoapProtocolPrivate::sendSubmittedRequests()
+{
+    Q_Q(QCoapProtocol);
+
+    QCoapRequestSubmission *submission = submissions.takeAll();
+    while (submission) {
+        QCoapRequestSubmission *next = submission->next;
+        if (!submission->batch.isEmpty()) {
+            for (const QCoapCallbackSubmission &item : qAsConst(submission->batch))
+                scheduleCallbackRequest(item.exchange, item.connection);
+        } else if (submission->callbackExchange) {
+            sendCallbackRequest(submission->callbackExchange, submission->connection);
+        } else {
+            q->sendRequest(submission->reply, submission->connection);
+        }
+        delete submission;
+        submission = next;
+    }
+}
+
+/*!
+    \internal
+
+    Sends the submitted requests when the submission event is received.
+*/
+bool QCoapProtocol::event(QEvent *event)
+{
+    Q_D(QCoapProtocol);
+
+    if (event->type() == submissionEventType()) {
+        d->sendSubmittedRequests();
+        return true;
+    }
+
+    return QObject::event(event);
+}
+
+/*!
+    \internal
+
+    Handles the timer of the timer wheel.
+*/
+void QCoapProtocol::timerEvent(QTimerEvent *event)
+{
+    Q_D(QCoapProtocol);
+
+    if (event->timerId() == d->deadlineTimer.timerId()) {
+        d->deadlineTimer.stop();
+        d->processExpiredDeadlines();
+    } else {
+        QObject::timerEvent(event);
+    }
+}
+
 /*!
     \internal
 
@@ -316,63 +931,114 @@ void QCoapProtocolPrivate::onRequestError(QCoapInternalRequest *request, QtCoap:
     Q_Q(QCoapProtocol);
     Q_ASSERT(request);
 
-    auto userReply = userReplyForToken(request->token());
+    const auto it = exchangeMap.constFind(request->token());
+    const bool hasCallback = it != exchangeMap.constEnd() && it->callbackExchange;
+    const QPointer<QCoapReply> userReply = userReplyForToken(request->token());
+
+    if (QCoapReplyCompletion *completion = completionForToken(request->token())) {
+        completion->steps = QCoapReplyCompletion::Finished;
 
-    if (!userReply.isNull()) {
         // Set error from content, or error enum
         if (reply) {
-            QMetaObject::invokeMethod(userReply.data(), "_q_setContent", Qt::QueuedConnection,
-                                      Q_ARG(QHostAddress, reply->senderAddress()),
-                                      Q_ARG(QCoapMessage, *reply->message()),
-                                      Q_ARG(QtCoap::ResponseCode, reply->responseCode()));
+            completion->steps |= QCoapReplyCompletion::Content;
+            completion->sender = reply->senderAddress();
+            completion->message = reply->detachedMessage();
+            completion->responseCode = reply->responseCode();
         } else {
-            QMetaObject::invokeMethod(userReply.data(), "_q_setError", Qt::QueuedConnection,
-                                      Q_ARG(QtCoap::Error, error));
+            completion->steps |= QCoapReplyCompletion::Error;
+            completion->error = error;
         }
 
-        QMetaObject::invokeMethod(userReply.data(), "_q_setFinished", Qt::QueuedConnection,
-                                  Q_ARG(QtCoap::Error, QtCoap::Error::Ok));
+        deliver(completion);
     }
 
     forgetExchange(request);
-    emit q->error(userReply.data(), error);
+    if (!hasCallback)
+        emit q->error(userReply.data(), error);
 }
 
 /*!
     \internal
 
     Decode and process the given \a data received from the \a sender.
+
+    The frame is first parsed into a QCoapPduView, and matched against the
+    exchanges using the token and message ID it points to. The reply is only
+    built once it is known to belong to an exchange, so malformed, unmatched
+    and misdirected frames are dropped without allocating. It then shares the
+    frame, and its data is only copied when handed over to the user reply.
 */
 void QCoapProtocolPrivate::onFrameReceived(const QByteArray &data, const QHostAddress &sender)
 {
     Q_Q(const QCoapProtocol);
     Q_ASSERT(QThread::currentThread() == q->thread());
 
-    QSharedPointer<QCoapInternalReply> reply(decode(data, sender));
-    const QCoapMessage *messageReceived = reply->message();
+    const QCoapPduView pdu(data);
+    if (!pdu.isValid()) {
+        qCDebug(lcCoapProtocol).nospace() << "QtCoap: Dropping malformed frame from " << sender
+                                          << " (" << static_cast<int>(pdu.status()) << ")";
+        return;
+    }
 
     QCoapInternalRequest *request = nullptr;
-    if (!messageReceived->token().isEmpty())
-        request = requestForToken(messageReceived->token());
+    if (pdu.tokenLength() > 0)
+        request = requestForToken(pdu.token());
 
     if (!request) {
-        request = findRequestByMessageId(messageReceived->messageId());
+        request = findRequestByMessageId(sender, pdu.messageId());
 
         // No matching request found, drop the frame.
         if (!request)
             return;
     }
 
-    QHostAddress originalTarget(request->targetUri().host());
-    if (!originalTarget.isMulticast() && !originalTarget.isEqual(sender)) {
+    if (!request->isMulticast() && !request->endpoint().matches(sender)) {
         qCDebug(lcCoapProtocol).nospace() << "QtCoap: Answer received from incorrect host ("
                                           << sender << " instead of "
-                                          << originalTarget << ")";
+                                          << request->endpoint().address() << ")";
+        return;
+    }
+
+    QSharedPointer<QCoapInternalReply> reply(decode(pdu, sender));
+    const QCoapMessage *messageReceived = reply->message();
+
+    // A retransmitted copy of a block already streamed to the user reply is
+    // acknowledged again, but must not stop the transmission of the next
+    // block request.
+    if (isBlockStreamed(request, reply.data())
+            && !isExpectedStreamedBlock(request->token(), reply.data())) {
+        if (messageReceived->type() == QCoapMessage::Type::Confirmable)
+            sendAcknowledgment(request, reply.data());
         return;
     }
 
-    if (!request->isMulticast())
+    if (!request->isMulticast()) {
+        // Only acknowledgments tell which transmission is answered
+        if (request->isTransmissionInProgress()
+                && request->message()->type() == QCoapMessage::Type::Confirmable
+                && messageReceived->type() == QCoapMessage::Type::Acknowledgment
+                && messageReceived->messageId() == request->message()->messageId()) {
+            const qint64 now = clock.elapsed();
+            rttEstimator.addSample(sender, now - request->transmissionStartTime(),
+                                   request->retransmissionCounter(), now);
+        }
+
+        // Only blocks actually exchanged tell whether their size goes through
+        const bool isBlockExchanged = request->message()->hasOption(QCoapOption::Block1)
+                || messageReceived->hasOption(QCoapOption::Block2);
+        const uint size = requestedBlockSize(request);
+        if (adaptiveBlockSize && isBlockExchanged && size > 0
+                && request->isTransmissionInProgress()) {
+            const qint64 now = clock.elapsed();
+            if (messageReceived->hasOption(QCoapOption::Block2) && reply->blockSize() < size) {
+                blockSizeController.limitBlockSize(sender, reply->blockSize(), now);
+            } else {
+                blockSizeController.addTransfer(sender, size, request->retransmissionCounter(),
+                                                now);
+            }
+        }
         request->stopTransmission();
+    }
     addReply(request->token(), reply);
 
     if (QtCoap::isError(reply->responseCode())) {
@@ -389,19 +1055,49 @@ void QCoapProtocolPrivate::onFrameReceived(const QByteArray &data, const QHostAd
         sendAcknowledgment(request);
     }
 
+    if (isBlockStreamed(request, reply.data()))
+        streamBlock(request, reply.data());
+
     // Send next block, ask for next block, or process the final reply
     if (reply->hasMoreBlocksToSend() && reply->nextBlockToSend() >= 0) {
-        request->setToSendBlock(static_cast<uint>(reply->nextBlockToSend()), blockSize);
-        request->setMessageId(generateUniqueMessageId());
+        if (requestUploadBlock(request->token(), static_cast<uint>(reply->nextBlockToSend())))
+            return;
+
+        // BERT blocks are numbered in blocks of 1024 bytes
+        const uint size = exchangeMap.value(request->token()).requestBlockSize;
+        uint nextBlock = static_cast<uint>(reply->nextBlockToSend());
+        if (size > 1024)
+            nextBlock += size / 1024 - 1;
+        request->setToSendBlock(nextBlock, size);
+        if (!setUniqueMessageId(request, sender)) {
+            onRequestError(request, QtCoap::Error::Unknown);
+            return;
+        }
+        setInitialTimeout(request);
         sendRequest(request);
-    } else if (reply->hasMoreBlocksToReceive()) {
-        request->setToRequestBlock(reply->currentBlockNumber() + 1, reply->blockSize());
-        request->setMessageId(generateUniqueMessageId());
+    } else if (hasMoreBlocksToRequest(request->token(), reply.data())) {
+        const qint64 nextOffset = reply->nextBlockOffset();
+        if (reply->isBertBlock()) {
+            // The server chooses the size of BERT blocks
+            request->setToRequestBlock(static_cast<uint>(nextOffset / 1024), 2 * 1024);
+        } else {
+            // Smaller blocks may be asked for at the same offset
+            uint nextBlockSize = reply->blockSize();
+            if (adaptiveBlockSize && isBlockStreamed(request, reply.data()))
+                nextBlockSize = qMin(nextBlockSize, blockSizeController.blockSize(sender));
+            request->setToRequestBlock(static_cast<uint>(nextOffset / nextBlockSize),
+                                       nextBlockSize);
+        }
+        if (!setUniqueMessageId(request, sender)) {
+            onRequestError(request, QtCoap::Error::Unknown);
+            return;
+        }
+        setInitialTimeout(request);
         // In case of multicast blockwise transfers, according to
         // https://tools.ietf.org/html/rfc7959#section-2.8, further blocks should be retrieved
         // via unicast requests. So instead of using the multicast request address, we need
         // to use the sender address for getting the next blocks.
-        sendRequest(request, sender.toString());
+        sendRequest(request, QCoapEndpoint(sender, request->endpoint().port()));
     } else {
         onLastMessageReceived(request, sender);
     }
@@ -435,6 +1131,43 @@ QPointer<QCoapReply> QCoapProtocolPrivate::userReplyForToken(const QCoapToken &t
     return nullptr;
 }
 
+/*!
+    \internal
+
+    Returns \c true if nothing is waiting for the result of the exchange
+    identified by \a token anymore, because its reply was destroyed or its
+    callback request was cancelled.
+*/
+bool QCoapProtocolPrivate::isExchangeAbandoned(const QCoapToken &token) const
+{
+    const auto it = exchangeMap.constFind(token);
+    if (it == exchangeMap.constEnd())
+        return true;
+
+    return it->callbackExchange ? it->callbackExchange->isCancelled() : it->userReply.isNull();
+}
+
+/*!
+    \internal
+
+    Returns a new completion record for the reply or the callback of the
+    exchange identified by \a token, or \c nullptr if the exchange is
+    abandoned. The record is to be passed to deliver().
+
+    \sa isExchangeAbandoned()
+*/
+QCoapReplyCompletion *QCoapProtocolPrivate::completionForToken(const QCoapToken &token) const
+{
+    if (isExchangeAbandoned(token))
+        return nullptr;
+
+    const CoapExchangeData &exchange = *exchangeMap.constFind(token);
+    auto completion = new QCoapReplyCompletion;
+    completion->reply = exchange.userReply;
+    completion->callbackExchange = exchange.callbackExchange;
+    return completion;
+}
+
 /*!
     \internal
 
@@ -471,10 +1204,9 @@ QCoapInternalReply *QCoapProtocolPrivate::lastReplyForToken(const QCoapToken &to
 */
 QCoapInternalRequest *QCoapProtocolPrivate::findRequestByUserReply(const QCoapReply *reply) const
 {
-    for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
-        if (it->userReply == reply)
-            return it->request.data();
-    }
+    const auto it = userReplyIndex.constFind(reply);
+    if (it != userReplyIndex.constEnd())
+        return requestForToken(*it);
 
     return nullptr;
 }
@@ -482,18 +1214,83 @@ QCoapInternalRequest *QCoapProtocolPrivate::findRequestByUserReply(const QCoapRe
 /*!
     \internal
 
-    Finds an internal request containing the message id \a messageId.
+    Finds an internal request sent to \a sender and containing the message
+    id \a messageId.
 */
-QCoapInternalRequest *QCoapProtocolPrivate::findRequestByMessageId(quint16 messageId) const
+QCoapInternalRequest *QCoapProtocolPrivate::findRequestByMessageId(const QHostAddress &sender,
+                                                                 quint16 messageId) const
 {
-    for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
-        if (it->request->message()->messageId() == messageId)
-            return it->request.data();
-    }
+    const auto it = messageIdIndex.constFind(messageIdKey(sender, messageId));
+    if (it != messageIdIndex.constEnd())
+        return requestForToken(*it);
 
     return nullptr;
 }
 
+/*!
+    \internal
+
+    Returns the tokens of the exchanges whose user reply targets \a url.
+*/
+QVector<QCoapToken> QCoapProtocolPrivate::findTokensByUrl(const QUrl &url) const
+{
+    return urlIndex.values(normalizedUrl(url)).toVector();
+}
+
+/*!
+    \internal
+
+    Sets the message id of the \a request to \a messageId, and updates the
+    message id index if the request belongs to a registered exchange. The
+    message id is indexed for \a host, the endpoint the request is sent to.
+*/
+void QCoapProtocolPrivate::setMessageId(QCoapInternalRequest *request, const QHostAddress &host,
+                                        quint16 messageId)
+{
+    Q_ASSERT(request);
+
+    const auto tokenIt = requestIndex.constFind(request);
+    if (tokenIt != requestIndex.constEnd()) {
+        auto exchangeIt = exchangeMap.find(*tokenIt);
+        Q_ASSERT(exchangeIt != exchangeMap.end());
+
+        auto idIt = messageIdIndex.find(exchangeIt->messageIdKey);
+        if (idIt != messageIdIndex.end() && *idIt == *tokenIt)
+            messageIdIndex.erase(idIt);
+
+        exchangeIt->messageIdKey = messageIdKey(host, messageId);
+        messageIdIndex.insert(exchangeIt->messageIdKey, *tokenIt);
+    }
+
+    request->setMessageId(messageId);
+}
+
+/*!
+    \internal
+
+    Returns the form of \a url used as key for the URL index.
+*/
+QUrl QCoapProtocolPrivate::normalizedUrl(const QUrl &url)
+{
+    return url.adjusted(QUrl::NormalizePathSegments);
+}
+
+/*!
+    \internal
+
+    Returns the key of the message id index for \a messageId and \a host.
+
+    An IPv4-mapped IPv6 address is keyed as its IPv4 address, so that the
+    messages received on a dual-stack socket from \c ::ffff:a.b.c.d match
+    the exchanges sent to \c a.b.c.d, as QHostAddress::isEqual() does.
+*/
+CoapMessageIdKey QCoapProtocolPrivate::messageIdKey(const QHostAddress &host, quint16 messageId)
+{
+    bool isIPv4 = false;
+    const quint32 ipv4Address = host.toIPv4Address(&isIPv4);
+    return qMakePair(isIPv4 ? QHostAddress(ipv4Address) : host, messageId);
+}
+
 /*!
     \internal
 
@@ -513,93 +1310,283 @@ void QCoapProtocolPrivate::onLastMessageReceived(QCoapInternalRequest *request,
     auto replies = repliesForToken(request->token());
     Q_ASSERT(!replies.isEmpty());
 
-    //! TODO: Change QPointer<QCoapReply> into something independent from
-    //! User. QSharedPointer(s)?
-    QPointer<QCoapReply> userReply = userReplyForToken(request->token());
-    if (userReply.isNull() || replies.isEmpty()
+    if (isExchangeAbandoned(request->token()) || replies.isEmpty()
             || (request->isObserve() && request->isObserveCancelled())) {
         forgetExchange(request);
         return;
     }
 
-    auto lastReply = replies.last();
-    // Ignore empty ACK messages
-    if (lastReply->message()->type() == QCoapMessage::Type::Acknowledgment
-            && lastReply->responseCode() == QtCoap::ResponseCode::EmptyMessage) {
-        exchangeMap[request->token()].replies.takeLast();
-        return;
-    }
+    auto lastReply = replies.last();
+    // Ignore empty ACK messages
+    if (lastReply->message()->type() == QCoapMessage::Type::Acknowledgment
+            && lastReply->responseCode() == QtCoap::ResponseCode::EmptyMessage) {
+        exchangeMap[request->token()].replies.takeLast();
+        return;
+    }
+
+    // Merge payloads for blockwise transfers
+    if (replies.size() > 1) {
+
+        // In multicast case, multiple hosts will reply to the same multicast request.
+        // We are interested only in replies coming from the sender.
+        if (request->isMulticast()) {
+            replies.erase(std::remove_if(replies.begin(), replies.end(),
+                                         [sender](QSharedPointer<QCoapInternalReply> reply) {
+                                            return reply->senderAddress() != sender;
+                                         }), replies.end());
+        }
+
+        std::stable_sort(std::begin(replies), std::end(replies),
+        [](QSharedPointer<QCoapInternalReply> a, QSharedPointer<QCoapInternalReply> b) -> bool {
+            return (a->currentBlockNumber() < b->currentBlockNumber());
+        });
+
+        QByteArray finalPayload;
+        int lastBlockNumber = -1;
+        for (auto reply : qAsConst(replies)) {
+            int currentBlock = static_cast<int>(reply->currentBlockNumber());
+            QByteArray replyPayload = reply->message()->payload();
+            if (replyPayload.isEmpty() || currentBlock <= lastBlockNumber)
+                continue;
+
+            finalPayload.append(replyPayload);
+            lastBlockNumber = currentBlock;
+        }
+
+        lastReply->message()->setPayload(finalPayload);
+    }
+
+    // Drop the notifications older than the one already delivered
+    if (request->isObserve() && !acceptNotification(request->token(), replies)) {
+        qCDebug(lcCoapProtocol).nospace() << "QtCoap: Dropping stale notification from "
+                                          << sender;
+        forgetExchangeReplies(request->token());
+        return;
+    }
+
+    // Forward the answer, along with the completion of the reply
+    QCoapReplyCompletion *completion = completionForToken(request->token());
+    if (!completion) {
+        forgetExchange(request);
+        return;
+    }
+    completion->steps = QCoapReplyCompletion::Content;
+    completion->sender = lastReply->senderAddress();
+    completion->message = lastReply->detachedMessage();
+    completion->responseCode = lastReply->responseCode();
+
+    if (request->isObserve()) {
+        completion->steps |= QCoapReplyCompletion::Notified;
+        deliver(completion);
+        forgetExchangeReplies(request->token());
+        // An established observation is no longer an outstanding interaction
+        releaseSchedulerSlot(request->token());
+    } else if (request->isMulticast()) {
+        Q_Q(QCoapProtocol);
+        const QPointer<QCoapReply> userReply = completion->reply;
+        const QCoapMessage message = completion->message;
+        deliver(completion);
+        emit q->responseToMulticastReceived(userReply, message, sender);
+    } else {
+        completion->steps |= QCoapReplyCompletion::Finished;
+        deliver(completion);
+        forgetExchange(request);
+    }
+}
+
+/*!
+    \internal
+
+    Returns \c true if the notification made of \a replies is fresher than
+    the last one accepted for the observation identified by \a token, as
+    described in \l {RFC 7641 - Section 3.4}, and records it as the
+    freshest one.
+
+    A response without an Observe option ends the observation, and is
+    always accepted.
+*/
+bool QCoapProtocolPrivate::acceptNotification(
+        const QCoapToken &token, const QVector<QSharedPointer<QCoapInternalReply>> &replies)
+{
+    const auto it = exchangeMap.find(token);
+    if (it == exchangeMap.end())
+        return false;
+
+    // Only the first block of a blockwise notification carries the option
+    const auto observeReply = std::find_if(replies.cbegin(), replies.cend(),
+                                           [](const QSharedPointer<QCoapInternalReply> &reply) {
+        return reply->message()->hasOption(QCoapOption::Observe);
+    });
+    if (observeReply == replies.cend())
+        return true;
+
+    const quint32 sequence = (*observeReply)->message()->option(QCoapOption::Observe).uintValue();
+    const qint64 now = clock.elapsed();
+    if (it->hasObserveSequence
+            && !isNotificationFresher(it->observeSequence, it->observeTime, sequence, now)) {
+        return false;
+    }
+
+    it->hasObserveSequence = true;
+    it->observeSequence = sequence;
+    it->observeTime = now;
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns \c true if a notification with the Observe \a sequence number,
+    received at \a time in milliseconds, is fresher than the one with
+    \a previousSequence received at \a previousTime.
+
+    The 24-bit sequence numbers wrap around, so a number is newer if it is
+    ahead by less than 2^23. After 128 seconds, the numbers cannot be
+    compared anymore and the new notification is always fresher.
+*/
+bool QCoapProtocolPrivate::isNotificationFresher(quint32 previousSequence, qint64 previousTime,
+                                                 quint32 sequence, qint64 time)
+{
+    const quint32 halfRange = 1u << 23;
+    const qint64 window = 128 * 1000;
+
+    return (previousSequence < sequence && sequence - previousSequence < halfRange)
+            || (previousSequence > sequence && previousSequence - sequence > halfRange)
+            || time > previousTime + window;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the payload of the given \a reply to \a request is
+    streamed to the user reply block by block, instead of being reassembled
+    once the last block is received.
+
+    This is the case for the Block2 responses of unicast requests that do
+    not observe the resource. The blocks of multicast responses may come from
+    several servers, and those of notifications belong to distinct
+    representations, so they are still reassembled at the end.
+*/
+bool QCoapProtocolPrivate::isBlockStreamed(const QCoapInternalRequest *request,
+                                           const QCoapInternalReply *reply) const
+{
+    if (request->isMulticast() || request->isObserve()
+            || !reply->message()->hasOption(QCoapOption::Block2)) {
+        return false;
+    }
+
+    // The result of a request sent with a callback is delivered at once
+    const auto it = exchangeMap.constFind(request->token());
+    return it == exchangeMap.constEnd() || !it->callbackExchange;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the block carried by \a reply starts where the payload
+    already streamed for the exchange identified by \a token ends.
+*/
+bool QCoapProtocolPrivate::isExpectedStreamedBlock(const QCoapToken &token,
+                                                   const QCoapInternalReply *reply) const
+{
+    const auto it = exchangeMap.constFind(token);
+    if (it == exchangeMap.constEnd())
+        return false;
+
+    const qint64 offset = qint64(reply->currentBlockNumber()) * reply->blockSize();
+    return offset == it->streamedSize;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the block following the one carried by \a reply must
+    be requested for the exchange identified by \a token. This is the case
+    if the server has more blocks, and the next block starts before the end
+    of the block range requested, if any.
+
+    The range is compared in bytes, so that it is still honored if the
+    server answers with smaller blocks than requested.
+*/
+bool QCoapProtocolPrivate::hasMoreBlocksToRequest(const QCoapToken &token,
+                                                  const QCoapInternalReply *reply) const
+{
+    if (!reply->hasMoreBlocksToReceive())
+        return false;
+
+    const auto it = exchangeMap.constFind(token);
+    if (it == exchangeMap.constEnd() || it->rangeEnd < 0)
+        return true;
 
-    // Merge payloads for blockwise transfers
-    if (replies.size() > 1) {
+    return reply->nextBlockOffset() < it->rangeEnd;
+}
 
-        // In multicast case, multiple hosts will reply to the same multicast request.
-        // We are interested only in replies coming from the sender.
-        if (request->isMulticast()) {
-            replies.erase(std::remove_if(replies.begin(), replies.end(),
-                                         [sender](QSharedPointer<QCoapInternalReply> reply) {
-                                            return reply->senderAddress() != sender;
-                                         }), replies.end());
-        }
+/*!
+    \internal
 
-        std::stable_sort(std::begin(replies), std::end(replies),
-        [](QSharedPointer<QCoapInternalReply> a, QSharedPointer<QCoapInternalReply> b) -> bool {
-            return (a->currentBlockNumber() < b->currentBlockNumber());
-        });
+    Forwards the payload of the block carried by \a reply to the user reply
+    of \a request, along with the size of the payload expected, computed
+    from the total size of the resource announced by the Size2 option of
+    the first block, if any, and from the block range requested.
 
-        QByteArray finalPayload;
-        int lastBlockNumber = -1;
-        for (auto reply : qAsConst(replies)) {
-            int currentBlock = static_cast<int>(reply->currentBlockNumber());
-            QByteArray replyPayload = reply->message()->payload();
-            if (replyPayload.isEmpty() || currentBlock <= lastBlockNumber)
-                continue;
+    Unless it is the last block, the internal reply is removed from the
+    exchange, so that only one block is held at a time by the protocol.
 
-            finalPayload.append(replyPayload);
-            lastBlockNumber = currentBlock;
-        }
+    For more details, refer to
+    \l{https://tools.ietf.org/html/rfc7959#section-4}{RFC 7959 - Section 4}.
+*/
+void QCoapProtocolPrivate::streamBlock(QCoapInternalRequest *request, QCoapInternalReply *reply)
+{
+    const auto it = exchangeMap.find(request->token());
+    if (it == exchangeMap.end())
+        return;
 
-        lastReply->message()->setPayload(finalPayload);
+    if (it->streamedSize == it->rangeStart) {
+        const QCoapOption size2 = reply->message()->option(QCoapOption::Size2);
+        qint64 end = size2.isValid() ? qint64(size2.uintValue()) : -1;
+        if (end >= 0 && it->rangeEnd >= 0)
+            end = qMin(end, it->rangeEnd);
+        it->streamTotalSize = end >= 0 ? qMax(end - it->rangeStart, qint64(0)) : -1;
     }
 
-    // Forward the answer
-    QMetaObject::invokeMethod(userReply, "_q_setContent", Qt::QueuedConnection,
-                              Q_ARG(QHostAddress, lastReply->senderAddress()),
-                              Q_ARG(QCoapMessage, *lastReply->message()),
-                              Q_ARG(QtCoap::ResponseCode, lastReply->responseCode()));
+    const QByteArray block = reply->detachedPayload();
+    it->streamedSize += block.size();
 
-    if (request->isObserve()) {
-        QMetaObject::invokeMethod(userReply, "_q_setNotified", Qt::QueuedConnection);
-        forgetExchangeReplies(request->token());
-    } else if (request->isMulticast()) {
-        Q_Q(QCoapProtocol);
-        emit q->responseToMulticastReceived(userReply, *lastReply->message(), sender);
-    } else {
-        QMetaObject::invokeMethod(userReply, "_q_setFinished", Qt::QueuedConnection,
-                                  Q_ARG(QtCoap::Error, QtCoap::Error::Ok));
-        forgetExchange(request);
+    if (!it->userReply.isNull()) {
+        auto completion = new QCoapReplyCompletion;
+        completion->reply = it->userReply;
+        completion->steps = QCoapReplyCompletion::Payload;
+        completion->block = block;
+        completion->totalSize = it->streamTotalSize;
+        deliver(completion);
     }
+
+    if (hasMoreBlocksToRequest(request->token(), reply))
+        it->replies.clear();
 }
 
 /*!
     \internal
 
     Sends an internal request acknowledging the given \a request, reusing its
-    URI and connection.
+    URI and connection. The acknowledgment echoes the message ID of \a reply,
+    or of the last reply received for the request if \a reply is \c nullptr.
 */
-void QCoapProtocolPrivate::sendAcknowledgment(QCoapInternalRequest *request) const
+void QCoapProtocolPrivate::sendAcknowledgment(QCoapInternalRequest *request,
+                                              const QCoapInternalReply *reply) const
 {
     Q_Q(const QCoapProtocol);
     Q_ASSERT(QThread::currentThread() == q->thread());
 
     QCoapInternalRequest ackRequest;
-    ackRequest.setTargetUri(request->targetUri());
+    ackRequest.setTargetUri(request->targetUri(), request->endpoint());
 
-    auto internalReply = lastReplyForToken(request->token());
+    const QCoapInternalReply *internalReply = reply ? reply
+                                                    : lastReplyForToken(request->token());
     ackRequest.initForAcknowledgment(internalReply->message()->messageId(),
                                      internalReply->message()->token());
     ackRequest.setConnection(request->connection());
-    sendRequest(&ackRequest);
+    transmit(&ackRequest);
 }
 
 /*!
@@ -615,12 +1602,12 @@ void QCoapProtocolPrivate::sendReset(QCoapInternalRequest *request) const
     Q_ASSERT(QThread::currentThread() == q->thread());
 
     QCoapInternalRequest resetRequest;
-    resetRequest.setTargetUri(request->targetUri());
+    resetRequest.setTargetUri(request->targetUri(), request->endpoint());
 
     auto lastReply = lastReplyForToken(request->token());
     resetRequest.initForReset(lastReply->message()->messageId());
     resetRequest.setConnection(request->connection());
-    sendRequest(&resetRequest);
+    transmit(&resetRequest);
 }
 
 /*!
@@ -648,7 +1635,10 @@ void QCoapProtocol::cancelObserve(QPointer<QCoapReply> reply) const
     }
 
     // Set as cancelled even if request is not tracked anymore
-    QMetaObject::invokeMethod(reply, "_q_setObserveCancelled", Qt::QueuedConnection);
+    auto completion = new QCoapReplyCompletion;
+    completion->reply = reply;
+    completion->steps = QCoapReplyCompletion::ObserveCancelled;
+    d->deliver(completion);
 }
 
 /*!
@@ -663,25 +1653,33 @@ void QCoapProtocol::cancelObserve(const QUrl &url) const
 {
     Q_D(const QCoapProtocol);
 
-    for (const auto &exchange : d->exchangeMap) {
-        Q_ASSERT(exchange.userReply);
-        if (exchange.userReply->url() == url)
-            cancelObserve(exchange.userReply);
+    const auto tokens = d->findTokensByUrl(url);
+    for (const auto &token : tokens) {
+        const auto userReply = d->userReplyForToken(token);
+        if (userReply)
+            cancelObserve(userReply);
     }
 }
 
 /*!
     \internal
 
-    Returns a currently unused message Id.
+    Returns a message Id for the given \a host which has not been used for
+    this host during the last \c EXCHANGE_LIFETIME, or 0 if all ids are
+    still in use.
+
+    \sa QCoapProtocol::exchangeLifetime()
 */
-quint16 QCoapProtocolPrivate::generateUniqueMessageId() const
+quint16 QCoapProtocolPrivate::generateUniqueMessageId(const QHostAddress &host)
 {
-    // TODO: Optimize message id generation for large sets
-    // TODO: Store used message id for the period specified by CoAP spec
-    quint16 id = 0;
-    while (isMessageIdRegistered(id))
-        id = static_cast<quint16>(QtCoap::randomGenerator().bounded(0x10000));
+    Q_Q(const QCoapProtocol);
+
+    const qint64 now = clock.elapsed();
+    quint16 id = messageIdAllocator.allocate(host, now, q->exchangeLifetime());
+
+    // Exchanges outliving EXCHANGE_LIFETIME, like observations, keep their id
+    while (id != 0 && isMessageIdRegistered(host, id))
+        id = messageIdAllocator.allocate(host, now, q->exchangeLifetime());
 
     return id;
 }
@@ -689,33 +1687,48 @@ quint16 QCoapProtocolPrivate::generateUniqueMessageId() const
 /*!
     \internal
 
-    Returns a currently unused token.
+    Sets a new unique message id for \a host to the registered \a request.
+    Returns \c false if no message id is available.
 */
-QCoapToken QCoapProtocolPrivate::generateUniqueToken() const
+bool QCoapProtocolPrivate::setUniqueMessageId(QCoapInternalRequest *request,
+                                              const QHostAddress &host)
 {
-    // TODO: Optimize token generation for large sets
-    // TODO: Store used token for the period specified by CoAP spec
-    QCoapToken token;
-    while (isTokenRegistered(token)) {
-        quint8 length = static_cast<quint8>(QtCoap::randomGenerator().bounded(minimumTokenSize, 9));
-        token.resize(length);
-        quint8 *tokenData = reinterpret_cast<quint8 *>(token.data());
-        for (int i = 0; i < token.size(); ++i)
-            tokenData[i] = static_cast<quint8>(QtCoap::randomGenerator().bounded(256));
+    const quint16 id = generateUniqueMessageId(host);
+    if (id == 0) {
+        qCWarning(lcCoapProtocol) << "No message id available for" << host
+                                  << "within EXCHANGE_LIFETIME.";
+        return false;
     }
 
+    setMessageId(request, host, id);
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns a token which is not used by any ongoing exchange.
+*/
+QCoapToken QCoapProtocolPrivate::generateUniqueToken()
+{
+    QCoapToken token;
+    do {
+        token = tokenGenerator.generate(minimumTokenSize);
+    } while (isTokenRegistered(token));
+
     return token;
 }
 
 /*!
     \internal
 
-    Returns a new unmanaged QCoapInternalReply based on \a data and \a sender.
+    Returns a new unmanaged QCoapInternalReply based on the valid frame \a pdu
+    and \a sender.
 */
-QCoapInternalReply *QCoapProtocolPrivate::decode(const QByteArray &data, const QHostAddress &sender)
+QCoapInternalReply *QCoapProtocolPrivate::decode(const QCoapPduView &pdu, const QHostAddress &sender)
 {
     Q_Q(QCoapProtocol);
-    QCoapInternalReply *reply = QCoapInternalReply::createFromFrame(data, q);
+    QCoapInternalReply *reply = QCoapInternalReply::createFromView(pdu, q);
     reply->setSenderAddress(sender);
 
     return reply;
@@ -741,39 +1754,116 @@ void QCoapProtocolPrivate::onRequestAborted(const QCoapToken &token)
 /*!
     \internal
 
-    Triggered in case of a connection error.
+    Drops the running exchange of the cancelled callback \a exchange. Its
+    timeouts are removed from the timer wheel and its scheduler slot is
+    freed. An exchange still queued by the scheduler is dropped when it is
+    dequeued, since it holds no slot.
 */
-void QCoapProtocolPrivate::onConnectionError(QAbstractSocket::SocketError socketError)
+void QCoapProtocolPrivate::onCallbackExchangeCancelled(
+        const QSharedPointer<QCoapCallbackExchange> &exchange)
 {
-    Q_Q(QCoapProtocol);
+    const QCoapToken token = callbackExchangeIndex.value(exchange.data());
+    if (!token.isEmpty())
+        onRequestAborted(token);
+}
+
+/*!
+    \internal
 
-    QtCoap::Error coapError;
+    Returns the CoAP error matching the \a socketError.
+*/
+static QtCoap::Error toCoapError(QAbstractSocket::SocketError socketError)
+{
     switch (socketError) {
     case QAbstractSocket::HostNotFoundError :
-        coapError = QtCoap::Error::HostNotFound;
-        break;
+        return QtCoap::Error::HostNotFound;
     case QAbstractSocket::AddressInUseError :
-        coapError = QtCoap::Error::AddressInUse;
-        break;
+        return QtCoap::Error::AddressInUse;
     default:
-        coapError = QtCoap::Error::Unknown;
-        break;
+        return QtCoap::Error::Unknown;
+    }
+}
+
+/*!
+    \internal
+
+    Triggered in case of a connection error.
+*/
+void QCoapProtocolPrivate::onConnectionError(QAbstractSocket::SocketError socketError)
+{
+    Q_Q(QCoapProtocol);
+
+    emit q->error(nullptr, toCoapError(socketError));
+}
+
+/*!
+    \internal
+
+    Fails the exchanges sent to \a endpoint over \a connection, whose
+    connection was lost because of \a socketError. Requests sent over a
+    reliable transport are never retransmitted, so they would otherwise
+    only fail once MAX_TRANSMIT_WAIT elapsed.
+*/
+void QCoapProtocolPrivate::onConnectionLost(QCoapConnection *connection,
+                                            const QCoapEndpoint &endpoint,
+                                            QAbstractSocket::SocketError socketError)
+{
+    // The exchanges are forgotten while failing them
+    QVector<QSharedPointer<QCoapInternalRequest>> lostRequests;
+    for (const CoapExchangeData &exchange : qAsConst(exchangeMap)) {
+        if (exchange.request->connection() == connection
+                && exchange.request->endpoint() == endpoint) {
+            lostRequests.append(exchange.request);
+        }
     }
 
-    emit q->error(nullptr, coapError);
+    const QtCoap::Error coapError = toCoapError(socketError);
+    for (const QSharedPointer<QCoapInternalRequest> &request : qAsConst(lostRequests)) {
+        if (!isRequestRegistered(request.data()))
+            continue;
+
+        qCDebug(lcCoapProtocol).nospace() << "Connection to " << endpoint.address()
+                                          << " lost, failing request for token '"
+                                          << request->token() << "'";
+        request->stopTransmission();
+        onRequestError(request.data(), coapError);
+    }
 }
 
 /*!
     \internal
 
     Registers a new CoAP exchange using \a token.
+
+    Besides the token, the exchange is indexed by the message id of the
+    \a request for its target host, by the \a request and \a reply pointers,
+    and by the URL of the \a reply. The indexes are kept consistent by
+    setMessageId() and forgetExchange().
 */
 void QCoapProtocolPrivate::registerExchange(const QCoapToken &token, QCoapReply *reply,
                                             QSharedPointer<QCoapInternalRequest> request)
 {
-    CoapExchangeData data = { reply, request,
-                              QVector<QSharedPointer<QCoapInternalReply> >()
-                            };
+    Q_ASSERT(request);
+
+    // Replacing an exchange must not leave stale entries behind
+    if (exchangeMap.contains(token))
+        forgetExchange(token);
+
+    CoapExchangeData data;
+    data.userReply = reply;
+    data.request = request;
+    data.userReplyKey = reply;
+    data.messageIdKey = messageIdKey(request->endpoint().address(),
+                                     request->message()->messageId());
+    if (reply)
+        data.url = normalizedUrl(reply->url());
+
+    messageIdIndex.insert(data.messageIdKey, token);
+    requestIndex.insert(request.data(), token);
+    if (reply) {
+        userReplyIndex.insert(reply, token);
+        urlIndex.insert(data.url, token);
+    }
 
     exchangeMap.insert(token, data);
 }
@@ -800,6 +1890,21 @@ bool QCoapProtocolPrivate::addReply(const QCoapToken &token,
     return true;
 }
 
+/*!
+    \internal
+
+    Removes the entry for \a key from the secondary \a index, if it refers
+    to the exchange identified by \a token.
+*/
+template<typename Key>
+static void removeIndexEntry(QHash<Key, QCoapToken> *index, const Key &key,
+                             const QCoapToken &token)
+{
+    const auto it = index->find(key);
+    if (it != index->end() && *it == token)
+        index->erase(it);
+}
+
 /*!
     \internal
 
@@ -812,7 +1917,28 @@ bool QCoapProtocolPrivate::addReply(const QCoapToken &token,
 */
 bool QCoapProtocolPrivate::forgetExchange(const QCoapToken &token)
 {
-    return exchangeMap.remove(token) > 0;
+    releaseSchedulerSlot(token);
+
+    const auto it = exchangeMap.find(token);
+    if (it == exchangeMap.end())
+        return false;
+
+    // Secondary index entries are only removed if they still refer to this exchange
+    removeIndexEntry(&messageIdIndex, it->messageIdKey, token);
+    removeIndexEntry(&requestIndex,
+                     static_cast<const QCoapInternalRequest *>(it->request.data()), token);
+    if (it->userReplyKey) {
+        removeIndexEntry(&userReplyIndex, it->userReplyKey, token);
+        urlIndex.remove(it->url, token);
+    }
+    if (it->callbackExchange) {
+        removeIndexEntry(&callbackExchangeIndex,
+                         static_cast<const QCoapCallbackExchange *>(it->callbackExchange.data()),
+                         token);
+    }
+
+    exchangeMap.erase(it);
+    return true;
 }
 
 /*!
@@ -842,6 +1968,24 @@ bool QCoapProtocolPrivate::forgetExchangeReplies(const QCoapToken &token)
     return true;
 }
 
+/*!
+    \internal
+
+    Delivers the \a completion record to its reply, in the thread of the
+    reply, and takes its ownership.
+
+    The record goes through the dispatcher of the client when there is
+    one, so that the updates of many replies are applied with a single
+    event. Otherwise it is applied with a queued invocation on the reply.
+*/
+void QCoapProtocolPrivate::deliver(QCoapReplyCompletion *completion) const
+{
+    if (replyDispatcher)
+        replyDispatcher->post(completion);
+    else
+        QCoapReplyDispatcher::invokeQueued(completion);
+}
+
 /*!
     \internal
 
@@ -865,32 +2009,22 @@ bool QCoapProtocolPrivate::isTokenRegistered(const QCoapToken &token) const
 */
 bool QCoapProtocolPrivate::isRequestRegistered(const QCoapInternalRequest *request) const
 {
-    for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
-        if (it->request.data() == request)
-            return true;
-    }
-
-    return false;
+    return requestIndex.contains(request);
 }
 
 /*!
     \internal
 
-    Returns \c true if a request has a message id equal to \a id, or if \a id
-    is reserved.
+    Returns \c true if a request sent to \a host has a message id equal to
+    \a id, or if \a id is reserved.
 */
-bool QCoapProtocolPrivate::isMessageIdRegistered(quint16 id) const
+bool QCoapProtocolPrivate::isMessageIdRegistered(const QHostAddress &host, quint16 id) const
 {
     // Reserved for uninitialized message Id
     if (id == 0)
         return true;
 
-    for (auto it = exchangeMap.constBegin(); it != exchangeMap.constEnd(); ++it) {
-        if (it->request->message()->messageId() == id)
-            return true;
-    }
-
-    return false;
+    return messageIdIndex.contains(messageIdKey(host, id));
 }
 
 /*!
@@ -997,6 +2131,22 @@ uint QCoapProtocol::maximumLatency() const
     return 100 * 1000;
 }
 
+/*!
+    \internal
+
+    Returns the \c EXCHANGE_LIFETIME in milliseconds, as defined in
+    \l{https://tools.ietf.org/search/rfc7252#section-4.8.2}{RFC 7252}.
+
+    It is the time from starting to send a Confirmable message to the time
+    when an acknowledgment is no longer expected, and thus the time during
+    which its message id cannot be reused.
+*/
+uint QCoapProtocol::exchangeLifetime() const
+{
+    // PROCESSING_DELAY is set to ACK_TIMEOUT, as suggested by the RFC
+    return maximumTransmitSpan() + 2 * maximumLatency() + ackTimeout();
+}
+
 /*!
     \internal
 
@@ -1056,6 +2206,93 @@ uint QCoapProtocol::maximumServerResponseDelay() const
     return d->maximumServerResponseDelay;
 }
 
+/*!
+    \internal
+
+    Returns \c true if the timeouts of Confirmable messages are adapted to
+    the round-trip times measured for each endpoint.
+
+    \sa setAdaptiveTimeoutEnabled(), roundTripStatistics()
+*/
+bool QCoapProtocol::isAdaptiveTimeoutEnabled() const
+{
+    Q_D(const QCoapProtocol);
+    return d->adaptiveTimeout;
+}
+
+/*!
+    \internal
+
+    Returns the round-trip time estimations and the current retransmission
+    timeout of the endpoint \a host. The round-trip times are measured even
+    when adaptive timeouts are disabled.
+
+    \sa isAdaptiveTimeoutEnabled()
+*/
+QCoapRttEstimator::Statistics QCoapProtocol::roundTripStatistics(const QHostAddress &host) const
+{
+    Q_D(const QCoapProtocol);
+    return d->rttEstimator.statistics(host, d->clock.elapsed());
+}
+
+/*!
+    \internal
+
+    Returns \c true if the size of the blocks exchanged with each endpoint
+    is adapted to the losses observed.
+
+    \sa setAdaptiveBlockSizeEnabled(), blockSizeStatistics()
+*/
+bool QCoapProtocol::isAdaptiveBlockSizeEnabled() const
+{
+    Q_D(const QCoapProtocol);
+    return d->adaptiveBlockSize;
+}
+
+/*!
+    \internal
+
+    Returns the current block size of the endpoint \a host, along with the
+    state of its adaptation.
+
+    \sa isAdaptiveBlockSizeEnabled()
+*/
+QCoapBlockSizeController::Statistics
+QCoapProtocol::blockSizeStatistics(const QHostAddress &host) const
+{
+    Q_D(const QCoapProtocol);
+    return d->blockSizeController.statistics(host);
+}
+
+/*!
+    \internal
+
+    Returns the maximum number of outstanding requests to each server, or 0
+    if it is not limited.
+
+    \sa setMaximumOutstandingRequests()
+*/
+int QCoapProtocol::maximumOutstandingRequests() const
+{
+    Q_D(const QCoapProtocol);
+    return d->scheduler.maximumOutstanding();
+}
+
+/*!
+    \internal
+
+    Returns the number of outstanding and queued requests to the server
+    \a host, along with the time spent by requests in the queue.
+
+    \sa setMaximumOutstandingRequests()
+*/
+QCoapRequestScheduler::Statistics
+QCoapProtocol::requestQueueStatistics(const QHostAddress &host) const
+{
+    Q_D(const QCoapProtocol);
+    return d->scheduler.statistics(host, d->clock.elapsed());
+}
+
 /*!
     \internal
 
@@ -1072,6 +2309,7 @@ void QCoapProtocol::setAckTimeout(uint ackTimeout)
 {
     Q_D(QCoapProtocol);
     d->ackTimeout = ackTimeout;
+    d->rttEstimator.setInitialTimeout(ackTimeout);
 }
 
 /*!
@@ -1139,6 +2377,7 @@ void QCoapProtocol::setBlockSize(quint16 blockSize)
     }
 
     d->blockSize = blockSize;
+    d->blockSizeController.setInitialBlockSize(blockSize);
 }
 
 /*!
@@ -1178,4 +2417,135 @@ void QCoapProtocol::setMinimumTokenSize(int tokenSize)
     }
 }
 
+/*!
+    \internal
+
+    Sets the maximum number of outstanding requests to each server, the
+    \c NSTART parameter of \l{https://tools.ietf.org/html/rfc7252#section-4.7}
+    {RFC 7252}, to \a count. Further requests are queued by priority, and
+    sent when a previous request to this server is completed, fails or
+    establishes an observation.
+
+    Multicast requests are not limited. The default value is 0, which does not
+    limit the number of outstanding requests.
+
+    \sa QCoapRequest::setPriority()
+*/
+void QCoapProtocol::setMaximumOutstandingRequests(int count)
+{
+    Q_D(QCoapProtocol);
+
+    if (count < 0) {
+        qCWarning(lcCoapProtocol, "Failed to set the maximum number of outstanding requests,"
+                                  " it should not be negative.");
+        return;
+    }
+
+    d->scheduler.setMaximumOutstanding(count);
+
+    // A higher limit frees slots for the queued requests
+    const QVector<QHostAddress> readyEndpoints = d->scheduler.readyEndpoints();
+    if (!readyEndpoints.isEmpty()) {
+        d->endpointsToDrain += readyEndpoints;
+        if (!d->drainPending) {
+            d->drainPending = true;
+            QMetaObject::invokeMethod(this, [d]() { d->startQueuedRequests(); },
+                                      Qt::QueuedConnection);
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Sets whether the timeouts of unicast Confirmable messages are adapted to
+    the round-trip times measured for each endpoint to \a enabled.
+
+    When enabled, the initial timeout of a request is a random value between
+    the retransmission timeout estimated for its endpoint and that value
+    multiplied by ackRandomFactor(), instead of being based on ackTimeout().
+    The timeout is then multiplied on each retransmission by a factor of 3,
+    2 or 1.5, depending on whether the estimated timeout is below 1 second,
+    between 1 and 3 seconds, or above 3 seconds.
+
+    The estimation follows the CoCoA algorithm, see QCoapRttEstimator.
+    Adaptive timeouts are disabled by default.
+*/
+void QCoapProtocol::setAdaptiveTimeoutEnabled(bool enabled)
+{
+    Q_D(QCoapProtocol);
+    d->adaptiveTimeout = enabled;
+}
+
+/*!
+    \internal
+
+    Sets whether the size of the blocks exchanged with each unicast endpoint
+    is adapted to the losses observed to \a enabled.
+
+    When enabled, blockwise transfers start with blockSize(), or with
+    blocks of 1024 bytes if it is 0, bounded by the path MTU of the
+    endpoint. The block size of an endpoint is doubled after blocks are
+    exchanged without retransmission, and halved when a block times out
+    repeatedly, which points to fragmented datagrams. Block1 transfers
+    keep their block size until they complete, while Block2 transfers
+    switch to smaller blocks at the same offset right away.
+
+    Adaptive block sizes are disabled by default.
+
+    \sa setPathMtu(), blockSizeStatistics(), QCoapBlockSizeController
+*/
+void QCoapProtocol::setAdaptiveBlockSizeEnabled(bool enabled)
+{
+    Q_D(QCoapProtocol);
+    d->adaptiveBlockSize = enabled;
+}
+
+/*!
+    \internal
+
+    Sets the path MTU to the endpoints outside of the subnets with a specific
+    path MTU to \a mtu bytes. Adaptive block sizes never exceed the largest
+    block whose messages fit in the path MTU. A value of 0, the default,
+    means that the path MTU is unknown.
+
+    \sa setAdaptiveBlockSizeEnabled()
+*/
+void QCoapProtocol::setPathMtu(int mtu)
+{
+    Q_D(QCoapProtocol);
+    d->blockSizeController.setPathMtu(mtu);
+}
+
+/*!
+    \internal
+    \overload
+
+    Sets the path MTU to the endpoints of the subnet \a subnet with a prefix
+    of \a prefixLength bits, such as the subnet of a network interface, to
+    \a mtu bytes. A value of 0 removes the path MTU of the subnet.
+*/
+void QCoapProtocol::setPathMtu(const QHostAddress &subnet, int prefixLength, int mtu)
+{
+    Q_D(QCoapProtocol);
+    d->blockSizeController.setPathMtu(subnet, prefixLength, mtu);
+}
+
+/*!
+    \internal
+
+    Sets whether compact tokens are used to \a enabled. Compact tokens have
+    exactly the minimum token size and are guaranteed to be distinct from the
+    previous 2^(8 * size) tokens, but are less random than the default tokens.
+    Compact tokens are disabled by default.
+
+    \sa setMinimumTokenSize()
+*/
+void QCoapProtocol::setCompactTokensEnabled(bool enabled)
+{
+    Q_D(QCoapProtocol);
+    d->tokenGenerator.setMode(enabled ? QCoapTokenGenerator::Mode::Compact
+                                      : QCoapTokenGenerator::Mode::Random);
+}
+
 QT_END_NAMESPACE
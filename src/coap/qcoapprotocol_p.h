@@ -34,10 +34,25 @@
 #include <QtCoap/qcoapglobal.h>
 #include <QtCoap/qcoapreply.h>
 #include <QtCoap/qcoapresource.h>
+#include <private/qcoapblocksizecontroller_p.h>
+#include <private/qcoapendpoint_p.h>
+#include <private/qcoaplockfreequeue_p.h>
+#include <private/qcoapmessageidallocator_p.h>
+#include <private/qcoapreplydispatcher_p.h>
+#include <private/qcoaprequestscheduler_p.h>
+#include <private/qcoaprttestimator_p.h>
+#include <private/qcoaptimerwheel_p.h>
+#include <private/qcoaptokengenerator_p.h>
 #include <QtCore/qvector.h>
 #include <QtCore/qqueue.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpair.h>
+#include <QtCore/qurl.h>
 #include <QtCore/qpointer.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qbasictimer.h>
+#include <QtNetwork/qhostaddress.h>
 #include <private/qobject_p.h>
 
 //
@@ -57,6 +72,8 @@ class QCoapInternalRequest;
 class QCoapInternalReply;
 class QCoapProtocolPrivate;
 class QCoapConnection;
+class QCoapPduView;
+class QCoapUploadSource;
 class Q_AUTOTEST_EXPORT QCoapProtocol : public QObject
 {
     Q_OBJECT
@@ -71,6 +88,7 @@ public:
     uint maximumTransmitSpan() const;
     uint maximumTransmitWait() const;
     uint maximumLatency() const;
+    uint exchangeLifetime() const;
 
     uint minimumTimeout() const;
     uint maximumTimeout() const;
@@ -78,6 +96,15 @@ public:
     uint nonConfirmLifetime() const;
     uint maximumServerResponseDelay() const;
 
+    bool isAdaptiveTimeoutEnabled() const;
+    QCoapRttEstimator::Statistics roundTripStatistics(const QHostAddress &host) const;
+
+    bool isAdaptiveBlockSizeEnabled() const;
+    QCoapBlockSizeController::Statistics blockSizeStatistics(const QHostAddress &host) const;
+
+    int maximumOutstandingRequests() const;
+    QCoapRequestScheduler::Statistics requestQueueStatistics(const QHostAddress &host) const;
+
 Q_SIGNALS:
     void finished(QCoapReply *reply);
     void responseToMulticastReceived(QCoapReply *reply, const QCoapMessage &message,
@@ -91,6 +118,16 @@ public:
     Q_INVOKABLE void setBlockSize(quint16 blockSize);
     Q_INVOKABLE void setMaximumServerResponseDelay(uint responseDelay);
     Q_INVOKABLE void setMinimumTokenSize(int tokenSize);
+    Q_INVOKABLE void setCompactTokensEnabled(bool enabled);
+    Q_INVOKABLE void setAdaptiveTimeoutEnabled(bool enabled);
+    Q_INVOKABLE void setAdaptiveBlockSizeEnabled(bool enabled);
+    Q_INVOKABLE void setPathMtu(int mtu);
+    Q_INVOKABLE void setPathMtu(const QHostAddress &subnet, int prefixLength, int mtu);
+    Q_INVOKABLE void setMaximumOutstandingRequests(int count);
+
+protected:
+    bool event(QEvent *event) override;
+    void timerEvent(QTimerEvent *event) override;
 
 private:
     Q_INVOKABLE void sendRequest(QPointer<QCoapReply> reply, QCoapConnection *connection);
@@ -102,29 +139,114 @@ private:
 
     friend class QCoapClient;
     friend class QCoapClientPrivate;
+    friend class QCoapBatchPrivate;
+    friend class QCoapCallbackExchange;
 };
 
+typedef QPair<QHostAddress, quint16> CoapMessageIdKey;
+
 struct CoapExchangeData {
     QPointer<QCoapReply> userReply;
+    // Set instead of the user reply for requests sent with a callback
+    QSharedPointer<QCoapCallbackExchange> callbackExchange;
     QSharedPointer<QCoapInternalRequest> request;
     QVector<QSharedPointer<QCoapInternalReply> > replies;
+
+    // Keys under which the exchange is stored in the secondary indexes. They are
+    // kept here, since the user reply may already be destroyed when forgetting it.
+    const QCoapReply *userReplyKey = nullptr;
+    CoapMessageIdKey messageIdKey;
+    QUrl url;
+
+    // Endpoint of the scheduler slot held by the exchange, null if none
+    QHostAddress schedulerHost;
+
+    // Blockwise response streamed to the user reply
+    qint64 streamedSize = 0;
+    qint64 streamTotalSize = -1;
+
+    // Byte range of the resource requested with a block range, the end is
+    // -1 if the resource is requested up to its last block
+    qint64 rangeStart = 0;
+    qint64 rangeEnd = -1;
+
+    // Size of the blocks of the request payload, chosen when the exchange starts
+    uint requestBlockSize = 0;
+
+    // Blockwise request whose payload is read from a device
+    QPointer<QCoapUploadSource> uploadSource;
+
+    // Observe sequence number and reception time of the freshest
+    // notification, used to drop the reordered ones
+    bool hasObserveSequence = false;
+    quint32 observeSequence = 0;
+    qint64 observeTime = 0;
 };
 
-typedef QMap<QByteArray, CoapExchangeData> CoapExchangeMap;
+typedef QHash<QCoapToken, CoapExchangeData> CoapExchangeMap;
+
+// Callback request of a batch, already validated by the client
+struct QCoapCallbackSubmission
+{
+    QSharedPointer<QCoapCallbackExchange> exchange;
+    QCoapConnection *connection = nullptr;
+};
+
+struct QCoapRequestSubmission
+{
+    QPointer<QCoapReply> reply;
+    QSharedPointer<QCoapCallbackExchange> callbackExchange;
+    QCoapConnection *connection = nullptr;
+    QVector<QCoapCallbackSubmission> batch;
+    QCoapRequestSubmission *next = nullptr;
+};
 
 class Q_AUTOTEST_EXPORT QCoapProtocolPrivate : public QObjectPrivate
 {
 public:
     QCoapProtocolPrivate() = default;
 
-    quint16 generateUniqueMessageId() const;
-    QCoapToken generateUniqueToken() const;
+    quint16 generateUniqueMessageId(const QHostAddress &host);
+    bool setUniqueMessageId(QCoapInternalRequest *request, const QHostAddress &host);
+    QCoapToken generateUniqueToken();
 
-    QCoapInternalReply *decode(const QByteArray &data, const QHostAddress &sender);
+    QCoapInternalReply *decode(const QCoapPduView &pdu, const QHostAddress &sender);
 
-    void sendAcknowledgment(QCoapInternalRequest *request) const;
+    void sendAcknowledgment(QCoapInternalRequest *request,
+                            const QCoapInternalReply *reply = nullptr) const;
     void sendReset(QCoapInternalRequest *request) const;
-    void sendRequest(QCoapInternalRequest *request, const QString& host = QString()) const;
+    void submitRequest(QCoapReply *reply, QCoapConnection *connection);
+    void submitRequest(const QSharedPointer<QCoapCallbackExchange> &exchange,
+                       QCoapConnection *connection);
+    void submitBatch(QVector<QCoapCallbackSubmission> &&batch);
+    void sendSubmittedRequests();
+    void sendCallbackRequest(const QSharedPointer<QCoapCallbackExchange> &exchange,
+                             QCoapConnection *connection);
+    void scheduleCallbackRequest(const QSharedPointer<QCoapCallbackExchange> &exchange,
+                                 QCoapConnection *connection);
+    void startExchange(const QPointer<QCoapReply> &reply,
+                       const QSharedPointer<QCoapCallbackExchange> &callbackExchange,
+                       QCoapConnection *connection, bool holdsSchedulerSlot);
+    bool requestUploadBlock(const QCoapToken &token, uint blockNumber);
+    void sendUploadBlock(const QCoapToken &token, uint blockNumber, const QByteArray &data,
+                         bool hasMoreBlocks);
+    void onUploadFailed(const QCoapToken &token);
+    void releaseSchedulerSlot(const QCoapToken &token);
+    void releaseSchedulerSlot(const QHostAddress &host);
+    void startQueuedRequests();
+    void sendRequest(QCoapInternalRequest *request, const QCoapEndpoint &endpoint = QCoapEndpoint());
+    void setInitialTimeout(QCoapInternalRequest *request);
+    uint blockSizeFor(const QHostAddress &host) const;
+    bool reduceRequestedBlockSize(QCoapInternalRequest *request);
+    static uint requestedBlockSize(const QCoapInternalRequest *request);
+    void transmit(const QCoapInternalRequest *request,
+                  const QCoapEndpoint &endpoint = QCoapEndpoint()) const;
+
+    bool isBlockStreamed(const QCoapInternalRequest *request,
+                         const QCoapInternalReply *reply) const;
+    bool isExpectedStreamedBlock(const QCoapToken &token, const QCoapInternalReply *reply) const;
+    bool hasMoreBlocksToRequest(const QCoapToken &token, const QCoapInternalReply *reply) const;
+    void streamBlock(QCoapInternalRequest *request, QCoapInternalReply *reply);
 
     void onLastMessageReceived(QCoapInternalRequest *request, const QHostAddress &sender);
     void onRequestError(QCoapInternalRequest *request, QCoapInternalReply *reply);
@@ -134,20 +256,34 @@ public:
     void onRequestTimeout(QCoapInternalRequest *request);
     void onRequestMaxTransmissionSpanReached(QCoapInternalRequest *request);
     void onMulticastRequestExpired(QCoapInternalRequest *request);
+    void processExpiredDeadlines();
+    void updateDeadlineTimer();
     void onFrameReceived(const QByteArray &data, const QHostAddress &sender);
     void onConnectionError(QAbstractSocket::SocketError error);
+    void onConnectionLost(QCoapConnection *connection, const QCoapEndpoint &endpoint,
+                          QAbstractSocket::SocketError error);
     void onRequestAborted(const QCoapToken &token);
+    void onCallbackExchangeCancelled(const QSharedPointer<QCoapCallbackExchange> &exchange);
 
-    bool isMessageIdRegistered(quint16 id) const;
+    bool isMessageIdRegistered(const QHostAddress &host, quint16 id) const;
     bool isTokenRegistered(const QCoapToken &token) const;
     bool isRequestRegistered(const QCoapInternalRequest *request) const;
 
     QCoapInternalRequest *requestForToken(const QCoapToken &token) const;
     QPointer<QCoapReply> userReplyForToken(const QCoapToken &token) const;
+    bool isExchangeAbandoned(const QCoapToken &token) const;
+    QCoapReplyCompletion *completionForToken(const QCoapToken &token) const;
     QVector<QSharedPointer<QCoapInternalReply>> repliesForToken(const QCoapToken &token) const;
     QCoapInternalReply *lastReplyForToken(const QCoapToken &token) const;
-    QCoapInternalRequest *findRequestByMessageId(quint16 messageId) const;
+    QCoapInternalRequest *findRequestByMessageId(const QHostAddress &sender,
+                                                 quint16 messageId) const;
     QCoapInternalRequest *findRequestByUserReply(const QCoapReply *reply) const;
+    QVector<QCoapToken> findTokensByUrl(const QUrl &url) const;
+
+    void setMessageId(QCoapInternalRequest *request, const QHostAddress &host,
+                      quint16 messageId);
+    static QUrl normalizedUrl(const QUrl &url);
+    static CoapMessageIdKey messageIdKey(const QHostAddress &host, quint16 messageId);
 
     void registerExchange(const QCoapToken &token, QCoapReply *reply,
                           QSharedPointer<QCoapInternalRequest> request);
@@ -156,7 +292,38 @@ public:
     bool forgetExchange(const QCoapInternalRequest *request);
     bool forgetExchangeReplies(const QCoapToken &token);
 
+    bool acceptNotification(const QCoapToken &token,
+                            const QVector<QSharedPointer<QCoapInternalReply>> &replies);
+    static bool isNotificationFresher(quint32 previousSequence, qint64 previousTime,
+                                      quint32 sequence, qint64 time);
+
+    void deliver(QCoapReplyCompletion *completion) const;
+
+    // Requests submitted from any thread, sent by the thread of the protocol
+    QCoapLockFreeQueue<QCoapRequestSubmission> submissions;
+
     CoapExchangeMap exchangeMap;
+    QHash<CoapMessageIdKey, QCoapToken> messageIdIndex;
+    QHash<const QCoapInternalRequest *, QCoapToken> requestIndex;
+    QHash<const QCoapReply *, QCoapToken> userReplyIndex;
+    QHash<const QCoapCallbackExchange *, QCoapToken> callbackExchangeIndex;
+    QMultiHash<QUrl, QCoapToken> urlIndex;
+    QCoapMessageIdAllocator messageIdAllocator;
+    QCoapTokenGenerator tokenGenerator;
+    QCoapRttEstimator rttEstimator;
+    QCoapBlockSizeController blockSizeController;
+    QCoapRequestScheduler scheduler;
+    QVector<QHostAddress> endpointsToDrain;
+    bool drainPending = false;
+    QElapsedTimer clock;
+    QCoapTimerWheel timerWheel;
+    QBasicTimer deadlineTimer;
+    qint64 deadlineTimerExpiry = -1;
+
+    // Delivers the updates of the replies to the thread of the client,
+    // owned by the client
+    QCoapReplyDispatcher *replyDispatcher = nullptr;
+
     quint16 blockSize = 0;
 
     uint maximumRetransmitCount = 4;
@@ -164,6 +331,8 @@ public:
     uint maximumServerResponseDelay = 250 * 1000;
     int minimumTokenSize = 4;
     double ackRandomFactor = 1.5;
+    bool adaptiveTimeout = false;
+    bool adaptiveBlockSize = false;
 
     Q_DECLARE_PUBLIC(QCoapProtocol)
 };
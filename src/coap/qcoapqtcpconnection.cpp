@@ -0,0 +1,704 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapqtcpconnection_p.h"
+#include "qcoappduview_p.h"
+
+#include <QtCore/qendian.h>
+#include <QtCore/qloggingcategory.h>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(lcCoapConnection)
+
+namespace {
+
+// Option numbers of the CSM signaling message, RFC 8323 - Section 5.3
+const quint16 MaxMessageSizeOption = 2;
+const quint16 BlockWiseTransferOption = 4;
+
+// Room left for the header, token and options of a message carrying a BERT block
+const quint32 BertMessageOverhead = 64;
+const quint32 MaximumBertBlockSize = 64 * 1024;
+
+// Size of the Len/TKL byte and of the extended length following it
+int tcpHeaderSize(quint8 firstByte)
+{
+    switch (firstByte >> 4) {
+    case 13:
+        return 2;
+    case 14:
+        return 3;
+    case 15:
+        return 5;
+    default:
+        return 1;
+    }
+}
+
+}
+
+/*!
+    \internal
+
+    \class QCoapQTcpConnection
+    \inmodule QtCoap
+
+    \brief The QCoapQTcpConnection class handles the transfer of frames to
+    and from a server over TCP.
+
+    \reentrant
+
+    The QCoapQTcpConnection class implements the reliable transport defined
+    in \l{https://tools.ietf.org/html/rfc8323}{RFC 8323}. It opens one TCP
+    connection per server, on the first frame sent to it, and starts each
+    connection with a Capabilities and Settings Message (CSM).
+
+    Frames are written and emitted with the readyRead() signal in the encoding
+    of RFC 7252, and converted to and from the TCP framing, that has neither
+    message type nor message ID. Responses are thus seen by the protocol as
+    non-confirmable messages, matched by their token. Empty messages, i.e.
+    acknowledgments and resets, have no meaning over TCP and are dropped.
+
+    Once the server advertised support for block-wise transfers with BERT
+    in its CSM, bertBlockSize() returns the size of the BERT blocks fitting
+    in its maximum message size.
+
+    \sa QCoapQUdpConnection
+*/
+
+/*!
+    \internal
+
+    \enum QCoapQTcpConnection::SignalingCode
+
+    This enum specifies the codes of the signaling messages of
+    \l{https://tools.ietf.org/html/rfc8323#section-5}{RFC 8323 - Section 5}.
+
+    \value CapabilitiesAndSettings  7.01 CSM
+    \value Ping                     7.02 Ping
+    \value Pong                     7.03 Pong
+    \value Release                  7.04 Release
+    \value Abort                    7.05 Abort
+*/
+
+/*!
+    \internal
+
+    \fn void QCoapQTcpConnection::pong(const QString &host, quint16 port)
+
+    This signal is emitted when the server at \a host and \a port answers
+    a ping().
+*/
+
+/*!
+    \internal
+
+    \fn void QCoapQTcpConnection::capabilitiesReceived(const QString &host, quint16 port)
+
+    This signal is emitted when the server at \a host and \a port sends its
+    Capabilities and Settings Message.
+*/
+
+/*!
+    Constructs a new QCoapQTcpConnection and sets \a parent as the parent
+    object.
+*/
+QCoapQTcpConnection::QCoapQTcpConnection(QObject *parent) :
+    QCoapConnection(*new QCoapQTcpConnectionPrivate, parent)
+{
+}
+
+/*!
+    \internal
+
+    Destroys the QCoapQTcpConnection and closes its connections.
+*/
+QCoapQTcpConnection::~QCoapQTcpConnection()
+{
+    close();
+}
+
+/*!
+    \internal
+
+    Returns the socket connected to \a host and \a port, or \c nullptr if no
+    connection to this server was opened.
+*/
+QTcpSocket *QCoapQTcpConnection::socket(const QString &host, quint16 port) const
+{
+    Q_D(const QCoapQTcpConnection);
+    const CoapTcpPeer *peer = d->findPeer(QCoapEndpoint::fromHost(host, port));
+    return peer ? peer->socket.data() : nullptr;
+}
+
+/*!
+    \internal
+
+    Returns the size of the largest message accepted from the servers, as
+    advertised in the CSM.
+*/
+quint32 QCoapQTcpConnection::maximumMessageSize() const
+{
+    Q_D(const QCoapQTcpConnection);
+    return d->maximumMessageSize;
+}
+
+/*!
+    \internal
+
+    Returns the size of the largest message accepted by the server at \a host
+    and \a port. It is 1152 bytes until the server tells otherwise.
+*/
+quint32 QCoapQTcpConnection::peerMaximumMessageSize(const QString &host, quint16 port) const
+{
+    Q_D(const QCoapQTcpConnection);
+    const CoapTcpPeer *peer = d->findPeer(QCoapEndpoint::fromHost(host, port));
+    return peer ? peer->maximumMessageSize : CoapTcpPeer().maximumMessageSize;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the server at \a host and \a port advertised support
+    for BERT blocks.
+*/
+bool QCoapQTcpConnection::isPeerBertSupported(const QString &host, quint16 port) const
+{
+    Q_D(const QCoapQTcpConnection);
+    const CoapTcpPeer *peer = d->findPeer(QCoapEndpoint::fromHost(host, port));
+    return peer && peer->bertSupported;
+}
+
+/*!
+    \internal
+
+    Sends a Ping signaling message to the server at \a host and \a port,
+    opening the connection if needed. The pong() signal is emitted when the
+    server answers.
+*/
+void QCoapQTcpConnection::ping(const QString &host, quint16 port)
+{
+    Q_D(QCoapQTcpConnection);
+
+    CoapTcpPeer *peer = d->connectToPeer(QCoapEndpoint::fromHost(host, port));
+    if (peer)
+        d->sendSignal(peer, Ping, QByteArray());
+}
+
+/*!
+    \internal
+
+    There is nothing to bind before connecting to a server, the connection
+    is opened by the first frame sent to it. Emits the bound() signal.
+*/
+void QCoapQTcpConnection::bind(const QCoapEndpoint &endpoint)
+{
+    Q_UNUSED(endpoint);
+
+    emit bound();
+}
+
+/*!
+    \internal
+
+    Sends the given \a data frame to the \a endpoint, opening
+    the connection to it if needed. The frame is queued until the connection
+    is established.
+*/
+void QCoapQTcpConnection::writeData(const QByteArray &data, const QCoapEndpoint &endpoint)
+{
+    Q_D(QCoapQTcpConnection);
+
+    // Empty messages only acknowledge or reset messages over UDP
+    if (data.size() < 4 || data.at(1) == 0)
+        return;
+
+    const QByteArray frame = toTcpFrame(data);
+    if (frame.isEmpty()) {
+        qCWarning(lcCoapConnection, "Cannot convert an invalid frame for TCP");
+        return;
+    }
+
+    CoapTcpPeer *peer = d->connectToPeer(endpoint);
+    if (peer)
+        d->writeFrame(peer, frame);
+}
+
+/*!
+    \internal
+
+    Sends a Release message to the connected servers and closes all the
+    connections.
+*/
+void QCoapQTcpConnection::close()
+{
+    Q_D(QCoapQTcpConnection);
+
+    const auto endpoints = d->peers.keys();
+    for (const QCoapEndpoint &endpoint : endpoints) {
+        CoapTcpPeer &peer = d->peers[endpoint];
+        if (peer.socket && peer.socket->state() == QAbstractSocket::ConnectedState)
+            d->sendSignal(&peer, Release, QByteArray());
+        d->removePeer(endpoint, false);
+    }
+}
+
+/*!
+    \internal
+
+    Returns the size of the BERT blocks exchanged with the server at
+    \a endpoint, or \c 0 if it does not support them. The size is the largest
+    multiple of 1024 bytes fitting in the messages accepted by the server, up
+    to 64 KiB.
+*/
+uint QCoapQTcpConnection::bertBlockSize(const QCoapEndpoint &endpoint) const
+{
+    Q_D(const QCoapQTcpConnection);
+
+    const CoapTcpPeer *peer = d->findPeer(endpoint);
+    if (!peer || !peer->bertSupported || peer->maximumMessageSize <= BertMessageOverhead)
+        return 0;
+
+    const quint32 size = qMin((peer->maximumMessageSize - BertMessageOverhead) / 1024 * 1024,
+                              MaximumBertBlockSize);
+
+    // A single block of 1024 bytes is a regular block
+    return size >= 2 * 1024 ? size : 0;
+}
+
+/*!
+    \internal
+
+    Returns the size of the TCP frame starting at the offset \a from in
+    \a buffer, \c 0 if the buffer does not contain its whole header yet, or
+    \c -1 if the frame is invalid.
+*/
+qint64 QCoapQTcpConnection::tcpFrameSize(const QByteArray &buffer, int from)
+{
+    if (buffer.size() <= from)
+        return 0;
+
+    const auto *data = reinterpret_cast<const uchar *>(buffer.constData()) + from;
+    const int available = buffer.size() - from;
+    const int tokenLength = data[0] & 0x0F;
+    if (tokenLength > 8)
+        return -1;
+
+    const int headerSize = tcpHeaderSize(data[0]);
+    if (available < headerSize)
+        return 0;
+
+    qint64 length = data[0] >> 4;
+    switch (headerSize) {
+    case 2:
+        length = data[1] + 13;
+        break;
+    case 3:
+        length = qFromBigEndian<quint16>(data + 1) + 269;
+        break;
+    case 5:
+        length = qint64(qFromBigEndian<quint32>(data + 1)) + 65805;
+        break;
+    default:
+        break;
+    }
+
+    // Header, extended length, code, token, then options and payload
+    return headerSize + 1 + tokenLength + length;
+}
+
+/*!
+    \internal
+
+    Converts the \a frame, encoded as defined in
+    \l{https://tools.ietf.org/html/rfc7252#section-3}{RFC 7252 - Section 3},
+    to the framing of \l{https://tools.ietf.org/html/rfc8323#section-3.2}
+    {RFC 8323 - Section 3.2}. Returns an empty byte array if \a frame is
+    invalid.
+*/
+QByteArray QCoapQTcpConnection::toTcpFrame(const QByteArray &frame)
+{
+    if (frame.size() < 4)
+        return QByteArray();
+
+    const int tokenLength = frame.at(0) & 0x0F;
+    const int length = frame.size() - 4 - tokenLength;
+    if (tokenLength > 8 || length < 0)
+        return QByteArray();
+
+    QByteArray tcpFrame;
+    tcpFrame.reserve(frame.size() + 4);
+    if (length < 13) {
+        tcpFrame.append(static_cast<char>((length << 4) | tokenLength));
+    } else if (length < 269) {
+        tcpFrame.append(static_cast<char>((13 << 4) | tokenLength));
+        tcpFrame.append(static_cast<char>(length - 13));
+    } else if (length < 65805) {
+        tcpFrame.append(static_cast<char>((14 << 4) | tokenLength));
+        tcpFrame.append(static_cast<char>((length - 269) >> 8));
+        tcpFrame.append(static_cast<char>((length - 269) & 0xFF));
+    } else {
+        char extended[4];
+        qToBigEndian<quint32>(static_cast<quint32>(length - 65805), extended);
+        tcpFrame.append(static_cast<char>((15 << 4) | tokenLength));
+        tcpFrame.append(extended, 4);
+    }
+
+    // Code, token, options and payload
+    tcpFrame.append(frame.constData() + 1, 1);
+    tcpFrame.append(frame.constData() + 4, frame.size() - 4);
+    return tcpFrame;
+}
+
+/*!
+    \internal
+
+    Converts the TCP \a frame to the encoding of RFC 7252, as a
+    non-confirmable message with the message ID \c 0. Returns an empty byte
+    array if \a frame is invalid or truncated.
+*/
+QByteArray QCoapQTcpConnection::fromTcpFrame(const QByteArray &frame)
+{
+    const qint64 size = tcpFrameSize(frame);
+    if (size <= 0 || size != frame.size())
+        return QByteArray();
+
+    const int tokenLength = frame.at(0) & 0x0F;
+    const int headerSize = tcpHeaderSize(static_cast<quint8>(frame.at(0)));
+
+    QByteArray udpFrame;
+    udpFrame.reserve(frame.size() - headerSize + 4);
+    udpFrame.append(static_cast<char>(0x50 | tokenLength));
+    udpFrame.append(frame.at(headerSize));
+    udpFrame.append(2, '\0');
+    udpFrame.append(frame.constData() + headerSize + 1, frame.size() - headerSize - 1);
+    return udpFrame;
+}
+
+QCoapQTcpConnectionPrivate::QCoapQTcpConnectionPrivate()
+    : QCoapConnectionPrivate(QtCoap::SecurityMode::NoSecurity)
+{
+    reliable = true;
+}
+
+/*!
+    \internal
+
+    Returns the connection to \a endpoint, or \c nullptr if there is none.
+*/
+CoapTcpPeer *QCoapQTcpConnectionPrivate::findPeer(const QCoapEndpoint &endpoint) const
+{
+    const auto it = peers.constFind(endpoint);
+    return it != peers.constEnd() ? const_cast<CoapTcpPeer *>(&it.value()) : nullptr;
+}
+
+/*!
+    \internal
+
+    Returns the connection to \a endpoint, and starts to connect if there
+    is none. Returns \c nullptr if the endpoint has no IP address.
+
+    The returned pointer is only valid until the connections are modified.
+*/
+CoapTcpPeer *QCoapQTcpConnectionPrivate::connectToPeer(const QCoapEndpoint &endpoint)
+{
+    Q_Q(QCoapQTcpConnection);
+
+    if (CoapTcpPeer *peer = findPeer(endpoint))
+        return peer;
+
+    if (endpoint.isNull()) {
+        qCWarning(lcCoapConnection) << "Invalid host IP address" << endpoint.host()
+                                    << "- only IPv4/IPv6 destination addresses are supported.";
+        return nullptr;
+    }
+
+    CoapTcpPeer &peer = peers[endpoint];
+    peer.endpoint = endpoint;
+    peer.socket = new QTcpSocket(q);
+    peer.socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    QObject::connect(peer.socket.data(), &QTcpSocket::connected, q, [this, endpoint]() {
+        onConnected(endpoint);
+    });
+    QObject::connect(peer.socket.data(), &QTcpSocket::readyRead, q, [this, endpoint]() {
+        onReadyRead(endpoint);
+    });
+    QObject::connect(peer.socket.data(), &QTcpSocket::errorOccurred, q,
+                     [this, endpoint](QAbstractSocket::SocketError socketError) {
+        onSocketError(endpoint, socketError);
+    });
+
+    peer.socket->connectToHost(endpoint.address(), endpoint.port());
+    return &peer;
+}
+
+/*!
+    \internal
+
+    Closes the connection to \a endpoint and forgets it. The
+    connection is aborted if \a abort is \c true, otherwise the frames
+    already written are sent first.
+*/
+void QCoapQTcpConnectionPrivate::removePeer(const QCoapEndpoint &endpoint, bool abort)
+{
+    const auto it = peers.find(endpoint);
+    if (it == peers.end())
+        return;
+
+    QPointer<QTcpSocket> socket = it->socket;
+    peers.erase(it);
+
+    if (socket) {
+        socket->disconnect();
+        if (abort)
+            socket->abort();
+        else
+            socket->disconnectFromHost();
+        socket->deleteLater();
+    }
+}
+
+/*!
+    \internal
+
+    Sends the CSM message, that must be the first message of the connection
+    to \a endpoint, then the frames queued while connecting.
+*/
+void QCoapQTcpConnectionPrivate::onConnected(const QCoapEndpoint &endpoint)
+{
+    const auto it = peers.find(endpoint);
+    if (it == peers.end())
+        return;
+
+    CoapTcpPeer *peer = &it.value();
+
+    // Max-Message-Size and an empty Block-Wise-Transfer option, telling
+    // that BERT blocks are supported
+    char size[4];
+    qToBigEndian<quint32>(maximumMessageSize, size);
+    int offset = 0;
+    while (offset < 3 && size[offset] == 0)
+        ++offset;
+
+    QByteArray options;
+    options.append(static_cast<char>((MaxMessageSizeOption << 4) | (4 - offset)));
+    options.append(size + offset, 4 - offset);
+    options.append(static_cast<char>((BlockWiseTransferOption - MaxMessageSizeOption) << 4));
+
+    const QVector<QByteArray> pendingFrames = peer->pendingFrames;
+    peer->pendingFrames.clear();
+
+    sendSignal(peer, QCoapQTcpConnection::CapabilitiesAndSettings, QByteArray(), options);
+    for (const QByteArray &frame : pendingFrames)
+        peer->socket->write(frame);
+}
+
+/*!
+    \internal
+
+    Reads the data received on the connection to \a endpoint and processes
+    each complete frame.
+*/
+void QCoapQTcpConnectionPrivate::onReadyRead(const QCoapEndpoint &endpoint)
+{
+    Q_Q(QCoapQTcpConnection);
+
+    const auto it = peers.find(endpoint);
+    if (it == peers.end() || !it->socket)
+        return;
+
+    CoapTcpPeer *peer = &it.value();
+    peer->readBuffer.append(peer->socket->readAll());
+
+    QVector<QByteArray> frames;
+    int offset = 0;
+    forever {
+        const qint64 size = QCoapQTcpConnection::tcpFrameSize(peer->readBuffer, offset);
+        if (size < 0 || size > maximumMessageSize) {
+            qCWarning(lcCoapConnection) << "Invalid or oversized frame received from"
+                                        << endpoint.host() << "- aborting the connection";
+            sendSignal(peer, QCoapQTcpConnection::Abort, QByteArray());
+            peer->socket->flush();
+            removePeer(endpoint, true);
+            emit q->connectionLost(endpoint, QAbstractSocket::UnknownSocketError);
+            return;
+        }
+
+        if (size == 0 || peer->readBuffer.size() - offset < size)
+            break;
+
+        frames.append(peer->readBuffer.mid(offset, static_cast<int>(size)));
+        offset += static_cast<int>(size);
+    }
+    peer->readBuffer.remove(0, offset);
+
+    // The connection may be modified while the frames are processed
+    for (const QByteArray &frame : qAsConst(frames))
+        processFrame(endpoint, frame);
+}
+
+/*!
+    \internal
+
+    Forgets the connection to \a endpoint after the \a socketError and
+    emits the connectionLost() and error() signals.
+*/
+void QCoapQTcpConnectionPrivate::onSocketError(const QCoapEndpoint &endpoint,
+                                               QAbstractSocket::SocketError socketError)
+{
+    Q_Q(QCoapQTcpConnection);
+
+    const auto it = peers.constFind(endpoint);
+    if (it == peers.constEnd())
+        return;
+
+    qCWarning(lcCoapConnection) << "CoAP TCP socket error" << socketError
+                                << (it->socket ? it->socket->errorString() : QString());
+    removePeer(endpoint, true);
+    emit q->connectionLost(endpoint, socketError);
+    emit q->error(socketError);
+}
+
+/*!
+    \internal
+
+    Processes the complete TCP \a frame received on the connection to
+    \a endpoint. Signaling messages are handled here, other messages are
+    converted and emitted with the readyRead() signal.
+*/
+void QCoapQTcpConnectionPrivate::processFrame(const QCoapEndpoint &endpoint,
+                                              const QByteArray &frame)
+{
+    Q_Q(QCoapQTcpConnection);
+
+    const auto it = peers.find(endpoint);
+    if (it == peers.end() || !it->socket)
+        return;
+
+    CoapTcpPeer *peer = &it.value();
+    const QByteArray udpFrame = QCoapQTcpConnection::fromTcpFrame(frame);
+    if (udpFrame.isEmpty())
+        return;
+
+    const quint8 code = static_cast<quint8>(udpFrame.at(1));
+    if ((code >> 5) != 7) {
+        emit q->readyRead(udpFrame, endpoint.address());
+        return;
+    }
+
+    const QString host = endpoint.host();
+    const quint16 port = endpoint.port();
+    switch (code) {
+    case QCoapQTcpConnection::CapabilitiesAndSettings:
+        processCapabilities(peer, udpFrame);
+        emit q->capabilitiesReceived(host, port);
+        break;
+    case QCoapQTcpConnection::Ping:
+        sendSignal(peer, QCoapQTcpConnection::Pong, QCoapPduView(udpFrame).token());
+        break;
+    case QCoapQTcpConnection::Pong:
+        emit q->pong(host, port);
+        break;
+    case QCoapQTcpConnection::Release:
+        removePeer(endpoint, false);
+        emit q->connectionLost(endpoint, QAbstractSocket::RemoteHostClosedError);
+        break;
+    case QCoapQTcpConnection::Abort:
+        qCWarning(lcCoapConnection) << "Connection aborted by" << host;
+        removePeer(endpoint, true);
+        emit q->connectionLost(endpoint, QAbstractSocket::RemoteHostClosedError);
+        emit q->error(QAbstractSocket::RemoteHostClosedError);
+        break;
+    default:
+        break;
+    }
+}
+
+/*!
+    \internal
+
+    Reads the settings of \a peer from its CSM \a frame, converted to the
+    encoding of RFC 7252.
+*/
+void QCoapQTcpConnectionPrivate::processCapabilities(CoapTcpPeer *peer, const QByteArray &frame)
+{
+    const QCoapPduView pdu(frame);
+    if (!pdu.isValid())
+        return;
+
+    const int sizeIndex = pdu.indexOfOption(MaxMessageSizeOption);
+    if (sizeIndex >= 0) {
+        quint32 size = 0;
+        const QByteArray value = pdu.optionValue(sizeIndex);
+        for (const char byte : value)
+            size = (size << 8) | static_cast<quint8>(byte);
+        peer->maximumMessageSize = size;
+    }
+
+    if (pdu.indexOfOption(BlockWiseTransferOption) >= 0)
+        peer->bertSupported = true;
+}
+
+/*!
+    \internal
+
+    Sends to \a peer the signaling message with the given \a code, \a token
+    and encoded \a options.
+*/
+void QCoapQTcpConnectionPrivate::sendSignal(CoapTcpPeer *peer, quint8 code,
+                                            const QByteArray &token, const QByteArray &options)
+{
+    QByteArray frame;
+    frame.reserve(4 + token.size() + options.size());
+    frame.append(static_cast<char>(0x50 | token.size()));
+    frame.append(static_cast<char>(code));
+    frame.append(2, '\0');
+    frame.append(token);
+    frame.append(options);
+
+    writeFrame(peer, QCoapQTcpConnection::toTcpFrame(frame));
+}
+
+/*!
+    \internal
+
+    Writes the \a tcpFrame to \a peer, or queues it until the connection is
+    established.
+*/
+void QCoapQTcpConnectionPrivate::writeFrame(CoapTcpPeer *peer, const QByteArray &tcpFrame)
+{
+    if (peer->socket && peer->socket->state() == QAbstractSocket::ConnectedState)
+        peer->socket->write(tcpFrame);
+    else
+        peer->pendingFrames.append(tcpFrame);
+}
+
+QT_END_NAMESPACE
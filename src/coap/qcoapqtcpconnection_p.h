@@ -0,0 +1,133 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPQTCPCONNECTION_P_H
+#define QCOAPQTCPCONNECTION_P_H
+
+#include <private/qcoapconnection_p.h>
+
+#include <QtNetwork/qtcpsocket.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qvector.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QCoapQTcpConnectionPrivate;
+class Q_AUTOTEST_EXPORT QCoapQTcpConnection : public QCoapConnection
+{
+    Q_OBJECT
+
+public:
+    enum SignalingCode : quint8 {
+        CapabilitiesAndSettings = 0xE1,
+        Ping = 0xE2,
+        Pong = 0xE3,
+        Release = 0xE4,
+        Abort = 0xE5
+    };
+
+    explicit QCoapQTcpConnection(QObject *parent = nullptr);
+    ~QCoapQTcpConnection() override;
+
+    QTcpSocket *socket(const QString &host, quint16 port) const;
+    quint32 maximumMessageSize() const;
+    quint32 peerMaximumMessageSize(const QString &host, quint16 port) const;
+    bool isPeerBertSupported(const QString &host, quint16 port) const;
+
+    Q_INVOKABLE void ping(const QString &host, quint16 port);
+
+    static QByteArray toTcpFrame(const QByteArray &frame);
+    static QByteArray fromTcpFrame(const QByteArray &frame);
+    static qint64 tcpFrameSize(const QByteArray &buffer, int from = 0);
+
+Q_SIGNALS:
+    void pong(const QString &host, quint16 port);
+    void capabilitiesReceived(const QString &host, quint16 port);
+
+protected:
+    void bind(const QCoapEndpoint &endpoint) override;
+    void writeData(const QByteArray &data, const QCoapEndpoint &endpoint) override;
+    void close() override;
+    uint bertBlockSize(const QCoapEndpoint &endpoint) const override;
+
+    Q_DECLARE_PRIVATE(QCoapQTcpConnection)
+};
+
+struct CoapTcpPeer {
+    QPointer<QTcpSocket> socket;
+    QCoapEndpoint endpoint;
+
+    QByteArray readBuffer;
+    QVector<QByteArray> pendingFrames;
+
+    // Settings of the peer, as long as no CSM message tells otherwise
+    quint32 maximumMessageSize = 1152;
+    bool bertSupported = false;
+};
+
+class Q_AUTOTEST_EXPORT QCoapQTcpConnectionPrivate : public QCoapConnectionPrivate
+{
+public:
+    QCoapQTcpConnectionPrivate();
+
+    CoapTcpPeer *findPeer(const QCoapEndpoint &endpoint) const;
+    CoapTcpPeer *connectToPeer(const QCoapEndpoint &endpoint);
+    void removePeer(const QCoapEndpoint &endpoint, bool abort);
+
+    void onConnected(const QCoapEndpoint &endpoint);
+    void onReadyRead(const QCoapEndpoint &endpoint);
+    void onSocketError(const QCoapEndpoint &endpoint, QAbstractSocket::SocketError socketError);
+
+    void processFrame(const QCoapEndpoint &endpoint, const QByteArray &frame);
+    void processCapabilities(CoapTcpPeer *peer, const QByteArray &frame);
+    void sendSignal(CoapTcpPeer *peer, quint8 code, const QByteArray &token,
+                    const QByteArray &options = QByteArray());
+    void writeFrame(CoapTcpPeer *peer, const QByteArray &tcpFrame);
+
+    QHash<QCoapEndpoint, CoapTcpPeer> peers;
+    quint32 maximumMessageSize = 1024 * 1024;
+
+    Q_DECLARE_PUBLIC(QCoapQTcpConnection)
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPQTCPCONNECTION_P_H
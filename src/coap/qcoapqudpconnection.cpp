@@ -31,19 +31,73 @@
 #include "qcoapqudpconnection_p.h"
 
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qvarlengtharray.h>
 #include <QtNetwork/qnetworkdatagram.h>
 
+#if defined(Q_OS_LINUX)
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
 #if QT_CONFIG(dtls)
+#include <QtCore/QTimer>
 #include <QtNetwork/QDtls>
 #include <QtNetwork/QSslPreSharedKeyAuthenticator>
 #include <QtNetwork/QSslConfiguration>
 #include <QtNetwork/QSslKey>
+
+#include <algorithm>
 #endif
 
 QT_BEGIN_NAMESPACE
 
 Q_DECLARE_LOGGING_CATEGORY(lcCoapConnection)
 
+#if defined(Q_OS_LINUX)
+namespace {
+
+// Datagrams read or written with a single recvmmsg() or sendmmsg() call
+const int DatagramBatchSize = 16;
+
+// Largest UDP payload, so that no datagram is truncated when read in a batch
+const int MaximumDatagramSize = 65535;
+
+/*
+    Fills \a storage with the socket address of \a endpoint, in the IPv6
+    family if \a ipv6 is \c true, and returns its size. IPv4 addresses are
+    mapped to IPv6 for dual-stack sockets. Returns \c 0 for IPv6 addresses
+    on IPv4 sockets, whose datagrams are left to the regular path, which
+    reports the error.
+*/
+socklen_t toSocketAddress(const QCoapEndpoint &endpoint, bool ipv6, sockaddr_storage *storage)
+{
+    ::memset(storage, 0, sizeof(sockaddr_storage));
+
+    if (ipv6) {
+        auto *address6 = reinterpret_cast<sockaddr_in6 *>(storage);
+        address6->sin6_family = AF_INET6;
+        address6->sin6_port = htons(endpoint.port());
+        address6->sin6_scope_id = endpoint.scopeIndex();
+        const Q_IPV6ADDR bytes = endpoint.toIPv6Address();
+        ::memcpy(&address6->sin6_addr, bytes.c, sizeof(bytes.c));
+        return sizeof(sockaddr_in6);
+    }
+
+    if (!endpoint.isIPv4())
+        return 0;
+
+    auto *address4 = reinterpret_cast<sockaddr_in *>(storage);
+    address4->sin_family = AF_INET;
+    address4->sin_port = htons(endpoint.port());
+    address4->sin_addr.s_addr = htonl(endpoint.toIPv4Address());
+    return sizeof(sockaddr_in);
+}
+
+}
+#endif
+
 /*!
     \internal
 
@@ -62,9 +116,33 @@ Q_DECLARE_LOGGING_CATEGORY(lcCoapConnection)
     When a reply is available, the QCoapQUdpConnection object emits a readyRead()
     signal.
 
+    A secure connection keeps a DTLS session with each server, over the same
+    socket. The session is opened by the first frame sent to the server, which
+    waits for the handshake to complete, and the received datagrams are
+    dispatched to the sessions by their source address and port. The number
+    of sessions and the time they are kept idle are bounded by the
+    QCoapSecurityConfiguration.
+
+    The handshakeCompleted() signal reports the duration of each handshake.
+
+    On Linux, the datagrams of unsecure connections are read and written in
+    batches, with the recvmmsg() and sendmmsg() system calls. The frames
+    written during an event loop iteration are sent together once control
+    returns to the event loop.
+
     \sa QCoapClient
 */
 
+/*!
+    \internal
+    \fn void QCoapQUdpConnection::handshakeCompleted(const QHostAddress &address,
+                                                    quint16 port, qint64 duration)
+
+    This signal is emitted when the DTLS handshake with the server at
+    \a address and \a port completes, \a duration milliseconds after it
+    started.
+*/
+
 /*!
     Constructs a new QCoapQUdpConnection for the given \a securityMode and
     sets \a parent as the parent object.
@@ -100,7 +178,7 @@ QCoapQUdpConnection::QCoapQUdpConnection(QCoapQUdpConnectionPrivate &dd, QObject
                        d->setSecurityConfiguration(securityConfiguration());
                 });
 
-        auto configuration = QSslConfiguration::defaultDtlsConfiguration();
+        d->dtlsConfiguration = QSslConfiguration::defaultDtlsConfiguration();
 
         switch (d->securityMode) {
         case QtCoap::SecurityMode::RawPublicKey:
@@ -109,25 +187,21 @@ QCoapQUdpConnection::QCoapQUdpConnection(QCoapQUdpConnectionPrivate &dd, QObject
             d->securityMode = QtCoap::SecurityMode::NoSecurity;
             break;
         case QtCoap::SecurityMode::PreSharedKey:
-            d->dtls = new QDtls(QSslSocket::SslClientMode, this);
-            configuration.setPeerVerifyMode(QSslSocket::VerifyNone);
-            d->dtls->setDtlsConfiguration(configuration);
-
-            connect(d->dtls.data(), &QDtls::pskRequired, this, &QCoapQUdpConnection::pskRequired);
-            connect(d->dtls.data(), &QDtls::handshakeTimeout,
-                    this, &QCoapQUdpConnection::handshakeTimeout);
+            d->dtlsConfiguration.setPeerVerifyMode(QSslSocket::VerifyNone);
             break;
         case QtCoap::SecurityMode::Certificate:
-            d->dtls = new QDtls(QSslSocket::SslClientMode, this);
-            configuration.setPeerVerifyMode(QSslSocket::VerifyPeer);
-            d->dtls->setDtlsConfiguration(configuration);
-
-            connect(d->dtls.data(), &QDtls::handshakeTimeout,
-                    this, &QCoapQUdpConnection::handshakeTimeout);
+            d->dtlsConfiguration.setPeerVerifyMode(QSslSocket::VerifyPeer);
             break;
         default:
             break;
         }
+
+        d->sessionClock.start();
+        d->idleTimer = new QTimer(this);
+        connect(d->idleTimer, &QTimer::timeout, this, [this]() {
+            Q_D(QCoapQUdpConnection);
+            d->removeIdleSessions();
+        });
 #else
         qCWarning(lcCoapConnection, "DTLS is disabled, falling back to QtCoap::NoSecurity mode.");
         d->securityMode = QtCoap::SecurityMode::NoSecurity;
@@ -161,9 +235,6 @@ void QCoapQUdpConnection::createSocket()
 
 QCoapQUdpConnectionPrivate::QCoapQUdpConnectionPrivate(QtCoap::SecurityMode security)
     : QCoapConnectionPrivate(security)
-#if QT_CONFIG(dtls)
-    , dtls(nullptr)
-#endif
     , udpSocket(nullptr)
 {
 }
@@ -171,9 +242,11 @@ QCoapQUdpConnectionPrivate::QCoapQUdpConnectionPrivate(QtCoap::SecurityMode secu
 QCoapQUdpConnectionPrivate::~QCoapQUdpConnectionPrivate()
 {
 #if QT_CONFIG(dtls)
-    if (dtls && dtls->isConnectionEncrypted()) {
-        Q_ASSERT(udpSocket);
-        dtls->shutdown(udpSocket);
+    for (const CoapDtlsSession &session : qAsConst(dtlsSessions)) {
+        if (session.dtls && session.dtls->isConnectionEncrypted()) {
+            Q_ASSERT(udpSocket);
+            session.dtls->shutdown(udpSocket);
+        }
     }
 #endif
 }
@@ -205,44 +278,48 @@ void QCoapQUdpConnectionPrivate::bindSocket()
 /*!
     \internal
 
-    Prepares the socket for data transmission to the given \a host and
-    \a port by binding the socket. In case of a secure connection also
-    starts the handshake with the server.
-    Emits the bound() signal when the transport is ready.
+    Prepares the socket for data transmission to the given \a endpoint
+    by binding the socket.
+    Emits the bound() signal when the transport is ready. In case of a secure
+    connection, the handshake with each server is started by the first frame
+    written to it.
 */
-void QCoapQUdpConnection::bind(const QString &host, quint16 port)
+void QCoapQUdpConnection::bind(const QCoapEndpoint &endpoint)
 {
     Q_D(QCoapQUdpConnection);
+    Q_UNUSED(endpoint);
 
     if (!isSecure()) {
         d->bindSocket();
-#if QT_CONFIG(dtls)
-    } else {
-        Q_ASSERT(d->dtls);
-        if (d->dtls->isConnectionEncrypted()) {
-            emit bound();
-        } else if (socket()->state() == QAbstractSocket::UnconnectedState) {
-            socket()->bind();
-            d->dtls->setPeer(QHostAddress(host), port);
-            if (!d->dtls->doHandshake(d->socket()))
-                qCWarning(lcCoapConnection) << "Handshake error: " << d->dtls->dtlsErrorString();
-        }
-#else
-        Q_UNUSED(host);
-        Q_UNUSED(port);
-#endif
+    } else if (socket()->state() != QAbstractSocket::UnconnectedState || socket()->bind()) {
+        emit bound();
     }
 }
 
 /*!
     \internal
 
-    Sends the given \a data frame to the \a host at the \a port.
+    Sends the given \a data frame to the \a endpoint.
+    On Linux, the frame is queued to be sent in a batch. In case of a secure
+    connection, the frame is sent through the DTLS session with the server.
 */
-void QCoapQUdpConnection::writeData(const QByteArray &data, const QString &host, quint16 port)
+void QCoapQUdpConnection::writeData(const QByteArray &data, const QCoapEndpoint &endpoint)
 {
     Q_D(QCoapQUdpConnection);
-    d->writeToSocket(data, host, port);
+
+#if QT_CONFIG(dtls)
+    if (isSecure()) {
+        d->writeToSession(data, endpoint);
+        return;
+    }
+#endif
+#if defined(Q_OS_LINUX)
+    if (d->datagramBatching && !isSecure()) {
+        d->queueDatagram(data, endpoint);
+        return;
+    }
+#endif
+    d->writeToSocket(data, endpoint);
 }
 
 /*!
@@ -250,20 +327,23 @@ void QCoapQUdpConnection::writeData(const QByteArray &data, const QString &host,
 
     \brief Close the UDP socket
 
+    The datagrams waiting to be sent in a batch are written first.
     In the case of a secure connection, this also interrupts any ongoing
-    hand-shake and shuts down the DTLS connection.
+    hand-shake and shuts down the DTLS sessions.
 */
 void QCoapQUdpConnection::close()
 {
     Q_D(QCoapQUdpConnection);
 
+#if defined(Q_OS_LINUX)
+    d->flushDatagrams();
+#endif
+
 #if QT_CONFIG(dtls)
     if (isSecure()) {
-        if (d->dtls->handshakeState() == QDtls::HandshakeInProgress)
-            d->dtls->abortHandshake(d->socket());
-
-        if (d->dtls->isConnectionEncrypted())
-            d->dtls->shutdown(d->socket());
+        const auto endpoints = d->dtlsSessions.keys();
+        for (const QCoapEndpoint &endpoint : endpoints)
+            d->removeSession(endpoint);
     }
 #endif
     d->socket()->close();
@@ -283,12 +363,11 @@ void QCoapQUdpConnection::setSocketOption(QAbstractSocket::SocketOption option,
 /*!
     \internal
 
-    Sends the given \a data frame to the \a host at the \a port.
+    Sends the given \a data frame to the \a endpoint.
 */
-void QCoapQUdpConnectionPrivate::writeToSocket(const QByteArray &data, const QString &host, quint16 port)
+void QCoapQUdpConnectionPrivate::writeToSocket(const QByteArray &data,
+                                               const QCoapEndpoint &endpoint)
 {
-    Q_Q(QCoapQUdpConnection);
-
     if (!socket()->isWritable()) {
         bool opened = socket()->open(socket()->openMode() | QIODevice::WriteOnly);
         if (!opened) {
@@ -297,19 +376,14 @@ void QCoapQUdpConnectionPrivate::writeToSocket(const QByteArray &data, const QSt
         }
     }
 
-    QHostAddress hostAddress(host);
-    if (hostAddress.isNull()) {
-        qCWarning(lcCoapConnection) << "Invalid host IP address" << host
+    if (endpoint.isNull()) {
+        qCWarning(lcCoapConnection) << "Invalid host IP address" << endpoint.host()
                                     << "- only IPv4/IPv6 destination addresses are supported.";
         return;
     }
 
-    const qint64 bytesWritten =
-#if QT_CONFIG(dtls)
-            q->isSecure() ? (Q_ASSERT(dtls), dtls->writeDatagramEncrypted(socket(), data)) :
-#endif
-            socket()->writeDatagram(data, hostAddress, port);
-
+    const qint64 bytesWritten = socket()->writeDatagram(data, endpoint.address(),
+                                                        endpoint.port());
     if (bytesWritten < 0)
         qCWarning(lcCoapConnection) << "Failed to write datagram:" << socket()->errorString();
 }
@@ -336,6 +410,12 @@ void QCoapQUdpConnectionPrivate::socketReadyRead()
         if (!q->isSecure()) {
             const auto &datagram = socket()->receiveDatagram();
             emit q->readyRead(datagram.data(), datagram.senderAddress());
+#if defined(Q_OS_LINUX)
+            // Reading the first datagram through the socket re-enables its read
+            // notifier, the following ones are read in batches
+            if (datagramBatching)
+                receiveDatagramBatches();
+#endif
 #if QT_CONFIG(dtls)
         } else {
             handleEncryptedDatagram();
@@ -344,6 +424,175 @@ void QCoapQUdpConnectionPrivate::socketReadyRead()
     }
 }
 
+#if defined(Q_OS_LINUX)
+/*!
+    \internal
+
+    Queues the \a data frame for the \a endpoint, to be written
+    with the other frames sent during the same event loop iteration by
+    flushDatagrams().
+*/
+void QCoapQUdpConnectionPrivate::queueDatagram(const QByteArray &data,
+                                               const QCoapEndpoint &endpoint)
+{
+    Q_Q(QCoapQUdpConnection);
+
+    // Invalid hosts are reported by the regular path
+    if (endpoint.isNull()) {
+        writeToSocket(data, endpoint);
+        return;
+    }
+
+    datagramsToSend.append(CoapFrame(data, endpoint));
+    if (datagramsToSend.size() >= DatagramBatchSize) {
+        flushDatagrams();
+    } else if (!flushScheduled) {
+        flushScheduled = true;
+        QMetaObject::invokeMethod(q, [this]() {
+            flushScheduled = false;
+            flushDatagrams();
+        }, Qt::QueuedConnection);
+    }
+}
+
+/*!
+    \internal
+
+    Writes the queued datagrams with as few sendmmsg() calls as possible.
+    The datagrams without socket address for the socket, or not accepted by
+    the kernel, are written one by one, so that errors are reported as for a
+    single datagram.
+*/
+void QCoapQUdpConnectionPrivate::flushDatagrams()
+{
+    if (datagramsToSend.isEmpty())
+        return;
+
+    const QVector<CoapFrame> frames = datagramsToSend;
+    datagramsToSend.clear();
+
+    QVarLengthArray<bool, DatagramBatchSize> isSent(frames.size());
+    ::memset(isSent.data(), 0, static_cast<size_t>(isSent.size()) * sizeof(bool));
+
+    const qintptr descriptor = socket() ? socket()->socketDescriptor() : -1;
+    sockaddr_storage local;
+    socklen_t localLength = sizeof(local);
+    if (descriptor >= 0 && ::getsockname(static_cast<int>(descriptor),
+                                         reinterpret_cast<sockaddr *>(&local),
+                                         &localLength) == 0) {
+        const bool ipv6 = local.ss_family == AF_INET6;
+
+        mmsghdr messages[DatagramBatchSize];
+        iovec vectors[DatagramBatchSize];
+        sockaddr_storage targets[DatagramBatchSize];
+        int batch[DatagramBatchSize];
+
+        int next = 0;
+        while (next < frames.size()) {
+            int count = 0;
+            ::memset(messages, 0, sizeof(messages));
+            for (; next < frames.size() && count < DatagramBatchSize; ++next) {
+                const CoapFrame &frame = frames.at(next);
+                const socklen_t targetLength = toSocketAddress(frame.endpoint, ipv6,
+                                                               &targets[count]);
+                // Sending without address would fail, or reach the wrong host
+                if (targetLength == 0)
+                    continue;
+
+                vectors[count].iov_base = const_cast<char *>(frame.currentPdu.constData());
+                vectors[count].iov_len = static_cast<size_t>(frame.currentPdu.size());
+                messages[count].msg_hdr.msg_iov = &vectors[count];
+                messages[count].msg_hdr.msg_iovlen = 1;
+                messages[count].msg_hdr.msg_name = &targets[count];
+                messages[count].msg_hdr.msg_namelen = targetLength;
+                batch[count++] = next;
+            }
+            if (count == 0)
+                break;
+
+            int result;
+            do {
+                result = ::sendmmsg(static_cast<int>(descriptor), messages,
+                                    static_cast<unsigned int>(count), 0);
+            } while (result < 0 && errno == EINTR);
+
+            if (result <= 0)
+                break;
+            for (int i = 0; i < result; ++i)
+                isSent[batch[i]] = true;
+
+            // Resume after the last datagram accepted
+            if (result < count)
+                next = batch[result];
+        }
+    }
+
+    for (int i = 0; i < frames.size(); ++i) {
+        if (!isSent.at(i))
+            writeToSocket(frames.at(i).currentPdu, frames.at(i).endpoint);
+    }
+}
+
+/*!
+    \internal
+
+    Reads the pending datagrams with recvmmsg(), in batches, and emits a
+    readyRead() signal for each of them.
+*/
+void QCoapQUdpConnectionPrivate::receiveDatagramBatches()
+{
+    Q_Q(QCoapQUdpConnection);
+
+    if (receiveBuffer.isEmpty())
+        receiveBuffer.resize(DatagramBatchSize * MaximumDatagramSize);
+
+    mmsghdr messages[DatagramBatchSize];
+    iovec vectors[DatagramBatchSize];
+    sockaddr_storage senders[DatagramBatchSize];
+    QVarLengthArray<QPair<QByteArray, QHostAddress>, DatagramBatchSize> datagrams;
+
+    forever {
+        const qintptr descriptor = socket() ? socket()->socketDescriptor() : -1;
+        if (descriptor < 0)
+            return;
+
+        ::memset(messages, 0, sizeof(messages));
+        for (int i = 0; i < DatagramBatchSize; ++i) {
+            vectors[i].iov_base = receiveBuffer.data() + i * MaximumDatagramSize;
+            vectors[i].iov_len = MaximumDatagramSize;
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_name = &senders[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        }
+
+        int count;
+        do {
+            count = ::recvmmsg(static_cast<int>(descriptor), messages, DatagramBatchSize,
+                               MSG_DONTWAIT, nullptr);
+        } while (count < 0 && errno == EINTR);
+
+        if (count <= 0)
+            return;
+
+        // The buffer is copied before emitting, since it is reused
+        datagrams.clear();
+        for (int i = 0; i < count; ++i) {
+            datagrams.append(qMakePair(
+                    QByteArray(receiveBuffer.constData() + i * MaximumDatagramSize,
+                               static_cast<int>(messages[i].msg_len)),
+                    QHostAddress(reinterpret_cast<const sockaddr *>(&senders[i]))));
+        }
+
+        for (const auto &datagram : qAsConst(datagrams))
+            emit q->readyRead(datagram.first, datagram.second);
+
+        if (count < DatagramBatchSize)
+            return;
+    }
+}
+#endif
+
 /*!
     \internal
 
@@ -358,14 +607,13 @@ QUdpSocket *QCoapQUdpConnection::socket() const
 /*!
     \internal
 
-    Sets the DTLS configuration.
+    Sets the DTLS configuration of the sessions opened from now on.
 */
 void QCoapQUdpConnectionPrivate::setSecurityConfiguration(
         const QCoapSecurityConfiguration &configuration)
 {
 #if QT_CONFIG(dtls)
-    Q_ASSERT(dtls);
-    auto dtlsConfig = dtls->dtlsConfiguration();
+    auto dtlsConfig = dtlsConfiguration;
 
     if (!configuration.defaultCipherString().isEmpty()) {
         dtlsConfig.setBackendConfigurationOption("CipherString",
@@ -394,7 +642,11 @@ void QCoapQUdpConnectionPrivate::setSecurityConfiguration(
         }
     }
 
-    dtls->setDtlsConfiguration(dtlsConfig);
+    // Applies to the sessions opened from now on
+    dtlsConfiguration = dtlsConfig;
+
+    if (configuration.sessionIdleTimeout() == 0)
+        idleTimer->stop();
 #else
     Q_UNUSED(configuration);
 #endif
@@ -405,72 +657,235 @@ void QCoapQUdpConnectionPrivate::setSecurityConfiguration(
     \internal
 
     This slot is invoked when PSK authentication is required. It is used
-    for setting the identity and pre shared key in order for the TLS handshake
-    to complete.
+    for setting the identity and pre shared key of the server of the
+    handshake in order for the TLS handshake to complete.
 */
 void QCoapQUdpConnection::pskRequired(QSslPreSharedKeyAuthenticator *authenticator)
 {
     Q_ASSERT(authenticator);
-    authenticator->setIdentity(securityConfiguration().preSharedKeyIdentity());
-    authenticator->setPreSharedKey(securityConfiguration().preSharedKey());
+
+    const auto dtls = qobject_cast<QDtls *>(sender());
+    const QHostAddress peer = dtls ? dtls->peerAddress() : QHostAddress();
+    authenticator->setIdentity(securityConfiguration().preSharedKeyIdentity(peer));
+    authenticator->setPreSharedKey(securityConfiguration().preSharedKey(peer));
 }
 
 /*!
     \internal
 
-    This slot handles handshake timeouts.
+    This slot handles handshake timeouts. The session is closed if the
+    handshake messages cannot be re-transmitted.
 */
 void QCoapQUdpConnection::handshakeTimeout()
 {
     Q_D(QCoapQUdpConnection);
 
+    const auto dtls = qobject_cast<QDtls *>(sender());
+    if (!dtls)
+        return;
+
     qCWarning(lcCoapConnection, "Handshake timeout, trying to re-transmit");
-    if (d->dtls->handshakeState() == QDtls::HandshakeInProgress &&
-            !d->dtls->handleTimeout(d->udpSocket)) {
-        qCWarning(lcCoapConnection) << "Failed to re-transmit" << d->dtls->dtlsErrorString();
+    if (dtls->handshakeState() == QDtls::HandshakeInProgress &&
+            !dtls->handleTimeout(d->udpSocket)) {
+        qCWarning(lcCoapConnection) << "Failed to re-transmit" << dtls->dtlsErrorString();
+        d->removeSession(QCoapEndpoint(dtls->peerAddress(), dtls->peerPort()));
+    }
+}
+
+/*!
+    \internal
+
+    Returns the DTLS session with the server at \a endpoint, opening it if
+    needed. If the maximum number of sessions is reached, the least recently
+    used session is closed first.
+*/
+CoapDtlsSession *QCoapQUdpConnectionPrivate::openSession(const QCoapEndpoint &endpoint)
+{
+    Q_Q(QCoapQUdpConnection);
+
+    const auto it = dtlsSessions.find(endpoint);
+    if (it != dtlsSessions.end())
+        return &it.value();
+
+    const QCoapSecurityConfiguration configuration = q->securityConfiguration();
+    const int maximumSessionCount = configuration.maximumSessionCount();
+    if (maximumSessionCount > 0 && dtlsSessions.size() >= maximumSessionCount) {
+        const auto oldest = std::min_element(dtlsSessions.cbegin(), dtlsSessions.cend(),
+                                             [](const CoapDtlsSession &left,
+                                                const CoapDtlsSession &right) {
+                                                 return left.lastActivity < right.lastActivity;
+                                             });
+        removeSession(oldest.key());
+    }
+
+    CoapDtlsSession session;
+    session.dtls = new QDtls(QSslSocket::SslClientMode, q);
+    session.dtls->setDtlsConfiguration(dtlsConfiguration);
+    session.dtls->setPeer(endpoint.address(), endpoint.port());
+    session.lastActivity = sessionClock.elapsed();
+
+    if (securityMode == QtCoap::SecurityMode::PreSharedKey) {
+        QObject::connect(session.dtls.data(), &QDtls::pskRequired,
+                         q, &QCoapQUdpConnection::pskRequired);
+    }
+    QObject::connect(session.dtls.data(), &QDtls::handshakeTimeout,
+                     q, &QCoapQUdpConnection::handshakeTimeout);
+
+    // Idle sessions are looked for twice per timeout
+    const int idleTimeout = configuration.sessionIdleTimeout();
+    if (idleTimeout > 0 && !idleTimer->isActive())
+        idleTimer->start(qMax(1, idleTimeout / 2));
+
+    return &dtlsSessions.insert(endpoint, session).value();
+}
+
+/*!
+    \internal
+
+    Closes the DTLS session with the server at \a endpoint, dropping the
+    frames waiting for its handshake.
+*/
+void QCoapQUdpConnectionPrivate::removeSession(const QCoapEndpoint &endpoint)
+{
+    const CoapDtlsSession session = dtlsSessions.take(endpoint);
+    if (session.dtls) {
+        if (session.dtls->handshakeState() == QDtls::HandshakeInProgress)
+            session.dtls->abortHandshake(socket());
+        else if (session.dtls->isConnectionEncrypted())
+            session.dtls->shutdown(socket());
+
+        // The session may be removed from one of its own signals
+        session.dtls->deleteLater();
     }
+
+    if (dtlsSessions.isEmpty())
+        idleTimer->stop();
 }
 
 /*!
     \internal
 
-    Returns a decrypted datagram received from a UDP socket.
+    Closes the DTLS sessions without traffic for longer than the idle
+    timeout of the security configuration.
 */
-QNetworkDatagram QCoapQUdpConnectionPrivate::receiveDatagramDecrypted() const
+void QCoapQUdpConnectionPrivate::removeIdleSessions()
 {
-    auto datagram = socket()->receiveDatagram();
-    const QByteArray plainText = dtls->decryptDatagram(socket(), datagram.data());
-    datagram.setData(plainText);
-    return datagram;
+    Q_Q(QCoapQUdpConnection);
+
+    const int idleTimeout = q->securityConfiguration().sessionIdleTimeout();
+    if (idleTimeout <= 0) {
+        idleTimer->stop();
+        return;
+    }
+
+    const qint64 now = sessionClock.elapsed();
+    QVector<QCoapEndpoint> idleEndpoints;
+    for (auto it = dtlsSessions.cbegin(); it != dtlsSessions.cend(); ++it) {
+        if (now - it->lastActivity >= idleTimeout)
+            idleEndpoints.append(it.key());
+    }
+
+    for (const QCoapEndpoint &endpoint : qAsConst(idleEndpoints))
+        removeSession(endpoint);
+}
+
+/*!
+    \internal
+
+    Sends the given \a data frame through the DTLS session with the server
+    at \a endpoint. The frame is queued until the handshake completes if
+    the session is not encrypted yet.
+*/
+void QCoapQUdpConnectionPrivate::writeToSession(const QByteArray &data,
+                                                const QCoapEndpoint &endpoint)
+{
+    if (endpoint.isNull()) {
+        qCWarning(lcCoapConnection) << "Invalid host IP address" << endpoint.host()
+                                    << "- only IPv4/IPv6 destination addresses are supported.";
+        return;
+    }
+
+    CoapDtlsSession *session = openSession(endpoint);
+    session->lastActivity = sessionClock.elapsed();
+
+    if (session->dtls->isConnectionEncrypted()) {
+        if (session->dtls->writeDatagramEncrypted(socket(), data) < 0) {
+            qCWarning(lcCoapConnection) << "Failed to write datagram:"
+                                        << session->dtls->dtlsErrorString();
+        }
+        return;
+    }
+
+    session->pendingFrames.append(data);
+    if (session->dtls->handshakeState() != QDtls::HandshakeNotStarted)
+        return;
+
+    session->handshakeStart = sessionClock.elapsed();
+    if (!session->dtls->doHandshake(socket())) {
+        qCWarning(lcCoapConnection) << "Handshake error: " << session->dtls->dtlsErrorString();
+        removeSession(endpoint);
+    }
 }
 
 /*!
     \internal
 
-    If the connection is encrypted, emits the readyRead() signal for
-    the pending datagram. Otherwise starts the DTLS handshake and
-    if it is completed, starts to send the pending request.
+    Reads the pending datagram and passes it to the DTLS session with its
+    sender. If the session is encrypted, emits the readyRead() signal for
+    the decrypted datagram. Otherwise continues the handshake and, once it
+    is completed, sends the frames waiting for it and emits the
+    handshakeCompleted() signal.
 */
 void QCoapQUdpConnectionPrivate::handleEncryptedDatagram()
 {
     Q_Q(QCoapQUdpConnection);
 
-    Q_ASSERT(dtls);
+    const QNetworkDatagram datagram = socket()->receiveDatagram();
+    const QCoapEndpoint endpoint(datagram.senderAddress(),
+                                 static_cast<quint16>(datagram.senderPort()));
+
+    const auto it = dtlsSessions.find(endpoint);
+    if (it == dtlsSessions.end() || !it->dtls) {
+        qCDebug(lcCoapConnection) << "Ignoring datagram from" << datagram.senderAddress()
+                                  << "without DTLS session";
+        return;
+    }
 
+    it->lastActivity = sessionClock.elapsed();
+
+    // Emitting readyRead() may open new sessions, invalidating the iterator
+    QDtls *dtls = it->dtls;
     if (dtls->isConnectionEncrypted()) {
-        const auto &datagram = receiveDatagramDecrypted();
-        emit q->readyRead(datagram.data(), datagram.senderAddress());
-    } else {
-        if (!dtls->doHandshake(socket(), socket()->receiveDatagram().data())) {
-            qCWarning(lcCoapConnection) << "Handshake error: " << dtls->dtlsErrorString();
+        const QByteArray plainText = dtls->decryptDatagram(socket(), datagram.data());
+        if (dtls->dtlsError() == QDtlsError::RemoteClosedConnectionError) {
+            removeSession(endpoint);
             return;
         }
 
-        // The handshake is successfully done, emit the bound() signal to inform
-        // listeners that the socket is ready to start transferring data.
-        if (dtls->isConnectionEncrypted())
-            emit q->bound();
+        if (!plainText.isEmpty())
+            emit q->readyRead(plainText, datagram.senderAddress());
+        return;
+    }
+
+    if (!dtls->doHandshake(socket(), datagram.data())) {
+        qCWarning(lcCoapConnection) << "Handshake error: " << dtls->dtlsErrorString();
+        removeSession(endpoint);
+        return;
     }
+
+    if (!dtls->isConnectionEncrypted())
+        return;
+
+    const qint64 duration = sessionClock.elapsed() - it->handshakeStart;
+    qCDebug(lcCoapConnection).nospace() << "DTLS handshake with " << endpoint.address()
+                                        << " completed in " << duration << " ms";
+
+    const QVector<QByteArray> frames = it->pendingFrames;
+    it->pendingFrames.clear();
+    for (const QByteArray &frame : frames)
+        dtls->writeDatagramEncrypted(socket(), frame);
+
+    emit q->handshakeCompleted(endpoint.address(), endpoint.port(), duration);
 }
 
 #endif // dtls
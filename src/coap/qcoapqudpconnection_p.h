@@ -35,7 +35,13 @@
 #include <private/qcoapconnection_p.h>
 
 #include <QtNetwork/qudpsocket.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qqueue.h>
+#include <QtCore/qvector.h>
+#if QT_CONFIG(dtls)
+#include <QtNetwork/qsslconfiguration.h>
+#endif
 
 //
 //  W A R N I N G
@@ -51,6 +57,7 @@
 QT_BEGIN_NAMESPACE
 
 class QDtls;
+class QTimer;
 class QSslPreSharedKeyAuthenticator;
 class QCoapQUdpConnectionPrivate;
 class Q_AUTOTEST_EXPORT QCoapQUdpConnection : public QCoapConnection
@@ -68,6 +75,9 @@ public:
 public Q_SLOTS:
     void setSocketOption(QAbstractSocket::SocketOption, const QVariant &value);
 
+Q_SIGNALS:
+    void handshakeCompleted(const QHostAddress &address, quint16 port, qint64 duration);
+
 #if QT_CONFIG(dtls)
 private Q_SLOTS:
     void pskRequired(QSslPreSharedKeyAuthenticator *authenticator);
@@ -77,8 +87,8 @@ private Q_SLOTS:
 protected:
     explicit QCoapQUdpConnection(QCoapQUdpConnectionPrivate &dd, QObject *parent = nullptr);
 
-    void bind(const QString &host, quint16 port) override;
-    void writeData(const QByteArray &data, const QString &host, quint16 port) override;
+    void bind(const QCoapEndpoint &endpoint) override;
+    void writeData(const QByteArray &data, const QCoapEndpoint &endpoint) override;
     void close() override;
 
     void createSocket();
@@ -86,6 +96,15 @@ protected:
     Q_DECLARE_PRIVATE(QCoapQUdpConnection)
 };
 
+#if QT_CONFIG(dtls)
+struct CoapDtlsSession {
+    QPointer<QDtls> dtls;
+    QVector<QByteArray> pendingFrames;
+    qint64 lastActivity = 0;
+    qint64 handshakeStart = 0;
+};
+#endif
+
 class Q_AUTOTEST_EXPORT QCoapQUdpConnectionPrivate : public QCoapConnectionPrivate
 {
 public:
@@ -95,17 +114,34 @@ public:
     virtual bool bind();
 
     void bindSocket();
-    void writeToSocket(const QByteArray &data, const QString &host, quint16 port);
+    void writeToSocket(const QByteArray &data, const QCoapEndpoint &endpoint);
     QUdpSocket* socket() const { return udpSocket; }
     void socketReadyRead();
 
+#if defined(Q_OS_LINUX)
+    void queueDatagram(const QByteArray &data, const QCoapEndpoint &endpoint);
+    void flushDatagrams();
+    void receiveDatagramBatches();
+
+    QVector<CoapFrame> datagramsToSend;
+    QByteArray receiveBuffer;
+    bool flushScheduled = false;
+#endif
+    bool datagramBatching = true;
+
     void setSecurityConfiguration(const QCoapSecurityConfiguration &configuration);
 
 #if QT_CONFIG(dtls)
-    QNetworkDatagram receiveDatagramDecrypted() const;
+    CoapDtlsSession *openSession(const QCoapEndpoint &endpoint);
+    void removeSession(const QCoapEndpoint &endpoint);
+    void removeIdleSessions();
+    void writeToSession(const QByteArray &data, const QCoapEndpoint &endpoint);
     void handleEncryptedDatagram();
 
-    QPointer<QDtls> dtls;
+    QHash<QCoapEndpoint, CoapDtlsSession> dtlsSessions;
+    QSslConfiguration dtlsConfiguration;
+    QElapsedTimer sessionClock;
+    QTimer *idleTimer = nullptr;
 #endif
     QPointer<QUdpSocket> udpSocket;
 
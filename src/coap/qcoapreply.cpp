@@ -29,6 +29,7 @@
 ****************************************************************************/
 
 #include "qcoapreply_p.h"
+#include "qcoapuploadsource_p.h"
 #include "qcoapinternalreply_p.h"
 #include "qcoapnamespace_p.h"
 
@@ -94,14 +95,86 @@ void QCoapReplyPrivate::_q_setContent(const QHostAddress &, const QCoapMessage &
     if (q->isFinished())
         return;
 
-    message = msg;
-    responseCode = code;
-    seekBuffer(0);
+    // The streamed part of the payload may already have been read
+    if (!isStreaming || QtCoap::isError(code))
+        seekBuffer(0);
+    setMessage(msg, code);
 
     if (QtCoap::isError(responseCode))
         _q_setError(responseCode);
 }
 
+/*!
+    \internal
+
+    Sets the message and response code of this reply to \a msg and \a code.
+
+    If the payload of a blockwise response was streamed to the reply, it
+    becomes the payload of the message, unless the final response is an
+    error.
+*/
+void QCoapReplyPrivate::setMessage(const QCoapMessage &msg, QtCoap::ResponseCode code)
+{
+    message = msg;
+    responseCode = code;
+
+    if (isStreaming) {
+        if (!QtCoap::isError(code))
+            message.setPayload(streamedPayload);
+        streamedPayload.clear();
+        isStreaming = false;
+    }
+}
+
+/*!
+    \internal
+
+    Returns the payload that can be read from the reply, including the
+    blocks streamed so far.
+*/
+QByteArray QCoapReplyPrivate::payload() const
+{
+    return isStreaming ? streamedPayload : message.payload();
+}
+
+/*!
+    \internal
+
+    Emits the uploadProgress() signal with \a bytesSent and \a bytesTotal.
+*/
+void QCoapReplyPrivate::setUploadProgress(qint64 bytesSent, qint64 bytesTotal)
+{
+    Q_Q(QCoapReply);
+    emit q->uploadProgress(bytesSent, bytesTotal);
+}
+
+/*!
+    \internal
+
+    Appends the payload \a block of a blockwise response to the reply, and
+    emits the readyRead() and downloadProgress() signals. The buffer is
+    allocated for the \a totalSize of the resource with the first block,
+    if the server announced it.
+*/
+void QCoapReplyPrivate::_q_appendPayload(const QByteArray &block, qint64 totalSize)
+{
+    Q_Q(QCoapReply);
+
+    if (q->isFinished())
+        return;
+
+    if (!isStreaming) {
+        isStreaming = true;
+        streamedPayload.clear();
+        if (totalSize > 0 && totalSize <= std::numeric_limits<int>::max())
+            streamedPayload.reserve(static_cast<int>(totalSize));
+    }
+    streamedPayload.append(block);
+
+    emit q->readyRead();
+    emit q->downloadProgress(streamedPayload.size(), totalSize);
+}
+
 /*!
     \internal
 
@@ -136,6 +209,9 @@ void QCoapReplyPrivate::_q_setFinished(QtCoap::Error newError)
     if (newError != QtCoap::Error::Ok)
         _q_setError(newError);
 
+    if (!uploadSource.isNull() && q->isSuccessful())
+        setUploadProgress(uploadSource->totalSize(), uploadSource->totalSize());
+
     emit q->finished(q);
 }
 
@@ -183,6 +259,10 @@ void QCoapReplyPrivate::_q_setError(QtCoap::ResponseCode code)
     For \e Observe requests specifically, the notified() signal is emitted
     whenever a notification is received.
 
+    When the response is transferred in several blocks, each block is
+    appended to the reply as soon as it is received, and announced with the
+    readyRead() and downloadProgress() signals.
+
     \sa QCoapClient, QCoapRequest, QCoapResourceDiscoveryReply
 */
 
@@ -216,6 +296,37 @@ void QCoapReplyPrivate::_q_setError(QtCoap::ResponseCode code)
     \sa QCoapClient::finished(), isFinished(), finished(), notified()
 */
 
+/*!
+    \fn void QCoapReply::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+
+    This signal is emitted whenever a block of a blockwise response is
+    received, after the readyRead() signal. The data received so far can
+    be read from the reply before it is finished.
+
+    The \a bytesReceived parameter is the size of the payload received so
+    far, and \a bytesTotal the size of the whole resource, or -1 if the
+    server did not announce it with the Size2 option.
+
+    Observe and multicast replies are not streamed, their payload is only
+    available once complete.
+
+    \sa finished()
+*/
+
+/*!
+    \fn void QCoapReply::uploadProgress(qint64 bytesSent, qint64 bytesTotal)
+
+    This signal is emitted when the payload of a request sent from a
+    QIODevice is uploaded blockwise, each time the server acknowledged a
+    block, and once more when the reply successfully finished.
+
+    The \a bytesSent parameter is the size of the payload acknowledged so
+    far, and \a bytesTotal the size of the whole payload, or -1 if it is not
+    known yet, as for a sequential device that was not fully read.
+
+    \sa QCoapClient::put(), QCoapClient::post()
+*/
+
 /*!
     \fn void QCoapReply::error(QCoapReply* reply, QtCoap::Error error)
 
@@ -272,7 +383,7 @@ qint64 QCoapReply::readData(char *data, qint64 maxSize)
 {
     Q_D(QCoapReply);
 
-    QByteArray payload = d->message.payload();
+    const QByteArray payload = d->payload();
 
     maxSize = qMin(maxSize, qint64(payload.size()) - pos());
     if (maxSize <= 0)
@@ -64,6 +64,8 @@ Q_SIGNALS:
     void notified(QCoapReply *reply, const QCoapMessage &message);
     void error(QCoapReply *reply, QtCoap::Error error);
     void aborted(const QCoapToken &token);
+    void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void uploadProgress(qint64 bytesSent, qint64 bytesTotal);
 
 protected:
     qint64 readData(char *data, qint64 maxSize) override;
@@ -73,6 +75,7 @@ protected:
     Q_PRIVATE_SLOT(d_func(), void _q_setRunning(const QCoapToken &, QCoapMessageId))
     Q_PRIVATE_SLOT(d_func(), void _q_setContent(const QHostAddress &host, const QCoapMessage &,
                                                 QtCoap::ResponseCode))
+    Q_PRIVATE_SLOT(d_func(), void _q_appendPayload(const QByteArray &, qint64))
     Q_PRIVATE_SLOT(d_func(), void _q_setNotified())
     Q_PRIVATE_SLOT(d_func(), void _q_setObserveCancelled())
     Q_PRIVATE_SLOT(d_func(), void _q_setFinished(QtCoap::Error))
@@ -34,6 +34,7 @@
 #include <QtCoap/qcoapreply.h>
 #include <private/qcoapmessage_p.h>
 #include <private/qiodevice_p.h>
+#include <QtCore/qpointer.h>
 
 //
 //  W A R N I N G
@@ -49,6 +50,7 @@
 QT_BEGIN_NAMESPACE
 
 class QHostAddress;
+class QCoapUploadSource;
 class Q_AUTOTEST_EXPORT QCoapReplyPrivate : public QIODevicePrivate
 {
 public:
@@ -56,13 +58,19 @@ public:
 
     void _q_setRunning(const QCoapToken &, QCoapMessageId);
     virtual void _q_setContent(const QHostAddress &sender, const QCoapMessage &, QtCoap::ResponseCode);
+    void _q_appendPayload(const QByteArray &block, qint64 totalSize);
     void _q_setNotified();
     void _q_setObserveCancelled();
     void _q_setFinished(QtCoap::Error = QtCoap::Error::Ok);
     void _q_setError(QtCoap::ResponseCode code);
     void _q_setError(QtCoap::Error);
 
+    void setMessage(const QCoapMessage &msg, QtCoap::ResponseCode code);
+    QByteArray payload() const;
+    void setUploadProgress(qint64 bytesSent, qint64 bytesTotal);
+
     static QCoapReply *createCoapReply(const QCoapRequest &request, QObject *parent = nullptr);
+    static QCoapReplyPrivate *get(QCoapReply *reply) { return reply->d_func(); }
 
     QCoapRequest request;
     QCoapMessage message;
@@ -71,6 +79,9 @@ public:
     bool isRunning = false;
     bool isFinished = false;
     bool isAborted = false;
+    bool isStreaming = false;
+    QByteArray streamedPayload;
+    QPointer<QCoapUploadSource> uploadSource;
 
     Q_DECLARE_PUBLIC(QCoapReply)
 };
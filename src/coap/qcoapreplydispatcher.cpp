@@ -0,0 +1,312 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapreplydispatcher_p.h"
+#include "qcoapreply_p.h"
+#include "qcoapcallbackexchange_p.h"
+#include "qcoapnamespace_p.h"
+
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qsharedpointer.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+
+    \class QCoapReplyDispatcher
+    \inmodule QtCoap
+
+    \brief The QCoapReplyDispatcher class delivers the updates of the
+    replies from the worker threads of a client to its thread.
+
+    The protocol describes each update of a reply, such as its content
+    followed by its completion, with a single QCoapReplyCompletion record.
+    The records are posted from any thread to a lock-free queue, and the
+    first record posted to an empty queue posts one event to the dispatcher.
+    When the event is handled, in the thread of the client, all the records
+    posted so far are taken at once and applied in the order they were
+    posted. A busy client thus handles a single event for a whole batch of
+    replies, instead of one event per update of each reply.
+
+    \sa QCoapReplyCompletion
+*/
+
+/*!
+    \internal
+
+    \struct QCoapReplyCompletion
+    \inmodule QtCoap
+
+    \brief The QCoapReplyCompletion struct holds the updates of a reply
+    delivered at once to its thread.
+
+    The \c steps flags tell which updates are applied, and the fields used
+    by each of them are grouped under its name.
+*/
+
+/*!
+    \internal
+
+    Constructs a new dispatcher and sets \a parent as the parent object.
+*/
+QCoapReplyDispatcher::QCoapReplyDispatcher(QObject *parent) :
+    QObject(parent)
+{
+}
+
+/*!
+    \internal
+
+    Returns the type of the event requesting the delivery of the pending
+    records.
+*/
+QEvent::Type QCoapReplyDispatcher::deliveryEventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+/*!
+    \internal
+
+    Queues the \a completion record for the thread of the dispatcher, which
+    takes its ownership. This method is thread-safe.
+*/
+void QCoapReplyDispatcher::post(QCoapReplyCompletion *completion)
+{
+    // The queue was empty, so no delivery is scheduled yet
+    if (pending.enqueue(completion))
+        QCoreApplication::postEvent(this, new QEvent(deliveryEventType()));
+}
+
+/*!
+    \internal
+
+    Applies all the records posted so far, in the order they were posted,
+    and returns their number.
+
+    The dispatcher is not used once the records are taken, so that a slot
+    connected to a signal of a reply may destroy the client.
+*/
+int QCoapReplyDispatcher::deliverPending()
+{
+    QCoapReplyCompletion *completion = pending.takeAll();
+    if (coalesceNotifications)
+        completion = dropSupersededNotifications(completion);
+
+    int count = 0;
+    while (completion) {
+        QCoapReplyCompletion *next = completion->next;
+        apply(*completion);
+        delete completion;
+        completion = next;
+        ++count;
+    }
+
+    return count;
+}
+
+/*!
+    \internal
+
+    Returns \c true if notifications are coalesced.
+
+    \sa setNotificationCoalescingEnabled()
+*/
+bool QCoapReplyDispatcher::isNotificationCoalescingEnabled() const
+{
+    return coalesceNotifications;
+}
+
+/*!
+    \internal
+
+    Sets whether notifications are coalesced to \a enabled. When they are,
+    only the newest of the notifications of an observation pending in the
+    same batch is applied, the others being outdated before the client
+    thread gets to them.
+*/
+void QCoapReplyDispatcher::setNotificationCoalescingEnabled(bool enabled)
+{
+    coalesceNotifications = enabled;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the \a completion record only carries a
+    notification, which a newer notification of the same reply supersedes.
+*/
+bool QCoapReplyDispatcher::isNotification(const QCoapReplyCompletion &completion)
+{
+    return !completion.callbackExchange
+            && completion.steps == (QCoapReplyCompletion::Content
+                                    | QCoapReplyCompletion::Notified);
+}
+
+/*!
+    \internal
+
+    Removes from the list of \a completions, in posting order, the
+    notifications followed by a newer notification of the same reply, and
+    returns the head of the remaining list.
+*/
+QCoapReplyCompletion *
+QCoapReplyDispatcher::dropSupersededNotifications(QCoapReplyCompletion *completions)
+{
+    QHash<const QCoapReply *, const QCoapReplyCompletion *> newest;
+    for (auto completion = completions; completion; completion = completion->next) {
+        if (isNotification(*completion) && completion->reply)
+            newest.insert(completion->reply.data(), completion);
+    }
+
+    QCoapReplyCompletion **link = &completions;
+    while (QCoapReplyCompletion *completion = *link) {
+        if (isNotification(*completion)
+                && newest.value(completion->reply.data(), completion) != completion) {
+            *link = completion->next;
+            delete completion;
+        } else {
+            link = &completion->next;
+        }
+    }
+
+    return completions;
+}
+
+/*!
+    \internal
+
+    Applies the updates of the \a completion record to its reply, and emits
+    the matching signals of the reply. The reply may be destroyed by one of
+    these signals, in which case the next updates are dropped.
+
+    For a request sent with a callback, the updates make up the result
+    passed to the callback instead.
+*/
+void QCoapReplyDispatcher::apply(const QCoapReplyCompletion &completion)
+{
+    if (completion.callbackExchange) {
+        applyResult(completion);
+        return;
+    }
+
+    const QPointer<QCoapReply> &reply = completion.reply;
+    const auto stepApplies = [&](QCoapReplyCompletion::Step step) {
+        return (completion.steps & step) && !reply.isNull();
+    };
+
+    if (stepApplies(QCoapReplyCompletion::Running)) {
+        QCoapReplyPrivate::get(reply)->_q_setRunning(completion.token,
+                                                     completion.messageId);
+    }
+    if (stepApplies(QCoapReplyCompletion::Payload)) {
+        QCoapReplyPrivate::get(reply)->_q_appendPayload(completion.block,
+                                                        completion.totalSize);
+    }
+    if (stepApplies(QCoapReplyCompletion::Content)) {
+        QCoapReplyPrivate::get(reply)->_q_setContent(completion.sender, completion.message,
+                                                     completion.responseCode);
+    }
+    if (stepApplies(QCoapReplyCompletion::Error))
+        QCoapReplyPrivate::get(reply)->_q_setError(completion.error);
+    if (stepApplies(QCoapReplyCompletion::Notified))
+        QCoapReplyPrivate::get(reply)->_q_setNotified();
+    if (stepApplies(QCoapReplyCompletion::Finished))
+        QCoapReplyPrivate::get(reply)->_q_setFinished(completion.finishError);
+    if (stepApplies(QCoapReplyCompletion::ObserveCancelled))
+        QCoapReplyPrivate::get(reply)->_q_setObserveCancelled();
+}
+
+/*!
+    \internal
+
+    Passes the result made of the updates of the \a completion record to
+    the callback of its exchange, once the exchange is finished.
+*/
+void QCoapReplyDispatcher::applyResult(const QCoapReplyCompletion &completion)
+{
+    if (!(completion.steps & QCoapReplyCompletion::Finished))
+        return;
+
+    QCoapResult result;
+    if (completion.steps & QCoapReplyCompletion::Content) {
+        result.responseCode = completion.responseCode;
+        result.options = completion.message.options();
+        result.payload = completion.message.payload();
+        if (QtCoap::isError(completion.responseCode))
+            result.error = QtCoap::errorForResponseCode(completion.responseCode);
+    }
+    if (completion.steps & QCoapReplyCompletion::Error)
+        result.error = completion.error;
+    if (completion.finishError != QtCoap::Error::Ok)
+        result.error = completion.finishError;
+
+    completion.callbackExchange->complete(std::move(result));
+}
+
+/*!
+    \internal
+
+    Applies the \a completion record with a queued invocation on its reply,
+    and takes its ownership. This is used when the protocol runs without
+    a client, and thus without a dispatcher.
+*/
+void QCoapReplyDispatcher::invokeQueued(QCoapReplyCompletion *completion)
+{
+    // Requests sent with a callback always go through a client
+    Q_ASSERT(!completion->callbackExchange);
+
+    QSharedPointer<QCoapReplyCompletion> shared(completion);
+    if (shared->reply.isNull())
+        return;
+
+    QMetaObject::invokeMethod(shared->reply.data(), [shared]() {
+        QCoapReplyDispatcher::apply(*shared);
+    }, Qt::QueuedConnection);
+}
+
+/*!
+    \internal
+
+    Delivers the pending records when the delivery event is received.
+*/
+bool QCoapReplyDispatcher::event(QEvent *event)
+{
+    if (event->type() == deliveryEventType()) {
+        deliverPending();
+        return true;
+    }
+
+    return QObject::event(event);
+}
+
+QT_END_NAMESPACE
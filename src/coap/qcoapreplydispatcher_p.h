@@ -0,0 +1,128 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPREPLYDISPATCHER_P_H
+#define QCOAPREPLYDISPATCHER_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapmessage.h>
+#include <QtCoap/qcoapnamespace.h>
+#include <private/qcoaplockfreequeue_p.h>
+#include <QtCore/qcoreevent.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QCoapCallbackExchange;
+class QCoapReply;
+
+struct QCoapReplyCompletion
+{
+    // Updates of the reply, applied in the order of declaration
+    enum Step : quint8 {
+        Running = 0x01,
+        Payload = 0x02,
+        Content = 0x04,
+        Error = 0x08,
+        Notified = 0x10,
+        Finished = 0x20,
+        ObserveCancelled = 0x40
+    };
+
+    // The updates of a request sent with a callback make up its result
+    QPointer<QCoapReply> reply;
+    QSharedPointer<QCoapCallbackExchange> callbackExchange;
+    quint8 steps = 0;
+
+    // Running
+    QCoapToken token;
+    QCoapMessageId messageId = 0;
+
+    // Payload
+    QByteArray block;
+    qint64 totalSize = -1;
+
+    // Content
+    QHostAddress sender;
+    QCoapMessage message;
+    QtCoap::ResponseCode responseCode = QtCoap::ResponseCode::InvalidCode;
+
+    // Error and Finished
+    QtCoap::Error error = QtCoap::Error::Ok;
+    QtCoap::Error finishError = QtCoap::Error::Ok;
+
+    QCoapReplyCompletion *next = nullptr;
+};
+
+class Q_AUTOTEST_EXPORT QCoapReplyDispatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QCoapReplyDispatcher(QObject *parent = nullptr);
+
+    void post(QCoapReplyCompletion *completion);
+    int deliverPending();
+
+    bool isNotificationCoalescingEnabled() const;
+    void setNotificationCoalescingEnabled(bool enabled);
+
+    static void apply(const QCoapReplyCompletion &completion);
+    static void invokeQueued(QCoapReplyCompletion *completion);
+
+protected:
+    bool event(QEvent *event) override;
+
+private:
+    static QEvent::Type deliveryEventType();
+    static void applyResult(const QCoapReplyCompletion &completion);
+    static bool isNotification(const QCoapReplyCompletion &completion);
+    static QCoapReplyCompletion *dropSupersededNotifications(QCoapReplyCompletion *completions);
+
+    QCoapLockFreeQueue<QCoapReplyCompletion> pending;
+    bool coalesceNotifications = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPREPLYDISPATCHER_P_H
@@ -42,6 +42,7 @@ Q_DECLARE_LOGGING_CATEGORY(lcCoapExchange)
 namespace {
 const auto CoapScheme = QLatin1String("coap");
 const auto CoapSecureScheme = QLatin1String("coaps");
+const auto CoapTcpScheme = QLatin1String("coap+tcp");
 }
 
 QCoapRequestPrivate::QCoapRequestPrivate(const QUrl &url, QCoapMessage::Type type,
@@ -79,7 +80,7 @@ void QCoapRequestPrivate::setUrl(const QUrl &url)
     // If the port is unknown, try to set it based on scheme
     QUrl finalizedUrl = url;
     if (!url.scheme().isEmpty()) {
-        if (url.scheme() == CoapScheme) {
+        if (url.scheme() == CoapScheme || url.scheme() == CoapTcpScheme) {
             if (url.port() == -1)
                 finalizedUrl.setPort(QtCoap::DefaultPort);
         } else if (url.scheme() == CoapSecureScheme) {
@@ -110,6 +111,20 @@ void QCoapRequestPrivate::setUrl(const QUrl &url)
     \sa QCoapClient, QCoapReply, QCoapResourceDiscoveryReply
 */
 
+/*!
+    \enum QCoapRequest::Priority
+
+    This enum lists the possible priorities of a request, which decide the
+    order in which the requests waiting to be sent to the same server are
+    sent.
+
+    \value HighPriority     High priority.
+    \value NormalPriority   Normal priority. This is the default.
+    \value LowPriority      Low priority.
+
+    \sa QCoapClient::setMaximumOutstandingRequests()
+*/
+
 /*!
     Constructs a QCoapRequest object with the target \a url,
     the proxy URL \a proxyUrl and the \a type of the message.
@@ -186,6 +201,64 @@ bool QCoapRequest::isObserve() const
     return hasOption(QCoapOption::Observe);
 }
 
+/*!
+    Returns the priority of the request.
+
+    \sa setPriority()
+*/
+QCoapRequest::Priority QCoapRequest::priority() const
+{
+    Q_D(const QCoapRequest);
+    return d->priority;
+}
+
+/*!
+    Returns \c true if only a range of blocks of the resource is requested.
+
+    \sa setBlockRange(), firstBlock(), lastBlock()
+*/
+bool QCoapRequest::hasBlockRange() const
+{
+    Q_D(const QCoapRequest);
+    return d->rangeBlockSize > 0;
+}
+
+/*!
+    Returns the number of the first block requested, if the request has a
+    block range.
+
+    \sa setBlockRange(), hasBlockRange()
+*/
+uint QCoapRequest::firstBlock() const
+{
+    Q_D(const QCoapRequest);
+    return d->firstBlock;
+}
+
+/*!
+    Returns the number of the last block requested, if the request has a
+    block range.
+
+    \sa setBlockRange(), hasBlockRange()
+*/
+uint QCoapRequest::lastBlock() const
+{
+    Q_D(const QCoapRequest);
+    return d->lastBlock;
+}
+
+/*!
+    Returns the size of the blocks of the block range, or \c 0 if the
+    request has no block range.
+
+    \sa setBlockRange(), hasBlockRange()
+*/
+quint16 QCoapRequest::rangeBlockSize() const
+{
+    Q_D(const QCoapRequest);
+    return d->rangeBlockSize;
+}
+
 /*!
     Sets the target URI of the request to the given \a url.
 
@@ -224,6 +297,74 @@ void QCoapRequest::enableObserve()
     addOption(QCoapOption::Observe);
 }
 
+/*!
+    Sets the priority of the request to \a priority.
+
+    When the number of outstanding requests to a server is limited, the
+    requests waiting to be sent to this server are sent by decreasing
+    priority, and in the order they were made for the same priority.
+
+    \sa priority(), QCoapClient::setMaximumOutstandingRequests()
+*/
+void QCoapRequest::setPriority(Priority priority)
+{
+    Q_D(QCoapRequest);
+    d->priority = priority;
+}
+
+/*!
+    Requests only the blocks from \a firstBlock to \a lastBlock included of
+    the resource, using blocks of \a blockSize bytes. The reply then holds
+    the bytes from offset \c{firstBlock * blockSize} to
+    \c{(lastBlock + 1) * blockSize}, or up to the end of the resource if it
+    is shorter.
+
+    The \a blockSize should range from 16 to 1024 and be a power of 2. It
+    overrides the block size of the client for this request. The blocks are
+    fetched with the Block2 option, so the server must support blockwise
+    transfers; otherwise the whole resource is returned.
+
+    Independent ranges of the same resource can be fetched in parallel by
+    sending one request per range.
+
+    For more details, refer to
+    \l{https://tools.ietf.org/html/rfc7959#section-2.4}{RFC 7959 - Section 2.4}.
+
+    \sa clearBlockRange(), hasBlockRange(), QCoapClient::getBlockRanges()
+*/
+void QCoapRequest::setBlockRange(uint firstBlock, uint lastBlock, quint16 blockSize)
+{
+    Q_D(QCoapRequest);
+
+    if (blockSize < 16 || blockSize > 1024 || (blockSize & (blockSize - 1)) != 0) {
+        qCWarning(lcCoapExchange, "Block size should be a power of 2 from 16 to 1024.");
+        return;
+    }
+
+    if (firstBlock > lastBlock || lastBlock >= (1u << 20)) {
+        qCWarning(lcCoapExchange, "Invalid block range %u-%u.", firstBlock, lastBlock);
+        return;
+    }
+
+    d->firstBlock = firstBlock;
+    d->lastBlock = lastBlock;
+    d->rangeBlockSize = blockSize;
+}
+
+/*!
+    Removes the block range of the request, so that the whole resource is
+    requested.
+
+    \sa setBlockRange()
+*/
+void QCoapRequest::clearBlockRange()
+{
+    Q_D(QCoapRequest);
+    d->firstBlock = 0;
+    d->lastBlock = 0;
+    d->rangeBlockSize = 0;
+}
+
 /*!
     \internal
 
@@ -256,7 +397,8 @@ QCoapRequest &QCoapRequest::operator=(const QCoapRequest &other)
 bool QCoapRequestPrivate::isUrlValid(const QUrl &url)
 {
     return (url.isValid() && !url.isLocalFile() && !url.isRelative()
-            && (url.scheme() == CoapScheme || url.scheme() == CoapSecureScheme)
+            && (url.scheme() == CoapScheme || url.scheme() == CoapSecureScheme
+                || url.scheme() == CoapTcpScheme)
             && !url.hasFragment());
 }
 
@@ -45,6 +45,12 @@ class QCoapRequestPrivate;
 class Q_COAP_EXPORT QCoapRequest : public QCoapMessage
 {
 public:
+    enum Priority {
+        HighPriority = 1,
+        NormalPriority = 3,
+        LowPriority = 5
+    };
+
     explicit QCoapRequest(const QUrl &url = QUrl(),
                           Type type = Type::NonConfirmable,
                           const QUrl &proxyUrl = QUrl());
@@ -58,9 +64,17 @@ public:
     QUrl proxyUrl() const;
     QtCoap::Method method() const;
     bool isObserve() const;
+    Priority priority() const;
+    bool hasBlockRange() const;
+    uint firstBlock() const;
+    uint lastBlock() const;
+    quint16 rangeBlockSize() const;
     void setUrl(const QUrl &url);
     void setProxyUrl(const QUrl &proxyUrl);
     void enableObserve();
+    void setPriority(Priority priority);
+    void setBlockRange(uint firstBlock, uint lastBlock, quint16 blockSize);
+    void clearBlockRange();
 
 private:
     // Q_DECLARE_PRIVATE equivalent for shared data pointers
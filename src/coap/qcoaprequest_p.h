@@ -68,6 +68,10 @@ public:
     QUrl uri;
     QUrl proxyUri;
     QtCoap::Method method = QtCoap::Method::Invalid;
+    QCoapRequest::Priority priority = QCoapRequest::NormalPriority;
+    uint firstBlock = 0;
+    uint lastBlock = 0;
+    quint16 rangeBlockSize = 0;
 };
 
 QT_END_NAMESPACE
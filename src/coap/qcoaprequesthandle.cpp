@@ -0,0 +1,187 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoaprequesthandle.h"
+#include "qcoapcallbackexchange_p.h"
+#include "qcoapprotocol_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QCoapRequestHandle
+    \inmodule QtCoap
+
+    \brief The QCoapRequestHandle class refers to a request sent with a
+    completion callback.
+
+    \reentrant
+
+    A QCoapRequestHandle is returned by the QCoapClient methods taking a
+    QCoapResultCallback. It can be copied cheaply, and dropping it does not
+    affect the request. It only allows to know if the callback was called,
+    and to cancel the request.
+
+    \sa QCoapResult
+*/
+
+/*!
+    \internal
+
+    \class QCoapCallbackExchange
+    \brief The QCoapCallbackExchange class holds the state of a request
+    sent with a completion callback.
+
+    It is shared by the handles of the request, and by the protocol while
+    the exchange is running.
+*/
+
+/*!
+    \internal
+
+    Constructs the exchange of the \a request, whose result is passed to
+    \a callback.
+*/
+QCoapCallbackExchange::QCoapCallbackExchange(const QCoapRequest &request,
+                                             const QCoapResultCallback &callback) :
+    request(request),
+    callback(callback)
+{
+}
+
+/*!
+    \internal
+
+    Passes the \a result to the callback, unless the exchange was cancelled
+    or already completed. The callback is released once called.
+*/
+void QCoapCallbackExchange::complete(QCoapResult &&result)
+{
+    if (isCancelled() || !finished.testAndSetOrdered(0, 1))
+        return;
+
+    QCoapResultCallback call;
+    call.swap(callback);
+    call(std::move(result));
+}
+
+/*!
+    \internal
+
+    Marks the exchange as cancelled, and asks the protocol to drop it at
+    once, so that its timeouts are removed and the slot it holds in the
+    request scheduler is freed without waiting for its next deadline.
+*/
+void QCoapCallbackExchange::cancel()
+{
+    if (!cancelled.testAndSetOrdered(0, 1))
+        return;
+
+    const QPointer<QCoapProtocol> target = protocol;
+    if (target.isNull() || isFinished())
+        return;
+
+    const QSharedPointer<QCoapCallbackExchange> self = sharedFromThis();
+    QMetaObject::invokeMethod(target.data(), [target, self]() {
+        if (target)
+            target->d_func()->onCallbackExchangeCancelled(self);
+    }, Qt::QueuedConnection);
+}
+
+/*!
+    Constructs a null handle.
+*/
+QCoapRequestHandle::QCoapRequestHandle()
+{
+}
+
+/*!
+    \internal
+
+    Constructs a handle referring to \a exchange.
+*/
+QCoapRequestHandle::QCoapRequestHandle(const QSharedPointer<QCoapCallbackExchange> &exchange) :
+    d(exchange)
+{
+}
+
+/*!
+    Constructs a copy of the \a other handle.
+*/
+QCoapRequestHandle::QCoapRequestHandle(const QCoapRequestHandle &other) :
+    d(other.d)
+{
+}
+
+/*!
+    Destroys the handle. The request is not affected.
+*/
+QCoapRequestHandle::~QCoapRequestHandle()
+{
+}
+
+/*!
+    Copies the \a other handle into this one.
+*/
+QCoapRequestHandle &QCoapRequestHandle::operator=(const QCoapRequestHandle &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Returns \c true if the handle does not refer to a request, which is the
+    case when the request could not be sent.
+*/
+bool QCoapRequestHandle::isNull() const
+{
+    return d.isNull();
+}
+
+/*!
+    Returns \c true if the callback of the request was called.
+*/
+bool QCoapRequestHandle::isFinished() const
+{
+    return d && d->isFinished();
+}
+
+/*!
+    Cancels the request. Its callback is not called after this method
+    returns, if it is called from the thread of the client. This method
+    can be called from any thread. The protocol
+    stops retransmitting the request and forgets the exchange as soon as
+    it processes the cancellation.
+*/
+void QCoapRequestHandle::cancel()
+{
+    if (d)
+        d->cancel();
+}
+
+QT_END_NAMESPACE
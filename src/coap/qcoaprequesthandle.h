@@ -0,0 +1,62 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPREQUESTHANDLE_H
+#define QCOAPREQUESTHANDLE_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qsharedpointer.h>
+
+QT_BEGIN_NAMESPACE
+
+class QCoapCallbackExchange;
+class Q_COAP_EXPORT QCoapRequestHandle
+{
+public:
+    QCoapRequestHandle();
+    QCoapRequestHandle(const QCoapRequestHandle &other);
+    ~QCoapRequestHandle();
+
+    QCoapRequestHandle &operator=(const QCoapRequestHandle &other);
+
+    bool isNull() const;
+    bool isFinished() const;
+    void cancel();
+
+private:
+    explicit QCoapRequestHandle(const QSharedPointer<QCoapCallbackExchange> &exchange);
+
+    QSharedPointer<QCoapCallbackExchange> d;
+
+    friend class QCoapClientPrivate;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPREQUESTHANDLE_H
@@ -0,0 +1,238 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoaprequestscheduler_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+
+    \class QCoapRequestScheduler
+    \brief The QCoapRequestScheduler class limits the number of outstanding
+    interactions with each endpoint.
+
+    As described in \l{https://tools.ietf.org/html/rfc7252#section-4.7}
+    {RFC 7252 - Section 4.7}, a client should limit the number of
+    simultaneous outstanding interactions it has with a given server, this
+    limit being called \c NSTART.
+
+    A request may start when tryAcquire() succeeds for its endpoint; it then
+    holds a slot until release() is called. Other requests are queued by
+    priority, and in FIFO order for the same priority. When a slot is freed,
+    takeNext() returns the next queued request, which holds the slot in turn.
+
+    The scheduler also keeps gauges of the queue depth and of the time spent
+    by the requests in the queue for each endpoint.
+*/
+
+/*!
+    \internal
+
+    Returns the maximum number of outstanding requests for each endpoint, or 0
+    if it is not limited.
+*/
+int QCoapRequestScheduler::maximumOutstanding() const
+{
+    return maximumOutstandingCount;
+}
+
+/*!
+    \internal
+
+    Sets the maximum number of outstanding requests for each endpoint to
+    \a count. A value of 0 disables the limit.
+
+    \sa readyEndpoints()
+*/
+void QCoapRequestScheduler::setMaximumOutstanding(int count)
+{
+    maximumOutstandingCount = qMax(count, 0);
+}
+
+/*!
+    \internal
+
+    Takes a slot of the endpoint \a host and returns \c true if a slot is free
+    and no other request is waiting for it, returns \c false otherwise.
+*/
+bool QCoapRequestScheduler::tryAcquire(const QHostAddress &host)
+{
+    EndpointState &state = endpoints[host];
+    if (state.queueDepth > 0 || !hasFreeSlot(state))
+        return false;
+
+    ++state.outstandingCount;
+    return true;
+}
+
+/*!
+    \internal
+
+    Queues \a request for the endpoint \a host with the given \a priority.
+*/
+void QCoapRequestScheduler::enqueue(const QHostAddress &host, QCoapRequest::Priority priority,
+                                    const PendingRequest &request)
+{
+    EndpointState &state = endpoints[host];
+    state.queues[priority].enqueue(request);
+    ++state.queueDepth;
+}
+
+/*!
+    \internal
+
+    Frees a slot of the endpoint \a host.
+*/
+void QCoapRequestScheduler::release(const QHostAddress &host)
+{
+    auto it = endpoints.find(host);
+    if (it == endpoints.end() || it->outstandingCount == 0) {
+        Q_ASSERT_X(false, "QCoapRequestScheduler::release", "No slot acquired");
+        return;
+    }
+
+    --it->outstandingCount;
+    if (it->outstandingCount == 0 && it->queueDepth == 0 && it->dequeuedCount == 0)
+        endpoints.erase(it);
+}
+
+/*!
+    \internal
+
+    If a slot of the endpoint \a host is free and a request is queued for it,
+    takes the slot, sets \a request to the next queued request and returns
+    \c true. Returns \c false otherwise.
+
+    The wait time of the request is computed with the current time \a now.
+*/
+bool QCoapRequestScheduler::takeNext(const QHostAddress &host, qint64 now,
+                                     PendingRequest *request)
+{
+    auto it = endpoints.find(host);
+    if (it == endpoints.end() || it->queueDepth == 0 || !hasFreeSlot(*it))
+        return false;
+
+    EndpointState &state = *it;
+    auto queue = state.queues.begin();
+    *request = queue->dequeue();
+    if (queue->isEmpty())
+        state.queues.erase(queue);
+    --state.queueDepth;
+    ++state.outstandingCount;
+
+    const qint64 waitTime = now - request->queuedTime;
+    state.lastWaitTime = waitTime;
+    state.maximumWaitTime = qMax(state.maximumWaitTime, waitTime);
+    state.totalWaitTime += waitTime;
+    ++state.dequeuedCount;
+
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns \c true if requests are queued for the endpoint \a host.
+*/
+bool QCoapRequestScheduler::hasQueuedRequests(const QHostAddress &host) const
+{
+    const auto it = endpoints.constFind(host);
+    return it != endpoints.constEnd() && it->queueDepth > 0;
+}
+
+/*!
+    \internal
+
+    Returns the endpoints which have both queued requests and free slots. This
+    is useful after raising the maximum number of outstanding requests.
+*/
+QVector<QHostAddress> QCoapRequestScheduler::readyEndpoints() const
+{
+    QVector<QHostAddress> ready;
+    for (auto it = endpoints.constBegin(); it != endpoints.constEnd(); ++it) {
+        if (it->queueDepth > 0 && hasFreeSlot(*it))
+            ready.append(it.key());
+    }
+
+    return ready;
+}
+
+/*!
+    \internal
+
+    Returns the gauges of the endpoint \a host at the time \a now.
+*/
+QCoapRequestScheduler::Statistics QCoapRequestScheduler::statistics(const QHostAddress &host,
+                                                                    qint64 now) const
+{
+    Statistics statistics;
+
+    const auto it = endpoints.constFind(host);
+    if (it == endpoints.constEnd())
+        return statistics;
+
+    statistics.outstandingCount = it->outstandingCount;
+    statistics.queueDepth = it->queueDepth;
+    statistics.lastWaitTime = it->lastWaitTime;
+    statistics.maximumWaitTime = it->maximumWaitTime;
+    statistics.dequeuedCount = it->dequeuedCount;
+    if (it->dequeuedCount > 0)
+        statistics.averageWaitTime = double(it->totalWaitTime) / it->dequeuedCount;
+
+    // The oldest request of the highest priority is not always the oldest one
+    for (const auto &queue : it->queues) {
+        statistics.oldestWaitTime = qMax(statistics.oldestWaitTime,
+                                         now - queue.head().queuedTime);
+    }
+
+    return statistics;
+}
+
+/*!
+    \internal
+
+    Drops all the queued requests and releases all the slots.
+*/
+void QCoapRequestScheduler::clear()
+{
+    endpoints.clear();
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a state has less outstanding requests than allowed.
+*/
+bool QCoapRequestScheduler::hasFreeSlot(const EndpointState &state) const
+{
+    return maximumOutstandingCount == 0 || state.outstandingCount < maximumOutstandingCount;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPREQUESTSCHEDULER_P_H
+#define QCOAPREQUESTSCHEDULER_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QCoapCallbackExchange;
+class QCoapConnection;
+class Q_AUTOTEST_EXPORT QCoapRequestScheduler
+{
+public:
+    struct PendingRequest {
+        QPointer<QCoapReply> reply;
+        QSharedPointer<QCoapCallbackExchange> callbackExchange;
+        QCoapConnection *connection = nullptr;
+        qint64 queuedTime = 0;
+    };
+
+    struct Statistics {
+        int outstandingCount = 0;
+        int queueDepth = 0;
+        qint64 oldestWaitTime = 0;
+        qint64 lastWaitTime = 0;
+        qint64 maximumWaitTime = 0;
+        double averageWaitTime = 0;
+        quint64 dequeuedCount = 0;
+    };
+
+    QCoapRequestScheduler() = default;
+
+    int maximumOutstanding() const;
+    void setMaximumOutstanding(int count);
+
+    bool tryAcquire(const QHostAddress &host);
+    void enqueue(const QHostAddress &host, QCoapRequest::Priority priority,
+                 const PendingRequest &request);
+    void release(const QHostAddress &host);
+    bool takeNext(const QHostAddress &host, qint64 now, PendingRequest *request);
+
+    bool hasQueuedRequests(const QHostAddress &host) const;
+    QVector<QHostAddress> readyEndpoints() const;
+    Statistics statistics(const QHostAddress &host, qint64 now) const;
+    void clear();
+
+private:
+    struct EndpointState {
+        int outstandingCount = 0;
+        int queueDepth = 0;
+        // Queues by priority, the highest priority having the lowest value
+        QMap<int, QQueue<PendingRequest>> queues;
+
+        qint64 lastWaitTime = 0;
+        qint64 maximumWaitTime = 0;
+        qint64 totalWaitTime = 0;
+        quint64 dequeuedCount = 0;
+    };
+
+    bool hasFreeSlot(const EndpointState &state) const;
+
+    QHash<QHostAddress, EndpointState> endpoints;
+    int maximumOutstandingCount = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPREQUESTSCHEDULER_P_H
@@ -54,8 +54,7 @@ void QCoapResourceDiscoveryReplyPrivate::_q_setContent(const QHostAddress &sende
     if (q->isFinished())
         return;
 
-    message = msg;
-    responseCode = code;
+    setMessage(msg, code);
 
     if (QtCoap::isError(responseCode)) {
         _q_setError(responseCode);
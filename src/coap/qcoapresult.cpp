@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapresult.h"
+#include "qcoapnamespace_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \struct QCoapResult
+    \inmodule QtCoap
+
+    \brief The QCoapResult struct holds the outcome of a request sent with
+    a completion callback.
+
+    \reentrant
+
+    A QCoapResult is passed to the QCoapResultCallback of a request sent
+    with one of the QCoapClient methods taking a callback. Unlike a
+    QCoapReply, it is not a QObject: it only holds the response code, the
+    options and the payload of the response, or the error which prevented
+    the request from completing. It can be moved, but not copied.
+
+    \sa QCoapRequestHandle, QCoapClient::get()
+*/
+
+/*!
+    \variable QCoapResult::error
+
+    The error of the request, QtCoap::Error::Ok if a response was received.
+    A response with an error code also sets the matching error.
+*/
+
+/*!
+    \variable QCoapResult::responseCode
+
+    The code of the response, QtCoap::ResponseCode::InvalidCode if no
+    response was received.
+*/
+
+/*!
+    \variable QCoapResult::options
+
+    The options of the response.
+*/
+
+/*!
+    \variable QCoapResult::payload
+
+    The payload of the response. The blocks of a blockwise response are
+    put end to end.
+*/
+
+/*!
+    \typedef QCoapResultCallback
+    \relates QCoapResult
+
+    Synonym for \c {std::function<void(QCoapResult)>}, the type of the
+    callback receiving the result of a request.
+*/
+
+/*!
+    Returns \c true if a response was received and its code is not an
+    error code.
+*/
+bool QCoapResult::isSuccessful() const
+{
+    return error == QtCoap::Error::Ok && responseCode != QtCoap::ResponseCode::InvalidCode
+            && !QtCoap::isError(responseCode);
+}
+
+QT_END_NAMESPACE
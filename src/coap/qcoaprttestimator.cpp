@@ -0,0 +1,271 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoaprttestimator_p.h"
+
+QT_BEGIN_NAMESPACE
+
+// Bounds of the retransmission timeout, in milliseconds
+static const double minimumTimeout = 1;
+static const double maximumTimeout = 60000;
+
+// Endpoints without new samples for this long are forgotten
+static const qint64 endpointIdleTimeout = 10 * 60 * 1000;
+
+/*!
+    \internal
+
+    \class QCoapRttEstimator
+    \brief The QCoapRttEstimator class estimates the retransmission timeout
+    of each endpoint from the measured round-trip times.
+
+    The estimation follows the CoAP Simple Congestion Control/Advanced
+    (CoCoA) algorithm, described in
+    \l{https://tools.ietf.org/html/draft-ietf-core-cocoa}{draft-ietf-core-cocoa}.
+
+    Two estimators are kept for each endpoint, using the algorithm of
+    \l{https://tools.ietf.org/html/rfc6298}{RFC 6298}. The strong estimator
+    is fed with the round-trip times of the exchanges acknowledged without
+    retransmission. The weak estimator is fed with the time elapsed since the
+    first transmission for exchanges acknowledged after one or two
+    retransmissions, as it is unknown which transmission was acknowledged.
+    Each new estimation is blended into the overall timeout of the endpoint,
+    the weak one having less weight.
+
+    When no sample is received for some time, the timeout is brought back
+    towards the initial timeout.
+*/
+
+/*!
+    \internal
+
+    Returns the timeout used for endpoints without samples, in milliseconds.
+*/
+uint QCoapRttEstimator::initialTimeout() const
+{
+    return defaultTimeout;
+}
+
+/*!
+    \internal
+
+    Sets the timeout used for endpoints without samples to \a timeout in
+    milliseconds. This is usually the \c ACK_TIMEOUT.
+*/
+void QCoapRttEstimator::setInitialTimeout(uint timeout)
+{
+    defaultTimeout = timeout;
+}
+
+/*!
+    \internal
+
+    Updates the estimations of the endpoint \a host with the \a roundTripTime
+    measured at the time \a now, in milliseconds, for an exchange acknowledged
+    after \a retransmissions retransmissions.
+
+    Samples of exchanges retransmitted more than twice are ignored.
+*/
+void QCoapRttEstimator::addSample(const QHostAddress &host, qint64 roundTripTime,
+                                  uint retransmissions, qint64 now)
+{
+    if (retransmissions > 2)
+        return;
+
+    if (now >= nextPurge) {
+        purge(now);
+        nextPurge = now + endpointIdleTimeout;
+    }
+
+    auto it = endpoints.find(host);
+    if (it == endpoints.end()) {
+        it = endpoints.insert(host, EndpointState());
+        it->timeout = defaultTimeout;
+    } else {
+        it->timeout = agedTimeout(*it, now);
+    }
+
+    EndpointState &state = *it;
+    const double sample = qMax<double>(roundTripTime, 0);
+    if (retransmissions == 0)
+        state.timeout = 0.5 * state.strong.update(sample, 4) + 0.5 * state.timeout;
+    else
+        state.timeout = 0.25 * state.weak.update(sample, 1) + 0.75 * state.timeout;
+
+    state.timeout = qBound(minimumTimeout, state.timeout, maximumTimeout);
+    state.lastUpdate = now;
+}
+
+/*!
+    \internal
+
+    Returns the retransmission timeout of the endpoint \a host at the time
+    \a now, in milliseconds.
+*/
+uint QCoapRttEstimator::retransmissionTimeout(const QHostAddress &host, qint64 now) const
+{
+    const auto it = endpoints.constFind(host);
+    if (it == endpoints.constEnd())
+        return defaultTimeout;
+
+    return static_cast<uint>(agedTimeout(*it, now));
+}
+
+/*!
+    \internal
+
+    Returns the state of the estimators of the endpoint \a host at the time
+    \a now.
+*/
+QCoapRttEstimator::Statistics QCoapRttEstimator::statistics(const QHostAddress &host,
+                                                            qint64 now) const
+{
+    Statistics statistics;
+    statistics.retransmissionTimeout = retransmissionTimeout(host, now);
+
+    const auto it = endpoints.constFind(host);
+    if (it != endpoints.constEnd()) {
+        statistics.strongRoundTripTime = it->strong.roundTripTime;
+        statistics.strongRoundTripTimeVariation = it->strong.roundTripTimeVariation;
+        statistics.strongSampleCount = it->strong.sampleCount;
+        statistics.weakRoundTripTime = it->weak.roundTripTime;
+        statistics.weakRoundTripTimeVariation = it->weak.roundTripTimeVariation;
+        statistics.weakSampleCount = it->weak.sampleCount;
+        statistics.lastUpdate = it->lastUpdate;
+    }
+
+    return statistics;
+}
+
+/*!
+    \internal
+
+    Returns the number of endpoints with estimations.
+*/
+int QCoapRttEstimator::endpointCount() const
+{
+    return endpoints.size();
+}
+
+/*!
+    \internal
+
+    Forgets the estimations of all endpoints.
+*/
+void QCoapRttEstimator::clear()
+{
+    endpoints.clear();
+    nextPurge = 0;
+}
+
+/*!
+    \internal
+
+    Returns the factor by which the timeout is multiplied on each
+    retransmission, for an initial \a retransmissionTimeout in milliseconds.
+    Short timeouts back off faster, and long timeouts slower.
+*/
+double QCoapRttEstimator::backoffFactor(uint retransmissionTimeout)
+{
+    if (retransmissionTimeout < 1000)
+        return 3;
+    if (retransmissionTimeout > 3000)
+        return 1.5;
+    return 2;
+}
+
+/*!
+    \internal
+
+    Updates the estimator with \a sample, and returns the new retransmission
+    timeout, using \a k as the weight of the round-trip time variation.
+*/
+double QCoapRttEstimator::Estimator::update(double sample, double k)
+{
+    if (sampleCount == 0) {
+        roundTripTime = sample;
+        roundTripTimeVariation = sample / 2;
+    } else {
+        roundTripTimeVariation = 0.75 * roundTripTimeVariation
+                + 0.25 * qAbs(roundTripTime - sample);
+        roundTripTime = 0.875 * roundTripTime + 0.125 * sample;
+    }
+    ++sampleCount;
+
+    return roundTripTime + k * roundTripTimeVariation;
+}
+
+/*!
+    \internal
+
+    Returns the timeout of \a state at the time \a now, after aging.
+
+    A timeout below 1 s which has not been updated for 16 times its value is
+    doubled, and a timeout above 3 s which has not been updated for 4 times
+    its value is moved halfway towards the initial timeout. Aging never moves
+    the timeout past the initial timeout.
+*/
+double QCoapRttEstimator::agedTimeout(const EndpointState &state, qint64 now) const
+{
+    double timeout = state.timeout;
+    qint64 updated = state.lastUpdate;
+
+    for (;;) {
+        if (timeout < 1000 && timeout < defaultTimeout && now - updated >= 16 * timeout) {
+            updated += static_cast<qint64>(16 * timeout);
+            timeout = qMin<double>(timeout * 2, defaultTimeout);
+        } else if (timeout > 3000 && timeout > defaultTimeout
+                   && now - updated >= 4 * timeout) {
+            updated += static_cast<qint64>(4 * timeout);
+            timeout = (defaultTimeout + timeout) / 2;
+        } else {
+            break;
+        }
+    }
+
+    return timeout;
+}
+
+/*!
+    \internal
+
+    Drops the estimations of the endpoints without new samples since
+    \c endpointIdleTimeout at the time \a now.
+*/
+void QCoapRttEstimator::purge(qint64 now)
+{
+    for (auto it = endpoints.begin(); it != endpoints.end();) {
+        if (now - it->lastUpdate >= endpointIdleTimeout)
+            it = endpoints.erase(it);
+        else
+            ++it;
+    }
+}
+
+QT_END_NAMESPACE
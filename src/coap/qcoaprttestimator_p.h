@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPRTTESTIMATOR_P_H
+#define QCOAPRTTESTIMATOR_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qhash.h>
+#include <QtNetwork/qhostaddress.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapRttEstimator
+{
+public:
+    struct Statistics {
+        uint retransmissionTimeout = 0;
+        double strongRoundTripTime = 0;
+        double strongRoundTripTimeVariation = 0;
+        int strongSampleCount = 0;
+        double weakRoundTripTime = 0;
+        double weakRoundTripTimeVariation = 0;
+        int weakSampleCount = 0;
+        qint64 lastUpdate = -1;
+    };
+
+    QCoapRttEstimator() = default;
+
+    uint initialTimeout() const;
+    void setInitialTimeout(uint timeout);
+
+    void addSample(const QHostAddress &host, qint64 roundTripTime, uint retransmissions,
+                   qint64 now);
+    uint retransmissionTimeout(const QHostAddress &host, qint64 now) const;
+    Statistics statistics(const QHostAddress &host, qint64 now) const;
+    int endpointCount() const;
+    void clear();
+
+    static double backoffFactor(uint retransmissionTimeout);
+
+private:
+    struct Estimator {
+        double roundTripTime = 0;
+        double roundTripTimeVariation = 0;
+        int sampleCount = 0;
+
+        double update(double sample, double k);
+    };
+
+    struct EndpointState {
+        Estimator strong;
+        Estimator weak;
+        double timeout = 0;
+        qint64 lastUpdate = 0;
+    };
+
+    double agedTimeout(const EndpointState &state, qint64 now) const;
+    void purge(qint64 now);
+
+    QHash<QHostAddress, EndpointState> endpoints;
+    uint defaultTimeout = 2000;
+    qint64 nextPurge = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPRTTESTIMATOR_P_H
@@ -31,7 +31,10 @@
 
 #include <QtCore/QVector>
 #include <QtCore/QByteArray>
+#include <QtCore/QHash>
 #include <QtCore/QIODevice>
+#include <QtCore/QPair>
+#include <QtNetwork/QHostAddress>
 #include <QtNetwork/QSslCertificate>
 
 QT_BEGIN_NAMESPACE
@@ -55,6 +58,9 @@ public:
     QVector<QSslCertificate> caCertificates;
     QVector<QSslCertificate> localCertificateChain;
     QCoapPrivateKey privateKey;
+    QHash<QHostAddress, QPair<QByteArray, QByteArray>> peerPreSharedKeys;
+    int maximumSessionCount = 64;
+    int sessionIdleTimeout = 0;
 };
 
 /*!
@@ -205,6 +211,11 @@ QByteArray QCoapPrivateKey::passPhrase() const
 
     It holds information such as client identity, pre shared key, information
     about certificates, and so on.
+
+    A secure client keeps a DTLS session with each server it exchanges with,
+    over a single UDP socket. The pre-shared key and identity can be set for
+    each server with setPeerPreSharedKey(), and the number of sessions kept
+    open is bounded by setMaximumSessionCount() and setSessionIdleTimeout().
 */
 
 
@@ -299,6 +310,48 @@ QByteArray QCoapSecurityConfiguration::preSharedKey() const
     return d->preSharedKey;
 }
 
+/*!
+    Sets the PSK client \a identity and the \a preSharedKey used for the
+    handshakes with the server at the \a peer address, instead of the
+    default ones.
+
+    \sa setPreSharedKeyIdentity(), setPreSharedKey()
+*/
+void QCoapSecurityConfiguration::setPeerPreSharedKey(const QHostAddress &peer,
+                                                     const QByteArray &identity,
+                                                     const QByteArray &preSharedKey)
+{
+    d->peerPreSharedKeys.insert(peer, qMakePair(identity, preSharedKey));
+}
+
+/*!
+    \overload
+
+    Returns the PSK client identity used for the server at the \a peer
+    address, or the default identity if none is set for it.
+
+    \sa setPeerPreSharedKey()
+*/
+QByteArray QCoapSecurityConfiguration::preSharedKeyIdentity(const QHostAddress &peer) const
+{
+    const auto it = d->peerPreSharedKeys.constFind(peer);
+    return it != d->peerPreSharedKeys.cend() ? it->first : d->identity;
+}
+
+/*!
+    \overload
+
+    Returns the pre shared key used for the server at the \a peer address,
+    or the default pre shared key if none is set for it.
+
+    \sa setPeerPreSharedKey()
+*/
+QByteArray QCoapSecurityConfiguration::preSharedKey(const QHostAddress &peer) const
+{
+    const auto it = d->peerPreSharedKeys.constFind(peer);
+    return it != d->peerPreSharedKeys.cend() ? it->second : d->preSharedKey;
+}
+
 /*!
     Sets the SSL cipher string to \a cipherString.
 
@@ -389,4 +442,50 @@ QCoapPrivateKey QCoapSecurityConfiguration::privateKey() const
     return d->privateKey;
 }
 
+/*!
+    Sets the maximum number of DTLS sessions kept open at the same time to
+    \a count. When a session with a new server is needed while the maximum
+    is reached, the least recently used session is closed. A value of 0
+    does not limit the number of sessions. The default is 64.
+
+    \sa maximumSessionCount(), setSessionIdleTimeout()
+*/
+void QCoapSecurityConfiguration::setMaximumSessionCount(int count)
+{
+    d->maximumSessionCount = qMax(0, count);
+}
+
+/*!
+    Returns the maximum number of DTLS sessions kept open at the same time.
+
+    \sa setMaximumSessionCount()
+*/
+int QCoapSecurityConfiguration::maximumSessionCount() const
+{
+    return d->maximumSessionCount;
+}
+
+/*!
+    Sets the time after which a DTLS session without any traffic is closed
+    to \a msecs milliseconds. A new handshake is made with the server on its
+    next request. A value of 0 keeps idle sessions open. The default is 0.
+
+    \sa sessionIdleTimeout(), setMaximumSessionCount()
+*/
+void QCoapSecurityConfiguration::setSessionIdleTimeout(int msecs)
+{
+    d->sessionIdleTimeout = qMax(0, msecs);
+}
+
+/*!
+    Returns the time in milliseconds after which a DTLS session without any
+    traffic is closed.
+
+    \sa setSessionIdleTimeout()
+*/
+int QCoapSecurityConfiguration::sessionIdleTimeout() const
+{
+    return d->sessionIdleTimeout;
+}
+
 QT_END_NAMESPACE
@@ -38,6 +38,7 @@
 
 QT_BEGIN_NAMESPACE
 
+class QHostAddress;
 class QCoapPrivateKeyPrivate;
 class Q_COAP_EXPORT QCoapPrivateKey
 {
@@ -92,6 +93,11 @@ public:
     void setPreSharedKey(const QByteArray &preSharedKey);
     QByteArray preSharedKey() const;
 
+    void setPeerPreSharedKey(const QHostAddress &peer, const QByteArray &identity,
+                             const QByteArray &preSharedKey);
+    QByteArray preSharedKeyIdentity(const QHostAddress &peer) const;
+    QByteArray preSharedKey(const QHostAddress &peer) const;
+
     void setDefaultCipherString(const QString &cipherString);
     QString defaultCipherString() const;
 
@@ -104,6 +110,12 @@ public:
     void setPrivateKey(const QCoapPrivateKey &key);
     QCoapPrivateKey privateKey() const;
 
+    void setMaximumSessionCount(int count);
+    int maximumSessionCount() const;
+
+    void setSessionIdleTimeout(int msecs);
+    int sessionIdleTimeout() const;
+
 private:
      QSharedDataPointer<QCoapSecurityConfigurationPrivate> d;
 };
@@ -0,0 +1,358 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoaptimerwheel_p.h"
+
+#include <QtCore/qalgorithms.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+
+    \class QCoapTimerWheel
+    \brief The QCoapTimerWheel class schedules a large number of deadlines
+    with a millisecond resolution.
+
+    The deadlines are stored in a hierarchical timing wheel of 4 levels of
+    64 slots each. The first level holds the deadlines of the next 64
+    milliseconds, one slot per millisecond, and each following level
+    covers 64 times the span of the previous one. Deadlines further than
+    the last level are kept in its farthest slot until they come in range.
+    When the time reaches a slot of an upper level, its entries are
+    redistributed to the lower levels.
+
+    Scheduling and cancelling an entry take constant time and do not
+    allocate memory, since entries are linked in place. Occupied slots are
+    tracked in bitmaps, so that advancing the time only visits the slots
+    which contain entries.
+
+    Expired entries are moved to a list from which they are taken one at a
+    time with takeExpired(). This lets the owner handle a whole batch of
+    expirations, while each handler is still free to cancel or destroy
+    other entries of the batch.
+*/
+
+/*!
+    \internal
+
+    \class QCoapTimerWheel::Entry
+    \brief The QCoapTimerWheel::Entry class is a deadline which can be
+    scheduled on a QCoapTimerWheel.
+
+    An entry is cancelled automatically when it is destroyed.
+*/
+
+/*!
+    \internal
+
+    Destroys the entry and removes it from its wheel.
+*/
+QCoapTimerWheel::Entry::~Entry()
+{
+    cancel();
+}
+
+/*!
+    \internal
+
+    Removes the entry from its wheel, if it is scheduled or expired and not
+    taken yet.
+*/
+void QCoapTimerWheel::Entry::cancel()
+{
+    if (wheel)
+        wheel->unlink(this);
+}
+
+/*!
+    \internal
+
+    Constructs a new empty timer wheel, whose current time is \a now.
+*/
+QCoapTimerWheel::QCoapTimerWheel(qint64 now) :
+    current(now)
+{
+}
+
+/*!
+    \internal
+
+    Destroys the timer wheel. The entries still scheduled are detached from it.
+*/
+QCoapTimerWheel::~QCoapTimerWheel()
+{
+    const auto detach = [](Entry *entry) {
+        while (entry) {
+            Entry *next = entry->next;
+            entry->wheel = nullptr;
+            entry->previous = entry->next = nullptr;
+            entry = next;
+        }
+    };
+
+    for (int level = 0; level < LevelCount; ++level) {
+        for (int slot = 0; slot < SlotCount; ++slot)
+            detach(slots[level][slot]);
+    }
+    detach(expiredHead);
+}
+
+/*!
+    \internal
+
+    Schedules \a entry to expire at the time \a deadline, in milliseconds.
+    If the entry is already scheduled, it is rescheduled.
+
+    Deadlines which are not after the current time expire at the next
+    millisecond.
+*/
+void QCoapTimerWheel::schedule(Entry *entry, qint64 deadline)
+{
+    Q_ASSERT(entry);
+
+    if (entry->wheel)
+        entry->wheel->unlink(entry);
+
+    entry->wheel = this;
+    entry->expiry = deadline;
+    ++count;
+
+    // The slot of the current time has already been processed
+    place(entry, qMax(deadline, current + 1));
+}
+
+/*!
+    \internal
+
+    Advances the current time of the wheel to \a now, and moves the entries
+    whose deadline is reached to the expired list.
+
+    \sa takeExpired()
+*/
+void QCoapTimerWheel::advance(qint64 now)
+{
+    while (current < now) {
+        // Find the next tick with entries in the first level, stopping at the
+        // end of its rotation, where the upper levels must be redistributed.
+        const int index = int(current & SlotMask);
+        const quint64 pending = (index == SlotMask)
+                ? 0 : occupied[0] & (~quint64(0) << (index + 1));
+        const qint64 next = pending ? (current & ~qint64(SlotMask)) + qCountTrailingZeroBits(pending)
+                                    : (current | SlotMask) + 1;
+        if (next > now) {
+            current = now;
+            break;
+        }
+
+        current = next;
+        const int slot = int(current & SlotMask);
+        if (slot == 0)
+            cascade(1);
+
+        Entry *entry = slots[0][slot];
+        slots[0][slot] = nullptr;
+        occupied[0] &= ~(quint64(1) << slot);
+        while (entry) {
+            Entry *following = entry->next;
+            entry->previous = entry->next = nullptr;
+            link(entry, ExpiredLevel, 0);
+            entry = following;
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Removes the oldest entry from the expired list and returns it, or returns
+    \nullptr if there is no expired entry left.
+*/
+QCoapTimerWheel::Entry *QCoapTimerWheel::takeExpired()
+{
+    Entry *entry = expiredHead;
+    if (entry)
+        unlink(entry);
+
+    return entry;
+}
+
+/*!
+    \internal
+
+    Returns the time at which the wheel needs to be advanced next, or -1 if no
+    entry is scheduled. The returned time is never after the earliest deadline,
+    but it may be before it, when entries of an upper level need to be
+    redistributed first.
+*/
+qint64 QCoapTimerWheel::nextExpiry() const
+{
+    if (expiredHead)
+        return current;
+
+    qint64 result = -1;
+    for (int level = 0; level < LevelCount; ++level) {
+        if (!occupied[level])
+            continue;
+
+        const int shift = LevelBits * level;
+        const qint64 block = current >> shift;
+        const int index = int(block & SlotMask);
+
+        // Slots up to the current index belong to the next rotation
+        const quint64 pending = (index == SlotMask)
+                ? 0 : occupied[level] & (~quint64(0) << (index + 1));
+        const qint64 nextBlock = pending
+                ? block - index + qCountTrailingZeroBits(pending)
+                : block - index + SlotCount + qCountTrailingZeroBits(occupied[level]);
+
+        const qint64 time = nextBlock << shift;
+        if (result < 0 || time < result)
+            result = time;
+    }
+
+    return result;
+}
+
+/*!
+    \internal
+
+    Links \a entry to the slot matching the time \a tick, which must not be
+    before the current time.
+*/
+void QCoapTimerWheel::place(Entry *entry, qint64 tick)
+{
+    Q_ASSERT(tick >= current);
+
+    for (int level = 0; level < LevelCount; ++level) {
+        const int shift = LevelBits * level;
+        const qint64 span = qint64(1) << (shift + LevelBits);
+        if (tick - current < span || level == LevelCount - 1) {
+            // Out of range deadlines wait in the farthest slot
+            const qint64 target = qMin(tick, current + span - 1);
+            link(entry, level, int((target >> shift) & SlotMask));
+            return;
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Inserts \a entry in the slot \a slot of \a level, or at the end of the
+    expired list if \a level is \c ExpiredLevel.
+*/
+void QCoapTimerWheel::link(Entry *entry, int level, int slot)
+{
+    entry->level = level;
+    entry->slot = slot;
+
+    if (level == ExpiredLevel) {
+        entry->previous = expiredTail;
+        entry->next = nullptr;
+        if (expiredTail)
+            expiredTail->next = entry;
+        else
+            expiredHead = entry;
+        expiredTail = entry;
+        return;
+    }
+
+    Entry *&head = slots[level][slot];
+    entry->previous = nullptr;
+    entry->next = head;
+    if (head)
+        head->previous = entry;
+    head = entry;
+    occupied[level] |= quint64(1) << slot;
+}
+
+/*!
+    \internal
+
+    Removes \a entry from the wheel.
+*/
+void QCoapTimerWheel::unlink(Entry *entry)
+{
+    Q_ASSERT(entry->wheel == this);
+
+    if (entry->level == ExpiredLevel) {
+        if (entry->previous)
+            entry->previous->next = entry->next;
+        else
+            expiredHead = entry->next;
+        if (entry->next)
+            entry->next->previous = entry->previous;
+        else
+            expiredTail = entry->previous;
+    } else {
+        Entry *&head = slots[entry->level][entry->slot];
+        if (entry->previous)
+            entry->previous->next = entry->next;
+        else
+            head = entry->next;
+        if (entry->next)
+            entry->next->previous = entry->previous;
+        if (!head)
+            occupied[entry->level] &= ~(quint64(1) << entry->slot);
+    }
+
+    entry->wheel = nullptr;
+    entry->previous = entry->next = nullptr;
+    --count;
+}
+
+/*!
+    \internal
+
+    Redistributes the entries of the current slot of \a level to the lower
+    levels. This is called when the current time reaches the start of that
+    slot, and cascades to the next level at the end of a rotation.
+*/
+void QCoapTimerWheel::cascade(int level)
+{
+    const int shift = LevelBits * level;
+    const int index = int((current >> shift) & SlotMask);
+
+    Entry *entry = slots[level][index];
+    slots[level][index] = nullptr;
+    occupied[level] &= ~(quint64(1) << index);
+
+    while (entry) {
+        Entry *following = entry->next;
+        entry->previous = entry->next = nullptr;
+        place(entry, qMax(entry->expiry, current));
+        entry = following;
+    }
+
+    if (index == 0 && level + 1 < LevelCount)
+        cascade(level + 1);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPTIMERWHEEL_P_H
+#define QCOAPTIMERWHEEL_P_H
+
+#include <QtCoap/qcoapglobal.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapTimerWheel
+{
+public:
+    class Q_AUTOTEST_EXPORT Entry
+    {
+    public:
+        Entry() = default;
+        ~Entry();
+
+        bool isScheduled() const { return wheel != nullptr; }
+        qint64 deadline() const { return expiry; }
+        void cancel();
+
+    private:
+        Q_DISABLE_COPY(Entry)
+        friend class QCoapTimerWheel;
+
+        QCoapTimerWheel *wheel = nullptr;
+        Entry *previous = nullptr;
+        Entry *next = nullptr;
+        qint64 expiry = 0;
+        int level = 0;
+        int slot = 0;
+    };
+
+    explicit QCoapTimerWheel(qint64 now = 0);
+    ~QCoapTimerWheel();
+
+    void schedule(Entry *entry, qint64 deadline);
+    void advance(qint64 now);
+    Entry *takeExpired();
+
+    qint64 nextExpiry() const;
+    qint64 currentTime() const { return current; }
+    int size() const { return count; }
+
+private:
+    Q_DISABLE_COPY(QCoapTimerWheel)
+
+    enum {
+        LevelBits = 6,
+        SlotCount = 1 << LevelBits,
+        SlotMask = SlotCount - 1,
+        LevelCount = 4,
+        // Pseudo level of the entries waiting in the expired list
+        ExpiredLevel = LevelCount
+    };
+
+    void place(Entry *entry, qint64 tick);
+    void link(Entry *entry, int level, int slot);
+    void unlink(Entry *entry);
+    void cascade(int level);
+
+    Entry *slots[LevelCount][SlotCount] = {};
+    quint64 occupied[LevelCount] = {};
+    Entry *expiredHead = nullptr;
+    Entry *expiredTail = nullptr;
+    qint64 current = 0;
+    int count = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPTIMERWHEEL_P_H
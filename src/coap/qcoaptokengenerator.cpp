@@ -0,0 +1,137 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoaptokengenerator_p.h"
+#include "qcoapnamespace_p.h"
+
+#include <QtCore/qendian.h>
+
+QT_BEGIN_NAMESPACE
+
+static const int maximumTokenSize = 8;
+
+/*!
+    \internal
+
+    \class QCoapTokenGenerator
+    \brief The QCoapTokenGenerator class generates the tokens of the requests.
+
+    In the default \l Random mode, each token is filled from the cryptographically
+    secure pool of the current thread, with a random length between the minimum
+    size and 8 bytes, as recommended by
+    \l{https://tools.ietf.org/html/rfc7252#section-5.3.1}{RFC 7252 - Section 5.3.1}.
+
+    In the \l Compact mode, tokens have exactly the minimum size and are
+    obtained by encrypting a counter with a keyed permutation of the token
+    width. Successive tokens are therefore distinct until the counter wraps
+    around, after 2^(8 * size) tokens. They are harder to guess than the plain
+    counter, but should only be used when the shorter messages matter more
+    than the protection against off-path attackers.
+
+    \value Random   Tokens are random with a variable length.
+    \value Compact  Tokens are distinct and have a fixed length.
+*/
+
+/*!
+    \internal
+
+    Constructs a new token generator with random keys and initial counter.
+*/
+QCoapTokenGenerator::QCoapTokenGenerator()
+{
+    QtCoap::fillSecureRandom(keys, sizeof(keys));
+    QtCoap::fillSecureRandom(&counter, sizeof(counter));
+}
+
+/*!
+    \internal
+
+    Returns the token generation mode.
+*/
+QCoapTokenGenerator::Mode QCoapTokenGenerator::mode() const
+{
+    return tokenMode;
+}
+
+/*!
+    \internal
+
+    Sets the token generation mode to \a mode.
+*/
+void QCoapTokenGenerator::setMode(Mode mode)
+{
+    tokenMode = mode;
+}
+
+/*!
+    \internal
+
+    Returns a new token of at least \a minimumSize bytes and at most 8 bytes.
+*/
+QCoapToken QCoapTokenGenerator::generate(int minimumSize)
+{
+    Q_ASSERT(minimumSize > 0 && minimumSize <= maximumTokenSize);
+
+    if (tokenMode == Mode::Compact) {
+        const quint64 value = permute(counter++, minimumSize * 8);
+        quint8 bytes[maximumTokenSize];
+        qToBigEndian(value, bytes);
+        return QCoapToken(reinterpret_cast<const char *>(bytes) + maximumTokenSize - minimumSize,
+                          minimumSize);
+    }
+
+    // One extra byte chooses the length
+    quint8 bytes[maximumTokenSize + 1];
+    QtCoap::fillSecureRandom(bytes, sizeof(bytes));
+
+    const int size = minimumSize + bytes[0] % (maximumTokenSize - minimumSize + 1);
+    return QCoapToken(reinterpret_cast<const char *>(bytes) + 1, size);
+}
+
+/*!
+    \internal
+
+    Returns the image of \a value by a keyed permutation of the integers
+    of \a bits bits. Every step is invertible modulo 2^bits, so distinct
+    values always give distinct results.
+*/
+quint64 QCoapTokenGenerator::permute(quint64 value, int bits) const
+{
+    const quint64 mask = (bits == 64) ? ~quint64(0) : (quint64(1) << bits) - 1;
+    const int shift = bits / 2;
+
+    value = (value ^ keys[0]) & mask;
+    value = (value * (keys[1] | 1)) & mask;
+    value ^= value >> shift;
+    value = (value * (keys[2] | 1)) & mask;
+    value ^= value >> shift;
+    return (value ^ keys[3]) & mask;
+}
+
+QT_END_NAMESPACE
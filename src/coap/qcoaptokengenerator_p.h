@@ -0,0 +1,73 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPTOKENGENERATOR_P_H
+#define QCOAPTOKENGENERATOR_P_H
+
+#include <QtCoap/qcoapglobal.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QCoapTokenGenerator
+{
+public:
+    enum class Mode {
+        Random,
+        Compact
+    };
+
+    QCoapTokenGenerator();
+
+    Mode mode() const;
+    void setMode(Mode mode);
+
+    QCoapToken generate(int minimumSize);
+
+private:
+    quint64 permute(quint64 value, int bits) const;
+
+    Mode tokenMode = Mode::Random;
+    quint64 counter = 0;
+    quint64 keys[4];
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPTOKENGENERATOR_P_H
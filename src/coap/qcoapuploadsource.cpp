@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qcoapuploadsource_p.h"
+#include "qcoapreply_p.h"
+
+#include <QtCore/qiodevice.h>
+#include <QtCore/qloggingcategory.h>
+
+QT_BEGIN_NAMESPACE
+
+Q_DECLARE_LOGGING_CATEGORY(lcCoapExchange)
+
+/*!
+    \internal
+
+    \class QCoapUploadSource
+    \brief The QCoapUploadSource class reads the payload of a blockwise
+    upload from a QIODevice, one block at a time.
+
+    It lives in the thread of the QCoapReply it belongs to, which is also
+    the thread of the device, and is driven by the protocol: each time a
+    Block1 request can be sent, readBlock() is invoked, and the block is
+    delivered with the blockRead() signal as soon as it can be read from
+    the device. Blocks must be requested in sequence.
+
+    To know whether more blocks follow, the source reads at least one byte
+    past the requested block, or waits for the end of the device. It never
+    buffers more than the requested block and the next one, so sequential
+    devices such as sockets or pipes are streamed with a bounded memory use.
+
+    For more details, refer to
+    \l{https://tools.ietf.org/html/rfc7959#section-2.5}{RFC 7959 - Section 2.5}.
+*/
+
+/*!
+    \internal
+
+    \fn void QCoapUploadSource::blockRead(const QCoapToken &token, uint blockNumber,
+                                          const QByteArray &data, bool hasMoreBlocks)
+
+    This signal is emitted when the block \a blockNumber requested for the
+    exchange identified by \a token was read from the device. The block
+    \a data is followed by further blocks if \a hasMoreBlocks is \c true.
+*/
+
+/*!
+    \internal
+
+    \fn void QCoapUploadSource::readFailed(const QCoapToken &token)
+
+    This signal is emitted when the block requested for the exchange
+    identified by \a token cannot be read from the device.
+*/
+
+/*!
+    \internal
+
+    Constructs an upload source reading from \a device, for the given
+    \a reply. The source is a child of \a reply.
+*/
+QCoapUploadSource::QCoapUploadSource(QIODevice *device, QCoapReply *reply) :
+    QObject(reply),
+    device(device),
+    reply(reply)
+{
+    Q_ASSERT(device);
+
+    if (!device->isSequential())
+        deviceTotalSize = device->size() - device->pos();
+
+    connect(device, &QIODevice::readyRead, this, &QCoapUploadSource::serveBlock);
+    connect(device, &QIODevice::readChannelFinished,
+            this, &QCoapUploadSource::onReadChannelFinished);
+    connect(device, &QIODevice::aboutToClose, this, &QCoapUploadSource::onReadChannelFinished);
+}
+
+/*!
+    \internal
+
+    Returns the size of the whole payload, or -1 if it is not known yet.
+    The size of a sequential device is only known once it is fully read.
+*/
+qint64 QCoapUploadSource::totalSize() const
+{
+    if (deviceTotalSize >= 0)
+        return deviceTotalSize;
+    return deviceFinished ? windowOffset + window.size() : -1;
+}
+
+/*!
+    \internal
+
+    Returns the number of bytes read from the device but not yet consumed.
+*/
+qint64 QCoapUploadSource::bufferedSize() const
+{
+    return window.size();
+}
+
+/*!
+    \internal
+
+    Returns \c true if the whole device was read.
+*/
+bool QCoapUploadSource::isAtEnd() const
+{
+    return deviceFinished;
+}
+
+/*!
+    \internal
+
+    Requests the block \a blockNumber of \a blockSize bytes for the exchange
+    identified by \a token. The blockRead() signal is emitted right away if
+    the block can already be read, otherwise once the device has enough data.
+
+    As the block follows the ones acknowledged by the server, the upload
+    progress of the reply is updated.
+*/
+void QCoapUploadSource::readBlock(const QCoapToken &token, uint blockNumber, uint blockSize)
+{
+    Q_ASSERT(blockSize > 0);
+
+    pendingToken = token;
+    pendingBlockNumber = blockNumber;
+    pendingBlockSize = blockSize;
+    hasPendingBlock = true;
+
+    if (blockNumber > 0) {
+        QCoapReplyPrivate::get(reply)->setUploadProgress(qint64(blockNumber) * blockSize,
+                                                         totalSize());
+    }
+
+    serveBlock();
+}
+
+/*!
+    \internal
+
+    Reads from the device until the window ends at \a end or no more data is
+    available. Returns \c false if the device cannot be read.
+*/
+bool QCoapUploadSource::fillWindow(qint64 end)
+{
+    while (!deviceFinished && windowOffset + window.size() < end) {
+        const int bufferSize = window.size();
+        const int wanted = static_cast<int>(end - windowOffset - bufferSize);
+
+        window.resize(bufferSize + wanted);
+        const qint64 read = device->read(window.data() + bufferSize, wanted);
+        window.resize(bufferSize + static_cast<int>(qMax(read, qint64(0))));
+
+        if (read < 0)
+            return false;
+
+        if (read == 0) {
+            // A sequential device may only be waiting for more data
+            if (!device->isSequential() || readChannelClosed || !device->isOpen())
+                deviceFinished = true;
+            break;
+        }
+    }
+    return true;
+}
+
+/*!
+    \internal
+
+    Emits the blockRead() signal for the pending block, if it can be read.
+*/
+void QCoapUploadSource::serveBlock()
+{
+    if (!hasPendingBlock)
+        return;
+
+    if (device.isNull()) {
+        fail("device was destroyed");
+        return;
+    }
+
+    const qint64 blockOffset = qint64(pendingBlockNumber) * pendingBlockSize;
+    const qint64 blockEnd = blockOffset + pendingBlockSize;
+
+    // The requested block follows the previous one, which was acknowledged
+    if (blockOffset < windowOffset || blockOffset > windowOffset + window.size()) {
+        fail("blocks must be read in sequence");
+        return;
+    }
+    window.remove(0, static_cast<int>(blockOffset - windowOffset));
+    windowOffset = blockOffset;
+
+    // Read the next block ahead, and at least one byte to know if it exists
+    if (!fillWindow(blockEnd + pendingBlockSize + 1)) {
+        fail("read error");
+        return;
+    }
+
+    const qint64 windowEnd = windowOffset + window.size();
+    if (windowEnd <= blockEnd && !deviceFinished)
+        return;
+
+    hasPendingBlock = false;
+    emit blockRead(pendingToken, pendingBlockNumber,
+                   window.left(static_cast<int>(pendingBlockSize)), windowEnd > blockEnd);
+}
+
+/*!
+    \internal
+
+    Gives up reading the pending block because of \a reason.
+*/
+void QCoapUploadSource::fail(const char *reason)
+{
+    qCWarning(lcCoapExchange, "Cannot read block %u of the upload: %s.",
+              pendingBlockNumber, reason);
+
+    hasPendingBlock = false;
+    emit readFailed(pendingToken);
+}
+
+/*!
+    \internal
+
+    Marks the end of a sequential device, once its remaining data is read.
+*/
+void QCoapUploadSource::onReadChannelFinished()
+{
+    readChannelClosed = true;
+    serveBlock();
+}
+
+QT_END_NAMESPACE
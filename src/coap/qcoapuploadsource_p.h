@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QCOAPUPLOADSOURCE_P_H
+#define QCOAPUPLOADSOURCE_P_H
+
+#include <QtCoap/qcoapglobal.h>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qpointer.h>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+QT_BEGIN_NAMESPACE
+
+class QIODevice;
+class QCoapReply;
+class Q_AUTOTEST_EXPORT QCoapUploadSource : public QObject
+{
+    Q_OBJECT
+public:
+    QCoapUploadSource(QIODevice *device, QCoapReply *reply);
+
+    qint64 totalSize() const;
+    qint64 bufferedSize() const;
+    bool isAtEnd() const;
+
+    Q_INVOKABLE void readBlock(const QCoapToken &token, uint blockNumber, uint blockSize);
+
+Q_SIGNALS:
+    void blockRead(const QCoapToken &token, uint blockNumber, const QByteArray &data,
+                   bool hasMoreBlocks);
+    void readFailed(const QCoapToken &token);
+
+private:
+    bool fillWindow(qint64 end);
+    void serveBlock();
+    void fail(const char *reason);
+    void onReadChannelFinished();
+
+    QPointer<QIODevice> device;
+    QCoapReply *reply = nullptr;
+
+    QByteArray window;
+    qint64 windowOffset = 0;
+    qint64 deviceTotalSize = -1;
+    bool deviceFinished = false;
+    bool readChannelClosed = false;
+
+    QCoapToken pendingToken;
+    uint pendingBlockNumber = 0;
+    uint pendingBlockSize = 0;
+    bool hasPendingBlock = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCOAPUPLOADSOURCE_P_H
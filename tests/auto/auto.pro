@@ -2,6 +2,7 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     cmake \
+    qcoapasync \
     qcoapclient \
     qcoapmessage \
     qcoapoption \
@@ -10,6 +11,18 @@ SUBDIRS += \
 
 qtConfig(private_tests): SUBDIRS += \
     qcoapqudpconnection \
+    qcoapqtcpconnection \
+    qcoapblocksizecontroller \
+    qcoapendpoint \
     qcoapinternalrequest \
     qcoapinternalreply \
-    qcoapreply
+    qcoaplockfreequeue \
+    qcoapmessageidallocator \
+    qcoappduview \
+    qcoapreply \
+    qcoapreplydispatcher \
+    qcoaprequestscheduler \
+    qcoaprttestimator \
+    qcoaptimerwheel \
+    qcoaptokengenerator \
+    qcoapuploadsource
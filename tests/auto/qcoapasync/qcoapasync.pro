@@ -0,0 +1,7 @@
+QT = testlib network core coap
+CONFIG += testcase c++2a
+
+# GCC 10 only enables coroutines on request
+gcc:!clang:equals(QMAKE_GCC_MAJOR_VERSION, 10): QMAKE_CXXFLAGS += -fcoroutines
+
+SOURCES += tst_qcoapasync.cpp
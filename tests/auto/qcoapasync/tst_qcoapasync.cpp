@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapasync.h>
+#include <QtCoap/qcoapclient.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtNetwork/qnetworkdatagram.h>
+#include <QtNetwork/qudpsocket.h>
+
+class tst_QCoapAsync : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void awaitResult();
+    void awaitNotifications();
+};
+
+#ifdef QT_COAP_COROUTINES
+/*
+    A coroutine started eagerly and destroyed when it returns, enough to
+    await the results of the client.
+*/
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static DetachedTask awaitGet(QCoapClient *client, QCoapRequest request, QCoapResult *result,
+                             bool *done)
+{
+    *result = co_await client->getAsync(request);
+    *done = true;
+}
+
+static DetachedTask awaitObserve(QCoapClient *client, QCoapRequest request,
+                                 QVector<QByteArray> *payloads, bool *done)
+{
+    QCoapNotificationStream stream = client->observeAsync(request);
+    while (std::optional<QCoapMessage> notification = co_await stream)
+        payloads->append(notification->payload());
+    *done = true;
+}
+#endif
+
+void tst_QCoapAsync::awaitResult()
+{
+#ifdef QT_COAP_COROUTINES
+    QCoapClient client;
+    client.setAckTimeout(100);
+    client.setMaximumRetransmitCount(0);
+
+    // A local server answering the requests to /content with a piggybacked
+    // 2.05 Content response, and ignoring the other requests
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            if (!request.contains("content"))
+                continue;
+
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            response.append(static_cast<char>(0xFF));
+            response.append("21.5");
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+    const QString baseUrl = QStringLiteral("coap://127.0.0.1:%1/").arg(server.localPort());
+
+    // Successful request
+    QCoapResult result;
+    bool done = false;
+    awaitGet(&client, QCoapRequest(QUrl(baseUrl + "content")), &result, &done);
+    QVERIFY(!done);
+    QTRY_VERIFY(done);
+    QVERIFY(result.isSuccessful());
+    QCOMPARE(result.payload, QByteArray("21.5"));
+
+    // Timeout
+    done = false;
+    awaitGet(&client, QCoapRequest(QUrl(baseUrl + "silent"), QCoapMessage::Type::Confirmable),
+             &result, &done);
+    QVERIFY(!done);
+    QTRY_VERIFY_WITH_TIMEOUT(done, 5000);
+    QCOMPARE(result.error, QtCoap::Error::TimeOut);
+
+    // A request which cannot be sent does not suspend the coroutine
+    done = false;
+    awaitGet(&client, QCoapRequest(QUrl("coap://")), &result, &done);
+    QVERIFY(done);
+    QCOMPARE(result.error, QtCoap::Error::Unknown);
+#else
+    QSKIP("The compiler does not support coroutines, skipping this test");
+#endif
+}
+
+void tst_QCoapAsync::awaitNotifications()
+{
+#ifdef QT_COAP_COROUTINES
+    QCoapClient client;
+
+    // A local server answering an observe request with two notifications,
+    // then ending the observation with a 4.04 Not Found response
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            const int tokenLength = request.at(0) & 0x0F;
+            const QByteArray token = request.mid(4, tokenLength);
+
+            const auto notification = [&](char code, const QByteArray &messageId,
+                                          char sequence, const QByteArray &payload) {
+                QByteArray frame;
+                frame.append(static_cast<char>(0x50 | tokenLength));
+                frame.append(code);
+                frame.append(messageId);
+                frame.append(token);
+                if (sequence) {
+                    frame.append(static_cast<char>(0x61)); // Observe
+                    frame.append(sequence);
+                }
+                if (!payload.isEmpty()) {
+                    frame.append(static_cast<char>(0xFF));
+                    frame.append(payload);
+                }
+                server.writeDatagram(datagram.makeReply(frame));
+            };
+            // Acknowledges a confirmable request with an empty message
+            if ((request.at(0) & 0x30) == 0) {
+                QByteArray ack;
+                ack.append(static_cast<char>(0x60));
+                ack.append(static_cast<char>(0x00));
+                ack.append(request.mid(2, 2));
+                server.writeDatagram(datagram.makeReply(ack));
+            }
+            notification(0x45, QByteArray::fromHex("2000"), 5, "a");
+            notification(0x45, QByteArray::fromHex("2001"), 6, "b");
+            notification(static_cast<char>(0x84), QByteArray::fromHex("2002"), 0, QByteArray());
+        }
+    });
+
+    QVector<QByteArray> payloads;
+    bool done = false;
+    awaitObserve(&client,
+                 QCoapRequest(QUrl(QStringLiteral("coap://127.0.0.1:%1/temperature")
+                                   .arg(server.localPort()))),
+                 &payloads, &done);
+    QVERIFY(!done);
+    QTRY_VERIFY(done);
+    QCOMPARE(payloads, QVector<QByteArray>({ "a", "b" }));
+
+    // A stream which cannot be observed ends at once
+    payloads.clear();
+    done = false;
+    awaitObserve(&client, QCoapRequest(QUrl("coap://")), &payloads, &done);
+    QVERIFY(done);
+    QVERIFY(payloads.isEmpty());
+#else
+    QSKIP("The compiler does not support coroutines, skipping this test");
+#endif
+}
+
+QTEST_MAIN(tst_QCoapAsync)
+
+#include "tst_qcoapasync.moc"
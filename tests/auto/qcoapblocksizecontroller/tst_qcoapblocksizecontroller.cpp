@@ -0,0 +1,278 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoapblocksizecontroller_p.h>
+
+class tst_QCoapBlockSizeController : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initialBlockSize_data();
+    void initialBlockSize();
+    void blockSizeForMtu_data();
+    void blockSizeForMtu();
+    void pathMtuPerSubnet();
+    void stepUp();
+    void stepDown();
+    void stepUpThresholdBackoff();
+    void ignoredLosses();
+    void serverLimit();
+    void independentEndpoints();
+};
+
+static const QHostAddress lanHost(QStringLiteral("192.168.1.10"));
+static const QHostAddress remoteHost(QStringLiteral("10.20.30.40"));
+
+void tst_QCoapBlockSizeController::initialBlockSize_data()
+{
+    QTest::addColumn<uint>("configured");
+    QTest::addColumn<uint>("expected");
+
+    QTest::newRow("default") << 0u << 1024u;
+    QTest::newRow("configured") << 256u << 256u;
+    QTest::newRow("too_small") << 8u << 16u;
+    QTest::newRow("too_large") << 4096u << 1024u;
+}
+
+void tst_QCoapBlockSizeController::initialBlockSize()
+{
+    QFETCH(uint, configured);
+    QFETCH(uint, expected);
+
+    QCoapBlockSizeController controller;
+    QCOMPARE(controller.initialBlockSize(), 1024u);
+
+    controller.setInitialBlockSize(configured);
+    QCOMPARE(controller.initialBlockSize(), expected);
+    QCOMPARE(controller.blockSize(lanHost), expected);
+    QCOMPARE(controller.endpointCount(), 0);
+
+    const QCoapBlockSizeController::Statistics statistics = controller.statistics(lanHost);
+    QCOMPARE(statistics.blockSize, expected);
+    QCOMPARE(statistics.maximumBlockSize, 1024u);
+    QCOMPARE(statistics.lastUpdate, qint64(-1));
+}
+
+void tst_QCoapBlockSizeController::blockSizeForMtu_data()
+{
+    QTest::addColumn<int>("mtu");
+    QTest::addColumn<QAbstractSocket::NetworkLayerProtocol>("protocol");
+    QTest::addColumn<uint>("blockSize");
+
+    QTest::newRow("unknown") << 0 << QAbstractSocket::IPv4Protocol << 1024u;
+    QTest::newRow("ethernet") << 1500 << QAbstractSocket::IPv4Protocol << 1024u;
+    QTest::newRow("ipv6_minimum") << 1280 << QAbstractSocket::IPv6Protocol << 1024u;
+    QTest::newRow("ipv4_minimum") << 576 << QAbstractSocket::IPv4Protocol << 256u;
+    QTest::newRow("ipv6_just_below") << 1135 << QAbstractSocket::IPv6Protocol << 512u;
+    QTest::newRow("ipv6_exact") << 1136 << QAbstractSocket::IPv6Protocol << 1024u;
+    QTest::newRow("6lowpan") << 127 << QAbstractSocket::IPv6Protocol << 16u;
+}
+
+void tst_QCoapBlockSizeController::blockSizeForMtu()
+{
+    QFETCH(int, mtu);
+    QFETCH(QAbstractSocket::NetworkLayerProtocol, protocol);
+    QFETCH(uint, blockSize);
+
+    QCOMPARE(QCoapBlockSizeController::blockSizeForMtu(mtu, protocol), blockSize);
+}
+
+void tst_QCoapBlockSizeController::pathMtuPerSubnet()
+{
+    QCoapBlockSizeController controller;
+    QCOMPARE(controller.pathMtu(lanHost), 0);
+
+    controller.setPathMtu(1500);
+    controller.setPathMtu(QHostAddress(QStringLiteral("192.168.0.0")), 16, 576);
+    controller.setPathMtu(QHostAddress(QStringLiteral("192.168.1.0")), 24, 400);
+
+    // The most specific subnet wins
+    QCOMPARE(controller.pathMtu(lanHost), 400);
+    QCOMPARE(controller.pathMtu(QHostAddress(QStringLiteral("192.168.2.1"))), 576);
+    QCOMPARE(controller.pathMtu(remoteHost), 1500);
+
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+    QCOMPARE(controller.blockSize(QHostAddress(QStringLiteral("192.168.2.1"))), 256u);
+    QCOMPARE(controller.blockSize(remoteHost), 1024u);
+
+    controller.setPathMtu(QHostAddress(QStringLiteral("192.168.1.0")), 24, 300);
+    QCOMPARE(controller.pathMtu(lanHost), 300);
+    QCOMPARE(controller.blockSize(lanHost), 128u);
+
+    controller.setPathMtu(QHostAddress(QStringLiteral("192.168.1.0")), 24, 0);
+    QCOMPARE(controller.pathMtu(lanHost), 576);
+}
+
+void tst_QCoapBlockSizeController::stepUp()
+{
+    QCoapBlockSizeController controller;
+    controller.setInitialBlockSize(64);
+
+    for (int i = 0; i < 7; ++i)
+        controller.addTransfer(lanHost, 64, 0, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 64u);
+    QCOMPARE(controller.statistics(lanHost).cleanTransferCount, 7);
+
+    controller.addTransfer(lanHost, 64, 0, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 128u);
+    QCOMPARE(controller.statistics(lanHost).cleanTransferCount, 0);
+
+    // A retransmitted block restarts the count
+    for (int i = 0; i < 7; ++i)
+        controller.addTransfer(lanHost, 128, 0, 1000);
+    controller.addTransfer(lanHost, 128, 1, 1000);
+    controller.addTransfer(lanHost, 128, 0, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 128u);
+
+    // Blocks of the previous size do not count
+    for (int i = 0; i < 10; ++i)
+        controller.addTransfer(lanHost, 64, 0, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 128u);
+
+    // The block size never exceeds the path MTU
+    controller.setPathMtu(400);
+    for (int i = 0; i < 100; ++i)
+        controller.addTransfer(lanHost, controller.blockSize(lanHost), 0, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+}
+
+void tst_QCoapBlockSizeController::stepDown()
+{
+    QCoapBlockSizeController controller;
+    QCOMPARE(controller.blockSize(lanHost), 1024u);
+
+    // A single timeout may be a random loss
+    QCOMPARE(controller.addLoss(lanHost, 1024, 1000), false);
+    QCOMPARE(controller.blockSize(lanHost), 1024u);
+
+    QCOMPARE(controller.addLoss(lanHost, 1024, 2000), true);
+    QCOMPARE(controller.blockSize(lanHost), 512u);
+    QCOMPARE(controller.statistics(lanHost).stepDownCount, 1);
+
+    // Blocks of the previous size still in flight follow the new size
+    QCOMPARE(controller.addLoss(lanHost, 1024, 2500), true);
+    QCOMPARE(controller.blockSize(lanHost), 512u);
+
+    // A block received in between means the losses are not due to its size
+    QCOMPARE(controller.addLoss(lanHost, 512, 3000), false);
+    controller.addTransfer(lanHost, 512, 1, 3500);
+    QCOMPARE(controller.addLoss(lanHost, 512, 4000), false);
+    QCOMPARE(controller.blockSize(lanHost), 512u);
+
+    // The block size stops at the smallest size
+    for (int i = 0; i < 20; ++i)
+        controller.addLoss(lanHost, controller.blockSize(lanHost), 5000);
+    QCOMPARE(controller.blockSize(lanHost), 16u);
+    QCOMPARE(controller.addLoss(lanHost, 16, 6000), false);
+}
+
+void tst_QCoapBlockSizeController::stepUpThresholdBackoff()
+{
+    QCoapBlockSizeController controller;
+    controller.setInitialBlockSize(256);
+    QCOMPARE(controller.statistics(lanHost).stepUpThreshold, 8);
+
+    controller.addLoss(lanHost, 256, 1000);
+    controller.addLoss(lanHost, 256, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 128u);
+    QCOMPARE(controller.statistics(lanHost).stepUpThreshold, 16);
+
+    for (int i = 0; i < 15; ++i)
+        controller.addTransfer(lanHost, 128, 0, 2000);
+    QCOMPARE(controller.blockSize(lanHost), 128u);
+    controller.addTransfer(lanHost, 128, 0, 2000);
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+
+    // The threshold is bounded
+    for (int i = 0; i < 20; ++i) {
+        controller.addLoss(lanHost, 256, 3000);
+        controller.addLoss(lanHost, 256, 3000);
+        while (controller.blockSize(lanHost) < 256)
+            controller.addTransfer(lanHost, controller.blockSize(lanHost), 0, 3000);
+    }
+    QCOMPARE(controller.statistics(lanHost).stepUpThreshold, 128);
+}
+
+void tst_QCoapBlockSizeController::ignoredLosses()
+{
+    QCoapBlockSizeController controller;
+    controller.setInitialBlockSize(128);
+
+    // Losses of blocks smaller than the current size do not reduce it
+    for (int i = 0; i < 8; ++i)
+        controller.addTransfer(lanHost, 128, 0, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+    QCOMPARE(controller.addLoss(lanHost, 128, 1000), false);
+    QCOMPARE(controller.addLoss(lanHost, 128, 1000), false);
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+}
+
+void tst_QCoapBlockSizeController::serverLimit()
+{
+    QCoapBlockSizeController controller;
+
+    controller.limitBlockSize(lanHost, 256, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+    QCOMPARE(controller.statistics(lanHost).stepDownCount, 0);
+
+    // A larger size chosen by the server does not raise the block size
+    controller.limitBlockSize(lanHost, 512, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 256u);
+}
+
+void tst_QCoapBlockSizeController::independentEndpoints()
+{
+    QCoapBlockSizeController controller;
+
+    controller.addLoss(lanHost, 1024, 1000);
+    controller.addLoss(lanHost, 1024, 1000);
+    QCOMPARE(controller.blockSize(lanHost), 512u);
+    QCOMPARE(controller.blockSize(remoteHost), 1024u);
+    QCOMPARE(controller.endpointCount(), 1);
+
+    controller.addTransfer(remoteHost, 1024, 0, 2000);
+    QCOMPARE(controller.endpointCount(), 2);
+
+    // Idle endpoints are forgotten
+    const qint64 later = 2000 + 10 * 60 * 1000;
+    controller.addTransfer(remoteHost, 1024, 0, later);
+    QCOMPARE(controller.endpointCount(), 1);
+    QCOMPARE(controller.blockSize(lanHost), 1024u);
+
+    controller.clear();
+    QCOMPARE(controller.endpointCount(), 0);
+}
+
+QTEST_MAIN(tst_QCoapBlockSizeController)
+
+#include "tst_qcoapblocksizecontroller.moc"
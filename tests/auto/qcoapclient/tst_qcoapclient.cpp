@@ -31,6 +31,7 @@
 #include <QtTest>
 #include <QCoreApplication>
 
+#include <QtCoap/qcoapasync.h>
 #include <QtCoap/qcoapclient.h>
 #include <QtCoap/qcoaprequest.h>
 #include <QtCoap/qcoapreply.h>
@@ -39,6 +40,7 @@
 #include <QtNetwork/qnetworkdatagram.h>
 #include <QtNetwork/qsslcipher.h>
 #include <private/qcoapclient_p.h>
+#include <private/qcoapinternalrequest_p.h>
 #include <private/qcoapqudpconnection_p.h>
 #include <private/qcoapprotocol_p.h>
 #include <private/qcoaprequest_p.h>
@@ -71,6 +73,9 @@ private Q_SLOTS:
     void multipleRequests();
     void blockwiseReply_data();
     void blockwiseReply();
+    void blockRange_data();
+    void blockRange();
+    void getBlockRanges();
     void blockwiseRequest_data();
     void blockwiseRequest();
     void discover_data();
@@ -82,6 +87,19 @@ private Q_SLOTS:
     void multicast_blockwise();
     void setMinimumTokenSize_data();
     void setMinimumTokenSize();
+    void workerThreads();
+    void customConnectionShards();
+    void callbackRequests();
+    void cancelCallbackRequest();
+    void concurrentCallbackRequests();
+    void asyncRequests();
+    void batchRequests();
+    void notificationFreshness_data();
+    void notificationFreshness();
+    void staleNotifications();
+    void messageIdMappedAddress();
+    void reducedBlockSizeTimeout();
+    void roundTripStatistics();
 };
 
 class QCoapClientForSecurityTests : public QCoapClient
@@ -191,18 +209,16 @@ class QCoapConnectionMulticastTests : public QCoapConnection
 public:
     ~QCoapConnectionMulticastTests() override = default;
 
-    void bind(const QString &host, quint16 port) override
+    void bind(const QCoapEndpoint &endpoint) override
     {
-        Q_UNUSED(host);
-        Q_UNUSED(port);
+        Q_UNUSED(endpoint);
         // Do nothing
     }
 
-    void writeData(const QByteArray &data, const QString &host, quint16 port) override
+    void writeData(const QByteArray &data, const QCoapEndpoint &endpoint) override
     {
         Q_UNUSED(data);
-        Q_UNUSED(host);
-        Q_UNUSED(port);
+        Q_UNUSED(endpoint);
         // Do nothing
     }
 
@@ -225,6 +241,19 @@ public:
     }
 };
 
+class QCoapClientForShardTests : public QCoapClient
+{
+public:
+    explicit QCoapClientForShardTests(int workerThreadCount)
+        : QCoapClient(QtCoap::SecurityMode::NoSecurity, workerThreadCount)
+    {}
+
+    QCoapClientPrivate *privateClient()
+    {
+        return static_cast<QCoapClientPrivate *>(d_func());
+    }
+};
+
 #endif
 
 class Helper : public QObject
@@ -679,13 +708,8 @@ void tst_QCoapClient::abort()
     QCOMPARE(spyReplyError.count(), 0);
 }
 
-void tst_QCoapClient::blockwiseReply_data()
+static QByteArray largeResourceData()
 {
-    QTest::addColumn<QUrl>("url");
-    QTest::addColumn<QCoapMessage::Type>("type");
-    QTest::addColumn<QByteArray>("replyData");
-    QTest::addColumn<QtCoap::SecurityMode>("security");
-
     QByteArray data;
     data.append("/-------------------------------------------------------------\\\n");
     data.append("|                 RESOURCE BLOCK NO. 1 OF 5                   |\n");
@@ -707,6 +731,17 @@ void tst_QCoapClient::blockwiseReply_data()
     data.append("|                 RESOURCE BLOCK NO. 5 OF 5                   |\n");
     data.append("|               [each line contains 64 bytes]                 |\n");
     data.append("\\-------------------------------------------------------------/\n");
+    return data;
+}
+
+void tst_QCoapClient::blockwiseReply_data()
+{
+    QTest::addColumn<QUrl>("url");
+    QTest::addColumn<QCoapMessage::Type>("type");
+    QTest::addColumn<QByteArray>("replyData");
+    QTest::addColumn<QtCoap::SecurityMode>("security");
+
+    const QByteArray data = largeResourceData();
 
     QTest::newRow("get_large")
             << QUrl(testServerUrl() + "/large")
@@ -781,6 +816,73 @@ void tst_QCoapClient::blockwiseReply()
     QCOMPARE(reply->readAll(), replyData);
 }
 
+void tst_QCoapClient::blockRange_data()
+{
+    QTest::addColumn<uint>("firstBlock");
+    QTest::addColumn<uint>("lastBlock");
+    QTest::addColumn<quint16>("blockSize");
+    QTest::addColumn<QByteArray>("replyData");
+
+    const QByteArray data = largeResourceData();
+    QTest::newRow("head") << 0u << 1u << quint16(64) << data.left(128);
+    QTest::newRow("slice") << 5u << 9u << quint16(64) << data.mid(320, 320);
+    QTest::newRow("tail") << 18u << 100u << quint16(64) << data.mid(1152);
+    QTest::newRow("single_block") << 2u << 2u << quint16(256) << data.mid(512, 256);
+    QTest::newRow("client_block_size_ignored") << 1u << 1u << quint16(512) << data.mid(512, 512);
+}
+
+void tst_QCoapClient::blockRange()
+{
+    CHECK_FOR_COAP_SERVER;
+
+    QFETCH(uint, firstBlock);
+    QFETCH(uint, lastBlock);
+    QFETCH(quint16, blockSize);
+    QFETCH(QByteArray, replyData);
+
+    QCoapClient client;
+    if (qstrcmp(QTest::currentDataTag(), "client_block_size_ignored") == 0)
+        client.setBlockSize(16);
+
+    QCoapRequest request(QUrl(testServerUrl() + "/large"));
+    request.setBlockRange(firstBlock, lastBlock, blockSize);
+
+    QScopedPointer<QCoapReply> reply(client.get(request));
+    QVERIFY(!reply.isNull());
+    QSignalSpy spyReplyFinished(reply.data(), &QCoapReply::finished);
+
+    QTRY_COMPARE_WITH_TIMEOUT(spyReplyFinished.count(), 1, 30000);
+    QVERIFY(reply->isSuccessful());
+    QCOMPARE(reply->readAll(), replyData);
+}
+
+void tst_QCoapClient::getBlockRanges()
+{
+    CHECK_FOR_COAP_SERVER;
+
+    const QByteArray data = largeResourceData();
+
+    QCoapClient client;
+    client.setMaximumOutstandingRequests(2);
+
+    QCoapRequest request(QUrl(testServerUrl() + "/large"));
+    const QVector<QCoapReply *> replies = client.getBlockRanges(request, data.size(), 128, 3);
+    QCOMPARE(replies.size(), 4);
+
+    QByteArray payload;
+    for (QCoapReply *reply : replies) {
+        QVERIFY(reply);
+        QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 30000);
+        QVERIFY(reply->isSuccessful());
+        payload.append(reply->readAll());
+    }
+    QCOMPARE(payload, data);
+
+    QVERIFY(client.getBlockRanges(request, 0, 128, 3).isEmpty());
+    QVERIFY(client.getBlockRanges(request, data.size(), 100, 3).isEmpty());
+    QVERIFY(client.getBlockRanges(request, data.size(), 128, 0).isEmpty());
+}
+
 void tst_QCoapClient::blockwiseRequest_data()
 {
     QTest::addColumn<QUrl>("url");
@@ -1117,6 +1219,675 @@ void tst_QCoapClient::setMinimumTokenSize()
 #endif
 }
 
+void tst_QCoapClient::workerThreads()
+{
+#ifdef QT_BUILD_INTERNAL
+    QCoapClientForShardTests client(4);
+    QCOMPARE(client.privateClient()->shards.size(), 4);
+
+    // Local servers answering each request with a piggybacked 2.05 Content
+    // response, and recording the port the request was sent from
+    const int serverCount = 8;
+    QObject serverParent;
+    QVector<QUrl> urls;
+    QVector<quint16> clientPorts(serverCount, 0);
+    for (int i = 0; i < serverCount; ++i) {
+        auto server = new QUdpSocket(&serverParent);
+        QVERIFY(server->bind(QHostAddress::LocalHost, 0));
+        connect(server, &QUdpSocket::readyRead, server, [server, i, &clientPorts]() {
+            while (server->hasPendingDatagrams()) {
+                const QNetworkDatagram datagram = server->receiveDatagram();
+                const QByteArray request = datagram.data();
+                const int tokenLength = request.at(0) & 0x0F;
+                QByteArray response;
+                response.append(static_cast<char>(0x60 | tokenLength));
+                response.append(static_cast<char>(0x45));
+                response.append(request.mid(2, 2 + tokenLength));
+                response.append(static_cast<char>(0xFF));
+                response.append(QByteArray::number(i));
+                clientPorts[i] = static_cast<quint16>(datagram.senderPort());
+                server->writeDatagram(datagram.makeReply(response));
+            }
+        });
+        urls.append(QUrl(QStringLiteral("coap://127.0.0.1:%1/shard").arg(server->localPort())));
+    }
+
+    QSignalSpy spyClientFinished(&client, &QCoapClient::finished);
+    QVector<QCoapReply *> replies;
+    for (const QUrl &url : qAsConst(urls))
+        replies.append(client.get(url));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spyClientFinished.count(), serverCount, 5000);
+    for (int i = 0; i < serverCount; ++i) {
+        QVERIFY(replies.at(i)->isSuccessful());
+        QCOMPARE(replies.at(i)->readAll(), QByteArray::number(i));
+    }
+
+    // Each server is served by the socket of its own shard
+    for (int i = 0; i < serverCount; ++i) {
+        for (int j = 0; j < serverCount; ++j) {
+            const bool sameShard = client.privateClient()->shardFor(urls.at(i)).protocol
+                    == client.privateClient()->shardFor(urls.at(j)).protocol;
+            QCOMPARE(clientPorts.at(i) == clientPorts.at(j), sameShard);
+        }
+    }
+#else
+    QSKIP("Not an internal build, skipping this test");
+#endif
+}
+
+void tst_QCoapClient::customConnectionShards()
+{
+#ifdef QT_BUILD_INTERNAL
+    QCoapClientForShardTests client(4);
+    QCoapClientPrivate *privateClient = client.privateClient();
+    QCOMPARE(privateClient->shards.size(), 4);
+    for (const QCoapClientShard &shard : qAsConst(privateClient->shards))
+        QVERIFY(shard.tcpConnection);
+
+    // A custom connection serves every server, in a single shard
+    auto customConnection = new QCoapConnectionMulticastTests;
+    privateClient->setConnection(customConnection);
+    QCOMPARE(privateClient->shards.size(), 1);
+    QCOMPARE(privateClient->connection, customConnection);
+    QCOMPARE(privateClient->shards.first().connection, customConnection);
+    QCOMPARE(privateClient->shards.first().protocol, privateClient->protocol);
+    QVERIFY(privateClient->shards.first().tcpConnection);
+
+    for (int port = 5683; port < 5693; ++port) {
+        const QUrl url(QStringLiteral("coap://127.0.0.1:%1/test").arg(port));
+        QCOMPARE(privateClient->shardFor(url).connection, customConnection);
+    }
+#else
+    QSKIP("Not an internal build, skipping this test");
+#endif
+}
+
+void tst_QCoapClient::callbackRequests()
+{
+    QCoapClient client;
+    client.setAckTimeout(100);
+    client.setMaximumRetransmitCount(0);
+
+    // A local server answering the requests to /content with a piggybacked
+    // 2.05 Content response, and ignoring the other requests
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            if (!request.contains("content"))
+                continue;
+
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            response.append(static_cast<char>(0xC0)); // Content-Format: text/plain
+            response.append(static_cast<char>(0xFF));
+            response.append("21.5");
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+    const QString baseUrl = QStringLiteral("coap://127.0.0.1:%1/").arg(server.localPort());
+    const QCoapRequest content(QUrl(baseUrl + "content"));
+    QSignalSpy spyClientFinished(&client, &QCoapClient::finished);
+
+    // Successful request
+    int callCount = 0;
+    QCoapResult result;
+    QCoapRequestHandle handle = client.get(content, [&](QCoapResult r) {
+        ++callCount;
+        result = std::move(r);
+    });
+    QVERIFY(!handle.isNull());
+    QVERIFY(!handle.isFinished());
+    QTRY_VERIFY(handle.isFinished());
+    QCOMPARE(callCount, 1);
+    QVERIFY(result.isSuccessful());
+    QCOMPARE(result.responseCode, QtCoap::ResponseCode::Content);
+    QCOMPARE(result.payload, QByteArray("21.5"));
+    QCOMPARE(result.options.size(), 1);
+    QCOMPARE(result.options.first().name(), QCoapOption::ContentFormat);
+
+    // Timeout
+    QCoapRequest confirmable(QUrl(baseUrl + "silent"), QCoapMessage::Type::Confirmable);
+    handle = client.get(confirmable, [&](QCoapResult r) {
+        ++callCount;
+        result = std::move(r);
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(handle.isFinished(), 5000);
+    QCOMPARE(callCount, 2);
+    QVERIFY(!result.isSuccessful());
+    QCOMPARE(result.error, QtCoap::Error::TimeOut);
+    QCOMPARE(result.responseCode, QtCoap::ResponseCode::InvalidCode);
+
+    // Cancelled request, whose callback is never called
+    handle = client.get(confirmable, [&](QCoapResult) { ++callCount; });
+    handle.cancel();
+    QTest::qWait(500);
+    QVERIFY(!handle.isFinished());
+    QCOMPARE(callCount, 2);
+
+    // Requests which cannot be sent
+    QVERIFY(client.get(QCoapRequest("coap://"), [&](QCoapResult) { ++callCount; }).isNull());
+    QVERIFY(client.get(content, QCoapResultCallback()).isNull());
+    QCoapRequest observe(content);
+    observe.enableObserve();
+    QVERIFY(client.get(observe, [&](QCoapResult) { ++callCount; }).isNull());
+
+    // No reply is created for these requests
+    QCOMPARE(spyClientFinished.count(), 0);
+    QVERIFY(client.findChildren<QCoapReply *>().isEmpty());
+}
+
+void tst_QCoapClient::cancelCallbackRequest()
+{
+    QCoapClient client;
+    client.setAckTimeout(10000);
+    client.setMaximumRetransmitCount(0);
+    client.setMaximumOutstandingRequests(1);
+
+    // A local server answering the requests to /content, and counting the others
+    int silentCount = 0;
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server, &silentCount]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            if (!request.contains("content")) {
+                ++silentCount;
+                continue;
+            }
+
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+    const QString baseUrl = QStringLiteral("coap://127.0.0.1:%1/").arg(server.localPort());
+
+    int callCount = 0;
+    const QCoapRequest silent(QUrl(baseUrl + "silent"), QCoapMessage::Type::Confirmable);
+    QCoapRequestHandle silentHandle = client.get(silent, [&](QCoapResult) { ++callCount; });
+    QTRY_COMPARE(silentCount, 1);
+
+    // The second request waits for the only slot of the server
+    const QCoapRequest content(QUrl(baseUrl + "content"));
+    QCoapRequestHandle contentHandle = client.get(content, [&](QCoapResult) { ++callCount; });
+    QTest::qWait(200);
+    QVERIFY(!contentHandle.isFinished());
+
+    // Cancelling the first request frees its slot long before its timeout
+    silentHandle.cancel();
+    QTRY_VERIFY_WITH_TIMEOUT(contentHandle.isFinished(), 2000);
+    QCOMPARE(callCount, 1);
+    QVERIFY(!silentHandle.isFinished());
+    QCOMPARE(silentCount, 1);
+}
+
+void tst_QCoapClient::concurrentCallbackRequests()
+{
+    QCoapClient client(QtCoap::SecurityMode::NoSecurity, 2);
+
+    // Local servers answering each request with a piggybacked 2.05 Content
+    // response
+    const int serverCount = 4;
+    QObject serverParent;
+    QVector<QUrl> urls;
+    for (int i = 0; i < serverCount; ++i) {
+        auto server = new QUdpSocket(&serverParent);
+        QVERIFY(server->bind(QHostAddress::LocalHost, 0));
+        connect(server, &QUdpSocket::readyRead, server, [server]() {
+            while (server->hasPendingDatagrams()) {
+                const QNetworkDatagram datagram = server->receiveDatagram();
+                const QByteArray request = datagram.data();
+                const int tokenLength = request.at(0) & 0x0F;
+                QByteArray response;
+                response.append(static_cast<char>(0x60 | tokenLength));
+                response.append(static_cast<char>(0x45));
+                response.append(request.mid(2, 2 + tokenLength));
+                server->writeDatagram(datagram.makeReply(response));
+            }
+        });
+        urls.append(QUrl(QStringLiteral("coap://127.0.0.1:%1/sensor").arg(server->localPort())));
+    }
+
+    // Several producer threads send requests through the same client
+    const int producerCount = 4;
+    const int requestsPerProducer = 100;
+    QAtomicInt rejectedCount;
+    QAtomicInt successCount;
+    QAtomicInt wrongThreadCount;
+    int finishedCount = 0;
+    QThread *clientThread = client.thread();
+    QVector<QThread *> producers;
+    for (int p = 0; p < producerCount; ++p) {
+        producers.append(QThread::create([&, p]() {
+            for (int i = 0; i < requestsPerProducer; ++i) {
+                const QCoapRequest request(urls.at((p + i) % serverCount),
+                                           QCoapMessage::Type::Confirmable);
+                const QCoapRequestHandle handle = client.get(request, [&](QCoapResult result) {
+                    if (QThread::currentThread() != clientThread)
+                        wrongThreadCount.ref();
+                    if (result.isSuccessful())
+                        successCount.ref();
+                    ++finishedCount;
+                });
+                if (handle.isNull())
+                    rejectedCount.ref();
+            }
+        }));
+    }
+    for (QThread *producer : qAsConst(producers))
+        producer->start();
+    for (QThread *producer : qAsConst(producers)) {
+        QVERIFY(producer->wait(5000));
+        delete producer;
+    }
+
+    const int requestCount = producerCount * requestsPerProducer;
+    QCOMPARE(rejectedCount.load(), 0);
+    QTRY_COMPARE_WITH_TIMEOUT(finishedCount, requestCount, 10000);
+    QCOMPARE(successCount.load(), requestCount);
+    QCOMPARE(wrongThreadCount.load(), 0);
+}
+
+void tst_QCoapClient::asyncRequests()
+{
+    QCoapClient client;
+    client.setAckTimeout(100);
+    client.setMaximumRetransmitCount(0);
+
+    // A local server answering the requests to /content with a piggybacked
+    // 2.05 Content response, and ignoring the other requests
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            if (!request.contains("content"))
+                continue;
+
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            response.append(static_cast<char>(0xFF));
+            response.append("21.5");
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+    const QString baseUrl = QStringLiteral("coap://127.0.0.1:%1/").arg(server.localPort());
+    const QCoapRequest content(QUrl(baseUrl + "content"));
+
+    // Successful request, resumed through a continuation
+    int resumeCount = 0;
+    QCoapAsyncResult pending = client.getAsync(content);
+    QVERIFY(!pending.isNull());
+    QVERIFY(!pending.isReady());
+    pending.setContinuation([&]() { ++resumeCount; });
+    QTRY_VERIFY(pending.isReady());
+    QCOMPARE(resumeCount, 1);
+    QCoapResult result = pending.takeResult();
+    QVERIFY(result.isSuccessful());
+    QCOMPARE(result.payload, QByteArray("21.5"));
+
+    // Timeout
+    QCoapRequest confirmable(QUrl(baseUrl + "silent"), QCoapMessage::Type::Confirmable);
+    pending = client.postAsync(confirmable, "data");
+    pending.setContinuation([&]() { ++resumeCount; });
+    QTRY_VERIFY_WITH_TIMEOUT(pending.isReady(), 5000);
+    QCOMPARE(resumeCount, 2);
+    QCOMPARE(pending.takeResult().error, QtCoap::Error::TimeOut);
+
+    // Destroying a pending result cancels the request
+    {
+        QCoapAsyncResult cancelled = client.getAsync(confirmable);
+        cancelled.setContinuation([&]() { ++resumeCount; });
+    }
+    QTest::qWait(500);
+    QCOMPARE(resumeCount, 2);
+
+    // A request which cannot be sent is ready at once
+    pending = client.getAsync(QUrl("coap://"));
+    QVERIFY(pending.isReady());
+    QCOMPARE(pending.takeResult().error, QtCoap::Error::Unknown);
+
+    // The stream of an observation owns its reply, aborted with the stream
+    QPointer<QCoapReply> observeReply;
+    {
+        QCoapNotificationStream stream = client.observeAsync(content);
+        QVERIFY(!stream.isNull());
+        QVERIFY(!stream.isFinished());
+        QVERIFY(!stream.hasPendingNotification());
+        observeReply = stream.reply();
+        QVERIFY(observeReply);
+    }
+    QTRY_VERIFY(observeReply.isNull());
+
+    QCoapNotificationStream invalidStream = client.observeAsync(QUrl("coap://"));
+    QVERIFY(invalidStream.isFinished());
+    QVERIFY(!invalidStream.hasPendingNotification());
+}
+
+void tst_QCoapClient::batchRequests()
+{
+    QCoapClient client;
+    client.setAckTimeout(100);
+    client.setMaximumRetransmitCount(0);
+
+    // A local server answering the requests to /content with a piggybacked
+    // 2.05 Content response echoing their path, and counting the others
+    int silentCount = 0;
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server, &silentCount]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            const int index = request.indexOf("content");
+            if (index < 0) {
+                ++silentCount;
+                continue;
+            }
+
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            response.append(static_cast<char>(0xFF));
+            response.append(request.mid(index, request.at(index - 1) & 0x0F));
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+    const QString baseUrl = QStringLiteral("coap://127.0.0.1:%1/").arg(server.localPort());
+
+    // Successful requests, with an invalid one
+    const int requestCount = 50;
+    QVector<QCoapRequest> requests;
+    for (int i = 0; i < requestCount; ++i)
+        requests.append(QCoapRequest(QUrl(baseUrl + QStringLiteral("content%1").arg(i))));
+    requests.insert(10, QCoapRequest(QUrl("coap://")));
+
+    int finishedCallCount = 0;
+    QCoapBatch batch = client.getBatch(requests, 8);
+    QVERIFY(!batch.isNull());
+    QCOMPARE(batch.size(), requestCount + 1);
+    QCOMPARE(batch.finishedCount(), 1);
+    QVERIFY(batch.isFinished(10));
+    batch.setFinishedCallback([&]() { ++finishedCallCount; });
+    QTRY_VERIFY(batch.isFinished());
+    QCOMPARE(finishedCallCount, 1);
+    QCOMPARE(batch.finishedCount(), requestCount + 1);
+
+    QCOMPARE(batch.takeResult(10).error, QtCoap::Error::Unknown);
+    for (int i = 0; i < batch.size(); ++i) {
+        if (i == 10)
+            continue;
+        const QCoapResult result = batch.takeResult(i);
+        QVERIFY(result.isSuccessful());
+        QCOMPARE(result.payload, QStringLiteral("content%1").arg(i < 10 ? i : i - 1).toUtf8());
+    }
+    QVERIFY(client.findChildren<QCoapReply *>().isEmpty());
+
+    // The requests waiting for a running one are never sent once cancelled
+    const QVector<QCoapRequest> silentRequests(4, QCoapRequest(QUrl(baseUrl + "silent"),
+                                                               QCoapMessage::Type::Confirmable));
+    batch = client.sendBatch(QtCoap::Method::Post, silentRequests, 1);
+    batch.setFinishedCallback([&]() { ++finishedCallCount; });
+    QTRY_COMPARE(silentCount, 1);
+    batch.cancel();
+    QVERIFY(batch.isCancelled());
+    QTest::qWait(500);
+    QCOMPARE(silentCount, 1);
+    QCOMPARE(batch.finishedCount(), 0);
+    QCOMPARE(finishedCallCount, 1);
+
+    // An empty batch is finished at once
+    batch = client.getBatch(QVector<QCoapRequest>());
+    QVERIFY(batch.isFinished());
+}
+
+void tst_QCoapClient::notificationFreshness_data()
+{
+    QTest::addColumn<quint32>("previousSequence");
+    QTest::addColumn<qint64>("previousTime");
+    QTest::addColumn<quint32>("sequence");
+    QTest::addColumn<qint64>("time");
+    QTest::addColumn<bool>("fresher");
+
+    QTest::newRow("newer") << 5u << qint64(0) << 6u << qint64(10) << true;
+    QTest::newRow("older") << 6u << qint64(0) << 5u << qint64(10) << false;
+    QTest::newRow("same") << 6u << qint64(0) << 6u << qint64(10) << false;
+    QTest::newRow("wrapped") << 0xFFFFFFu << qint64(0) << 1u << qint64(10) << true;
+    QTest::newRow("before_wrap") << 1u << qint64(0) << 0xFFFFFFu << qint64(10) << false;
+    QTest::newRow("half_range")
+            << 0u << qint64(0) << (1u << 23) << qint64(10) << false;
+    QTest::newRow("older_after_window")
+            << 6u << qint64(0) << 5u << qint64(128001) << true;
+    QTest::newRow("older_at_window")
+            << 6u << qint64(0) << 5u << qint64(128000) << false;
+}
+
+void tst_QCoapClient::notificationFreshness()
+{
+    QFETCH(quint32, previousSequence);
+    QFETCH(qint64, previousTime);
+    QFETCH(quint32, sequence);
+    QFETCH(qint64, time);
+    QFETCH(bool, fresher);
+
+#ifdef QT_BUILD_INTERNAL
+    QCOMPARE(QCoapProtocolPrivate::isNotificationFresher(previousSequence, previousTime,
+                                                         sequence, time), fresher);
+#else
+    QSKIP("Not an internal build, skipping this test");
+#endif
+}
+
+void tst_QCoapClient::staleNotifications()
+{
+    QCoapClient client;
+
+    // A local server answering an observe request, then sending
+    // non-confirmable notifications, the second one being reordered
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            const int tokenLength = request.at(0) & 0x0F;
+            const QByteArray token = request.mid(4, tokenLength);
+
+            const auto notification = [&](char type, const QByteArray &messageId,
+                                          char sequence, const QByteArray &payload) {
+                QByteArray frame;
+                frame.append(static_cast<char>(type | tokenLength));
+                frame.append(static_cast<char>(0x45));
+                frame.append(messageId);
+                frame.append(token);
+                frame.append(static_cast<char>(0x61)); // Observe
+                frame.append(sequence);
+                frame.append(static_cast<char>(0xFF));
+                frame.append(payload);
+                server.writeDatagram(datagram.makeReply(frame));
+            };
+            // The first notification is piggybacked on the acknowledgment
+            // of a confirmable request
+            if ((request.at(0) & 0x30) == 0)
+                notification(0x60, request.mid(2, 2), 5, "a");
+            else
+                notification(0x50, QByteArray::fromHex("1000"), 5, "a");
+            notification(0x50, QByteArray::fromHex("1001"), 7, "b");
+            notification(0x50, QByteArray::fromHex("1002"), 6, "stale");
+            notification(0x50, QByteArray::fromHex("1003"), 8, "c");
+        }
+    });
+
+    QScopedPointer<QCoapReply> reply(client.observe(
+            QUrl(QStringLiteral("coap://127.0.0.1:%1/temperature").arg(server.localPort()))));
+    QVERIFY(!reply.isNull());
+
+    QVector<QByteArray> payloads;
+    connect(reply.data(), &QCoapReply::notified, this,
+            [&payloads](QCoapReply *, const QCoapMessage &message) {
+        payloads.append(message.payload());
+    });
+
+    QTRY_COMPARE(payloads.size(), 3);
+    QCOMPARE(payloads, QVector<QByteArray>({ "a", "b", "c" }));
+    QTest::qWait(100);
+    QCOMPARE(payloads.size(), 3);
+}
+
+void tst_QCoapClient::messageIdMappedAddress()
+{
+#ifdef QT_BUILD_INTERNAL
+    QCoapProtocol protocol;
+    auto d = static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(&protocol));
+
+    const auto request = QCoapRequestPrivate::createRequest(
+                QCoapRequest(QUrl("coap://10.0.0.1/sensor")), QtCoap::Method::Get);
+    auto internalRequest = QSharedPointer<QCoapInternalRequest>::create(request);
+    internalRequest->setMessageId(42);
+    internalRequest->setToken("token");
+    d->registerExchange("token", nullptr, internalRequest);
+
+    // Messages received on a dual-stack socket come from IPv4-mapped addresses
+    const QHostAddress mappedSender(QStringLiteral("::ffff:10.0.0.1"));
+    QCOMPARE(d->findRequestByMessageId(QHostAddress("10.0.0.1"), 42), internalRequest.data());
+    QCOMPARE(d->findRequestByMessageId(mappedSender, 42), internalRequest.data());
+    QVERIFY(d->isMessageIdRegistered(mappedSender, 42));
+    QVERIFY(!d->findRequestByMessageId(QHostAddress("10.0.0.2"), 42));
+    QVERIFY(!d->findRequestByMessageId(mappedSender, 43));
+
+    QVERIFY(d->forgetExchange(QCoapToken("token")));
+    QVERIFY(!d->isMessageIdRegistered(mappedSender, 42));
+#else
+    QSKIP("Not an internal build, skipping this test");
+#endif
+}
+
+void tst_QCoapClient::reducedBlockSizeTimeout()
+{
+    QCoapClient client;
+    client.setAckTimeout(200);
+    client.setAckRandomFactor(1);
+    client.setAdaptiveBlockSizeEnabled(true);
+
+    // A local server dropping the requests for blocks, except the fourth one,
+    // answered with the last block of 512 bytes
+    QVector<QByteArray> requests;
+    QVector<qint64> arrivals;
+    QElapsedTimer timer;
+    timer.start();
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            requests.append(request);
+            arrivals.append(timer.elapsed());
+            if (requests.size() != 4)
+                continue;
+
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            response.append(QByteArray::fromHex("d10a05")); // Block2: 0/0/512
+            response.append(static_cast<char>(0xFF));
+            response.append(QByteArray(100, 'p'));
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+    const QUrl url(QStringLiteral("coap://127.0.0.1:%1/large").arg(server.localPort()));
+
+    QScopedPointer<QCoapReply> reply(
+                client.get(QCoapRequest(url, QCoapMessage::Type::Confirmable)));
+    QVERIFY(!reply.isNull());
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(reply->errorReceived(), QtCoap::Error::Ok);
+    QCOMPARE(requests.size(), 4);
+
+    // The block of 1024 bytes times out twice, then is asked for again with
+    // a size of 512 bytes, as a new message
+    const auto messageId = [&](int i) { return requests.at(i).mid(2, 2); };
+    QCOMPARE(static_cast<quint8>(requests.at(1).back()), quint8(0x06));
+    QCOMPARE(messageId(1), messageId(0));
+    QCOMPARE(static_cast<quint8>(requests.at(2).back()), quint8(0x05));
+    QVERIFY(messageId(2) != messageId(1));
+    QCOMPARE(messageId(3), messageId(2));
+
+    // The new message starts over with the initial timeout, not with the
+    // timeout backed off by the two previous transmissions
+    QVERIFY2(arrivals.at(3) - arrivals.at(2) < 600,
+             qPrintable(QString::number(arrivals.at(3) - arrivals.at(2))));
+}
+
+void tst_QCoapClient::roundTripStatistics()
+{
+    QCoapClient client(QtCoap::SecurityMode::NoSecurity, 2);
+    client.setAckTimeout(1000);
+
+    // A local server answering with a piggybacked 2.05 Content response
+    QUdpSocket server;
+    QVERIFY(server.bind(QHostAddress::LocalHost, 0));
+    connect(&server, &QUdpSocket::readyRead, &server, [&server]() {
+        while (server.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = server.receiveDatagram();
+            const QByteArray request = datagram.data();
+            const int tokenLength = request.at(0) & 0x0F;
+            QByteArray response;
+            response.append(static_cast<char>(0x60 | tokenLength));
+            response.append(static_cast<char>(0x45));
+            response.append(request.mid(2, 2 + tokenLength));
+            server.writeDatagram(datagram.makeReply(response));
+        }
+    });
+
+    // Servers never measured get the initial timeout
+    const QHostAddress host(QHostAddress::LocalHost);
+    QCoapRoundTripStatistics statistics = client.roundTripStatistics(host);
+    QCOMPARE(statistics.strongSampleCount, 0);
+    QCOMPARE(statistics.weakSampleCount, 0);
+    QCOMPARE(statistics.lastUpdateAge, qint64(-1));
+    QCOMPARE(statistics.retransmissionTimeout, 1000u);
+
+    const QUrl url(QStringLiteral("coap://127.0.0.1:%1/test").arg(server.localPort()));
+    QScopedPointer<QCoapReply> reply(
+                client.get(QCoapRequest(url, QCoapMessage::Type::Confirmable)));
+    QVERIFY(!reply.isNull());
+    QTRY_VERIFY(reply->isFinished());
+
+    statistics = client.roundTripStatistics(host);
+    QCOMPARE(statistics.strongSampleCount, 1);
+    QVERIFY(statistics.lastUpdateAge >= 0);
+
+    // The statistics may be read from any thread
+    QCoapRoundTripStatistics otherThreadStatistics;
+    QScopedPointer<QThread> thread(QThread::create([&]() {
+        otherThreadStatistics = client.roundTripStatistics(host);
+    }));
+    thread->start();
+    QVERIFY(thread->wait(5000));
+    QCOMPARE(otherThreadStatistics.strongSampleCount, 1);
+    QCOMPARE(otherThreadStatistics.strongRoundTripTime, statistics.strongRoundTripTime);
+}
+
 QTEST_MAIN(tst_QCoapClient)
 
 #include "tst_qcoapclient.moc"
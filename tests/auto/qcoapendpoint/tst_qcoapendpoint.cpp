@@ -0,0 +1,161 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoapendpoint_p.h>
+
+class tst_QCoapEndpoint : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void fromHost_data();
+    void fromHost();
+    void fromUrl_data();
+    void fromUrl();
+    void matches_data();
+    void matches();
+    void equality();
+};
+
+void tst_QCoapEndpoint::fromHost_data()
+{
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<bool>("isNull");
+    QTest::addColumn<bool>("isIPv4");
+    QTest::addColumn<bool>("isMulticast");
+
+    QTest::newRow("ipv4") << "10.20.30.40" << false << true << false;
+    QTest::newRow("ipv4_multicast") << "224.0.1.187" << false << true << true;
+    QTest::newRow("ipv6") << "2001:db8::1" << false << false << false;
+    QTest::newRow("ipv6_multicast") << "ff02::fd" << false << false << true;
+    QTest::newRow("name") << "coap.me" << true << false << false;
+    QTest::newRow("empty") << "" << true << false << false;
+}
+
+void tst_QCoapEndpoint::fromHost()
+{
+    QFETCH(QString, host);
+    QFETCH(bool, isNull);
+    QFETCH(bool, isIPv4);
+    QFETCH(bool, isMulticast);
+
+    const QCoapEndpoint endpoint = QCoapEndpoint::fromHost(host, 5683);
+    QCOMPARE(endpoint.isNull(), isNull);
+    QCOMPARE(endpoint.isIPv4(), isIPv4);
+    QCOMPARE(endpoint.isMulticast(), isMulticast);
+    QCOMPARE(endpoint.host(), host);
+    QCOMPARE(endpoint.port(), quint16(5683));
+    if (!isNull)
+        QCOMPARE(endpoint.address(), QHostAddress(host));
+}
+
+void tst_QCoapEndpoint::fromUrl_data()
+{
+    QTest::addColumn<QUrl>("url");
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<quint16>("port");
+
+    QTest::newRow("port") << QUrl("coap://10.20.30.40:1234/test")
+                          << "10.20.30.40" << quint16(1234);
+    QTest::newRow("coap_default_port") << QUrl("coap://10.20.30.40/test")
+                                       << "10.20.30.40" << quint16(5683);
+    QTest::newRow("coaps_default_port") << QUrl("coaps://10.20.30.40/test")
+                                        << "10.20.30.40" << quint16(5684);
+    QTest::newRow("tcp_default_port") << QUrl("coap+tcp://[2001:db8::1]/test")
+                                      << "2001:db8::1" << quint16(5683);
+}
+
+void tst_QCoapEndpoint::fromUrl()
+{
+    QFETCH(QUrl, url);
+    QFETCH(QString, host);
+    QFETCH(quint16, port);
+
+    const QCoapEndpoint endpoint = QCoapEndpoint::fromUrl(url);
+    QVERIFY(!endpoint.isNull());
+    QCOMPARE(endpoint.address(), QHostAddress(host));
+    QCOMPARE(endpoint.host(), host);
+    QCOMPARE(endpoint.port(), port);
+}
+
+void tst_QCoapEndpoint::matches_data()
+{
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<QString>("sender");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("ipv4") << "10.20.30.40" << "10.20.30.40" << true;
+    QTest::newRow("ipv4_other") << "10.20.30.40" << "10.20.30.41" << false;
+    QTest::newRow("ipv4_mapped_sender")
+            << "10.20.30.40" << "::ffff:10.20.30.40" << true;
+    QTest::newRow("ipv4_mapped_endpoint")
+            << "::ffff:10.20.30.40" << "10.20.30.40" << true;
+    QTest::newRow("ipv6") << "2001:db8::1" << "2001:db8::1" << true;
+    QTest::newRow("ipv6_other") << "2001:db8::1" << "2001:db8::2" << false;
+    QTest::newRow("null_sender") << "10.20.30.40" << QString() << false;
+    QTest::newRow("null_endpoint") << "coap.me" << "10.20.30.40" << false;
+}
+
+void tst_QCoapEndpoint::matches()
+{
+    QFETCH(QString, host);
+    QFETCH(QString, sender);
+    QFETCH(bool, matches);
+
+    QCOMPARE(QCoapEndpoint::fromHost(host, 5683).matches(QHostAddress(sender)), matches);
+}
+
+void tst_QCoapEndpoint::equality()
+{
+    const QCoapEndpoint endpoint = QCoapEndpoint::fromHost("10.20.30.40", 5683);
+    const QCoapEndpoint sameEndpoint(QHostAddress("10.20.30.40"), 5683);
+    const QCoapEndpoint otherPort = QCoapEndpoint::fromHost("10.20.30.40", 5684);
+    const QCoapEndpoint otherAddress = QCoapEndpoint::fromHost("10.20.30.41", 5683);
+
+    QCOMPARE(endpoint, sameEndpoint);
+    QCOMPARE(qHash(endpoint), qHash(sameEndpoint));
+    QVERIFY(endpoint != otherPort);
+    QVERIFY(endpoint != otherAddress);
+    QVERIFY(endpoint != QCoapEndpoint());
+    QCOMPARE(QCoapEndpoint(), QCoapEndpoint());
+
+    QHash<QCoapEndpoint, int> endpoints;
+    endpoints.insert(endpoint, 1);
+    endpoints.insert(otherPort, 2);
+    QCOMPARE(endpoints.value(sameEndpoint), 1);
+    QCOMPARE(endpoints.value(otherPort), 2);
+    QVERIFY(!endpoints.contains(otherAddress));
+}
+
+QTEST_MAIN(tst_QCoapEndpoint)
+
+#include "tst_qcoapendpoint.moc"
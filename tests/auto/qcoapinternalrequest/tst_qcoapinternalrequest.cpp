@@ -42,6 +42,9 @@ class tst_QCoapInternalRequest : public QObject
 private Q_SLOTS:
     void requestToFrame_data();
     void requestToFrame();
+    void extendedOptionToFrame();
+    void encodeIntoBuffer();
+    void encodedFrameCache();
     void parseUri_data();
     void parseUri();
     void urlOptions_data();
@@ -167,6 +170,95 @@ void tst_QCoapInternalRequest::requestToFrame()
     QCOMPARE(internalRequest.toQByteArray().toHex(), pdu);
 }
 
+void tst_QCoapInternalRequest::extendedOptionToFrame()
+{
+    // Option 2100 needs a 2-byte extended delta (14 + 0x0727), and its
+    // 300 bytes value a 2-byte extended length (14 + 0x001f).
+    const QByteArray value(300, 'v');
+    QCoapInternalRequest internalRequest;
+    internalRequest.setMethod(QtCoap::Method::Get);
+    internalRequest.message()->setType(QCoapMessage::Type::NonConfirmable);
+    internalRequest.setMessageId(1);
+    internalRequest.addOption(QCoapOption::OptionName(2101));
+    internalRequest.addOption(QCoapOption::OptionName(2100), value);
+
+    const QByteArray expected = QByteArray::fromHex("50010001ee0727001f") + value
+            + QByteArray::fromHex("10");
+    QCOMPARE(internalRequest.encodedSize(), expected.size());
+    QCOMPARE(internalRequest.toQByteArray(), expected);
+}
+
+void tst_QCoapInternalRequest::encodeIntoBuffer()
+{
+    QCoapRequest request(QUrl("coap://10.20.30.40:1234/request/to/encode"));
+    request.setMessageId(56400);
+    request.setToken("4647f09b");
+    request.setPayload("Some payload");
+    QCoapInternalRequest internalRequest(
+                QCoapRequestPrivate::createRequest(request, QtCoap::Method::Post));
+
+    const QByteArray expected = internalRequest.toQByteArray();
+    QCOMPARE(expected.size(), internalRequest.encodedSize());
+
+    QByteArray buffer;
+    buffer.reserve(256);
+    const char *bufferData = buffer.constData();
+
+    // The frame is written in place, without reallocating the buffer
+    internalRequest.encode(&buffer);
+    QCOMPARE(buffer, expected);
+    QCOMPARE(static_cast<const void *>(buffer.constData()),
+             static_cast<const void *>(bufferData));
+
+    internalRequest.message()->setPayload(QByteArray());
+    internalRequest.encode(&buffer);
+    QCOMPARE(buffer, internalRequest.toQByteArray());
+    QCOMPARE(buffer.size(), expected.size() - 13);
+    QCOMPARE(static_cast<const void *>(buffer.constData()),
+             static_cast<const void *>(bufferData));
+}
+
+void tst_QCoapInternalRequest::encodedFrameCache()
+{
+    QCoapRequest request(QUrl("coap://10.20.30.40:1234/request/to/encode"));
+    request.setMessageId(56400);
+    request.setToken("4647f09b");
+    QCoapInternalRequest internalRequest(
+                QCoapRequestPrivate::createRequest(request, QtCoap::Method::Get));
+
+    QByteArray expected;
+    internalRequest.encode(&expected);
+
+    // Successive calls return the cached frame
+    const char *frameData = internalRequest.encodedFrame().constData();
+    QCOMPARE(internalRequest.encodedFrame(), expected);
+    QVERIFY(internalRequest.encodedFrame().constData() == frameData);
+
+    // The message ID is patched in place
+    internalRequest.setMessageId(1234);
+    internalRequest.encode(&expected);
+    QCOMPARE(internalRequest.encodedFrame(), expected);
+    QVERIFY(internalRequest.encodedFrame().constData() == frameData);
+
+    // Other changes are encoded again
+    internalRequest.setToken("abcd");
+    internalRequest.encode(&expected);
+    QCOMPARE(internalRequest.encodedFrame(), expected);
+
+    internalRequest.message()->setPayload("Some payload");
+    internalRequest.encode(&expected);
+    QCOMPARE(internalRequest.encodedFrame(), expected);
+
+    internalRequest.addOption(QCoapOption::Observe);
+    internalRequest.encode(&expected);
+    QCOMPARE(internalRequest.encodedFrame(), expected);
+
+    internalRequest.setMethod(QtCoap::Method::Put);
+    internalRequest.encode(&expected);
+    QCOMPARE(internalRequest.encodedFrame(), expected);
+    QCOMPARE(internalRequest.toQByteArray(), expected);
+}
+
 void tst_QCoapInternalRequest::parseUri_data()
 {
     qRegisterMetaType<QVector<QCoapOption>>();
@@ -0,0 +1,4 @@
+QT = testlib core coap coap-private
+CONFIG += testcase
+
+SOURCES += tst_qcoaplockfreequeue.cpp
@@ -0,0 +1,183 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoaplockfreequeue_p.h>
+
+class tst_QCoapLockFreeQueue : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void takeInOrder();
+    void clear();
+    void concurrentProducers();
+};
+
+struct Node
+{
+    Node(int producer, int value) : producer(producer), value(value) { ++alive; }
+    ~Node() { --alive; }
+
+    int producer;
+    int value;
+    Node *next = nullptr;
+
+    static QAtomicInt alive;
+};
+
+QAtomicInt Node::alive;
+
+/*
+    Appends \a count nodes to the \a queue, counting how many of them were
+    appended to an empty queue.
+*/
+class Producer : public QThread
+{
+public:
+    Producer(QCoapLockFreeQueue<Node> *queue, int id, int count) :
+        queue(queue), id(id), count(count)
+    {}
+
+    void run() override
+    {
+        for (int i = 0; i < count; ++i) {
+            if (queue->enqueue(new Node(id, i)))
+                ++wakeUps;
+        }
+    }
+
+    QCoapLockFreeQueue<Node> *queue;
+    int id;
+    int count;
+    int wakeUps = 0;
+};
+
+void tst_QCoapLockFreeQueue::takeInOrder()
+{
+    QCoapLockFreeQueue<Node> queue;
+    QCOMPARE(queue.takeAll(), nullptr);
+
+    QVERIFY(queue.enqueue(new Node(0, 1)));
+    QVERIFY(!queue.enqueue(new Node(0, 2)));
+    QVERIFY(!queue.enqueue(new Node(0, 3)));
+
+    Node *node = queue.takeAll();
+    QCOMPARE(queue.takeAll(), nullptr);
+
+    for (int value = 1; value <= 3; ++value) {
+        QVERIFY(node);
+        QCOMPARE(node->value, value);
+        Node *next = node->next;
+        delete node;
+        node = next;
+    }
+    QCOMPARE(node, nullptr);
+
+    // The queue is empty again once taken
+    QVERIFY(queue.enqueue(new Node(0, 4)));
+    delete queue.takeAll();
+    QCOMPARE(Node::alive.loadAcquire(), 0);
+}
+
+void tst_QCoapLockFreeQueue::clear()
+{
+    {
+        QCoapLockFreeQueue<Node> queue;
+        for (int i = 0; i < 10; ++i)
+            queue.enqueue(new Node(0, i));
+        queue.clear();
+        QCOMPARE(Node::alive.loadAcquire(), 0);
+        QVERIFY(queue.enqueue(new Node(0, 10)));
+    }
+
+    // The remaining nodes are deleted with the queue
+    QCOMPARE(Node::alive.loadAcquire(), 0);
+}
+
+void tst_QCoapLockFreeQueue::concurrentProducers()
+{
+    const int producerCount = 32;
+    const int nodeCount = 5000;
+
+    QCoapLockFreeQueue<Node> queue;
+    QVector<Producer *> producers;
+    for (int i = 0; i < producerCount; ++i)
+        producers.append(new Producer(&queue, i, nodeCount));
+
+    for (Producer *producer : qAsConst(producers))
+        producer->start();
+
+    // Consume while the producers are running
+    QVector<int> nextValue(producerCount, 0);
+    int takeCount = 0;
+    int wakeUps = 0;
+    bool ordered = true;
+    const auto consume = [&]() {
+        Node *node = queue.takeAll();
+        if (node)
+            ++takeCount;
+        while (node) {
+            ordered &= node->value == nextValue[node->producer];
+            ++nextValue[node->producer];
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    };
+
+    bool running = true;
+    while (running) {
+        consume();
+        running = false;
+        for (Producer *producer : qAsConst(producers))
+            running |= !producer->isFinished();
+    }
+    consume();
+
+    for (Producer *producer : qAsConst(producers)) {
+        QVERIFY(producer->wait(10000));
+        wakeUps += producer->wakeUps;
+    }
+    qDeleteAll(producers);
+
+    // Each node is taken once, in the order of its producer, and each batch
+    // taken was started by exactly one producer
+    QVERIFY(ordered);
+    for (int value : qAsConst(nextValue))
+        QCOMPARE(value, nodeCount);
+    QCOMPARE(wakeUps, takeCount);
+    QCOMPARE(Node::alive.loadAcquire(), 0);
+}
+
+QTEST_MAIN(tst_QCoapLockFreeQueue)
+
+#include "tst_qcoaplockfreequeue.moc"
@@ -0,0 +1,147 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoapmessageidallocator_p.h>
+
+class tst_QCoapMessageIdAllocator : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void sequentialIds();
+    void noReuseWithinLifetime();
+    void reuseAfterLifetime();
+    void refuseWhenExhausted();
+    void independentEndpoints();
+    void purgeIdleEndpoints();
+};
+
+static const qint64 lifetime = 247000;
+
+void tst_QCoapMessageIdAllocator::sequentialIds()
+{
+    QCoapMessageIdAllocator allocator;
+    const QHostAddress host(QHostAddress::LocalHost);
+
+    quint16 previous = allocator.allocate(host, 0, lifetime);
+    QVERIFY(previous != 0);
+
+    for (int i = 0; i < 0x20000 / 4; ++i) {
+        const quint16 id = allocator.allocate(host, 4 * i, 1);
+        QVERIFY(id != 0);
+        QCOMPARE(id, static_cast<quint16>(previous == 0xFFFF ? 1 : previous + 1));
+        previous = id;
+    }
+}
+
+void tst_QCoapMessageIdAllocator::noReuseWithinLifetime()
+{
+    QCoapMessageIdAllocator allocator;
+    const QHostAddress host(QHostAddress::LocalHost);
+
+    QSet<quint16> ids;
+    for (int i = 0; i < 0xFFFF; ++i) {
+        const quint16 id = allocator.allocate(host, i, lifetime);
+        QVERIFY(id != 0);
+        QVERIFY(!ids.contains(id));
+        ids.insert(id);
+    }
+
+    QCOMPARE(allocator.usedCount(host, 0xFFFF), 0xFFFF);
+}
+
+void tst_QCoapMessageIdAllocator::reuseAfterLifetime()
+{
+    QCoapMessageIdAllocator allocator;
+    const QHostAddress host(QHostAddress::LocalHost);
+
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(allocator.allocate(host, i, lifetime) != 0);
+
+    QCOMPARE(allocator.usedCount(host, lifetime - 1), 10);
+    QCOMPARE(allocator.usedCount(host, lifetime + 4), 5);
+    QCOMPARE(allocator.usedCount(host, lifetime + 10), 0);
+}
+
+void tst_QCoapMessageIdAllocator::refuseWhenExhausted()
+{
+    QCoapMessageIdAllocator allocator;
+    const QHostAddress host(QHostAddress::LocalHost);
+
+    const quint16 first = allocator.allocate(host, 0, lifetime);
+    QVERIFY(first != 0);
+    for (int i = 1; i < 0xFFFF; ++i)
+        QVERIFY(allocator.allocate(host, 0, lifetime) != 0);
+
+    // All the usable ids are in use
+    QCOMPARE(allocator.allocate(host, 1, lifetime), quint16(0));
+    QCOMPARE(allocator.allocate(host, lifetime - 1, lifetime), quint16(0));
+
+    // The first id becomes available again once its lifetime is over
+    QCOMPARE(allocator.allocate(host, lifetime, lifetime), first);
+}
+
+void tst_QCoapMessageIdAllocator::independentEndpoints()
+{
+    QCoapMessageIdAllocator allocator;
+    const QHostAddress host1(QStringLiteral("10.0.0.1"));
+    const QHostAddress host2(QStringLiteral("10.0.0.2"));
+
+    for (int i = 0; i < 0xFFFF; ++i)
+        QVERIFY(allocator.allocate(host1, 0, lifetime) != 0);
+
+    QCOMPARE(allocator.allocate(host1, 0, lifetime), quint16(0));
+    QVERIFY(allocator.allocate(host2, 0, lifetime) != 0);
+    QCOMPARE(allocator.usedCount(host1, 0), 0xFFFF);
+    QCOMPARE(allocator.usedCount(host2, 0), 1);
+    QCOMPARE(allocator.endpointCount(), 2);
+}
+
+void tst_QCoapMessageIdAllocator::purgeIdleEndpoints()
+{
+    QCoapMessageIdAllocator allocator;
+
+    for (quint32 i = 0; i < 100; ++i)
+        QVERIFY(allocator.allocate(QHostAddress(0x0A000000 + i), 0, lifetime) != 0);
+    QCOMPARE(allocator.endpointCount(), 100);
+
+    // Endpoints without ids in use are dropped on a later allocation
+    QVERIFY(allocator.allocate(QHostAddress(QHostAddress::LocalHost), lifetime, lifetime) != 0);
+    QCOMPARE(allocator.endpointCount(), 1);
+
+    allocator.clear();
+    QCOMPARE(allocator.endpointCount(), 0);
+}
+
+QTEST_MAIN(tst_QCoapMessageIdAllocator)
+
+#include "tst_qcoapmessageidallocator.moc"
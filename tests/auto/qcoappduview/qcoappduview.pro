@@ -0,0 +1,5 @@
+QT = testlib network core coap coap-private
+CONFIG += testcase
+
+SOURCES += \
+    tst_qcoappduview.cpp
@@ -0,0 +1,203 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoappduview_p.h>
+#include <private/qcoapinternalreply_p.h>
+
+Q_DECLARE_METATYPE(QCoapPduView::Status)
+
+class tst_QCoapPduView : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void parseHeader();
+    void fieldsShareFrame();
+    void extendedOptions();
+    void indexOfOption();
+    void malformedFrame_data();
+    void malformedFrame();
+};
+
+static bool pointsInto(const QByteArray &field, const QByteArray &frame)
+{
+    return field.constData() >= frame.constData()
+            && field.constData() + field.size() <= frame.constData() + frame.size();
+}
+
+void tst_QCoapPduView::parseHeader()
+{
+    const QByteArray frame = QByteArray::fromHex("6445fbcf4647f09bc0211eff") + "Hello";
+    const QCoapPduView pdu(frame);
+
+    QVERIFY(pdu.isValid());
+    QCOMPARE(pdu.status(), QCoapPduView::Status::Ok);
+    QCOMPARE(pdu.version(), quint8(1));
+    QCOMPARE(pdu.type(), QCoapMessage::Type::Acknowledgment);
+    QCOMPARE(pdu.responseCode(), QtCoap::ResponseCode::Content);
+    QCOMPARE(pdu.messageId(), quint16(64463));
+    QCOMPARE(pdu.tokenLength(), 4);
+    QCOMPARE(pdu.token(), QByteArray::fromHex("4647f09b"));
+
+    QCOMPARE(pdu.optionCount(), 2);
+    QCOMPARE(pdu.optionNumber(0), quint16(QCoapOption::ContentFormat));
+    QCOMPARE(pdu.optionLength(0), 0);
+    QVERIFY(pdu.optionValue(0).isEmpty());
+    QCOMPARE(pdu.optionNumber(1), quint16(QCoapOption::MaxAge));
+    QCOMPARE(pdu.optionValue(1), QByteArray::fromHex("1e"));
+
+    QVERIFY(pdu.hasPayload());
+    QCOMPARE(pdu.payloadLength(), 5);
+    QCOMPARE(pdu.payload(), QByteArray("Hello"));
+}
+
+void tst_QCoapPduView::fieldsShareFrame()
+{
+    const QByteArray frame = QByteArray::fromHex("5445fbcf4647f09bd10a0aff") + "payload";
+    const QCoapPduView pdu(frame);
+    QVERIFY(pdu.isValid());
+
+    // The view does not copy the frame, and its fields point into it
+    QVERIFY(pdu.frame().constData() == frame.constData());
+    QVERIFY(pointsInto(pdu.token(), frame));
+    QVERIFY(pointsInto(pdu.optionValue(0), frame));
+    QVERIFY(pointsInto(pdu.payload(), frame));
+
+    // The reply built from the view shares the frame
+    QScopedPointer<QCoapInternalReply> reply(QCoapInternalReply::createFromView(pdu));
+    QCOMPARE(reply->message()->token(), pdu.token());
+    QVERIFY(pointsInto(reply->message()->token(), frame));
+    QCOMPARE(reply->message()->payload(), QByteArray("payload"));
+    QVERIFY(pointsInto(reply->message()->payload(), frame));
+    QCOMPARE(reply->message()->optionAt(0).name(), QCoapOption::Block2);
+    QCOMPARE(reply->message()->optionAt(0).opaqueValue(), QByteArray::fromHex("0a"));
+    QVERIFY(pointsInto(reply->message()->optionAt(0).opaqueValue(), frame));
+
+    // Its detached message owns its data
+    const QCoapMessage message = reply->detachedMessage();
+    QCOMPARE(message.token(), pdu.token());
+    QVERIFY(!pointsInto(message.token(), frame));
+    QCOMPARE(message.payload(), QByteArray("payload"));
+    QVERIFY(!pointsInto(message.payload(), frame));
+    QCOMPARE(message.optionAt(0).opaqueValue(), QByteArray::fromHex("0a"));
+    QVERIFY(!pointsInto(message.optionAt(0).opaqueValue(), frame));
+    QVERIFY(!pointsInto(reply->detachedPayload(), frame));
+
+    // The frame outlives the byte array it was received in
+    QScopedPointer<QCoapInternalReply> received(QCoapInternalReply::createFromFrame(
+            QByteArray::fromHex("5445fbcf4647f09bff") + "payload"));
+    QCOMPARE(received->message()->payload(), QByteArray("payload"));
+    QCOMPARE(received->message()->token(), QByteArray::fromHex("4647f09b"));
+}
+
+void tst_QCoapPduView::extendedOptions()
+{
+    // Option 2100 (delta 14 + 0x0727) with a 300 bytes value (length 14 + 0x001f),
+    // followed by option 2101 (delta 1) with an empty value.
+    const QByteArray value(300, 'v');
+    const QByteArray frame = QByteArray::fromHex("50450001ee0727001f") + value
+            + QByteArray::fromHex("10");
+    const QCoapPduView pdu(frame);
+
+    QVERIFY(pdu.isValid());
+    QCOMPARE(pdu.tokenLength(), 0);
+    QVERIFY(pdu.token().isEmpty());
+    QCOMPARE(pdu.optionCount(), 2);
+    QCOMPARE(pdu.optionNumber(0), quint16(2100));
+    QCOMPARE(pdu.optionLength(0), 300);
+    QCOMPARE(pdu.optionValue(0), value);
+    QCOMPARE(pdu.optionNumber(1), quint16(2101));
+    QCOMPARE(pdu.optionLength(1), 0);
+    QVERIFY(!pdu.hasPayload());
+    QVERIFY(pdu.payload().isEmpty());
+}
+
+void tst_QCoapPduView::indexOfOption()
+{
+    // Two Uri-Path options, then Uri-Query
+    const QByteArray frame = QByteArray::fromHex("40010001b1610162414b");
+    const QCoapPduView pdu(frame);
+
+    QVERIFY(pdu.isValid());
+    QCOMPARE(pdu.indexOfOption(QCoapOption::UriPath), 0);
+    QCOMPARE(pdu.indexOfOption(QCoapOption::UriPath, 1), 1);
+    QCOMPARE(pdu.indexOfOption(QCoapOption::UriPath, 2), -1);
+    QCOMPARE(pdu.indexOfOption(QCoapOption::UriQuery), 2);
+    QCOMPARE(pdu.indexOfOption(QCoapOption::ContentFormat), -1);
+}
+
+void tst_QCoapPduView::malformedFrame_data()
+{
+    QTest::addColumn<QByteArray>("frame");
+    QTest::addColumn<QCoapPduView::Status>("status");
+
+    QTest::newRow("empty") << QByteArray() << QCoapPduView::Status::Truncated;
+    QTest::newRow("short_header") << QByteArray::fromHex("5445fb")
+                                  << QCoapPduView::Status::Truncated;
+    QTest::newRow("version_2") << QByteArray::fromHex("9445fbcf4647f09b")
+                               << QCoapPduView::Status::UnsupportedVersion;
+    QTest::newRow("token_length_9") << QByteArray::fromHex("5945fbcf00000000000000000000")
+                                    << QCoapPduView::Status::InvalidTokenLength;
+    QTest::newRow("short_token") << QByteArray::fromHex("5445fbcf4647f0")
+                                 << QCoapPduView::Status::Truncated;
+    QTest::newRow("short_option_value") << QByteArray::fromHex("5045fbcf6203")
+                                        << QCoapPduView::Status::Truncated;
+    QTest::newRow("short_extended_delta") << QByteArray::fromHex("5045fbcfe007")
+                                          << QCoapPduView::Status::Truncated;
+    QTest::newRow("short_extended_length") << QByteArray::fromHex("5045fbcf1d")
+                                           << QCoapPduView::Status::Truncated;
+    QTest::newRow("reserved_delta") << QByteArray::fromHex("5045fbcff0")
+                                    << QCoapPduView::Status::InvalidOption;
+    QTest::newRow("reserved_length") << QByteArray::fromHex("5045fbcf1f")
+                                     << QCoapPduView::Status::InvalidOption;
+    QTest::newRow("option_number_overflow") << QByteArray::fromHex("5045fbcfe0feff")
+                                            << QCoapPduView::Status::InvalidOption;
+    QTest::newRow("empty_payload") << QByteArray::fromHex("5045fbcfff")
+                                   << QCoapPduView::Status::EmptyPayload;
+}
+
+void tst_QCoapPduView::malformedFrame()
+{
+    QFETCH(QByteArray, frame);
+    QFETCH(QCoapPduView::Status, status);
+
+    const QCoapPduView pdu(frame);
+    QVERIFY(!pdu.isValid());
+    QCOMPARE(pdu.status(), status);
+
+    QScopedPointer<QCoapInternalReply> reply(QCoapInternalReply::createFromFrame(frame));
+    QVERIFY(reply.isNull());
+}
+
+QTEST_MAIN(tst_QCoapPduView)
+
+#include "tst_qcoappduview.moc"
@@ -0,0 +1,493 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapclient.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtNetwork/qtcpserver.h>
+#include <QtNetwork/qtcpsocket.h>
+#include <private/qcoapinternalreply_p.h>
+#include <private/qcoapqtcpconnection_p.h>
+
+class tst_QCoapQTcpConnection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+    void frameConversion_data();
+    void frameConversion();
+    void tcpFrameSize_data();
+    void tcpFrameSize();
+    void sendRequest();
+    void emptyMessageDropped();
+    void capabilities();
+    void ping();
+    void pingFromServer();
+    void abortFromServer();
+    void connectionRefused();
+    void requestsFailOnConnectionLoss();
+    void bertDownload();
+    void bertUpload();
+    void noRetransmission();
+
+private:
+    QByteArray readFrames(int count);
+    QCoapMessage readRequest(int count = 1);
+
+    QTcpServer *server = nullptr;
+    QPointer<QTcpSocket> serverSocket;
+    QByteArray serverBuffer;
+};
+
+class QCoapQTcpConnectionForTest : public QCoapQTcpConnection
+{
+    Q_OBJECT
+public:
+    QCoapQTcpConnectionForTest(QObject *parent = nullptr) :
+        QCoapQTcpConnection(parent)
+    {}
+
+    void sendRequest(const QByteArray &request, const QString &host, quint16 port)
+    {
+        d_func()->sendRequest(request, QCoapEndpoint::fromHost(host, port));
+    }
+
+    using QCoapQTcpConnection::bertBlockSize;
+};
+
+static const QString localHost = QStringLiteral("127.0.0.1");
+
+// CSM sent by the connection: 1 MiB Max-Message-Size and BERT support
+static const QByteArray clientCapabilities = QByteArray::fromHex("50e123100000" "20");
+
+// CSM sent by the server: 8 KiB Max-Message-Size and BERT support, allowing
+// BERT blocks of 7 KiB
+static const QByteArray serverCapabilities = QByteArray::fromHex("40e1" "222000" "20");
+
+/*
+    Returns the TCP frame of a response with the given \a code and \a token,
+    carrying the one byte value \a blockValue in the Block option \a block,
+    if any, followed by \a payload.
+*/
+static QByteArray tcpResponse(quint8 code, const QByteArray &token,
+                              QCoapOption::OptionName block = QCoapOption::Invalid,
+                              quint8 blockValue = 0, const QByteArray &payload = QByteArray())
+{
+    QByteArray frame;
+    frame.append(static_cast<char>(0x50 | token.size()));
+    frame.append(static_cast<char>(code));
+    frame.append(2, '\0');
+    frame.append(token);
+    if (block != QCoapOption::Invalid) {
+        // Option delta over 12, encoded on an extra byte
+        frame.append(static_cast<char>(0xD1));
+        frame.append(static_cast<char>(block - 13));
+        frame.append(static_cast<char>(blockValue));
+    }
+    if (!payload.isEmpty())
+        frame.append(static_cast<char>(0xFF)).append(payload);
+
+    return QCoapQTcpConnection::toTcpFrame(frame);
+}
+
+/*
+    Returns the one byte value of the Block option \a block of \a message,
+    or -1 if it has none.
+*/
+static int blockValue(const QCoapMessage &message, QCoapOption::OptionName block)
+{
+    const QCoapOption option = message.option(block);
+    if (!option.isValid() || option.length() != 1)
+        return -1;
+    return static_cast<quint8>(option.opaqueValue().at(0));
+}
+
+void tst_QCoapQTcpConnection::init()
+{
+    server = new QTcpServer(this);
+    QVERIFY(server->listen(QHostAddress::LocalHost));
+
+    serverBuffer.clear();
+    connect(server, &QTcpServer::newConnection, this, [this]() {
+        serverSocket = server->nextPendingConnection();
+        connect(serverSocket.data(), &QTcpSocket::readyRead, this, [this]() {
+            serverBuffer.append(serverSocket->readAll());
+        });
+    });
+}
+
+void tst_QCoapQTcpConnection::cleanup()
+{
+    delete server;
+    server = nullptr;
+}
+
+/*
+    Waits for \a count frames sent to the server and returns them,
+    concatenated.
+*/
+QByteArray tst_QCoapQTcpConnection::readFrames(int count)
+{
+    int size = 0;
+    const auto hasFrames = [&]() {
+        size = 0;
+        for (int i = 0; i < count; ++i) {
+            const qint64 frameSize = QCoapQTcpConnection::tcpFrameSize(serverBuffer, size);
+            if (frameSize <= 0 || serverBuffer.size() - size < frameSize)
+                return false;
+            size += static_cast<int>(frameSize);
+        }
+        return true;
+    };
+
+    if (!QTest::qWaitFor(hasFrames))
+        return QByteArray();
+
+    const QByteArray frames = serverBuffer.left(size);
+    serverBuffer.remove(0, size);
+    return frames;
+}
+
+/*
+    Waits for \a count frames sent to the server and returns the message of
+    the last one.
+*/
+QCoapMessage tst_QCoapQTcpConnection::readRequest(int count)
+{
+    QByteArray frames = readFrames(count);
+    for (int i = 1; i < count; ++i)
+        frames.remove(0, static_cast<int>(QCoapQTcpConnection::tcpFrameSize(frames)));
+    if (frames.isEmpty())
+        return QCoapMessage();
+
+    QScopedPointer<QCoapInternalReply> request(
+                QCoapInternalReply::createFromFrame(QCoapQTcpConnection::fromTcpFrame(frames)));
+    return request->detachedMessage();
+}
+
+void tst_QCoapQTcpConnection::frameConversion_data()
+{
+    QTest::addColumn<QByteArray>("udpFrame");
+    QTest::addColumn<QByteArray>("tcpHeader");
+
+    const QByteArray get = QByteArray::fromHex("4401" "1234" "deadbeef" "b474657374");
+    QTest::newRow("short") << get << QByteArray::fromHex("5401");
+
+    const QByteArray content = QByteArray::fromHex("6445" "1234" "deadbeefff");
+    QTest::newRow("8-bit_length")
+            << QByteArray(content + QByteArray(20, 'p')) << QByteArray::fromHex("d40845");
+    QTest::newRow("16-bit_length")
+            << QByteArray(content + QByteArray(300, 'p')) << QByteArray::fromHex("e4002045");
+    QTest::newRow("32-bit_length")
+            << QByteArray(content + QByteArray(70000, 'p'))
+            << QByteArray::fromHex("f40000106445");
+}
+
+void tst_QCoapQTcpConnection::frameConversion()
+{
+    QFETCH(QByteArray, udpFrame);
+    QFETCH(QByteArray, tcpHeader);
+
+    const QByteArray tcpFrame = QCoapQTcpConnection::toTcpFrame(udpFrame);
+    QCOMPARE(tcpFrame.left(tcpHeader.size()), tcpHeader);
+    QCOMPARE(tcpFrame.mid(tcpHeader.size()), udpFrame.mid(4));
+    QCOMPARE(QCoapQTcpConnection::tcpFrameSize(tcpFrame), qint64(tcpFrame.size()));
+
+    // Converted back as a non-confirmable message with the message ID 0
+    QByteArray expected = udpFrame;
+    expected[0] = static_cast<char>(0x50 | (udpFrame.at(0) & 0x0F));
+    expected[2] = 0;
+    expected[3] = 0;
+    QCOMPARE(QCoapQTcpConnection::fromTcpFrame(tcpFrame), expected);
+}
+
+void tst_QCoapQTcpConnection::tcpFrameSize_data()
+{
+    QTest::addColumn<QByteArray>("buffer");
+    QTest::addColumn<qint64>("size");
+
+    QTest::newRow("empty") << QByteArray() << qint64(0);
+    QTest::newRow("no_length") << QByteArray::fromHex("00") << qint64(2);
+    QTest::newRow("truncated_payload") << QByteArray::fromHex("5401") << qint64(11);
+    QTest::newRow("truncated_8-bit_length") << QByteArray::fromHex("d4") << qint64(0);
+    QTest::newRow("truncated_16-bit_length") << QByteArray::fromHex("e400") << qint64(0);
+    QTest::newRow("16-bit_length") << QByteArray::fromHex("e40020") << qint64(3 + 1 + 4 + 301);
+    QTest::newRow("invalid_token_length") << QByteArray::fromHex("09") << qint64(-1);
+}
+
+void tst_QCoapQTcpConnection::tcpFrameSize()
+{
+    QFETCH(QByteArray, buffer);
+    QFETCH(qint64, size);
+
+    QCOMPARE(QCoapQTcpConnection::tcpFrameSize(buffer), size);
+}
+
+void tst_QCoapQTcpConnection::sendRequest()
+{
+    QCoapQTcpConnectionForTest connection;
+    QVector<QPair<QByteArray, QHostAddress>> received;
+    connect(&connection, &QCoapConnection::readyRead,
+            [&](const QByteArray &data, const QHostAddress &sender) {
+                received.append(qMakePair(data, sender));
+            });
+
+    const QByteArray request = QByteArray::fromHex("4401" "1234" "deadbeef" "b474657374");
+    connection.sendRequest(request, localHost, server->serverPort());
+
+    // The CSM is always the first message of the connection
+    QCOMPARE(readFrames(2), clientCapabilities
+                            + QByteArray::fromHex("5401" "deadbeef" "b474657374"));
+    QVERIFY(connection.socket(localHost, server->serverPort()));
+
+    serverSocket->write(QByteArray::fromHex("6445" "deadbeef" "ff") + "hello");
+    QTRY_COMPARE(received.count(), 1);
+    QCOMPARE(received.first().first,
+             QByteArray::fromHex("5445" "0000" "deadbeef" "ff") + "hello");
+    QCOMPARE(received.first().second, QHostAddress(localHost));
+}
+
+void tst_QCoapQTcpConnection::emptyMessageDropped()
+{
+    QCoapQTcpConnectionForTest connection;
+
+    // Acknowledgments and resets have no meaning over TCP
+    connection.sendRequest(QByteArray::fromHex("60001234"), localHost, server->serverPort());
+    connection.sendRequest(QByteArray::fromHex("70001234"), localHost, server->serverPort());
+    connection.sendRequest(QByteArray::fromHex("44011234deadbeef"), localHost,
+                           server->serverPort());
+
+    QCOMPARE(readFrames(2), clientCapabilities + QByteArray::fromHex("0401deadbeef"));
+}
+
+void tst_QCoapQTcpConnection::capabilities()
+{
+    QCoapQTcpConnectionForTest connection;
+    QSignalSpy spyCapabilities(&connection, &QCoapQTcpConnection::capabilitiesReceived);
+    const quint16 port = server->serverPort();
+
+    connection.ping(localHost, port);
+    QVERIFY(!readFrames(2).isEmpty());
+    QCOMPARE(connection.peerMaximumMessageSize(localHost, port), 1152u);
+    QCOMPARE(connection.bertBlockSize(QCoapEndpoint::fromHost(localHost, port)), 0u);
+
+    // 8 KiB Max-Message-Size and BERT support
+    serverSocket->write(QByteArray::fromHex("40e1" "222000" "20"));
+    QTRY_COMPARE(spyCapabilities.count(), 1);
+    QCOMPARE(connection.peerMaximumMessageSize(localHost, port), 8192u);
+    QVERIFY(connection.isPeerBertSupported(localHost, port));
+    QCOMPARE(connection.bertBlockSize(QCoapEndpoint::fromHost(localHost, port)), 7u * 1024);
+}
+
+void tst_QCoapQTcpConnection::ping()
+{
+    QCoapQTcpConnectionForTest connection;
+    QSignalSpy spyPong(&connection, &QCoapQTcpConnection::pong);
+
+    connection.ping(localHost, server->serverPort());
+    QCOMPARE(readFrames(2), clientCapabilities + QByteArray::fromHex("00e2"));
+
+    serverSocket->write(QByteArray::fromHex("00e3"));
+    QTRY_COMPARE(spyPong.count(), 1);
+    QCOMPARE(spyPong.first().at(0).toString(), localHost);
+    QCOMPARE(spyPong.first().at(1).value<quint16>(), server->serverPort());
+}
+
+void tst_QCoapQTcpConnection::pingFromServer()
+{
+    QCoapQTcpConnectionForTest connection;
+
+    connection.ping(localHost, server->serverPort());
+    QVERIFY(!readFrames(2).isEmpty());
+
+    // The Pong echoes the token of the Ping
+    serverSocket->write(QByteArray::fromHex("02e2" "abcd"));
+    QCOMPARE(readFrames(1), QByteArray::fromHex("02e3" "abcd"));
+}
+
+void tst_QCoapQTcpConnection::abortFromServer()
+{
+    QCoapQTcpConnectionForTest connection;
+    QVector<QAbstractSocket::SocketError> errors;
+    connect(&connection, &QCoapConnection::error,
+            [&](QAbstractSocket::SocketError error) { errors.append(error); });
+    QVector<QCoapEndpoint> lostEndpoints;
+    connect(&connection, &QCoapConnection::connectionLost,
+            [&](const QCoapEndpoint &endpoint, QAbstractSocket::SocketError) {
+                lostEndpoints.append(endpoint);
+            });
+    const quint16 port = server->serverPort();
+
+    connection.ping(localHost, port);
+    QVERIFY(!readFrames(2).isEmpty());
+
+    serverSocket->write(QByteArray::fromHex("00e5"));
+    QTRY_COMPARE(errors.count(), 1);
+    QCOMPARE(errors.first(), QAbstractSocket::RemoteHostClosedError);
+    QVERIFY(!connection.socket(localHost, port));
+    QCOMPARE(lostEndpoints, QVector<QCoapEndpoint>({ QCoapEndpoint::fromHost(localHost, port) }));
+}
+
+void tst_QCoapQTcpConnection::connectionRefused()
+{
+    QCoapQTcpConnectionForTest connection;
+    QVector<QPair<QCoapEndpoint, QAbstractSocket::SocketError>> lost;
+    connect(&connection, &QCoapConnection::connectionLost,
+            [&](const QCoapEndpoint &endpoint, QAbstractSocket::SocketError error) {
+                lost.append(qMakePair(endpoint, error));
+            });
+
+    const quint16 port = server->serverPort();
+    server->close();
+
+    connection.ping(localHost, port);
+    QTRY_COMPARE(lost.count(), 1);
+    QCOMPARE(lost.first().first, QCoapEndpoint::fromHost(localHost, port));
+    QCOMPARE(lost.first().second, QAbstractSocket::ConnectionRefusedError);
+    QVERIFY(!connection.socket(localHost, port));
+}
+
+void tst_QCoapQTcpConnection::requestsFailOnConnectionLoss()
+{
+    // Requests over TCP are never retransmitted, so they must fail as soon
+    // as their connection is lost, not after MAX_TRANSMIT_WAIT
+    QCoapClient client;
+    const QUrl url(QStringLiteral("coap+tcp://127.0.0.1:%1/test").arg(server->serverPort()));
+
+    QScopedPointer<QCoapReply> aborted(client.get(url));
+    QVERIFY(!aborted.isNull());
+    QVERIFY(!readFrames(2).isEmpty());
+    serverSocket->write(QByteArray::fromHex("00e5"));
+    QTRY_VERIFY_WITH_TIMEOUT(aborted->isFinished(), 5000);
+    QVERIFY(aborted->errorReceived() != QtCoap::Error::Ok);
+
+    QScopedPointer<QCoapReply> reset(client.get(url));
+    QVERIFY(!readFrames(2).isEmpty());
+    serverSocket->abort();
+    QTRY_VERIFY_WITH_TIMEOUT(reset->isFinished(), 5000);
+    QVERIFY(reset->errorReceived() != QtCoap::Error::Ok);
+
+    server->close();
+    QScopedPointer<QCoapReply> refused(client.get(url));
+    QTRY_VERIFY_WITH_TIMEOUT(refused->isFinished(), 5000);
+    QVERIFY(refused->errorReceived() != QtCoap::Error::Ok);
+}
+
+void tst_QCoapQTcpConnection::bertDownload()
+{
+    QCoapClient client;
+    const QUrl url(QStringLiteral("coap+tcp://127.0.0.1:%1/large").arg(server->serverPort()));
+    const QByteArray firstBlock(2048, 'a');
+    const QByteArray lastBlock(100, 'b');
+
+    QScopedPointer<QCoapReply> reply(client.get(url));
+    QVERIFY(!reply.isNull());
+
+    // The capabilities of the server are unknown yet: no Block2 option
+    QCoapMessage request = readRequest(2);
+    QVERIFY(!request.token().isEmpty());
+    QVERIFY(!request.hasOption(QCoapOption::Block2));
+
+    // BERT block of two blocks of 1024 bytes, number 0, more blocks follow
+    serverSocket->write(serverCapabilities
+                        + tcpResponse(0x45, request.token(), QCoapOption::Block2, 0x0F,
+                                      firstBlock));
+
+    // The next block is numbered in blocks of 1024 bytes
+    request = readRequest();
+    QCOMPARE(blockValue(request, QCoapOption::Block2), 0x27);
+
+    serverSocket->write(tcpResponse(0x45, request.token(), QCoapOption::Block2, 0x27,
+                                    lastBlock));
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(reply->errorReceived(), QtCoap::Error::Ok);
+    QCOMPARE(reply->readAll(), firstBlock + lastBlock);
+}
+
+void tst_QCoapQTcpConnection::bertUpload()
+{
+    QCoapClient client;
+    const QUrl url(QStringLiteral("coap+tcp://127.0.0.1:%1/large").arg(server->serverPort()));
+
+    // Learn the capabilities of the server first
+    QScopedPointer<QCoapReply> warmUp(client.get(url));
+    const QCoapMessage getRequest = readRequest(2);
+    serverSocket->write(serverCapabilities + tcpResponse(0x45, getRequest.token()));
+    QTRY_VERIFY_WITH_TIMEOUT(warmUp->isFinished(), 5000);
+
+    QByteArray data(10000, 'u');
+    for (int i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>('a' + i % 26);
+
+    QScopedPointer<QCoapReply> reply(client.post(url, data));
+    QVERIFY(!reply.isNull());
+
+    // BERT block of seven blocks of 1024 bytes, number 0, more blocks follow
+    QCoapMessage request = readRequest();
+    QCOMPARE(blockValue(request, QCoapOption::Block1), 0x0F);
+    QCOMPARE(request.payload(), data.left(7 * 1024));
+
+    serverSocket->write(tcpResponse(0x5F, request.token(), QCoapOption::Block1, 0x0F));
+
+    // The last block starts at block 7, right after the payload of the first one
+    request = readRequest();
+    QCOMPARE(blockValue(request, QCoapOption::Block1), 0x77);
+    QCOMPARE(request.payload(), data.mid(7 * 1024));
+
+    serverSocket->write(tcpResponse(0x44, request.token(), QCoapOption::Block1, 0x77));
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(reply->errorReceived(), QtCoap::Error::Ok);
+    QCOMPARE(reply->responseCode(), QtCoap::ResponseCode::Changed);
+}
+
+void tst_QCoapQTcpConnection::noRetransmission()
+{
+    QCoapClient client;
+    client.setAckTimeout(100);
+    client.setMaximumRetransmitCount(2);
+    const QUrl url(QStringLiteral("coap+tcp://127.0.0.1:%1/test").arg(server->serverPort()));
+
+    QScopedPointer<QCoapReply> reply(
+                client.get(QCoapRequest(url, QCoapMessage::Type::Confirmable)));
+    QVERIFY(!reply.isNull());
+    QVERIFY(!readRequest(2).token().isEmpty());
+
+    // The request only fails after MAX_TRANSMIT_WAIT, without being sent again
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(reply->errorReceived(), QtCoap::Error::TimeOut);
+    QVERIFY(serverBuffer.isEmpty());
+}
+
+QTEST_MAIN(tst_QCoapQTcpConnection)
+
+#include "tst_qcoapqtcpconnection.moc"
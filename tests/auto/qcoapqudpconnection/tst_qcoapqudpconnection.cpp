@@ -43,6 +43,12 @@
 #include <private/qcoaprequest_p.h>
 #include "../coapnetworksettings.h"
 
+#if QT_CONFIG(dtls)
+#include <QtNetwork/qdtls.h>
+#include <QtNetwork/qsslcipher.h>
+#include <QtNetwork/qsslpresharedkeyauthenticator.h>
+#endif
+
 using namespace QtCoapNetworkSettings;
 
 class tst_QCoapQUdpConnection : public QObject
@@ -56,22 +62,132 @@ private Q_SLOTS:
     void reconnect();
     void sendRequest_data();
     void sendRequest();
+    void datagramBurst();
+    void ipv6EndpointOnIpv4Socket();
+    void dtlsSessionPerPeer();
+    void dtlsSessionLimit();
+    void dtlsHandshakeReport();
 };
 
 class QCoapQUdpConnectionForTest : public QCoapQUdpConnection
 {
     Q_OBJECT
 public:
-    QCoapQUdpConnectionForTest(QObject *parent = nullptr) :
-        QCoapQUdpConnection(QtCoap::SecurityMode::NoSecurity, parent)
+    QCoapQUdpConnectionForTest(QtCoap::SecurityMode security = QtCoap::SecurityMode::NoSecurity,
+                               QObject *parent = nullptr) :
+        QCoapQUdpConnection(security, parent)
     {}
 
     void bindSocketForTest() { d_func()->bindSocket(); }
     void sendRequest(const QByteArray &request, const QString &host, quint16 port)
     {
-        d_func()->sendRequest(request, host, port);
+        d_func()->sendRequest(request, QCoapEndpoint::fromHost(host, port));
+    }
+#if QT_CONFIG(dtls)
+    int sessionCount() const { return d_func()->dtlsSessions.size(); }
+#endif
+};
+
+class QCoapQUdpConnectionIPv4Private : public QCoapQUdpConnectionPrivate
+{
+    bool bind() override
+    {
+        return socket()->bind(QHostAddress::AnyIPv4, 0);
+    }
+};
+
+/*
+    A connection whose socket only handles IPv4.
+*/
+class QCoapQUdpConnectionIPv4 : public QCoapQUdpConnection
+{
+    Q_OBJECT
+public:
+    QCoapQUdpConnectionIPv4() :
+        QCoapQUdpConnection(*new QCoapQUdpConnectionIPv4Private)
+    {
+        createSocket();
+    }
+
+    void sendRequest(const QByteArray &request, const QString &host, quint16 port)
+    {
+        d_func()->sendRequest(request, QCoapEndpoint::fromHost(host, port));
+    }
+};
+
+#if QT_CONFIG(dtls)
+/*
+    A DTLS server authenticating its clients with a pre-shared key, and
+    sending back the frames it receives.
+*/
+class DtlsEchoServer : public QObject
+{
+    Q_OBJECT
+public:
+    DtlsEchoServer(const QHostAddress &address, const QByteArray &preSharedKey)
+        : preSharedKey(preSharedKey)
+    {
+        bound = socket.bind(address, 0);
+        connect(&socket, &QUdpSocket::readyRead, this, &DtlsEchoServer::readDatagrams);
+    }
+
+    static QList<QSslCipher> pskCiphers()
+    {
+        QList<QSslCipher> ciphers;
+        for (const QSslCipher &cipher : QSslConfiguration::supportedCiphers()) {
+            if (cipher.name().startsWith(QLatin1String("PSK-")))
+                ciphers.append(cipher);
+        }
+        return ciphers;
+    }
+
+    bool bound = false;
+    QUdpSocket socket;
+    QByteArray clientIdentity;
+    int handshakeCount = 0;
+
+private:
+    void readDatagrams()
+    {
+        while (socket.hasPendingDatagrams()) {
+            const QNetworkDatagram datagram = socket.receiveDatagram();
+            if (!dtls)
+                startSession(datagram);
+
+            if (dtls->isConnectionEncrypted()) {
+                const QByteArray frame = dtls->decryptDatagram(&socket, datagram.data());
+                if (dtls->dtlsError() == QDtlsError::RemoteClosedConnectionError)
+                    dtls.reset();
+                else if (!frame.isEmpty())
+                    dtls->writeDatagramEncrypted(&socket, frame);
+            } else if (dtls->doHandshake(&socket, datagram.data())
+                       && dtls->isConnectionEncrypted()) {
+                ++handshakeCount;
+            }
+        }
+    }
+
+    void startSession(const QNetworkDatagram &datagram)
+    {
+        auto configuration = QSslConfiguration::defaultDtlsConfiguration();
+        configuration.setPeerVerifyMode(QSslSocket::VerifyNone);
+        configuration.setDtlsCookieVerificationEnabled(false);
+        configuration.setCiphers(pskCiphers());
+
+        dtls.reset(new QDtls(QSslSocket::SslServerMode));
+        dtls->setDtlsConfiguration(configuration);
+        dtls->setPeer(datagram.senderAddress(), static_cast<quint16>(datagram.senderPort()));
+        connect(dtls.data(), &QDtls::pskRequired,
+                [this](QSslPreSharedKeyAuthenticator *authenticator) {
+                    clientIdentity = authenticator->identity();
+                    authenticator->setPreSharedKey(preSharedKey);
+                });
     }
+
+    QByteArray preSharedKey;
+    QScopedPointer<QDtls> dtls;
 };
+#endif
 
 void tst_QCoapQUdpConnection::initTestCase()
 {
@@ -205,6 +321,210 @@ void tst_QCoapQUdpConnection::sendRequest()
     QVERIFY(QString(data.toHex()).endsWith(dataHexaPayload));
 }
 
+void tst_QCoapQUdpConnection::datagramBurst()
+{
+    // More datagrams than a single batch, in both directions
+    const int datagramCount = 40;
+
+    QCoapQUdpConnectionForTest connection;
+    QVector<QByteArray> received;
+    connect(&connection, &QCoapConnection::readyRead,
+            [&](const QByteArray &data, const QHostAddress &sender) {
+                QVERIFY(sender.isEqual(QHostAddress::LocalHost));
+                received.append(data);
+            });
+
+    QUdpSocket peer;
+    QVERIFY(peer.bind(QHostAddress::LocalHost, 0));
+
+    // This will trigger connection.bind()
+    for (int i = 0; i < datagramCount; ++i) {
+        connection.sendRequest(QByteArray::number(i), QStringLiteral("127.0.0.1"),
+                               peer.localPort());
+    }
+
+    QVector<QByteArray> sent;
+    QTRY_VERIFY([&]() {
+        while (peer.hasPendingDatagrams())
+            sent.append(peer.receiveDatagram().data());
+        return sent.size() == datagramCount;
+    }());
+    for (int i = 0; i < datagramCount; ++i)
+        QCOMPARE(sent.at(i), QByteArray::number(i));
+
+    for (int i = 0; i < datagramCount; ++i) {
+        peer.writeDatagram(QByteArray::number(i), QHostAddress::LocalHost,
+                           connection.socket()->localPort());
+    }
+    QTRY_COMPARE(received.size(), datagramCount);
+    for (int i = 0; i < datagramCount; ++i)
+        QCOMPARE(received.at(i), QByteArray::number(i));
+}
+
+void tst_QCoapQUdpConnection::ipv6EndpointOnIpv4Socket()
+{
+    QCoapQUdpConnectionIPv4 connection;
+    QUdpSocket peer;
+    QVERIFY(peer.bind(QHostAddress::LocalHost, 0));
+
+    // The IPv6 datagrams cannot be sent in a batch by an IPv4 socket, and
+    // must not prevent the others from being sent
+    const int datagramCount = 20;
+    for (int i = 0; i < datagramCount; ++i) {
+        connection.sendRequest(QByteArray::number(i), QStringLiteral("127.0.0.1"),
+                               peer.localPort());
+        if (i % 3 == 0) {
+            connection.sendRequest(QByteArray("ipv6"), QStringLiteral("::1"),
+                                   peer.localPort());
+        }
+    }
+
+    QVector<QByteArray> sent;
+    QTRY_VERIFY([&]() {
+        while (peer.hasPendingDatagrams())
+            sent.append(peer.receiveDatagram().data());
+        return sent.size() == datagramCount;
+    }());
+    for (int i = 0; i < datagramCount; ++i)
+        QCOMPARE(sent.at(i), QByteArray::number(i));
+    QCOMPARE(connection.socket()->localAddress(), QHostAddress(QHostAddress::AnyIPv4));
+}
+
+void tst_QCoapQUdpConnection::dtlsSessionPerPeer()
+{
+#if QT_CONFIG(dtls)
+    if (DtlsEchoServer::pskCiphers().isEmpty())
+        QSKIP("No PSK cipher is supported, skipping this test");
+
+    DtlsEchoServer first(QHostAddress::LocalHost, "first key");
+    DtlsEchoServer second(QHostAddress::LocalHostIPv6, "second key");
+    QVERIFY(first.bound);
+    if (!second.bound)
+        QSKIP("IPv6 is not available, skipping this test");
+
+    // The second server has its own identity and key
+    QCoapSecurityConfiguration configuration;
+    configuration.setDefaultCipherString(QStringLiteral("PSK"));
+    configuration.setPreSharedKeyIdentity("default");
+    configuration.setPreSharedKey("first key");
+    configuration.setPeerPreSharedKey(QHostAddress::LocalHostIPv6, "second", "second key");
+
+    QCoapQUdpConnectionForTest connection(QtCoap::SecurityMode::PreSharedKey);
+    connection.setSecurityConfiguration(configuration);
+
+    QVector<QPair<QHostAddress, QByteArray>> received;
+    connect(&connection, &QCoapConnection::readyRead,
+            [&](const QByteArray &data, const QHostAddress &sender) {
+                received.append(qMakePair(sender, data));
+            });
+
+    // Both sessions share the socket of the connection
+    connection.sendRequest("to first", QStringLiteral("127.0.0.1"), first.socket.localPort());
+    connection.sendRequest("to second", QStringLiteral("::1"), second.socket.localPort());
+
+    QTRY_COMPARE(received.size(), 2);
+    QCOMPARE(connection.sessionCount(), 2);
+    QCOMPARE(first.clientIdentity, QByteArray("default"));
+    QCOMPARE(second.clientIdentity, QByteArray("second"));
+
+    for (const auto &datagram : qAsConst(received)) {
+        if (datagram.first.isEqual(QHostAddress::LocalHost))
+            QCOMPARE(datagram.second, QByteArray("to first"));
+        else
+            QCOMPARE(datagram.second, QByteArray("to second"));
+    }
+#else
+    QSKIP("DTLS is disabled, skipping this test");
+#endif
+}
+
+void tst_QCoapQUdpConnection::dtlsSessionLimit()
+{
+#if QT_CONFIG(dtls)
+    if (DtlsEchoServer::pskCiphers().isEmpty())
+        QSKIP("No PSK cipher is supported, skipping this test");
+
+    DtlsEchoServer first(QHostAddress::LocalHost, "key");
+    DtlsEchoServer second(QHostAddress::LocalHost, "key");
+    QVERIFY(first.bound);
+    QVERIFY(second.bound);
+
+    QCoapSecurityConfiguration configuration;
+    configuration.setDefaultCipherString(QStringLiteral("PSK"));
+    configuration.setPreSharedKeyIdentity("client");
+    configuration.setPreSharedKey("key");
+    configuration.setMaximumSessionCount(1);
+
+    QCoapQUdpConnectionForTest connection(QtCoap::SecurityMode::PreSharedKey);
+    connection.setSecurityConfiguration(configuration);
+
+    int received = 0;
+    connect(&connection, &QCoapConnection::readyRead, [&received]() { ++received; });
+
+    const QString host = QStringLiteral("127.0.0.1");
+    connection.sendRequest("frame", host, first.socket.localPort());
+    QTRY_COMPARE(received, 1);
+
+    // Opening a session with the second server closes the first one
+    connection.sendRequest("frame", host, second.socket.localPort());
+    QTRY_COMPARE(received, 2);
+    QCOMPARE(connection.sessionCount(), 1);
+
+    connection.sendRequest("frame", host, first.socket.localPort());
+    QTRY_COMPARE(received, 3);
+    QCOMPARE(connection.sessionCount(), 1);
+    QCOMPARE(first.handshakeCount, 2);
+    QCOMPARE(second.handshakeCount, 1);
+#else
+    QSKIP("DTLS is disabled, skipping this test");
+#endif
+}
+
+void tst_QCoapQUdpConnection::dtlsHandshakeReport()
+{
+#if QT_CONFIG(dtls)
+    if (DtlsEchoServer::pskCiphers().isEmpty())
+        QSKIP("No PSK cipher is supported, skipping this test");
+
+    DtlsEchoServer server(QHostAddress::LocalHost, "key");
+    QVERIFY(server.bound);
+
+    QCoapSecurityConfiguration configuration;
+    configuration.setDefaultCipherString(QStringLiteral("PSK"));
+    configuration.setPreSharedKeyIdentity("client");
+    configuration.setPreSharedKey("key");
+
+    QCoapQUdpConnectionForTest connection(QtCoap::SecurityMode::PreSharedKey);
+    connection.setSecurityConfiguration(configuration);
+
+    int received = 0;
+    connect(&connection, &QCoapConnection::readyRead, [&received]() { ++received; });
+    QVector<qint64> handshakes;
+    connect(&connection, &QCoapQUdpConnection::handshakeCompleted,
+            [&](const QHostAddress &address, quint16 port, qint64 duration) {
+                QVERIFY(address.isEqual(QHostAddress::LocalHost));
+                QCOMPARE(port, server.socket.localPort());
+                handshakes.append(duration);
+            });
+
+    const QString host = QStringLiteral("127.0.0.1");
+    connection.sendRequest("frame", host, server.socket.localPort());
+    QTRY_COMPARE(received, 1);
+    QCOMPARE(handshakes.size(), 1);
+    QVERIFY(handshakes.first() >= 0);
+
+    // Reconnecting after disconnect() makes a new handshake
+    connection.disconnect();
+    connection.sendRequest("frame", host, server.socket.localPort());
+    QTRY_COMPARE(received, 2);
+    QCOMPARE(handshakes.size(), 2);
+    QVERIFY(handshakes.last() >= 0);
+    QCOMPARE(server.handshakeCount, 2);
+#else
+    QSKIP("DTLS is disabled, skipping this test");
+#endif
+}
+
 QTEST_MAIN(tst_QCoapQUdpConnection)
 
 #include "tst_qcoapqudpconnection.moc"
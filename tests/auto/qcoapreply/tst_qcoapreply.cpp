@@ -43,6 +43,8 @@ private Q_SLOTS:
     void updateReply_data();
     void updateReply();
     void requestData();
+    void streamBlocks_data();
+    void streamBlocks();
     void abortRequest();
 };
 
@@ -126,6 +128,67 @@ void tst_QCoapReply::requestData()
     QCOMPARE(reply->request().messageId(), 543);
 }
 
+void tst_QCoapReply::streamBlocks_data()
+{
+    QTest::addColumn<qint64>("totalSize");
+    QTest::addColumn<QtCoap::ResponseCode>("responseCode");
+
+    QTest::newRow("known_size") << qint64(40) << QtCoap::ResponseCode::Content;
+    QTest::newRow("unknown_size") << qint64(-1) << QtCoap::ResponseCode::Content;
+    QTest::newRow("error") << qint64(40) << QtCoap::ResponseCode::RequestEntityIncomplete;
+}
+
+void tst_QCoapReply::streamBlocks()
+{
+    QFETCH(qint64, totalSize);
+    QFETCH(QtCoap::ResponseCode, responseCode);
+
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QSignalSpy spyReadyRead(reply.data(), &QCoapReply::readyRead);
+    QSignalSpy spyProgress(reply.data(), &QCoapReply::downloadProgress);
+
+    const QByteArray blocks[] = { QByteArray(16, 'a'), QByteArray(16, 'b'), QByteArray(8, 'c') };
+
+    // The data can be read as soon as each block is received
+    QByteArray readData;
+    qint64 received = 0;
+    for (const QByteArray &block : blocks) {
+        QMetaObject::invokeMethod(reply.data(), "_q_appendPayload",
+                                  Q_ARG(QByteArray, block),
+                                  Q_ARG(qint64, totalSize));
+        received += block.size();
+
+        QCOMPARE(spyProgress.count(), spyReadyRead.count());
+        const QList<QVariant> progress = spyProgress.takeLast();
+        QCOMPARE(progress.at(0).toLongLong(), received);
+        QCOMPARE(progress.at(1).toLongLong(), totalSize);
+        spyReadyRead.clear();
+
+        QCOMPARE(reply->readAll(), block);
+        readData.append(block);
+    }
+    QVERIFY(!reply->isFinished());
+
+    // The final message does not carry the streamed blocks again
+    QCoapMessage message;
+    message.setPayload(blocks[2]);
+    QMetaObject::invokeMethod(reply.data(), "_q_setContent",
+                              Q_ARG(QHostAddress, QHostAddress()),
+                              Q_ARG(QCoapMessage, message),
+                              Q_ARG(QtCoap::ResponseCode, responseCode));
+    QMetaObject::invokeMethod(reply.data(), "_q_setFinished",
+                              Q_ARG(QtCoap::Error, QtCoap::Error::Ok));
+
+    QVERIFY(reply->isFinished());
+    if (QtCoap::isError(responseCode)) {
+        QCOMPARE(reply->message().payload(), blocks[2]);
+        QCOMPARE(reply->readAll(), blocks[2]);
+    } else {
+        QCOMPARE(reply->message().payload(), readData);
+        QCOMPARE(reply->readAll(), QByteArray());
+    }
+}
+
 void tst_QCoapReply::abortRequest()
 {
     QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
@@ -0,0 +1,4 @@
+QT = testlib network core coap coap-private
+CONFIG += testcase
+
+SOURCES += tst_qcoapreplydispatcher.cpp
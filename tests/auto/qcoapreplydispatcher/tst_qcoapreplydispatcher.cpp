@@ -0,0 +1,307 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapreply.h>
+#include <private/qcoapreply_p.h>
+#include <private/qcoapreplydispatcher_p.h>
+
+class tst_QCoapReplyDispatcher : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void applySteps_data();
+    void applySteps();
+    void singleEventPerBatch();
+    void postFromThreads();
+    void replyDestroyed();
+    void coalesceNotifications_data();
+    void coalesceNotifications();
+};
+
+/*
+    Counts the delivery events received by the dispatcher.
+*/
+class DeliveryEventCounter : public QObject
+{
+public:
+    bool eventFilter(QObject *, QEvent *event) override
+    {
+        if (event->type() >= QEvent::User)
+            ++count;
+        return false;
+    }
+
+    int count = 0;
+};
+
+/*
+    Posts \a count records, each appending its index as a payload block to
+    \a reply.
+*/
+class CompletionProducer : public QThread
+{
+public:
+    CompletionProducer(QCoapReplyDispatcher *dispatcher, QCoapReply *reply, int count) :
+        dispatcher(dispatcher), reply(reply), count(count)
+    {}
+
+    void run() override
+    {
+        for (int i = 0; i < count; ++i) {
+            auto completion = new QCoapReplyCompletion;
+            completion->reply = reply;
+            completion->steps = QCoapReplyCompletion::Payload;
+            completion->block = QByteArray::number(i) + ',';
+            dispatcher->post(completion);
+        }
+    }
+
+    QCoapReplyDispatcher *dispatcher;
+    QCoapReply *reply;
+    int count;
+};
+
+void tst_QCoapReplyDispatcher::applySteps_data()
+{
+    QTest::addColumn<QtCoap::ResponseCode>("responseCode");
+    QTest::addColumn<QtCoap::Error>("error");
+    QTest::addColumn<bool>("observe");
+
+    QTest::newRow("content") << QtCoap::ResponseCode::Content << QtCoap::Error::Ok << false;
+    QTest::newRow("content_error")
+            << QtCoap::ResponseCode::NotFound << QtCoap::Error::Ok << false;
+    QTest::newRow("error") << QtCoap::ResponseCode::InvalidCode << QtCoap::Error::TimeOut << false;
+    QTest::newRow("notification") << QtCoap::ResponseCode::Content << QtCoap::Error::Ok << true;
+}
+
+void tst_QCoapReplyDispatcher::applySteps()
+{
+    QFETCH(QtCoap::ResponseCode, responseCode);
+    QFETCH(QtCoap::Error, error);
+    QFETCH(bool, observe);
+
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QSignalSpy spyFinished(reply.data(), &QCoapReply::finished);
+    QSignalSpy spyNotified(reply.data(), &QCoapReply::notified);
+    QSignalSpy spyError(reply.data(), &QCoapReply::error);
+
+    QCoapReplyDispatcher dispatcher;
+
+    auto running = new QCoapReplyCompletion;
+    running->reply = reply.data();
+    running->steps = QCoapReplyCompletion::Running;
+    running->token = "token";
+    running->messageId = 543;
+    dispatcher.post(running);
+
+    auto completion = new QCoapReplyCompletion;
+    completion->reply = reply.data();
+    if (error != QtCoap::Error::Ok) {
+        completion->steps = QCoapReplyCompletion::Error | QCoapReplyCompletion::Finished;
+        completion->error = error;
+    } else {
+        completion->steps = QCoapReplyCompletion::Content;
+        completion->steps |= observe ? QCoapReplyCompletion::Notified
+                                     : QCoapReplyCompletion::Finished;
+        completion->message.setPayload("payload");
+        completion->responseCode = responseCode;
+    }
+    dispatcher.post(completion);
+
+    // Nothing is applied before the delivery event is handled
+    QVERIFY(!reply->isRunning());
+    QTRY_VERIFY(reply->isRunning() || reply->isFinished());
+
+    QCOMPARE(reply->request().token(), QByteArray("token"));
+    QCOMPARE(reply->request().messageId(), 543);
+    QCOMPARE(reply->isFinished(), !observe);
+    QCOMPARE(spyFinished.count(), observe ? 0 : 1);
+    QCOMPARE(spyNotified.count(), observe ? 1 : 0);
+
+    const bool failed = error != QtCoap::Error::Ok || QtCoap::isError(responseCode);
+    QCOMPARE(spyError.count(), failed ? 1 : 0);
+    if (error == QtCoap::Error::Ok)
+        QCOMPARE(reply->readAll(), QByteArray("payload"));
+}
+
+void tst_QCoapReplyDispatcher::singleEventPerBatch()
+{
+    QCoapReplyDispatcher dispatcher;
+    DeliveryEventCounter counter;
+    dispatcher.installEventFilter(&counter);
+
+    QVector<QCoapReply *> replies;
+    for (int i = 0; i < 100; ++i) {
+        replies.append(QCoapReplyPrivate::createCoapReply(QCoapRequest(), &dispatcher));
+        auto completion = new QCoapReplyCompletion;
+        completion->reply = replies.last();
+        completion->steps = QCoapReplyCompletion::Content | QCoapReplyCompletion::Finished;
+        completion->responseCode = QtCoap::ResponseCode::Content;
+        dispatcher.post(completion);
+    }
+
+    QTRY_VERIFY(replies.last()->isFinished());
+    for (QCoapReply *reply : qAsConst(replies))
+        QVERIFY(reply->isFinished());
+    QCOMPARE(counter.count, 1);
+
+    // Records taken directly are not delivered again by the pending event
+    auto completion = new QCoapReplyCompletion;
+    completion->reply = replies.first();
+    completion->steps = QCoapReplyCompletion::Notified;
+    dispatcher.post(completion);
+    QCOMPARE(dispatcher.deliverPending(), 1);
+    QCoreApplication::processEvents();
+    QCOMPARE(counter.count, 2);
+    QCOMPARE(dispatcher.deliverPending(), 0);
+}
+
+void tst_QCoapReplyDispatcher::postFromThreads()
+{
+    const int producerCount = 4;
+    const int recordCount = 2000;
+
+    QCoapReplyDispatcher dispatcher;
+    QVector<QCoapReply *> replies;
+    QVector<CompletionProducer *> producers;
+    for (int i = 0; i < producerCount; ++i) {
+        replies.append(QCoapReplyPrivate::createCoapReply(QCoapRequest(), &dispatcher));
+        producers.append(new CompletionProducer(&dispatcher, replies.last(), recordCount));
+    }
+
+    for (CompletionProducer *producer : qAsConst(producers))
+        producer->start();
+    for (CompletionProducer *producer : qAsConst(producers))
+        QVERIFY(producer->wait(10000));
+    qDeleteAll(producers);
+
+    QByteArray expected;
+    for (int i = 0; i < recordCount; ++i)
+        expected += QByteArray::number(i) + ',';
+
+    // The records of each producer are applied in the order they were posted
+    for (QCoapReply *reply : qAsConst(replies)) {
+        QTRY_COMPARE(reply->bytesAvailable(), qint64(expected.size()));
+        QCOMPARE(reply->readAll(), expected);
+    }
+}
+
+void tst_QCoapReplyDispatcher::replyDestroyed()
+{
+    QCoapReplyDispatcher dispatcher;
+    QPointer<QCoapReply> deleted = QCoapReplyPrivate::createCoapReply(QCoapRequest());
+    QPointer<QCoapReply> deletedInSlot = QCoapReplyPrivate::createCoapReply(QCoapRequest());
+    QScopedPointer<QCoapReply> other(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+
+    connect(deletedInSlot.data(), &QCoapReply::finished, this, [](QCoapReply *reply) {
+        delete reply;
+    });
+
+    for (QCoapReply *reply : { deleted.data(), deletedInSlot.data(), other.data() }) {
+        auto completion = new QCoapReplyCompletion;
+        completion->reply = reply;
+        completion->steps = QCoapReplyCompletion::Finished
+                | QCoapReplyCompletion::ObserveCancelled;
+        dispatcher.post(completion);
+    }
+    delete deleted.data();
+
+    QTRY_VERIFY(other->isFinished());
+    QVERIFY(deletedInSlot.isNull());
+}
+
+void tst_QCoapReplyDispatcher::coalesceNotifications_data()
+{
+    QTest::addColumn<bool>("coalesce");
+
+    QTest::newRow("all") << false;
+    QTest::newRow("coalesced") << true;
+}
+
+void tst_QCoapReplyDispatcher::coalesceNotifications()
+{
+    QFETCH(bool, coalesce);
+
+    QCoapReplyDispatcher dispatcher;
+    dispatcher.setNotificationCoalescingEnabled(coalesce);
+    QCOMPARE(dispatcher.isNotificationCoalescingEnabled(), coalesce);
+
+    QScopedPointer<QCoapReply> first(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QScopedPointer<QCoapReply> second(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QVector<QByteArray> firstPayloads;
+    QVector<QByteArray> secondPayloads;
+    connect(first.data(), &QCoapReply::notified, this,
+            [&](QCoapReply *, const QCoapMessage &message) {
+        firstPayloads.append(message.payload());
+    });
+    connect(second.data(), &QCoapReply::notified, this,
+            [&](QCoapReply *, const QCoapMessage &message) {
+        secondPayloads.append(message.payload());
+    });
+
+    // Notifications of both replies, pending in the same batch, the last
+    // record of the first reply also finishing it
+    const auto postNotification = [&](QCoapReply *reply, const QByteArray &payload,
+                                      bool finished) {
+        auto completion = new QCoapReplyCompletion;
+        completion->reply = reply;
+        completion->steps = QCoapReplyCompletion::Content | QCoapReplyCompletion::Notified;
+        if (finished)
+            completion->steps |= QCoapReplyCompletion::Finished;
+        completion->responseCode = QtCoap::ResponseCode::Content;
+        completion->message.setPayload(payload);
+        dispatcher.post(completion);
+    };
+    postNotification(first.data(), "1", false);
+    postNotification(second.data(), "a", false);
+    postNotification(first.data(), "2", false);
+    postNotification(first.data(), "3", false);
+    postNotification(second.data(), "b", false);
+    postNotification(first.data(), "4", true);
+
+    QCOMPARE(dispatcher.deliverPending(), coalesce ? 3 : 6);
+    QVERIFY(first->isFinished());
+
+    // The notification finishing the reply does not supersede the others
+    if (coalesce) {
+        QCOMPARE(firstPayloads, QVector<QByteArray>({ "3", "4" }));
+        QCOMPARE(secondPayloads, QVector<QByteArray>({ "b" }));
+    } else {
+        QCOMPARE(firstPayloads, QVector<QByteArray>({ "1", "2", "3", "4" }));
+        QCOMPARE(secondPayloads, QVector<QByteArray>({ "a", "b" }));
+    }
+}
+
+QTEST_MAIN(tst_QCoapReplyDispatcher)
+
+#include "tst_qcoapreplydispatcher.moc"
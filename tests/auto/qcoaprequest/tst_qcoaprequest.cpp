@@ -48,6 +48,9 @@ private Q_SLOTS:
     void setUrl_data();
     void setUrl();
     void enableObserve();
+    void setPriority();
+    void setBlockRange_data();
+    void setBlockRange();
     void copyAndDetach();
 };
 
@@ -155,6 +158,65 @@ void tst_QCoapRequest::enableObserve()
     QCOMPARE(request.isObserve(), true);
 }
 
+void tst_QCoapRequest::setPriority()
+{
+    QCoapRequest request;
+    QCOMPARE(request.priority(), QCoapRequest::NormalPriority);
+
+    request.setPriority(QCoapRequest::HighPriority);
+    QCOMPARE(request.priority(), QCoapRequest::HighPriority);
+
+    QCoapRequest copy(request);
+    QCOMPARE(copy.priority(), QCoapRequest::HighPriority);
+}
+
+void tst_QCoapRequest::setBlockRange_data()
+{
+    QTest::addColumn<uint>("firstBlock");
+    QTest::addColumn<uint>("lastBlock");
+    QTest::addColumn<quint16>("blockSize");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("single_block") << 3u << 3u << quint16(64) << true;
+    QTest::newRow("range") << 0u << 10u << quint16(1024) << true;
+    QTest::newRow("smallest_blocks") << 2u << 5u << quint16(16) << true;
+    QTest::newRow("last_block_number") << 0u << 0xFFFFFu << quint16(16) << true;
+    QTest::newRow("reversed") << 5u << 2u << quint16(64) << false;
+    QTest::newRow("block_number_too_large") << 0u << 0x100000u << quint16(64) << false;
+    QTest::newRow("block_size_too_small") << 0u << 1u << quint16(8) << false;
+    QTest::newRow("block_size_too_large") << 0u << 1u << quint16(2048) << false;
+    QTest::newRow("block_size_not_power_of_2") << 0u << 1u << quint16(100) << false;
+}
+
+void tst_QCoapRequest::setBlockRange()
+{
+    QFETCH(uint, firstBlock);
+    QFETCH(uint, lastBlock);
+    QFETCH(quint16, blockSize);
+    QFETCH(bool, valid);
+
+    QCoapRequest request;
+    QCOMPARE(request.hasBlockRange(), false);
+    QCOMPARE(request.rangeBlockSize(), quint16(0));
+
+    request.setBlockRange(firstBlock, lastBlock, blockSize);
+    QCOMPARE(request.hasBlockRange(), valid);
+
+    if (valid) {
+        QCOMPARE(request.firstBlock(), firstBlock);
+        QCOMPARE(request.lastBlock(), lastBlock);
+        QCOMPARE(request.rangeBlockSize(), blockSize);
+
+        QCoapRequest copy(request);
+        QCOMPARE(copy.hasBlockRange(), true);
+        QCOMPARE(copy.firstBlock(), firstBlock);
+
+        copy.clearBlockRange();
+        QCOMPARE(copy.hasBlockRange(), false);
+        QCOMPARE(request.hasBlockRange(), true);
+    }
+}
+
 void tst_QCoapRequest::copyAndDetach()
 {
 #ifdef QT_BUILD_INTERNAL
@@ -0,0 +1,181 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoaprequestscheduler_p.h>
+
+class tst_QCoapRequestScheduler : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void unlimited();
+    void limitPerEndpoint();
+    void fifoOrder();
+    void priorityOrder();
+    void raiseLimit();
+    void statistics();
+};
+
+static const QHostAddress host1(QStringLiteral("10.0.0.1"));
+static const QHostAddress host2(QStringLiteral("10.0.0.2"));
+
+static QCoapRequestScheduler::PendingRequest pendingRequest(qint64 queuedTime)
+{
+    QCoapRequestScheduler::PendingRequest request;
+    request.queuedTime = queuedTime;
+    return request;
+}
+
+void tst_QCoapRequestScheduler::unlimited()
+{
+    QCoapRequestScheduler scheduler;
+    QCOMPARE(scheduler.maximumOutstanding(), 0);
+
+    for (int i = 0; i < 1000; ++i)
+        QVERIFY(scheduler.tryAcquire(host1));
+
+    QCOMPARE(scheduler.statistics(host1, 0).outstandingCount, 1000);
+}
+
+void tst_QCoapRequestScheduler::limitPerEndpoint()
+{
+    QCoapRequestScheduler scheduler;
+    scheduler.setMaximumOutstanding(2);
+
+    QVERIFY(scheduler.tryAcquire(host1));
+    QVERIFY(scheduler.tryAcquire(host1));
+    QVERIFY(!scheduler.tryAcquire(host1));
+    QVERIFY(scheduler.tryAcquire(host2));
+
+    QCoapRequestScheduler::PendingRequest next;
+    scheduler.enqueue(host1, QCoapRequest::NormalPriority, pendingRequest(0));
+    QVERIFY(scheduler.hasQueuedRequests(host1));
+    QVERIFY(!scheduler.takeNext(host1, 0, &next));
+
+    // A queued request keeps a released slot for itself
+    scheduler.release(host1);
+    QVERIFY(!scheduler.tryAcquire(host1));
+    QVERIFY(scheduler.takeNext(host1, 0, &next));
+    QVERIFY(!scheduler.hasQueuedRequests(host1));
+    QCOMPARE(scheduler.statistics(host1, 0).outstandingCount, 2);
+}
+
+void tst_QCoapRequestScheduler::fifoOrder()
+{
+    QCoapRequestScheduler scheduler;
+    scheduler.setMaximumOutstanding(1);
+    QVERIFY(scheduler.tryAcquire(host1));
+
+    for (int i = 0; i < 5; ++i)
+        scheduler.enqueue(host1, QCoapRequest::NormalPriority, pendingRequest(i));
+
+    QCoapRequestScheduler::PendingRequest next;
+    for (int i = 0; i < 5; ++i) {
+        scheduler.release(host1);
+        QVERIFY(scheduler.takeNext(host1, 10, &next));
+        QCOMPARE(next.queuedTime, qint64(i));
+    }
+
+    scheduler.release(host1);
+    QVERIFY(!scheduler.takeNext(host1, 10, &next));
+}
+
+void tst_QCoapRequestScheduler::priorityOrder()
+{
+    QCoapRequestScheduler scheduler;
+    scheduler.setMaximumOutstanding(1);
+    QVERIFY(scheduler.tryAcquire(host1));
+
+    scheduler.enqueue(host1, QCoapRequest::LowPriority, pendingRequest(1));
+    scheduler.enqueue(host1, QCoapRequest::NormalPriority, pendingRequest(2));
+    scheduler.enqueue(host1, QCoapRequest::HighPriority, pendingRequest(3));
+    scheduler.enqueue(host1, QCoapRequest::HighPriority, pendingRequest(4));
+
+    const qint64 expectedOrder[] = { 3, 4, 2, 1 };
+    QCoapRequestScheduler::PendingRequest next;
+    for (qint64 expected : expectedOrder) {
+        scheduler.release(host1);
+        QVERIFY(scheduler.takeNext(host1, 10, &next));
+        QCOMPARE(next.queuedTime, expected);
+    }
+}
+
+void tst_QCoapRequestScheduler::raiseLimit()
+{
+    QCoapRequestScheduler scheduler;
+    scheduler.setMaximumOutstanding(1);
+    QVERIFY(scheduler.tryAcquire(host1));
+    QVERIFY(scheduler.tryAcquire(host2));
+    scheduler.enqueue(host1, QCoapRequest::NormalPriority, pendingRequest(0));
+    QVERIFY(scheduler.readyEndpoints().isEmpty());
+
+    scheduler.setMaximumOutstanding(2);
+    QCOMPARE(scheduler.readyEndpoints(), QVector<QHostAddress>() << host1);
+
+    QCoapRequestScheduler::PendingRequest next;
+    QVERIFY(scheduler.takeNext(host1, 0, &next));
+    QVERIFY(scheduler.readyEndpoints().isEmpty());
+}
+
+void tst_QCoapRequestScheduler::statistics()
+{
+    QCoapRequestScheduler scheduler;
+    scheduler.setMaximumOutstanding(1);
+    QVERIFY(scheduler.tryAcquire(host1));
+
+    scheduler.enqueue(host1, QCoapRequest::LowPriority, pendingRequest(100));
+    scheduler.enqueue(host1, QCoapRequest::HighPriority, pendingRequest(200));
+
+    QCoapRequestScheduler::Statistics statistics = scheduler.statistics(host1, 300);
+    QCOMPARE(statistics.outstandingCount, 1);
+    QCOMPARE(statistics.queueDepth, 2);
+    QCOMPARE(statistics.oldestWaitTime, qint64(200));
+    QCOMPARE(statistics.dequeuedCount, quint64(0));
+
+    QCoapRequestScheduler::PendingRequest next;
+    scheduler.release(host1);
+    QVERIFY(scheduler.takeNext(host1, 300, &next));
+    scheduler.release(host1);
+    QVERIFY(scheduler.takeNext(host1, 500, &next));
+
+    statistics = scheduler.statistics(host1, 500);
+    QCOMPARE(statistics.queueDepth, 0);
+    QCOMPARE(statistics.oldestWaitTime, qint64(0));
+    QCOMPARE(statistics.lastWaitTime, qint64(400));
+    QCOMPARE(statistics.maximumWaitTime, qint64(400));
+    QCOMPARE(statistics.averageWaitTime, 250.0);
+    QCOMPARE(statistics.dequeuedCount, quint64(2));
+}
+
+QTEST_MAIN(tst_QCoapRequestScheduler)
+
+#include "tst_qcoaprequestscheduler.moc"
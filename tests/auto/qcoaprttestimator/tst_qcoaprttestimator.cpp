@@ -0,0 +1,187 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoaprttestimator_p.h>
+
+class tst_QCoapRttEstimator : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initialTimeout();
+    void strongSamples();
+    void weakSamples();
+    void ignoredSamples();
+    void independentEndpoints();
+    void agingShortTimeout();
+    void agingLongTimeout();
+    void backoffFactor_data();
+    void backoffFactor();
+};
+
+static const QHostAddress lanHost(QStringLiteral("192.168.1.10"));
+static const QHostAddress remoteHost(QStringLiteral("10.20.30.40"));
+
+void tst_QCoapRttEstimator::initialTimeout()
+{
+    QCoapRttEstimator estimator;
+    QCOMPARE(estimator.initialTimeout(), 2000u);
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 0), 2000u);
+
+    estimator.setInitialTimeout(500);
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 0), 500u);
+
+    const QCoapRttEstimator::Statistics statistics = estimator.statistics(lanHost, 0);
+    QCOMPARE(statistics.retransmissionTimeout, 500u);
+    QCOMPARE(statistics.strongSampleCount, 0);
+    QCOMPARE(statistics.weakSampleCount, 0);
+    QCOMPARE(statistics.lastUpdate, qint64(-1));
+}
+
+void tst_QCoapRttEstimator::strongSamples()
+{
+    QCoapRttEstimator estimator;
+
+    // First sample: RTT = 4, RTTVAR = 2, RTO = 0.5 * (4 + 4 * 2) + 0.5 * 2000
+    estimator.addSample(lanHost, 4, 0, 1000);
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 1000), 1006u);
+
+    for (int i = 0; i < 20; ++i)
+        estimator.addSample(lanHost, 4, 0, 1000);
+
+    QVERIFY(estimator.retransmissionTimeout(lanHost, 1000) < 20);
+
+    const QCoapRttEstimator::Statistics statistics = estimator.statistics(lanHost, 1000);
+    QCOMPARE(statistics.strongSampleCount, 21);
+    QCOMPARE(statistics.weakSampleCount, 0);
+    QCOMPARE(statistics.strongRoundTripTime, 4.0);
+    QCOMPARE(statistics.lastUpdate, qint64(1000));
+}
+
+void tst_QCoapRttEstimator::weakSamples()
+{
+    QCoapRttEstimator estimator;
+
+    // Weak estimations use K = 1 and a weight of 1/4
+    estimator.addSample(lanHost, 100, 1, 0);
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 0), 1537u);
+
+    const QCoapRttEstimator::Statistics statistics = estimator.statistics(lanHost, 0);
+    QCOMPARE(statistics.strongSampleCount, 0);
+    QCOMPARE(statistics.weakSampleCount, 1);
+    QCOMPARE(statistics.weakRoundTripTime, 100.0);
+    QCOMPARE(statistics.weakRoundTripTimeVariation, 50.0);
+}
+
+void tst_QCoapRttEstimator::ignoredSamples()
+{
+    QCoapRttEstimator estimator;
+
+    estimator.addSample(lanHost, 100, 3, 0);
+    QCOMPARE(estimator.endpointCount(), 0);
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 0), 2000u);
+}
+
+void tst_QCoapRttEstimator::independentEndpoints()
+{
+    QCoapRttEstimator estimator;
+
+    for (int i = 0; i < 20; ++i) {
+        estimator.addSample(lanHost, 3, 0, 0);
+        estimator.addSample(remoteHost, 900, 0, 0);
+    }
+
+    QCOMPARE(estimator.endpointCount(), 2);
+    QVERIFY(estimator.retransmissionTimeout(lanHost, 0) < 20);
+    QVERIFY(estimator.retransmissionTimeout(remoteHost, 0) > 800);
+
+    estimator.clear();
+    QCOMPARE(estimator.endpointCount(), 0);
+}
+
+void tst_QCoapRttEstimator::agingShortTimeout()
+{
+    QCoapRttEstimator estimator;
+    for (int i = 0; i < 20; ++i)
+        estimator.addSample(lanHost, 4, 0, 0);
+
+    const uint timeout = estimator.retransmissionTimeout(lanHost, 0);
+    QVERIFY(timeout < 20);
+
+    // Timeouts below 1 s double after 16 * RTO without update
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 16 * timeout - 1), timeout);
+    QVERIFY(estimator.retransmissionTimeout(lanHost, 16 * (timeout + 1)) >= 2 * timeout);
+
+    // And come back to the initial timeout, without exceeding it
+    QCOMPARE(estimator.retransmissionTimeout(lanHost, 3600 * 1000), 2000u);
+}
+
+void tst_QCoapRttEstimator::agingLongTimeout()
+{
+    QCoapRttEstimator estimator;
+
+    // RTO = 0.5 * (10000 + 4 * 5000) + 0.5 * 2000
+    estimator.addSample(remoteHost, 10000, 0, 0);
+    QCOMPARE(estimator.retransmissionTimeout(remoteHost, 0), 16000u);
+
+    // Timeouts above 3 s move halfway to the initial timeout after 4 * RTO
+    QCOMPARE(estimator.retransmissionTimeout(remoteHost, 4 * 16000 - 1), 16000u);
+    QCOMPARE(estimator.retransmissionTimeout(remoteHost, 4 * 16000), 9000u);
+
+    const uint timeout = estimator.retransmissionTimeout(remoteHost, 3600 * 1000);
+    QVERIFY(timeout > 2000);
+    QVERIFY(timeout <= 3000);
+}
+
+void tst_QCoapRttEstimator::backoffFactor_data()
+{
+    QTest::addColumn<uint>("timeout");
+    QTest::addColumn<double>("factor");
+
+    QTest::newRow("lan") << 10u << 3.0;
+    QTest::newRow("below_1s") << 999u << 3.0;
+    QTest::newRow("default") << 2000u << 2.0;
+    QTest::newRow("3s") << 3000u << 2.0;
+    QTest::newRow("cellular") << 5000u << 1.5;
+}
+
+void tst_QCoapRttEstimator::backoffFactor()
+{
+    QFETCH(uint, timeout);
+    QFETCH(double, factor);
+
+    QCOMPARE(QCoapRttEstimator::backoffFactor(timeout), factor);
+}
+
+QTEST_MAIN(tst_QCoapRttEstimator)
+
+#include "tst_qcoaprttestimator.moc"
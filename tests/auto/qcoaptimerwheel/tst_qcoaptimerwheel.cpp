@@ -0,0 +1,212 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoaptimerwheel_p.h>
+
+class tst_QCoapTimerWheel : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void expireInOrder_data();
+    void expireInOrder();
+    void cancel();
+    void reschedule();
+    void pastDeadline();
+    void nextExpiry();
+    void destroyEntriesDuringBatch();
+    void destroyWheelFirst();
+};
+
+struct TestEntry : public QCoapTimerWheel::Entry
+{
+    int id = 0;
+};
+
+void tst_QCoapTimerWheel::expireInOrder_data()
+{
+    QTest::addColumn<qint64>("start");
+    QTest::addColumn<qint64>("step");
+
+    QTest::newRow("milliseconds") << qint64(0) << qint64(1);
+    QTest::newRow("seconds") << qint64(12345) << qint64(997);
+    QTest::newRow("minutes") << qint64(60000) << qint64(61001);
+    QTest::newRow("beyond_range") << qint64(1) << qint64(1 << 22);
+}
+
+void tst_QCoapTimerWheel::expireInOrder()
+{
+    QFETCH(qint64, start);
+    QFETCH(qint64, step);
+
+    QCoapTimerWheel wheel(start);
+    TestEntry entries[10];
+    for (int i = 0; i < 10; ++i) {
+        entries[i].id = i;
+        wheel.schedule(&entries[i], start + (i + 1) * step);
+        QVERIFY(entries[i].isScheduled());
+    }
+    QCOMPARE(wheel.size(), 10);
+
+    for (int i = 0; i < 10; ++i) {
+        const qint64 deadline = start + (i + 1) * step;
+
+        wheel.advance(deadline - 1);
+        QVERIFY(!wheel.takeExpired());
+        QVERIFY(wheel.nextExpiry() <= deadline);
+
+        wheel.advance(deadline);
+        auto entry = static_cast<TestEntry *>(wheel.takeExpired());
+        QVERIFY(entry);
+        QCOMPARE(entry->id, i);
+        QCOMPARE(entry->deadline(), deadline);
+        QVERIFY(!entry->isScheduled());
+        QVERIFY(!wheel.takeExpired());
+    }
+
+    QCOMPARE(wheel.size(), 0);
+    QCOMPARE(wheel.nextExpiry(), qint64(-1));
+}
+
+void tst_QCoapTimerWheel::cancel()
+{
+    QCoapTimerWheel wheel;
+    TestEntry first;
+    TestEntry second;
+
+    wheel.schedule(&first, 100);
+    wheel.schedule(&second, 100);
+    first.cancel();
+    QVERIFY(!first.isScheduled());
+    QCOMPARE(wheel.size(), 1);
+
+    wheel.advance(100);
+    QCOMPARE(wheel.takeExpired(), &second);
+    QVERIFY(!wheel.takeExpired());
+}
+
+void tst_QCoapTimerWheel::reschedule()
+{
+    QCoapTimerWheel wheel;
+    TestEntry entry;
+
+    wheel.schedule(&entry, 5000);
+    wheel.schedule(&entry, 50);
+    QCOMPARE(wheel.size(), 1);
+
+    wheel.advance(50);
+    QCOMPARE(wheel.takeExpired(), &entry);
+
+    wheel.schedule(&entry, 200);
+    wheel.schedule(&entry, 90000);
+    wheel.advance(89999);
+    QVERIFY(!wheel.takeExpired());
+    wheel.advance(90000);
+    QCOMPARE(wheel.takeExpired(), &entry);
+}
+
+void tst_QCoapTimerWheel::pastDeadline()
+{
+    QCoapTimerWheel wheel(1000);
+    TestEntry entry;
+
+    // Deadlines already reached expire at the next millisecond
+    wheel.schedule(&entry, 10);
+    QCOMPARE(wheel.nextExpiry(), qint64(1001));
+    wheel.advance(1001);
+    QCOMPARE(wheel.takeExpired(), &entry);
+}
+
+void tst_QCoapTimerWheel::nextExpiry()
+{
+    QCoapTimerWheel wheel;
+    TestEntry near;
+    TestEntry far;
+
+    QCOMPARE(wheel.nextExpiry(), qint64(-1));
+
+    wheel.schedule(&far, 100000);
+    QVERIFY(wheel.nextExpiry() > 0);
+    QVERIFY(wheel.nextExpiry() <= 100000);
+
+    wheel.schedule(&near, 30);
+    QCOMPARE(wheel.nextExpiry(), qint64(30));
+
+    wheel.advance(30);
+    QCOMPARE(wheel.nextExpiry(), qint64(30));
+    QCOMPARE(wheel.takeExpired(), &near);
+
+    // Advancing to each returned time eventually reaches the deadline
+    int wakeUps = 0;
+    while (!wheel.takeExpired()) {
+        const qint64 next = wheel.nextExpiry();
+        QVERIFY(next <= 100000);
+        wheel.advance(next);
+        QVERIFY(++wakeUps < 10);
+    }
+    QCOMPARE(wheel.currentTime(), qint64(100000));
+}
+
+void tst_QCoapTimerWheel::destroyEntriesDuringBatch()
+{
+    QCoapTimerWheel wheel;
+    QVector<TestEntry *> entries;
+    for (int i = 0; i < 3; ++i) {
+        entries.append(new TestEntry);
+        wheel.schedule(entries.last(), 10);
+    }
+    wheel.advance(20);
+    QCOMPARE(wheel.size(), 3);
+
+    // Handling an expiration may destroy entries which have expired too
+    auto entry = static_cast<TestEntry *>(wheel.takeExpired());
+    QVERIFY(entries.removeOne(entry));
+    delete entry;
+    qDeleteAll(entries);
+
+    QVERIFY(!wheel.takeExpired());
+    QCOMPARE(wheel.size(), 0);
+}
+
+void tst_QCoapTimerWheel::destroyWheelFirst()
+{
+    TestEntry entry;
+    {
+        QCoapTimerWheel wheel;
+        wheel.schedule(&entry, 1000);
+    }
+    QVERIFY(!entry.isScheduled());
+}
+
+QTEST_MAIN(tst_QCoapTimerWheel)
+
+#include "tst_qcoaptimerwheel.moc"
@@ -0,0 +1,141 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <private/qcoaptokengenerator_p.h>
+#include <private/qcoapnamespace_p.h>
+
+Q_DECLARE_METATYPE(QCoapTokenGenerator::Mode)
+
+class tst_QCoapTokenGenerator : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void tokenSize_data();
+    void tokenSize();
+    void compactTokensAreDistinct();
+    void randomTokensAreDistinct();
+    void fillSecureRandomFromThreads();
+};
+
+void tst_QCoapTokenGenerator::tokenSize_data()
+{
+    QTest::addColumn<QCoapTokenGenerator::Mode>("mode");
+    QTest::addColumn<int>("minimumSize");
+
+    for (int size = 1; size <= 8; ++size) {
+        QTest::addRow("random_%d", size) << QCoapTokenGenerator::Mode::Random << size;
+        QTest::addRow("compact_%d", size) << QCoapTokenGenerator::Mode::Compact << size;
+    }
+}
+
+void tst_QCoapTokenGenerator::tokenSize()
+{
+    QFETCH(QCoapTokenGenerator::Mode, mode);
+    QFETCH(int, minimumSize);
+
+    QCoapTokenGenerator generator;
+    generator.setMode(mode);
+    QCOMPARE(generator.mode(), mode);
+
+    for (int i = 0; i < 1000; ++i) {
+        const QCoapToken token = generator.generate(minimumSize);
+        QVERIFY(token.size() >= minimumSize);
+        QVERIFY(token.size() <= 8);
+        if (mode == QCoapTokenGenerator::Mode::Compact)
+            QCOMPARE(token.size(), minimumSize);
+    }
+}
+
+void tst_QCoapTokenGenerator::compactTokensAreDistinct()
+{
+    QCoapTokenGenerator generator;
+    generator.setMode(QCoapTokenGenerator::Mode::Compact);
+
+    // A full cycle of 2 bytes tokens goes through every value once
+    QSet<QCoapToken> tokens;
+    for (int i = 0; i < 0x10000; ++i)
+        tokens.insert(generator.generate(2));
+
+    QCOMPARE(tokens.size(), 0x10000);
+
+    tokens.clear();
+    for (int i = 0; i < 100000; ++i)
+        tokens.insert(generator.generate(4));
+
+    QCOMPARE(tokens.size(), 100000);
+}
+
+void tst_QCoapTokenGenerator::randomTokensAreDistinct()
+{
+    QCoapTokenGenerator generator;
+
+    QSet<QCoapToken> tokens;
+    for (int i = 0; i < 10000; ++i)
+        tokens.insert(generator.generate(8));
+
+    QCOMPARE(tokens.size(), 10000);
+}
+
+void tst_QCoapTokenGenerator::fillSecureRandomFromThreads()
+{
+    const int threadCount = 4;
+    const int drawCount = 10000;
+
+    QVector<QVector<quint64>> values(threadCount);
+    QVector<QThread *> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        QVector<quint64> *output = &values[i];
+        threads.append(QThread::create([output, drawCount]() {
+            for (int j = 0; j < drawCount; ++j) {
+                quint64 value = 0;
+                QtCoap::fillSecureRandom(&value, sizeof(value));
+                output->append(value);
+            }
+        }));
+        threads.last()->start();
+    }
+
+    QSet<quint64> allValues;
+    for (int i = 0; i < threadCount; ++i) {
+        QVERIFY(threads.at(i)->wait(10000));
+        delete threads.at(i);
+        for (quint64 value : qAsConst(values.at(i)))
+            allValues.insert(value);
+    }
+
+    QCOMPARE(allValues.size(), threadCount * drawCount);
+}
+
+QTEST_MAIN(tst_QCoapTokenGenerator)
+
+#include "tst_qcoaptokengenerator.moc"
@@ -0,0 +1,227 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapreply.h>
+#include <private/qcoapreply_p.h>
+#include <private/qcoapuploadsource_p.h>
+
+class tst_QCoapUploadSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_QCoapUploadSource() { qRegisterMetaType<QCoapToken>("QCoapToken"); }
+
+private Q_SLOTS:
+    void randomAccessDevice();
+    void sequentialDevice();
+    void boundedReadAhead();
+    void outOfSequenceBlock();
+    void uploadProgress();
+};
+
+/*
+    A pipe-like device, whose data is fed by the test.
+*/
+class SequentialDevice : public QIODevice
+{
+public:
+    SequentialDevice() { open(QIODevice::ReadOnly); }
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return data.size() + QIODevice::bytesAvailable(); }
+
+    void feed(const QByteArray &bytes)
+    {
+        data.append(bytes);
+        emit readyRead();
+    }
+    void finish() { emit readChannelFinished(); }
+
+protected:
+    qint64 readData(char *buffer, qint64 maxSize) override
+    {
+        const int size = static_cast<int>(qMin(maxSize, qint64(data.size())));
+        memcpy(buffer, data.constData(), static_cast<size_t>(size));
+        data.remove(0, size);
+        return size;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QByteArray data;
+};
+
+static QByteArray testData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+        data[i] = static_cast<char>(i % 251);
+    return data;
+}
+
+void tst_QCoapUploadSource::randomAccessDevice()
+{
+    const QByteArray data = testData(2500);
+    QBuffer buffer;
+    buffer.setData(data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QCoapUploadSource source(&buffer, reply.data());
+    QSignalSpy spyBlockRead(&source, &QCoapUploadSource::blockRead);
+    QCOMPARE(source.totalSize(), qint64(2500));
+
+    const QCoapToken token("token");
+    for (uint block = 0; block < 3; ++block) {
+        source.readBlock(token, block, 1024);
+        QCOMPARE(spyBlockRead.count(), 1);
+
+        const QList<QVariant> arguments = spyBlockRead.takeFirst();
+        QCOMPARE(arguments.at(0).toByteArray(), token);
+        QCOMPARE(arguments.at(1).toUInt(), block);
+        QCOMPARE(arguments.at(2).toByteArray(), data.mid(static_cast<int>(block * 1024), 1024));
+        QCOMPARE(arguments.at(3).toBool(), block < 2);
+    }
+    QVERIFY(source.isAtEnd());
+}
+
+void tst_QCoapUploadSource::sequentialDevice()
+{
+    SequentialDevice device;
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QCoapUploadSource source(&device, reply.data());
+    QSignalSpy spyBlockRead(&source, &QCoapUploadSource::blockRead);
+    QCOMPARE(source.totalSize(), qint64(-1));
+
+    // The first block is delivered once it is known whether another follows
+    source.readBlock("token", 0, 16);
+    QCOMPARE(spyBlockRead.count(), 0);
+    device.feed(QByteArray(10, 'a'));
+    QCOMPARE(spyBlockRead.count(), 0);
+    device.feed(QByteArray(6, 'a'));
+    QCOMPARE(spyBlockRead.count(), 0);
+    device.feed(QByteArray(4, 'b'));
+    QCOMPARE(spyBlockRead.count(), 1);
+
+    QList<QVariant> arguments = spyBlockRead.takeFirst();
+    QCOMPARE(arguments.at(2).toByteArray(), QByteArray(16, 'a'));
+    QCOMPARE(arguments.at(3).toBool(), true);
+
+    // The last block is delivered at the end of the device
+    source.readBlock("token", 1, 16);
+    QCOMPARE(spyBlockRead.count(), 0);
+    device.finish();
+    QCOMPARE(spyBlockRead.count(), 1);
+
+    arguments = spyBlockRead.takeFirst();
+    QCOMPARE(arguments.at(1).toUInt(), 1u);
+    QCOMPARE(arguments.at(2).toByteArray(), QByteArray(4, 'b'));
+    QCOMPARE(arguments.at(3).toBool(), false);
+    QVERIFY(source.isAtEnd());
+    QCOMPARE(source.totalSize(), qint64(20));
+}
+
+void tst_QCoapUploadSource::boundedReadAhead()
+{
+    SequentialDevice device;
+    device.feed(testData(1000));
+
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QCoapUploadSource source(&device, reply.data());
+    QSignalSpy spyBlockRead(&source, &QCoapUploadSource::blockRead);
+
+    // At most the requested block, the next one and one more byte are read
+    source.readBlock("token", 0, 64);
+    QCOMPARE(spyBlockRead.count(), 1);
+    QCOMPARE(source.bufferedSize(), qint64(129));
+    QCOMPARE(device.bytesAvailable(), qint64(1000 - 129));
+
+    source.readBlock("token", 1, 64);
+    QCOMPARE(spyBlockRead.count(), 2);
+    QCOMPARE(source.bufferedSize(), qint64(129));
+    QCOMPARE(spyBlockRead.at(1).at(2).toByteArray(), testData(1000).mid(64, 64));
+}
+
+void tst_QCoapUploadSource::outOfSequenceBlock()
+{
+    QBuffer buffer;
+    buffer.setData(testData(4096));
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    QCoapUploadSource source(&buffer, reply.data());
+    QSignalSpy spyBlockRead(&source, &QCoapUploadSource::blockRead);
+    QSignalSpy spyReadFailed(&source, &QCoapUploadSource::readFailed);
+
+    source.readBlock("token", 2, 256);
+    QCOMPARE(spyBlockRead.count(), 0);
+    QCOMPARE(spyReadFailed.count(), 1);
+
+    source.readBlock("token", 0, 256);
+    source.readBlock("token", 1, 256);
+    QCOMPARE(spyBlockRead.count(), 2);
+
+    source.readBlock("token", 0, 256);
+    QCOMPARE(spyBlockRead.count(), 2);
+    QCOMPARE(spyReadFailed.count(), 2);
+}
+
+void tst_QCoapUploadSource::uploadProgress()
+{
+    QBuffer buffer;
+    buffer.setData(testData(100));
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    QScopedPointer<QCoapReply> reply(QCoapReplyPrivate::createCoapReply(QCoapRequest()));
+    auto source = new QCoapUploadSource(&buffer, reply.data());
+    QCoapReplyPrivate::get(reply.data())->uploadSource = source;
+    QSignalSpy spyProgress(reply.data(), &QCoapReply::uploadProgress);
+
+    // Requesting a block acknowledges the previous ones
+    source->readBlock("token", 0, 32);
+    QCOMPARE(spyProgress.count(), 0);
+    source->readBlock("token", 1, 32);
+    QCOMPARE(spyProgress.count(), 1);
+    QCOMPARE(spyProgress.at(0).at(0).toLongLong(), qint64(32));
+    QCOMPARE(spyProgress.at(0).at(1).toLongLong(), qint64(100));
+
+    QMetaObject::invokeMethod(reply.data(), "_q_setFinished",
+                              Q_ARG(QtCoap::Error, QtCoap::Error::Ok));
+    QCOMPARE(spyProgress.count(), 2);
+    QCOMPARE(spyProgress.at(1).at(0).toLongLong(), qint64(100));
+    QCOMPARE(spyProgress.at(1).at(1).toLongLong(), qint64(100));
+}
+
+QTEST_MAIN(tst_QCoapUploadSource)
+
+#include "tst_qcoapuploadsource.moc"
@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    qcoapclient
+
+qtConfig(private_tests): SUBDIRS += \
+    qcoapprotocol \
+    qcoapqudpconnection
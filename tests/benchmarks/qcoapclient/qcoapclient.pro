@@ -0,0 +1,6 @@
+TARGET = tst_bench_qcoapclient
+QT = testlib network core coap
+CONFIG += benchmark
+
+SOURCES += \
+    tst_bench_qcoapclient.cpp
@@ -0,0 +1,246 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoapclient.h>
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapreply.h>
+#include <QtNetwork/qudpsocket.h>
+#include <QtNetwork/qnetworkdatagram.h>
+
+/*
+    A server answering each request with a piggybacked 2.05 Content
+    response, in its own thread so that the servers are not the bottleneck.
+*/
+class LoopbackServer : public QThread
+{
+public:
+    quint16 port() const { return static_cast<quint16>(serverPort.loadAcquire()); }
+
+protected:
+    void run() override
+    {
+        QUdpSocket socket;
+        if (!socket.bind(QHostAddress::LocalHost, 0))
+            return;
+        serverPort.storeRelease(socket.localPort());
+
+        while (!isInterruptionRequested()) {
+            if (!socket.waitForReadyRead(100))
+                continue;
+
+            while (socket.hasPendingDatagrams()) {
+                const QNetworkDatagram datagram = socket.receiveDatagram();
+                const QByteArray request = datagram.data();
+                if (request.size() < 4)
+                    continue;
+
+                const int tokenLength = request.at(0) & 0x0F;
+                QByteArray response;
+                response.append(static_cast<char>(0x60 | tokenLength));
+                response.append(static_cast<char>(0x45));
+                response.append(request.mid(2, 2 + tokenLength));
+                response.append(static_cast<char>(0xFF));
+                response.append("21.5");
+                socket.writeDatagram(datagram.makeReply(response));
+            }
+        }
+    }
+
+private:
+    QAtomicInt serverPort;
+};
+
+class tst_QCoapClient : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void requestThroughput_data();
+    void requestThroughput();
+    void callbackThroughput_data();
+    void callbackThroughput();
+    void batchThroughput_data();
+    void batchThroughput();
+
+private:
+    QVector<LoopbackServer *> servers;
+};
+
+// Servers, each one on its own endpoint, and requests sent per iteration
+static const int serverCount = 16;
+static const int requestCount = 4096;
+
+void tst_QCoapClient::initTestCase()
+{
+    for (int i = 0; i < serverCount; ++i) {
+        auto server = new LoopbackServer;
+        server->start();
+        servers.append(server);
+    }
+
+    for (LoopbackServer *server : qAsConst(servers))
+        QTRY_VERIFY(server->port() != 0);
+}
+
+void tst_QCoapClient::cleanupTestCase()
+{
+    for (LoopbackServer *server : qAsConst(servers)) {
+        server->requestInterruption();
+        server->wait();
+    }
+    qDeleteAll(servers);
+    servers.clear();
+}
+
+void tst_QCoapClient::requestThroughput_data()
+{
+    QTest::addColumn<int>("workerThreadCount");
+
+    QTest::newRow("1_thread") << 1;
+    QTest::newRow("2_threads") << 2;
+    QTest::newRow("4_threads") << 4;
+    QTest::newRow("8_threads") << 8;
+}
+
+void tst_QCoapClient::requestThroughput()
+{
+    QFETCH(int, workerThreadCount);
+
+    QCoapClient client(QtCoap::SecurityMode::NoSecurity, workerThreadCount);
+
+    QVector<QCoapRequest> requests;
+    for (LoopbackServer *server : qAsConst(servers))
+        requests.append(QCoapRequest(QStringLiteral("coap://127.0.0.1:%1/temperature")
+                                     .arg(server->port())));
+
+    int finished = 0;
+    connect(&client, &QCoapClient::finished, [&finished](QCoapReply *reply) {
+        ++finished;
+        reply->deleteLater();
+    });
+
+    QBENCHMARK {
+        finished = 0;
+        for (int i = 0; i < requestCount; ++i)
+            client.get(requests.at(i % serverCount));
+        QTRY_COMPARE_WITH_TIMEOUT(finished, requestCount, 30000);
+    }
+}
+
+void tst_QCoapClient::callbackThroughput_data()
+{
+    QTest::addColumn<bool>("useCallback");
+
+    QTest::newRow("reply") << false;
+    QTest::newRow("callback") << true;
+}
+
+void tst_QCoapClient::callbackThroughput()
+{
+    QFETCH(bool, useCallback);
+
+    QCoapClient client;
+
+    QVector<QCoapRequest> requests;
+    for (LoopbackServer *server : qAsConst(servers))
+        requests.append(QCoapRequest(QStringLiteral("coap://127.0.0.1:%1/temperature")
+                                     .arg(server->port())));
+
+    int finished = 0;
+    connect(&client, &QCoapClient::finished, [&finished](QCoapReply *reply) {
+        ++finished;
+        reply->deleteLater();
+    });
+    const QCoapResultCallback callback = [&finished](QCoapResult result) {
+        if (result.isSuccessful())
+            ++finished;
+    };
+
+    QBENCHMARK {
+        finished = 0;
+        for (int i = 0; i < requestCount; ++i) {
+            if (useCallback)
+                client.get(requests.at(i % serverCount), callback);
+            else
+                client.get(requests.at(i % serverCount));
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(finished, requestCount, 30000);
+    }
+}
+
+void tst_QCoapClient::batchThroughput_data()
+{
+    QTest::addColumn<bool>("useBatch");
+    QTest::addColumn<int>("maximumConcurrency");
+
+    QTest::newRow("callbacks") << false << 0;
+    QTest::newRow("batch") << true << 0;
+    QTest::newRow("batch_64_running") << true << 64;
+}
+
+void tst_QCoapClient::batchThroughput()
+{
+    QFETCH(bool, useBatch);
+    QFETCH(int, maximumConcurrency);
+
+    QCoapClient client;
+
+    QVector<QCoapRequest> requests;
+    for (int i = 0; i < requestCount; ++i) {
+        requests.append(QCoapRequest(QStringLiteral("coap://127.0.0.1:%1/temperature")
+                                     .arg(servers.at(i % serverCount)->port())));
+    }
+
+    int finished = 0;
+    const QCoapResultCallback callback = [&finished](QCoapResult result) {
+        if (result.isSuccessful())
+            ++finished;
+    };
+
+    QBENCHMARK {
+        if (useBatch) {
+            const QCoapBatch batch = client.getBatch(requests, maximumConcurrency);
+            QTRY_VERIFY_WITH_TIMEOUT(batch.isFinished(), 30000);
+        } else {
+            finished = 0;
+            for (const QCoapRequest &request : qAsConst(requests))
+                client.get(request, callback);
+            QTRY_COMPARE_WITH_TIMEOUT(finished, requestCount, 30000);
+        }
+    }
+}
+
+QTEST_MAIN(tst_QCoapClient)
+
+#include "tst_bench_qcoapclient.moc"
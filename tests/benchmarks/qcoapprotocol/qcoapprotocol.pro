@@ -0,0 +1,6 @@
+TARGET = tst_bench_qcoapprotocol
+QT = testlib network core coap coap-private
+CONFIG += benchmark
+
+SOURCES += \
+    tst_bench_qcoapprotocol.cpp
@@ -0,0 +1,397 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtCoap/qcoaprequest.h>
+#include <QtCoap/qcoapreply.h>
+#include <private/qcoapprotocol_p.h>
+#include <private/qcoapinternalrequest_p.h>
+#include <private/qcoapinternalreply_p.h>
+#include <private/qcoappduview_p.h>
+#include <private/qcoaprequest_p.h>
+#include <private/qcoapreply_p.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+class tst_QCoapProtocol : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void unmatchedFrameReceived_data();
+    void unmatchedFrameReceived();
+    void findRequestByMessageId_data();
+    void findRequestByMessageId();
+    void findRequestByUserReply_data();
+    void findRequestByUserReply();
+    void requestForToken_data();
+    void requestForToken();
+    void generateUniqueToken_data();
+    void generateUniqueToken();
+    void decodeFrame_data();
+    void decodeFrame();
+    void encodeFrame_data();
+    void encodeFrame();
+
+private:
+    void addExchangeCountColumn();
+};
+
+/*
+    Registers exchanges directly in the protocol, bypassing the transport,
+    so that the matching cost can be measured for any table size.
+*/
+class ExchangeTable
+{
+public:
+    explicit ExchangeTable(int count)
+    {
+        d = static_cast<QCoapProtocolPrivate *>(QObjectPrivate::get(&protocol));
+
+        for (int i = 0; i < count; ++i) {
+            const QHostAddress host(static_cast<quint32>(0x0A000000 + i));
+            QUrl url;
+            url.setScheme(QLatin1String("coap"));
+            url.setHost(host.toString());
+            url.setPath(QLatin1String("/sensor"));
+
+            const auto request = QCoapRequestPrivate::createRequest(QCoapRequest(url),
+                                                                    QtCoap::Method::Get);
+            QCoapReply *reply = QCoapReplyPrivate::createCoapReply(request, &replyParent);
+
+            auto internalRequest = QSharedPointer<QCoapInternalRequest>::create(request);
+            const auto messageId = static_cast<quint16>(i % 0xFFFF + 1);
+            internalRequest->setMessageId(messageId);
+            QCoapToken token(8, Qt::Uninitialized);
+            qToBigEndian(static_cast<quint64>(i) + 1, token.data());
+            internalRequest->setToken(token);
+
+            d->registerExchange(token, reply, internalRequest);
+
+            lastHost = host;
+            lastMessageId = messageId;
+            lastToken = token;
+            lastReply = reply;
+        }
+    }
+
+    QObject replyParent;
+    QCoapProtocol protocol;
+    QCoapProtocolPrivate *d = nullptr;
+
+    QHostAddress lastHost;
+    quint16 lastMessageId = 0;
+    QCoapToken lastToken;
+    QCoapReply *lastReply = nullptr;
+};
+
+void tst_QCoapProtocol::addExchangeCountColumn()
+{
+    QTest::addColumn<int>("exchangeCount");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+    QTest::newRow("100000") << 100000;
+}
+
+void tst_QCoapProtocol::unmatchedFrameReceived_data()
+{
+    addExchangeCountColumn();
+}
+
+void tst_QCoapProtocol::unmatchedFrameReceived()
+{
+    QFETCH(int, exchangeCount);
+
+    ExchangeTable table(exchangeCount);
+
+    // Non-confirmable 2.05 Content with an unknown token: the frame is
+    // decoded, looked up by token and message id, then dropped.
+    const QByteArray frame = QByteArray::fromHex("5445fffe0badc0deff") + "payload";
+    const QHostAddress sender(QStringLiteral("192.168.1.1"));
+
+    QBENCHMARK {
+        table.d->onFrameReceived(frame, sender);
+    }
+}
+
+void tst_QCoapProtocol::findRequestByMessageId_data()
+{
+    addExchangeCountColumn();
+}
+
+void tst_QCoapProtocol::findRequestByMessageId()
+{
+    QFETCH(int, exchangeCount);
+
+    ExchangeTable table(exchangeCount);
+    QCoapInternalRequest *request = nullptr;
+
+    QBENCHMARK {
+        request = table.d->findRequestByMessageId(table.lastHost, table.lastMessageId);
+    }
+
+    QVERIFY(request);
+    QCOMPARE(request->token(), table.lastToken);
+}
+
+void tst_QCoapProtocol::findRequestByUserReply_data()
+{
+    addExchangeCountColumn();
+}
+
+void tst_QCoapProtocol::findRequestByUserReply()
+{
+    QFETCH(int, exchangeCount);
+
+    ExchangeTable table(exchangeCount);
+    QCoapInternalRequest *request = nullptr;
+
+    QBENCHMARK {
+        request = table.d->findRequestByUserReply(table.lastReply);
+    }
+
+    QVERIFY(request);
+    QCOMPARE(request->token(), table.lastToken);
+}
+
+void tst_QCoapProtocol::requestForToken_data()
+{
+    addExchangeCountColumn();
+}
+
+void tst_QCoapProtocol::requestForToken()
+{
+    QFETCH(int, exchangeCount);
+
+    ExchangeTable table(exchangeCount);
+    QCoapInternalRequest *request = nullptr;
+
+    QBENCHMARK {
+        request = table.d->requestForToken(table.lastToken);
+    }
+
+    QVERIFY(request);
+    QVERIFY(table.d->isRequestRegistered(request));
+}
+
+void tst_QCoapProtocol::generateUniqueToken_data()
+{
+    QTest::addColumn<bool>("compact");
+    QTest::addColumn<int>("exchangeCount");
+
+    QTest::newRow("random_0") << false << 0;
+    QTest::newRow("random_100000") << false << 100000;
+    QTest::newRow("compact_0") << true << 0;
+    QTest::newRow("compact_100000") << true << 100000;
+}
+
+void tst_QCoapProtocol::generateUniqueToken()
+{
+    QFETCH(bool, compact);
+    QFETCH(int, exchangeCount);
+
+    ExchangeTable table(exchangeCount);
+    table.protocol.setCompactTokensEnabled(compact);
+    QCoapToken token;
+
+    QBENCHMARK {
+        token = table.d->generateUniqueToken();
+    }
+
+    QVERIFY(token.size() >= 4);
+}
+
+/*
+    Returns the number of bytes allocated on the heap, or -1 if it cannot be
+    measured.
+*/
+static qint64 heapUsage()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    return qint64(mallinfo2().uordblks);
+#elif defined(__GLIBC__)
+    return qint64(mallinfo().uordblks);
+#else
+    return -1;
+#endif
+}
+
+void tst_QCoapProtocol::decodeFrame_data()
+{
+    QTest::addColumn<bool>("materialize");
+
+    QTest::newRow("view") << false;
+    QTest::newRow("internal_reply") << true;
+}
+
+void tst_QCoapProtocol::decodeFrame()
+{
+    QFETCH(bool, materialize);
+
+    // 2.05 Content with ETag, Content-Format, Max-Age and Block2 options
+    const QByteArray frame = QByteArray::fromHex("6445fbcf4647f09b"
+                                                 "44cafebabe"
+                                                 "80"
+                                                 "211e"
+                                                 "910a"
+                                                 "ff") + QByteArray(64, 'p');
+
+    QBENCHMARK {
+        const QCoapPduView pdu(frame);
+        if (materialize)
+            delete QCoapInternalReply::createFromView(pdu);
+    }
+
+    if (!materialize || heapUsage() < 0)
+        return;
+
+    // The reply of a matched frame points into the frame, so the memory it
+    // allocates does not depend on the size of its payload
+    const QCoapPduView pdu(frame);
+    const QByteArray largeFrame = frame + QByteArray(1024, 'p');
+    const QCoapPduView largePdu(largeFrame);
+
+    qint64 before = heapUsage();
+    QScopedPointer<QCoapInternalReply> reply(QCoapInternalReply::createFromView(pdu));
+    const qint64 allocated = heapUsage() - before;
+
+    before = heapUsage();
+    QScopedPointer<QCoapInternalReply> largeReply(QCoapInternalReply::createFromView(largePdu));
+    const qint64 largeAllocated = heapUsage() - before;
+
+    qDebug() << "Bytes allocated for a matched frame:" << allocated;
+    QCOMPARE(largeAllocated, allocated);
+}
+
+/*
+    The encoder used before QCoapInternalRequest::encode(), appending the
+    frame byte by byte, kept as a reference for the encodeFrame benchmark.
+*/
+static QByteArray appendingEncode(const QCoapInternalRequest &request)
+{
+    const QCoapMessage *message = request.message();
+    QByteArray pdu;
+
+    pdu.append(static_cast<char>((message->version() << 6)
+                                 | (static_cast<quint8>(message->type()) << 4)
+                                 | message->token().length()));
+    pdu.append(static_cast<char>(static_cast<quint8>(request.method())));
+    pdu.append(static_cast<char>(message->messageId() >> 8));
+    pdu.append(static_cast<char>(message->messageId() & 0xFF));
+    pdu.append(message->token());
+
+    const QVector<QCoapOption> options = message->options();
+    quint16 lastOptionNumber = 0;
+    for (const QCoapOption &option : options) {
+        quint16 optionDelta = static_cast<quint16>(option.name()) - lastOptionNumber;
+        quint16 optionLength = static_cast<quint16>(option.length());
+        QByteArray extended;
+        for (quint16 *value : { &optionDelta, &optionLength }) {
+            if (*value > 268) {
+                extended.append(static_cast<char>((*value - 269) >> 8));
+                extended.append(static_cast<char>((*value - 269) & 0xFF));
+                *value = 14;
+            } else if (*value > 12) {
+                extended.append(static_cast<char>(*value - 13));
+                *value = 13;
+            }
+        }
+        pdu.append(static_cast<char>((optionDelta << 4) | optionLength));
+        pdu.append(extended);
+        pdu.append(option.opaqueValue());
+        lastOptionNumber = static_cast<quint16>(option.name());
+    }
+
+    if (!message->payload().isEmpty()) {
+        pdu.append(static_cast<char>(0xFF));
+        pdu.append(message->payload());
+    }
+
+    return pdu;
+}
+
+void tst_QCoapProtocol::encodeFrame_data()
+{
+    QTest::addColumn<QString>("encoder");
+
+    QTest::newRow("appending") << QString("appending");
+    QTest::newRow("exact_size") << QString("exact_size");
+    QTest::newRow("reused_buffer") << QString("reused_buffer");
+    QTest::newRow("cached") << QString("cached");
+}
+
+void tst_QCoapProtocol::encodeFrame()
+{
+    QFETCH(QString, encoder);
+
+    QCoapRequest request(QUrl("coap://10.20.30.40:5683/sensors/temperature/living-room?unit=c"));
+    request.setMessageId(56400);
+    request.setToken(QByteArray::fromHex("4647f09b"));
+    request.addOption(QCoapOption(QCoapOption::Accept, quint32(50)));
+    request.setPayload(QByteArray(64, 'p'));
+    QCoapInternalRequest internalRequest(
+                QCoapRequestPrivate::createRequest(request, QtCoap::Method::Put));
+
+    const QByteArray expected = internalRequest.toQByteArray();
+    QByteArray frame;
+
+    if (encoder == QLatin1String("appending")) {
+        QBENCHMARK {
+            frame = appendingEncode(internalRequest);
+        }
+    } else if (encoder == QLatin1String("exact_size")) {
+        QBENCHMARK {
+            QByteArray pdu;
+            internalRequest.encode(&pdu);
+            frame = pdu;
+        }
+    } else if (encoder == QLatin1String("reused_buffer")) {
+        QBENCHMARK {
+            internalRequest.encode(&frame);
+        }
+    } else {
+        // Retransmission of an unchanged request
+        QBENCHMARK {
+            frame = internalRequest.encodedFrame();
+        }
+    }
+
+    QCOMPARE(frame, expected);
+}
+
+QTEST_MAIN(tst_QCoapProtocol)
+
+#include "tst_bench_qcoapprotocol.moc"
@@ -0,0 +1,142 @@
+/****************************************************************************
+**
+** Copyright (C) 2020 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the QtCoap module.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtTest>
+#include <QCoreApplication>
+
+#include <QtNetwork/qudpsocket.h>
+#include <QtNetwork/qnetworkdatagram.h>
+#include <private/qcoapqudpconnection_p.h>
+
+class tst_QCoapQUdpConnection : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void receiveBurst_data();
+    void receiveBurst();
+    void sendBurst_data();
+    void sendBurst();
+
+private:
+    void addBatchingColumn();
+};
+
+class QCoapQUdpConnectionForBenchmark : public QCoapQUdpConnection
+{
+    Q_OBJECT
+public:
+    explicit QCoapQUdpConnectionForBenchmark(bool batching)
+    {
+        d_func()->datagramBatching = batching;
+    }
+
+    void sendRequest(const QByteArray &request, const QString &host, quint16 port)
+    {
+        d_func()->sendRequest(request, QCoapEndpoint::fromHost(host, port));
+    }
+};
+
+// Datagrams exchanged on the loopback interface per iteration
+static const int burstSize = 64;
+
+// A non-confirmable 2.05 Content response with a short payload
+static const QByteArray frame = QByteArray::fromHex("5445fffe0badc0deff") + QByteArray(64, 'p');
+
+void tst_QCoapQUdpConnection::addBatchingColumn()
+{
+    QTest::addColumn<bool>("batching");
+
+    QTest::newRow("one_by_one") << false;
+    QTest::newRow("batched") << true;
+}
+
+void tst_QCoapQUdpConnection::receiveBurst_data()
+{
+    addBatchingColumn();
+}
+
+void tst_QCoapQUdpConnection::receiveBurst()
+{
+    QFETCH(bool, batching);
+
+    QUdpSocket peer;
+    QVERIFY(peer.bind(QHostAddress::LocalHost, 0));
+
+    QCoapQUdpConnectionForBenchmark connection(batching);
+    int received = 0;
+    connect(&connection, &QCoapConnection::readyRead, [&]() { ++received; });
+
+    // Binds the connection
+    connection.sendRequest(frame, QStringLiteral("127.0.0.1"), peer.localPort());
+    QTRY_VERIFY(peer.hasPendingDatagrams());
+    const quint16 port = connection.socket()->localPort();
+
+    QBENCHMARK {
+        received = 0;
+        for (int i = 0; i < burstSize; ++i)
+            peer.writeDatagram(frame, QHostAddress::LocalHost, port);
+        QTRY_COMPARE(received, burstSize);
+    }
+}
+
+void tst_QCoapQUdpConnection::sendBurst_data()
+{
+    addBatchingColumn();
+}
+
+void tst_QCoapQUdpConnection::sendBurst()
+{
+    QFETCH(bool, batching);
+
+    QUdpSocket peer;
+    QVERIFY(peer.bind(QHostAddress::LocalHost, 0));
+    peer.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, 4 * 1024 * 1024);
+
+    QCoapQUdpConnectionForBenchmark connection(batching);
+    const QString host = QStringLiteral("127.0.0.1");
+
+    QBENCHMARK {
+        for (int i = 0; i < burstSize; ++i)
+            connection.sendRequest(frame, host, peer.localPort());
+
+        int received = 0;
+        QTRY_VERIFY([&]() {
+            while (peer.hasPendingDatagrams()) {
+                peer.receiveDatagram();
+                ++received;
+            }
+            return received == burstSize;
+        }());
+    }
+}
+
+QTEST_MAIN(tst_QCoapQUdpConnection)
+
+#include "tst_bench_qcoapqudpconnection.moc"